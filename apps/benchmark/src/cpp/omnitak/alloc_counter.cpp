@@ -0,0 +1,140 @@
+/**
+ * alloc_counter.cpp - malloc interposition for alloc_counter.h
+ *
+ * The real allocator is found with dlsym(RTLD_NEXT). dlsym may itself call
+ * calloc before that lookup finishes, so early requests are served from a
+ * small static arena that is never freed.
+ */
+
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <dlfcn.h>
+
+namespace {
+
+using MallocFn = void* (*)(size_t);
+using CallocFn = void* (*)(size_t, size_t);
+using ReallocFn = void* (*)(void*, size_t);
+using FreeFn = void (*)(void*);
+using MemalignFn = int (*)(void**, size_t, size_t);
+
+MallocFn g_real_malloc = nullptr;
+CallocFn g_real_calloc = nullptr;
+ReallocFn g_real_realloc = nullptr;
+FreeFn g_real_free = nullptr;
+MemalignFn g_real_posix_memalign = nullptr;
+
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_bytes{0};
+thread_local bool t_ignored = false;
+
+alignas(16) char g_bootstrap[16 * 1024];
+size_t g_bootstrap_used = 0;
+bool g_resolving = false;
+
+bool in_bootstrap(void* pointer) {
+    return pointer >= (void*)g_bootstrap && pointer < (void*)(g_bootstrap + sizeof(g_bootstrap));
+}
+
+void* bootstrap_alloc(size_t size) {
+    size_t offset = (g_bootstrap_used + 15) & ~(size_t)15;
+    if (offset + size > sizeof(g_bootstrap)) {
+        return nullptr;
+    }
+    g_bootstrap_used = offset + size;
+    return g_bootstrap + offset; // Static storage, already zeroed
+}
+
+void resolve() {
+    if (g_real_free || g_resolving) {
+        return;
+    }
+    g_resolving = true;
+    g_real_malloc = (MallocFn)dlsym(RTLD_NEXT, "malloc");
+    g_real_calloc = (CallocFn)dlsym(RTLD_NEXT, "calloc");
+    g_real_realloc = (ReallocFn)dlsym(RTLD_NEXT, "realloc");
+    g_real_posix_memalign = (MemalignFn)dlsym(RTLD_NEXT, "posix_memalign");
+    g_real_free = (FreeFn)dlsym(RTLD_NEXT, "free");
+    g_resolving = false;
+}
+
+void count(size_t size) {
+    if (!t_ignored) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        g_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+// Resolve before main() so no thread races the lookup
+__attribute__((constructor)) void resolve_at_load() {
+    resolve();
+}
+
+} // namespace
+
+AllocCounts alloc_counts() {
+    return {g_allocations.load(std::memory_order_relaxed), g_bytes.load(std::memory_order_relaxed)};
+}
+
+void alloc_counter_ignore_thread() {
+    t_ignored = true;
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    resolve();
+    if (!g_real_malloc) {
+        return bootstrap_alloc(size);
+    }
+    count(size);
+    return g_real_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+    resolve();
+    if (!g_real_calloc) {
+        return bootstrap_alloc(nmemb * size);
+    }
+    count(nmemb * size);
+    return g_real_calloc(nmemb, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    resolve();
+    if (in_bootstrap(pointer) || !g_real_realloc) {
+        void* moved = malloc(size);
+        if (moved && pointer) {
+            size_t available = (size_t)(g_bootstrap + sizeof(g_bootstrap) - (char*)pointer);
+            memcpy(moved, pointer, size < available ? size : available);
+        }
+        return moved;
+    }
+    count(size);
+    return g_real_realloc(pointer, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    resolve();
+    if (!g_real_posix_memalign) {
+        *out = bootstrap_alloc(size);
+        return *out ? 0 : 12; // ENOMEM
+    }
+    count(size);
+    return g_real_posix_memalign(out, alignment, size);
+}
+
+void free(void* pointer) {
+    if (!pointer || in_bootstrap(pointer)) {
+        return;
+    }
+    resolve();
+    if (g_real_free) {
+        g_real_free(pointer);
+    }
+}
+
+} // extern "C"
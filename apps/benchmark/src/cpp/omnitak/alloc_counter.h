@@ -0,0 +1,24 @@
+/**
+ * alloc_counter.h - Process-wide heap allocation counter for native benchmarks
+ *
+ * Linking alloc_counter.cpp into an executable interposes malloc, calloc,
+ * realloc and posix_memalign for the whole process, including the Rust
+ * static library, and counts every allocation. Threads that belong to the
+ * harness rather than the code under test (the loopback server) opt out
+ * with alloc_counter_ignore_thread().
+ */
+
+#pragma once
+
+#include <cstdint>
+
+struct AllocCounts {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+// Totals since process start, excluding ignored threads
+AllocCounts alloc_counts();
+
+// Stop counting allocations made by the calling thread
+void alloc_counter_ignore_thread();
@@ -0,0 +1,216 @@
+/**
+ * cot_loopback_server.cpp - Loopback CoT server for the throughput benchmark
+ */
+
+#include "cot_loopback_server.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "alloc_counter.h"
+
+static const char kEventEnd[] = "</event>";
+static const size_t kEventEndLength = sizeof(kEventEnd) - 1;
+static const size_t kReadBufferSize = 256 * 1024;
+
+void cot_bench_stamp(char* digits, uint64_t sequence) {
+    for (size_t i = kCotBenchSequenceDigits; i > 0; --i) {
+        digits[i - 1] = (char)('0' + sequence % 10);
+        sequence /= 10;
+    }
+}
+
+bool cot_bench_sequence(const char* xml, size_t length, uint64_t* out) {
+    const size_t attrLength = sizeof(kCotBenchSequenceAttr) - 1;
+    const char* found = (const char*)memmem(xml, length, kCotBenchSequenceAttr, attrLength);
+    if (!found || (size_t)(xml + length - found) < attrLength + kCotBenchSequenceDigits) {
+        return false;
+    }
+    const char* digits = found + attrLength;
+    uint64_t sequence = 0;
+    for (size_t i = 0; i < kCotBenchSequenceDigits; ++i) {
+        if (digits[i] < '0' || digits[i] > '9') {
+            return false;
+        }
+        sequence = sequence * 10 + (uint64_t)(digits[i] - '0');
+    }
+    *out = sequence;
+    return true;
+}
+
+static int64_t thread_cpu_now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+CotLoopbackServer::~CotLoopbackServer() {
+    stop();
+}
+
+bool CotLoopbackServer::start() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        return false;
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    socklen_t length = sizeof(address);
+    if (bind(listen_fd_, (sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listen_fd_, 1) != 0 ||
+        getsockname(listen_fd_, (sockaddr*)&address, &length) != 0) {
+        return false;
+    }
+    port_ = ntohs(address.sin_port);
+    return true;
+}
+
+bool CotLoopbackServer::accept_client(int timeout_ms) {
+    pollfd ready = {listen_fd_, POLLIN, 0};
+    if (poll(&ready, 1, timeout_ms) != 1) {
+        return false;
+    }
+    client_fd_ = accept(listen_fd_, nullptr, nullptr);
+    if (client_fd_ < 0) {
+        return false;
+    }
+    // Latency runs send one small event at a time; don't let Nagle hold them back
+    int noDelay = 1;
+    setsockopt(client_fd_, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return true;
+}
+
+void CotLoopbackServer::stream(const std::vector<CotBenchMessage>& messages, uint64_t count, uint32_t rate,
+                               std::vector<int64_t>& sent_ns) {
+    join();
+    stopping_.store(false);
+    thread_ = std::thread(&CotLoopbackServer::stream_main, this, &messages, count, rate, &sent_ns);
+}
+
+void CotLoopbackServer::read(uint64_t count, std::vector<int64_t>& received_ns) {
+    join();
+    stopping_.store(false);
+    received_.store(0);
+    thread_ = std::thread(&CotLoopbackServer::read_main, this, count, &received_ns);
+}
+
+void CotLoopbackServer::join() {
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void CotLoopbackServer::stop() {
+    stopping_.store(true);
+    if (client_fd_ >= 0) {
+        shutdown(client_fd_, SHUT_RDWR);
+    }
+    join();
+    if (client_fd_ >= 0) {
+        close(client_fd_);
+        client_fd_ = -1;
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+void CotLoopbackServer::stream_main(const std::vector<CotBenchMessage>* messages, uint64_t count, uint32_t rate,
+                                    std::vector<int64_t>* sent_ns) {
+    alloc_counter_ignore_thread();
+    int64_t cpuStart = thread_cpu_now_ns();
+
+    // Private copies, so stamping never races the caller
+    std::vector<CotBenchMessage> buffers = *messages;
+    auto start = Clock::now();
+
+    for (uint64_t sequence = 0; sequence < count && !stopping_.load(std::memory_order_relaxed); ++sequence) {
+        if (rate > 0) {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(sequence * 1000000000ull / rate));
+        }
+
+        CotBenchMessage& message = buffers[sequence % buffers.size()];
+        cot_bench_stamp(&message.xml[message.sequence_offset], sequence);
+        (*sent_ns)[sequence] = now_ns();
+
+        const char* bytes = message.xml.data();
+        size_t remaining = message.xml.size();
+        while (remaining > 0) {
+            ssize_t written = send(client_fd_, bytes, remaining, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                thread_cpu_ns_.store(thread_cpu_now_ns() - cpuStart, std::memory_order_release);
+                return;
+            }
+            bytes += written;
+            remaining -= (size_t)written;
+        }
+    }
+
+    thread_cpu_ns_.store(thread_cpu_now_ns() - cpuStart, std::memory_order_release);
+}
+
+void CotLoopbackServer::read_main(uint64_t count, std::vector<int64_t>* received_ns) {
+    alloc_counter_ignore_thread();
+    int64_t cpuStart = thread_cpu_now_ns();
+
+    std::vector<char> buffer(kReadBufferSize);
+    size_t filled = 0;
+
+    while (received_.load(std::memory_order_relaxed) < count && !stopping_.load(std::memory_order_relaxed)) {
+        if (filled == buffer.size()) {
+            buffer.resize(buffer.size() * 2); // An event larger than the buffer
+        }
+        ssize_t got = recv(client_fd_, buffer.data() + filled, buffer.size() - filled, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        int64_t now = now_ns();
+
+        // Search from a little before the new bytes, in case "</event>" straddles reads
+        size_t scanFrom = filled > kEventEndLength ? filled - kEventEndLength : 0;
+        filled += (size_t)got;
+
+        size_t eventStart = 0;
+        const char* data = buffer.data();
+        while (true) {
+            const char* end = (const char*)memmem(data + scanFrom, filled - scanFrom, kEventEnd, kEventEndLength);
+            if (!end) {
+                break;
+            }
+            size_t eventEnd = (size_t)(end - data) + kEventEndLength;
+            uint64_t sequence;
+            if (cot_bench_sequence(data + eventStart, eventEnd - eventStart, &sequence) &&
+                sequence < received_ns->size()) {
+                (*received_ns)[sequence] = now;
+            }
+            received_.fetch_add(1, std::memory_order_release);
+            eventStart = eventEnd;
+            scanFrom = eventEnd;
+        }
+
+        // Keep the partial event for the next read
+        memmove(buffer.data(), data + eventStart, filled - eventStart);
+        filled -= eventStart;
+    }
+
+    thread_cpu_ns_.store(thread_cpu_now_ns() - cpuStart, std::memory_order_release);
+}
@@ -0,0 +1,95 @@
+/**
+ * cot_loopback_server.h - Minimal TAK-style TCP server on 127.0.0.1
+ *
+ * Accepts a single client and either streams CoT at it or reads CoT from it,
+ * for driving a real connection through the Rust FFI without a network.
+ * Every event the benchmark generates carries a fixed-width sequence number
+ * (see cot_bench_sequence), which the server stamps on the way out and reads
+ * back on the way in, so each message can be timed end to end.
+ *
+ * Server threads don't count towards alloc_counter.h.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Each synthetic event carries `bseq="NNNNNNNNNN"` on its <event> element
+static const char kCotBenchSequenceAttr[] = "bseq=\"";
+static const size_t kCotBenchSequenceDigits = 10;
+
+// Write `sequence` into the digits following the bseq attribute at `digits`
+void cot_bench_stamp(char* digits, uint64_t sequence);
+
+// Read the sequence number of an event; returns false when it has none
+bool cot_bench_sequence(const char* xml, size_t length, uint64_t* out);
+
+// A message template with the offset of its sequence digits
+struct CotBenchMessage {
+    std::string xml;
+    size_t sequence_offset;
+};
+
+class CotLoopbackServer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CotLoopbackServer() = default;
+    ~CotLoopbackServer();
+
+    CotLoopbackServer(const CotLoopbackServer&) = delete;
+    CotLoopbackServer& operator=(const CotLoopbackServer&) = delete;
+
+    // Bind an ephemeral port and listen. Returns false on socket errors.
+    bool start();
+    uint16_t port() const { return port_; }
+
+    // Wait for the client to connect
+    bool accept_client(int timeout_ms);
+
+    // Inbound: send `count` messages round-robin from `messages`, stamped with
+    // sequence numbers 0..count-1, at `rate` messages per second (0 = as fast
+    // as the socket takes them). The send time of each is written to
+    // `sent_ns[sequence]`. Runs on its own thread until done or stopped.
+    void stream(const std::vector<CotBenchMessage>& messages, uint64_t count, uint32_t rate,
+                std::vector<int64_t>& sent_ns);
+
+    // Outbound: read `count` events from the client and write the receive time
+    // of each into `received_ns[sequence]`, counting them in received().
+    void read(uint64_t count, std::vector<int64_t>& received_ns);
+
+    // Block until the thread started by stream() or read() finishes
+    void join();
+
+    // Events read back since read() started
+    uint64_t received() const { return received_.load(std::memory_order_acquire); }
+
+    // CPU time used by the server thread of the last stream()/read(), so it
+    // can be subtracted from the process total
+    int64_t thread_cpu_ns() const { return thread_cpu_ns_.load(std::memory_order_acquire); }
+
+    void stop();
+
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+private:
+    void stream_main(const std::vector<CotBenchMessage>* messages, uint64_t count, uint32_t rate,
+                     std::vector<int64_t>* sent_ns);
+    void read_main(uint64_t count, std::vector<int64_t>* received_ns);
+
+    int listen_fd_ = -1;
+    int client_fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<uint64_t> received_{0};
+    std::atomic<int64_t> thread_cpu_ns_{0};
+};
@@ -0,0 +1,527 @@
+/**
+ * cot_throughput_benchmark.cpp - End-to-end CoT throughput and latency benchmark
+ *
+ * Connects the Rust FFI to a loopback server and pushes synthetic CoT streams
+ * through it in both directions:
+ *
+ *   in   server -> Rust -> omnitak_register_callback -> bridge pipeline -> delivery
+ *   out  omnitak_send_cot -> Rust -> server
+ *
+ * The inbound callback runs cot_process_inbound (cot_inbound.h), the stage
+ * sequence of cot_callback_bridge in omnitak_jni.cpp, with counters, key
+ * parse, slab batching and the flush thread, and stops where the bridge
+ * would make its JNI upcall, so changes to the bridge
+ * and the FFI show up without needing a JVM. --parse adds the full record
+ * parse of the parsed delivery mode.
+ *
+ * Each stream is run flat out (throughput) and paced (latency, without
+ * queueing). Reported per run: messages/s, latency p50/p90/p99/max,
+ * heap allocations per message (malloc interposition, see alloc_counter.h)
+ * and CPU per message, both excluding the loopback server's own thread.
+ *
+ * Run on a device:
+ *   adb push cot_throughput_benchmark /data/local/tmp/
+ *   adb shell /data/local/tmp/cot_throughput_benchmark --messages 50000
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "cot_batch_buffer.h"
+#include "cot_connection_stats.h"
+#include "cot_inbound.h"
+#include "cot_loopback_server.h"
+#include "cot_parser.h"
+#include "cot_slab_pool.h"
+#include "omnitak_mobile.h"
+
+// MARK: - Options
+
+struct Options {
+    uint64_t messages = 20000;       // Per flood run
+    uint64_t paced_messages = 2000;  // Per paced run
+    uint32_t rate = 1000;            // Paced runs, messages per second
+    size_t batch = 64;               // 0 delivers every message directly, like string mode
+    uint32_t flush_ms = 16;
+    bool parse = false;
+    const char* scenario = nullptr;  // nullptr runs every scenario
+};
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [--messages N] [--paced-messages N] [--rate MSGS_PER_S]\n"
+            "          [--batch N] [--flush-ms MS] [--parse] [--scenario pli|chat|drawing]\n",
+            program);
+}
+
+static bool parse_options(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--parse") == 0) {
+            options->parse = true;
+            continue;
+        }
+        if (!value) {
+            return false;
+        }
+        if (strcmp(arg, "--messages") == 0) {
+            options->messages = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--paced-messages") == 0) {
+            options->paced_messages = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--rate") == 0) {
+            options->rate = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--batch") == 0) {
+            options->batch = (size_t)strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--flush-ms") == 0) {
+            options->flush_ms = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--scenario") == 0) {
+            options->scenario = value;
+        } else {
+            return false;
+        }
+        ++i;
+    }
+    return options->messages > 0 && options->rate > 0 && options->flush_ms > 0;
+}
+
+// MARK: - Corpus
+
+static CotBenchMessage make_message(std::string xml) {
+    // Stamp a sequence attribute into the <event> element, right after "<event"
+    size_t event = xml.find("<event ");
+    std::string attr = std::string(kCotBenchSequenceAttr) + std::string(kCotBenchSequenceDigits, '0') + "\" ";
+    xml.insert(event + 7, attr);
+    return {xml, event + 7 + sizeof(kCotBenchSequenceAttr) - 1};
+}
+
+// A PLI flood: many tracks, each reporting its position
+static std::vector<CotBenchMessage> make_pli_corpus(int tracks) {
+    std::vector<CotBenchMessage> corpus;
+    char xml[1024];
+    for (int i = 0; i < tracks; ++i) {
+        snprintf(xml, sizeof(xml),
+                 "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+                 "<event version=\"2.0\" uid=\"ANDROID-BENCH-%05d\" type=\"a-f-G-U-C\" how=\"m-g\" "
+                 "time=\"2024-05-01T12:34:56.789Z\" start=\"2024-05-01T12:34:56.789Z\" stale=\"2024-05-01T12:41:11.789Z\">"
+                 "<point lat=\"%.7f\" lon=\"%.7f\" hae=\"9999999.0\" ce=\"9999999.0\" le=\"9999999.0\"/>"
+                 "<detail>"
+                 "<takv os=\"34\" version=\"5.1.0.12 (4c5d1ba4).1713894458-CIV\" device=\"SAMSUNG SM-G998U\" platform=\"ATAK-CIV\"/>"
+                 "<contact endpoint=\"*:-1:stcp\" callsign=\"BENCH %d\"/>"
+                 "<__group role=\"Team Member\" name=\"Cyan\"/>"
+                 "<status battery=\"87\"/>"
+                 "<track course=\"131.23\" speed=\"1.42\"/>"
+                 "</detail>"
+                 "</event>",
+                 i, 38.88 + (i % 50) * 0.001, -77.03 - (i / 50) * 0.001, i);
+        corpus.push_back(make_message(xml));
+    }
+    return corpus;
+}
+
+// GeoChat: a distinct message id each time, with escaped remarks
+static std::vector<CotBenchMessage> make_chat_corpus(int messages) {
+    std::vector<CotBenchMessage> corpus;
+    char xml[2048];
+    for (int i = 0; i < messages; ++i) {
+        snprintf(xml, sizeof(xml),
+                 "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+                 "<event version=\"2.0\" uid=\"GeoChat.ANDROID-BENCH-00001.All Chat Rooms.%08x-3c1d-4b8e-9a51-0d2f6c4e8b11\" "
+                 "type=\"b-t-f\" how=\"h-g-i-g-o\" time=\"2024-05-01T12:35:02.114Z\" start=\"2024-05-01T12:35:02.114Z\" "
+                 "stale=\"2024-05-02T12:35:02.114Z\">"
+                 "<point lat=\"38.8894719\" lon=\"-77.0352291\" hae=\"9999999.0\" ce=\"9999999.0\" le=\"9999999.0\"/>"
+                 "<detail>"
+                 "<__chat parent=\"RootContactGroup\" groupOwner=\"false\" messageId=\"%08x-3c1d-4b8e-9a51-0d2f6c4e8b11\" "
+                 "chatroom=\"All Chat Rooms\" id=\"All Chat Rooms\" senderCallsign=\"BENCH 1\">"
+                 "<chatgrp uid0=\"ANDROID-BENCH-00001\" uid1=\"All Chat Rooms\" id=\"All Chat Rooms\"/>"
+                 "</__chat>"
+                 "<link uid=\"ANDROID-BENCH-00001\" type=\"a-f-G-U-C\" relation=\"p-p\"/>"
+                 "<remarks source=\"BAO.F.ATAK.ANDROID-BENCH-00001\" to=\"All Chat Rooms\" time=\"2024-05-01T12:35:02.114Z\">"
+                 "Moving to checkpoint &quot;BRAVO&quot; &amp; holding for relief, ETA %d min</remarks>"
+                 "</detail>"
+                 "</event>",
+                 i, i, i % 60);
+        corpus.push_back(make_message(xml));
+    }
+    return corpus;
+}
+
+// Freehand drawings: one <link point=...> per vertex, tens of kilobytes each
+static std::vector<CotBenchMessage> make_drawing_corpus(int shapes, int vertices) {
+    std::vector<CotBenchMessage> corpus;
+    char buffer[128];
+    for (int shape = 0; shape < shapes; ++shape) {
+        snprintf(buffer, sizeof(buffer), "3b7e1f0c-8d4a-4f62-a1b9-%012d", shape);
+        std::string xml =
+            "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>"
+            "<event version=\"2.0\" uid=\"" + std::string(buffer) + "\" type=\"u-d-f\" how=\"h-e\" "
+            "time=\"2024-05-01T12:36:40.002Z\" start=\"2024-05-01T12:36:40.002Z\" stale=\"2025-05-01T12:36:40.002Z\">"
+            "<point lat=\"38.8901200\" lon=\"-77.0340100\" hae=\"9999999.0\" ce=\"9999999.0\" le=\"9999999.0\"/>"
+            "<detail>";
+        for (int i = 0; i < vertices; ++i) {
+            snprintf(buffer, sizeof(buffer), "<link point=\"%.7f,%.7f\"/>",
+                     38.8894719 + i * 0.0000131, -77.0352291 + ((i + shape) % 7) * 0.0000217);
+            xml += buffer;
+        }
+        xml +=
+            "<strokeColor value=\"-65536\"/>"
+            "<strokeWeight value=\"4.0\"/>"
+            "<contact callsign=\"Route Alpha\"/>"
+            "<remarks/>"
+            "<archive/>"
+            "</detail>"
+            "</event>";
+        corpus.push_back(make_message(xml));
+    }
+    return corpus;
+}
+
+// MARK: - Bridge pipeline
+
+// Inbound stages of cot_callback_bridge, minus JNI and the stages the benchmark
+// leaves off (fan-in, track store, lanes, coalescing). `delivered_ns` is filled in
+// at the point the bridge would call into Kotlin.
+class BenchBridge {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BenchBridge(const Options& options)
+        : options_(options),
+          pool_(64 * 1024, 64),
+          batch_(pool_, options.batch, options.flush_ms) {}
+
+    void start() {
+        running_ = true;
+        flush_thread_ = std::thread(&BenchBridge::flush_main, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        cv_.notify_all();
+        if (flush_thread_.joinable()) {
+            flush_thread_.join();
+        }
+    }
+
+    void begin_run(std::vector<int64_t>* delivered_ns) {
+        delivered_.store(0);
+        delivered_ns_.store(delivered_ns, std::memory_order_release);
+    }
+
+    void end_run() { delivered_ns_.store(nullptr, std::memory_order_release); }
+
+    uint64_t delivered() const { return delivered_.load(std::memory_order_acquire); }
+    CotConnectionStats& stats() { return stats_; }
+
+    static void callback(void* user_data, uint64_t /* connection_id */, const char* cot_xml) {
+        if (cot_xml) {
+            cot_process_inbound(*static_cast<BenchBridge*>(user_data), cot_xml, strlen(cot_xml));
+        }
+    }
+
+    // MARK: Stages (cot_inbound.h)
+
+    void received(size_t length) { stats_.record_received(length); }
+
+    // The bridge parses the key whenever expiry tracking or coalescing is on
+    bool parse_key(const char* cot_xml, size_t length, CotEventKey* key) {
+        return cot_parse_key(cot_xml, length, key, true);
+    }
+
+    bool admit(const CotEventKey&, const char*, size_t) { return true; }
+    void track(const CotEventKey&) {}
+    bool fan_in(const CotEventKey*, const char*, size_t) { return false; }
+    bool deliver_urgent(const CotEventKey&, const char*) { return false; }
+    bool hold(const CotEventKey&, const char*, size_t) { return false; }
+
+    void deliver(const char* cot_xml, size_t length) {
+        if (options_.batch == 0) {
+            upcall(cot_xml, length);
+            return;
+        }
+
+        bool dropped = false;
+        bool full = batch_.push(cot_xml, length, &dropped);
+        if (dropped) {
+            stats_.record_dropped();
+        }
+        if (full) {
+            flush();
+        }
+    }
+
+private:
+    void flush() {
+        std::lock_guard<std::mutex> flushLock(batch_.flush_mutex());
+        std::vector<CotSlab*>& slabs = batch_.flush_scratch();
+        batch_.drain(slabs);
+        for (CotSlab* slab : slabs) {
+            for (uint32_t i = 0; i < slab->count(); ++i) {
+                upcall(slab->entry(i), slab->entry_length(i));
+            }
+            pool_.release(slab->id);
+        }
+    }
+
+    // Where the bridge would call into Kotlin
+    void upcall(const char* xml, size_t length) {
+        if (options_.parse) {
+            cot_parse_event(xml, length, &record_);
+        }
+        std::vector<int64_t>* delivered = delivered_ns_.load(std::memory_order_acquire);
+        uint64_t sequence;
+        if (delivered && cot_bench_sequence(xml, length, &sequence) && sequence < delivered->size()) {
+            (*delivered)[sequence] = CotLoopbackServer::now_ns();
+            delivered_.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void flush_main() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_) {
+            cv_.wait_for(lock, std::chrono::milliseconds(options_.flush_ms));
+            lock.unlock();
+            if (batch_.is_due(Clock::now())) {
+                flush();
+            }
+            lock.lock();
+        }
+    }
+
+    const Options& options_;
+    CotSlabPool pool_;
+    CotBatchBuffer batch_;
+    CotConnectionStats stats_;
+    CotEventRecord record_; // Only touched under the batch's flush mutex, or by the Rust thread
+
+    std::atomic<std::vector<int64_t>*> delivered_ns_{nullptr};
+    std::atomic<uint64_t> delivered_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool running_ = false;
+    std::thread flush_thread_;
+};
+
+// MARK: - Measurement
+
+struct RunResult {
+    uint64_t messages;
+    uint64_t completed;
+    double messages_per_second;
+    double p50_us, p90_us, p99_us, max_us;
+    double allocations_per_message;
+    double cpu_us_per_message;
+};
+
+static int64_t process_cpu_ns() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((int64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000 +
+           ((int64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000;
+}
+
+// Wait until `progress()` reaches `target`, or stops moving for a few seconds
+template <typename Progress>
+static void wait_for(uint64_t target, Progress progress) {
+    uint64_t last = 0;
+    auto lastChange = std::chrono::steady_clock::now();
+    while (true) {
+        uint64_t now = progress();
+        if (now >= target) {
+            return;
+        }
+        if (now != last) {
+            last = now;
+            lastChange = std::chrono::steady_clock::now();
+        } else if (std::chrono::steady_clock::now() - lastChange > std::chrono::seconds(3)) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+static RunResult summarize(uint64_t messages, const std::vector<int64_t>& start_ns, const std::vector<int64_t>& end_ns,
+                           AllocCounts allocStart, int64_t cpuNs) {
+    std::vector<double> latencies;
+    latencies.reserve(messages);
+    int64_t first = INT64_MAX, last = 0;
+    for (uint64_t i = 0; i < messages; ++i) {
+        if (start_ns[i] == 0 || end_ns[i] == 0) {
+            continue;
+        }
+        latencies.push_back((end_ns[i] - start_ns[i]) / 1000.0);
+        first = std::min(first, start_ns[i]);
+        last = std::max(last, end_ns[i]);
+    }
+
+    RunResult result = {};
+    result.messages = messages;
+    result.completed = latencies.size();
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        auto at = [&](double pct) { return latencies[(size_t)(pct * (latencies.size() - 1))]; };
+        result.p50_us = at(0.50);
+        result.p90_us = at(0.90);
+        result.p99_us = at(0.99);
+        result.max_us = latencies.back();
+        double seconds = (last - first) / 1e9;
+        result.messages_per_second = seconds > 0 ? latencies.size() / seconds : 0;
+    }
+    AllocCounts allocEnd = alloc_counts();
+    result.allocations_per_message = (double)(allocEnd.allocations - allocStart.allocations) / messages;
+    result.cpu_us_per_message = cpuNs / 1000.0 / messages;
+    return result;
+}
+
+static RunResult run_inbound(CotLoopbackServer& server, BenchBridge& bridge,
+                             const std::vector<CotBenchMessage>& corpus, uint64_t messages, uint32_t rate) {
+    std::vector<int64_t> sent(messages, 0), delivered(messages, 0);
+    bridge.begin_run(&delivered);
+
+    AllocCounts allocStart = alloc_counts();
+    int64_t cpuStart = process_cpu_ns();
+    server.stream(corpus, messages, rate, sent);
+    server.join();
+    wait_for(messages, [&] { return bridge.delivered(); });
+    int64_t cpuNs = process_cpu_ns() - cpuStart - server.thread_cpu_ns();
+
+    RunResult result = summarize(messages, sent, delivered, allocStart, cpuNs);
+    bridge.end_run();
+    return result;
+}
+
+static RunResult run_outbound(CotLoopbackServer& server, uint64_t connection,
+                              const std::vector<CotBenchMessage>& corpus, uint64_t messages, uint32_t rate) {
+    std::vector<int64_t> sent(messages, 0), received(messages, 0);
+    std::vector<CotBenchMessage> buffers = corpus;
+    server.read(messages, received);
+
+    AllocCounts allocStart = alloc_counts();
+    int64_t cpuStart = process_cpu_ns();
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t sequence = 0; sequence < messages; ++sequence) {
+        if (rate > 0) {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(sequence * 1000000000ull / rate));
+        }
+        CotBenchMessage& message = buffers[sequence % buffers.size()];
+        cot_bench_stamp(&message.xml[message.sequence_offset], sequence);
+        sent[sequence] = CotLoopbackServer::now_ns();
+        if (omnitak_send_cot(connection, message.xml.c_str()) != 0) {
+            sent[sequence] = 0;
+        }
+    }
+    wait_for(messages, [&] { return server.received(); });
+    server.join();
+    int64_t cpuNs = process_cpu_ns() - cpuStart - server.thread_cpu_ns();
+
+    return summarize(messages, sent, received, allocStart, cpuNs);
+}
+
+static void print_result(const char* scenario, const char* direction, const char* mode, const RunResult& r) {
+    printf("%-8s %-4s %-6s %8llu %8llu %11.0f %9.1f %9.1f %9.1f %10.1f %9.2f %9.2f\n",
+           scenario, direction, mode, (unsigned long long)r.messages, (unsigned long long)r.completed,
+           r.messages_per_second, r.p50_us, r.p90_us, r.p99_us, r.max_us,
+           r.allocations_per_message, r.cpu_us_per_message);
+}
+
+// MARK: - Main
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    struct Scenario {
+        const char* name;
+        std::vector<CotBenchMessage> corpus;
+    };
+    std::vector<Scenario> scenarios = {
+        {"pli", make_pli_corpus(500)},
+        {"chat", make_chat_corpus(64)},
+        {"drawing", make_drawing_corpus(8, 1000)},
+    };
+
+    if (omnitak_init() != 0) {
+        fprintf(stderr, "omnitak_init failed\n");
+        return 1;
+    }
+
+    CotLoopbackServer server;
+    if (!server.start()) {
+        fprintf(stderr, "could not listen on 127.0.0.1\n");
+        return 1;
+    }
+
+    uint64_t connection = omnitak_connect("127.0.0.1", server.port(), 0, 0, nullptr, nullptr, nullptr);
+    if (connection == 0 || !server.accept_client(5000)) {
+        fprintf(stderr, "could not connect to the loopback server on port %u\n", server.port());
+        return 1;
+    }
+
+    BenchBridge bridge(options);
+    bridge.start();
+    omnitak_register_callback(connection, &BenchBridge::callback, &bridge);
+
+    printf("batch=%zu flush_ms=%u parse=%d rate=%u/s (paced runs)\n",
+           options.batch, options.flush_ms, options.parse ? 1 : 0, options.rate);
+    printf("%-8s %-4s %-6s %8s %8s %11s %9s %9s %9s %10s %9s %9s\n",
+           "stream", "dir", "mode", "msgs", "done", "msgs/s", "p50 us", "p90 us", "p99 us", "max us",
+           "allocs", "cpu us");
+
+    bool complete = true;
+    for (const Scenario& scenario : scenarios) {
+        if (options.scenario && strcmp(options.scenario, scenario.name) != 0) {
+            continue;
+        }
+
+        // Warm up the connection, allocator and caches before measuring
+        run_inbound(server, bridge, scenario.corpus, scenario.corpus.size(), 0);
+
+        RunResult results[] = {
+            run_inbound(server, bridge, scenario.corpus, options.messages, 0),
+            run_inbound(server, bridge, scenario.corpus, options.paced_messages, options.rate),
+            run_outbound(server, connection, scenario.corpus, options.messages, 0),
+            run_outbound(server, connection, scenario.corpus, options.paced_messages, options.rate),
+        };
+        print_result(scenario.name, "in", "flood", results[0]);
+        print_result(scenario.name, "in", "paced", results[1]);
+        print_result(scenario.name, "out", "flood", results[2]);
+        print_result(scenario.name, "out", "paced", results[3]);
+
+        for (const RunResult& result : results) {
+            complete = complete && result.completed == result.messages;
+        }
+    }
+
+    CotConnectionStats::Snapshot stats = bridge.stats().snapshot();
+    printf("bridge: %llu bytes received, %llu dropped (slab pool exhausted)\n",
+           (unsigned long long)stats.bytes_received, (unsigned long long)stats.dropped);
+
+    omnitak_unregister_callback(connection);
+    omnitak_disconnect(connection);
+    bridge.stop();
+    server.stop();
+    omnitak_shutdown();
+
+    if (!complete) {
+        fprintf(stderr, "some messages were lost; latency and rate cover delivered messages only\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+//
+//  SCMapLibreStressBenchmark.h
+//  Valdi Benchmark - MapLibre rendering stress harness
+//
+//  Drives SCMapLibreMapView with synthetic moving tracks and measures frame
+//  pacing, marker update cost, memory and pan/zoom jank.
+//
+
+#import <UIKit/UIKit.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// One benchmark run: a track count, a render mode and an update rate
+@interface SCMapLibreStressConfiguration : NSObject <NSCopying>
+
+/// Number of synthetic tracks. Default 1000
+@property (nonatomic, assign) NSUInteger trackCount;
+/// options.renderMode: "annotations" (default), "symbols" or "clusters"
+@property (nonatomic, copy) NSString *renderMode;
+/// Full marker lists pushed through valdi_setMarkers: per second. Default 4
+@property (nonatomic, assign) double updatesPerSecond;
+/// Fraction of tracks that move between updates. Default 1
+@property (nonatomic, assign) double movingFraction;
+/// Seconds of steady updates with a still camera, then the same again while panning and zooming. Default 10
+@property (nonatomic, assign) NSTimeInterval phaseDuration;
+/// Default: the map view's own style
+@property (nonatomic, copy, nullable) NSString *styleURL;
+/// Seed for track placement and motion, so runs are reproducible. Default 1
+@property (nonatomic, assign) uint64_t seed;
+
++ (instancetype)configurationWithTrackCount:(NSUInteger)trackCount renderMode:(NSString *)renderMode;
+
+@end
+
+/**
+ * SCMapLibreStressBenchmark loads an SCMapLibreMapView into a host view with
+ * a configuration's synthetic tracks, then runs two phases:
+ *
+ * 1. steady: full marker lists at updatesPerSecond with a still camera
+ * 2. panZoom: the same updates while the camera flies a fixed pan/zoom loop
+ *
+ * Each phase reports display frame intervals (p50/p95/p99/max ms), janky
+ * frames (over 1.5 refresh intervals) and frames dropped, plus main-thread
+ * time per valdi_setMarkers: call. The run also reports the initial load
+ * time and the process memory footprint before, after loading and at its
+ * peak.
+ *
+ * Results are dictionaries of NSNumbers (see -description of a result for
+ * the keys) and are also logged as one table row per phase.
+ */
+@interface SCMapLibreStressBenchmark : NSObject
+
+/// 1k/5k/20k tracks in each render mode
++ (NSArray<SCMapLibreStressConfiguration *> *)defaultMatrix;
+
+/// Run configurations one after another in `hostView`, removing each map when done
++ (void)runConfigurations:(NSArray<SCMapLibreStressConfiguration *> *)configurations
+                   inView:(UIView *)hostView
+               completion:(void (^)(NSArray<NSDictionary *> *results))completion;
+
+/// Run the matrix on launch when started with `-SCMapLibreStressBenchmark YES`.
+/// `-SCMapLibreStressTracks 1000,5000`, `-SCMapLibreStressModes symbols,clusters`
+/// and `-SCMapLibreStressRate 10` narrow or change it.
++ (void)runIfRequestedAtLaunch;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,547 @@
+//
+//  SCMapLibreStressBenchmark.m
+//  Valdi Benchmark - MapLibre rendering stress harness
+//
+
+#import "SCMapLibreStressBenchmark.h"
+#import "SCMapLibreMapView.h"
+
+#import <QuartzCore/QuartzCore.h>
+#import <mach/mach.h>
+#import <mach/mach_time.h>
+
+@import MapLibre;
+
+// The attribute setters are what Valdi calls; the benchmark calls them the same way
+@interface SCMapLibreMapView (StressBenchmark)
+- (BOOL)valdi_setOptions:(NSDictionary *)options;
+- (BOOL)valdi_setMarkers:(NSArray *)markers;
+- (BOOL)valdi_setOnMapReady:(void (^)(void))callback;
+@end
+
+static const CLLocationDegrees kCenterLatitude = 38.9;
+static const CLLocationDegrees kCenterLongitude = -77.0;
+static const CLLocationDegrees kLatitudeSpan = 3.0;
+static const CLLocationDegrees kLongitudeSpan = 4.0;
+static const double kStartZoom = 7.0;
+static const NSTimeInterval kMapReadyTimeout = 20.0;
+static const NSTimeInterval kSettleDelay = 1.0;
+static const NSTimeInterval kCameraStepDuration = 1.5;
+static const NSUInteger kMemorySampleFrames = 10;
+
+#pragma mark - Helpers
+
+static uint64_t SCStressFootprintBytes(void) {
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.phys_footprint;
+}
+
+static double SCStressMachToMilliseconds(uint64_t ticks) {
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) {
+        mach_timebase_info(&timebase);
+    }
+    return (double)ticks * timebase.numer / timebase.denom / 1e6;
+}
+
+// xorshift64*, so the same seed always gives the same tracks and motion
+static double SCStressRandom(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return (double)((x * 2685821657736338717ull) >> 11) / (double)(1ull << 53);
+}
+
+static double SCStressPercentile(NSArray<NSNumber *> *sorted, double fraction) {
+    if (sorted.count == 0) {
+        return 0;
+    }
+    return sorted[(NSUInteger)(fraction * (sorted.count - 1))].doubleValue;
+}
+
+#pragma mark - SCMapLibreStressConfiguration
+
+@implementation SCMapLibreStressConfiguration
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _trackCount = 1000;
+        _renderMode = @"annotations";
+        _updatesPerSecond = 4;
+        _movingFraction = 1;
+        _phaseDuration = 10;
+        _seed = 1;
+    }
+    return self;
+}
+
++ (instancetype)configurationWithTrackCount:(NSUInteger)trackCount renderMode:(NSString *)renderMode {
+    SCMapLibreStressConfiguration *configuration = [[self alloc] init];
+    configuration.trackCount = trackCount;
+    configuration.renderMode = renderMode;
+    return configuration;
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+    SCMapLibreStressConfiguration *copy = [[SCMapLibreStressConfiguration alloc] init];
+    copy.trackCount = _trackCount;
+    copy.renderMode = _renderMode;
+    copy.updatesPerSecond = _updatesPerSecond;
+    copy.movingFraction = _movingFraction;
+    copy.phaseDuration = _phaseDuration;
+    copy.styleURL = _styleURL;
+    copy.seed = _seed;
+    return copy;
+}
+
+@end
+
+#pragma mark - SCMapLibreStressRun
+
+typedef NS_ENUM(NSInteger, SCMapLibreStressPhase) {
+    SCMapLibreStressPhaseLoading,
+    SCMapLibreStressPhaseSteady,
+    SCMapLibreStressPhasePanZoom,
+    SCMapLibreStressPhaseDone,
+};
+
+/// One configuration's map view, tracks and samples
+@interface SCMapLibreStressRun : NSObject
+@end
+
+@implementation SCMapLibreStressRun {
+    SCMapLibreStressConfiguration *_configuration;
+    UIView *_hostView;
+    void (^_completion)(NSArray<NSDictionary *> *);
+
+    SCMapLibreMapView *_map;
+    BOOL _mapReady;
+    CADisplayLink *_displayLink;
+
+    NSUInteger _trackCount;
+    double *_latitudes;
+    double *_longitudes;
+    double *_headings;
+    double *_speeds; // Degrees per second
+    NSArray<NSString *> *_trackIds;
+    NSArray<NSString *> *_titles;
+    uint64_t _random;
+
+    SCMapLibreStressPhase _phase;
+    CFTimeInterval _phaseStart;
+    CFTimeInterval _lastFrame;
+    CFTimeInterval _lastUpdate;
+    CFTimeInterval _nextUpdate;
+    NSUInteger _cameraStep;
+    NSUInteger _frames;
+
+    NSMutableArray<NSNumber *> *_frameIntervals;  // ms
+    NSMutableArray<NSNumber *> *_setMarkersTimes; // ms
+    NSUInteger _jankyFrames;
+    NSUInteger _droppedFrames;
+
+    double _loadMilliseconds;
+    uint64_t _footprintBefore;
+    uint64_t _footprintLoaded;
+    uint64_t _footprintPeak;
+    NSMutableArray<NSDictionary *> *_results;
+}
+
+- (instancetype)initWithConfiguration:(SCMapLibreStressConfiguration *)configuration
+                             hostView:(UIView *)hostView
+                           completion:(void (^)(NSArray<NSDictionary *> *))completion {
+    self = [super init];
+    if (self) {
+        _configuration = [configuration copy];
+        _hostView = hostView;
+        _completion = [completion copy];
+        _results = [NSMutableArray array];
+        _random = configuration.seed ?: 1;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_latitudes);
+    free(_longitudes);
+    free(_headings);
+    free(_speeds);
+}
+
+- (void)start {
+    [self makeTracks];
+    _footprintBefore = SCStressFootprintBytes();
+    _footprintPeak = _footprintBefore;
+
+    _map = [[SCMapLibreMapView alloc] initWithFrame:_hostView.bounds];
+    _map.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
+    if (_configuration.styleURL) {
+        _map.styleURL = _configuration.styleURL;
+    }
+    [_hostView addSubview:_map];
+    [_map layoutIfNeeded];
+
+    // Camera first, so the load measures the region the tracks are in
+    _map.mapView.centerCoordinate = CLLocationCoordinate2DMake(kCenterLatitude, kCenterLongitude);
+    _map.mapView.zoomLevel = kStartZoom;
+
+    __weak SCMapLibreStressRun *weakSelf = self;
+    [_map valdi_setOnMapReady:^{
+        [weakSelf mapDidBecomeReady];
+    }];
+    [_map valdi_setOptions:@{@"renderMode": _configuration.renderMode}];
+
+    // Some styles never finish loading offline; measure anyway rather than hang
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kMapReadyTimeout * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [weakSelf mapDidBecomeReady];
+    });
+}
+
+- (void)makeTracks {
+    _trackCount = _configuration.trackCount;
+    _latitudes = calloc(_trackCount, sizeof(double));
+    _longitudes = calloc(_trackCount, sizeof(double));
+    _headings = calloc(_trackCount, sizeof(double));
+    _speeds = calloc(_trackCount, sizeof(double));
+
+    NSMutableArray<NSString *> *ids = [NSMutableArray arrayWithCapacity:_trackCount];
+    NSMutableArray<NSString *> *titles = [NSMutableArray arrayWithCapacity:_trackCount];
+    for (NSUInteger i = 0; i < _trackCount; ++i) {
+        _latitudes[i] = kCenterLatitude + (SCStressRandom(&_random) - 0.5) * kLatitudeSpan;
+        _longitudes[i] = kCenterLongitude + (SCStressRandom(&_random) - 0.5) * kLongitudeSpan;
+        _headings[i] = SCStressRandom(&_random) * 360.0;
+        // Walking pace to fast jet, roughly 1 m/s to 250 m/s
+        _speeds[i] = (0.00001 + SCStressRandom(&_random) * 0.0025);
+        [ids addObject:[NSString stringWithFormat:@"STRESS-%06lu", (unsigned long)i]];
+        [titles addObject:[NSString stringWithFormat:@"T%lu", (unsigned long)i]];
+    }
+    _trackIds = ids;
+    _titles = titles;
+}
+
+- (void)moveTracksBy:(CFTimeInterval)elapsed {
+    for (NSUInteger i = 0; i < _trackCount; ++i) {
+        if (SCStressRandom(&_random) >= _configuration.movingFraction) {
+            continue;
+        }
+        double radians = _headings[i] * M_PI / 180.0;
+        _latitudes[i] += cos(radians) * _speeds[i] * elapsed;
+        _longitudes[i] += sin(radians) * _speeds[i] * elapsed;
+        _headings[i] = fmod(_headings[i] + (SCStressRandom(&_random) - 0.5) * 10.0 + 360.0, 360.0);
+    }
+}
+
+- (NSArray<NSDictionary *> *)markers {
+    NSMutableArray<NSDictionary *> *markers = [NSMutableArray arrayWithCapacity:_trackCount];
+    for (NSUInteger i = 0; i < _trackCount; ++i) {
+        [markers addObject:@{
+            @"id": _trackIds[i],
+            @"latitude": @(_latitudes[i]),
+            @"longitude": @(_longitudes[i]),
+            @"heading": @(_headings[i]),
+            @"title": _titles[i],
+            @"type": @"a-f-G-U-C",
+        }];
+    }
+    return markers;
+}
+
+// Main-thread time of one valdi_setMarkers: call, excluding building the list
+- (double)pushMarkers {
+    NSArray<NSDictionary *> *markers = [self markers];
+    uint64_t start = mach_absolute_time();
+    [_map valdi_setMarkers:markers];
+    return SCStressMachToMilliseconds(mach_absolute_time() - start);
+}
+
+- (void)mapDidBecomeReady {
+    if (_phase != SCMapLibreStressPhaseLoading || _displayLink) {
+        return;
+    }
+    _mapReady = _map.mapView.style != nil;
+
+    _loadMilliseconds = [self pushMarkers];
+    _footprintLoaded = SCStressFootprintBytes();
+    _footprintPeak = MAX(_footprintPeak, _footprintLoaded);
+
+    _displayLink = [CADisplayLink displayLinkWithTarget:self selector:@selector(frame:)];
+    if (@available(iOS 15.0, *)) {
+        NSInteger maximum = UIScreen.mainScreen.maximumFramesPerSecond;
+        _displayLink.preferredFrameRateRange = CAFrameRateRangeMake(maximum, maximum, maximum);
+    }
+    [_displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+
+    // Let the first render and tile loads finish before measuring
+    _phaseStart = CACurrentMediaTime() + kSettleDelay;
+}
+
+- (void)beginPhase:(SCMapLibreStressPhase)phase at:(CFTimeInterval)now {
+    _phase = phase;
+    _phaseStart = now;
+    _lastUpdate = now;
+    _nextUpdate = now;
+    _cameraStep = 0;
+    _frameIntervals = [NSMutableArray array];
+    _setMarkersTimes = [NSMutableArray array];
+    _jankyFrames = 0;
+    _droppedFrames = 0;
+}
+
+- (void)frame:(CADisplayLink *)link {
+    CFTimeInterval now = link.timestamp;
+    ++_frames;
+    if (_frames % kMemorySampleFrames == 0) {
+        _footprintPeak = MAX(_footprintPeak, SCStressFootprintBytes());
+    }
+
+    if (_phase == SCMapLibreStressPhaseLoading) {
+        if (now >= _phaseStart) {
+            [self beginPhase:SCMapLibreStressPhaseSteady at:now];
+            _lastFrame = now;
+        }
+        return;
+    }
+
+    // Frame interval, judged against the display's own refresh interval
+    CFTimeInterval interval = now - _lastFrame;
+    CFTimeInterval expected = link.targetTimestamp - link.timestamp;
+    _lastFrame = now;
+    [_frameIntervals addObject:@(interval * 1000.0)];
+    if (expected > 0) {
+        if (interval > expected * 1.5) {
+            ++_jankyFrames;
+        }
+        NSInteger missed = (NSInteger)llround(interval / expected) - 1;
+        _droppedFrames += missed > 0 ? (NSUInteger)missed : 0;
+    }
+
+    if (now >= _nextUpdate) {
+        [self moveTracksBy:now - _lastUpdate];
+        _lastUpdate = now;
+        _nextUpdate += 1.0 / MAX(_configuration.updatesPerSecond, 0.1);
+        [_setMarkersTimes addObject:@([self pushMarkers])];
+    }
+
+    if (_phase == SCMapLibreStressPhasePanZoom) {
+        NSUInteger step = (NSUInteger)((now - _phaseStart) / kCameraStepDuration);
+        if (step >= _cameraStep) {
+            [self moveCameraToStep:_cameraStep++];
+        }
+    }
+
+    if (now - _phaseStart >= _configuration.phaseDuration) {
+        [self finishPhase];
+        if (_phase == SCMapLibreStressPhaseSteady) {
+            [self beginPhase:SCMapLibreStressPhasePanZoom at:now];
+        } else {
+            [self finish];
+        }
+    }
+}
+
+// A fixed loop of pans and zooms over the tracks
+- (void)moveCameraToStep:(NSUInteger)step {
+    static const double kSteps[][3] = {
+        {0.0, 0.0, kStartZoom},
+        {0.6, 0.8, 9.0},
+        {-0.5, 1.0, 11.0},
+        {-0.8, -0.9, 9.5},
+        {0.4, -1.2, 8.0},
+        {0.0, 0.0, 6.0},
+    };
+    const size_t count = sizeof(kSteps) / sizeof(kSteps[0]);
+    const double *target = kSteps[step % count];
+    [_map.mapView setCenterCoordinate:CLLocationCoordinate2DMake(kCenterLatitude + target[0], kCenterLongitude + target[1])
+                            zoomLevel:target[2]
+                             animated:YES];
+}
+
+- (void)finishPhase {
+    NSArray<NSNumber *> *frames = [_frameIntervals sortedArrayUsingSelector:@selector(compare:)];
+    NSArray<NSNumber *> *updates = [_setMarkersTimes sortedArrayUsingSelector:@selector(compare:)];
+
+    NSDictionary *result = @{
+        @"tracks": @(_trackCount),
+        @"renderMode": _configuration.renderMode,
+        @"phase": _phase == SCMapLibreStressPhaseSteady ? @"steady" : @"panZoom",
+        @"updatesPerSecond": @(_configuration.updatesPerSecond),
+        @"mapReady": @(_mapReady),
+        @"frames": @(frames.count),
+        @"frameP50Ms": @(SCStressPercentile(frames, 0.50)),
+        @"frameP95Ms": @(SCStressPercentile(frames, 0.95)),
+        @"frameP99Ms": @(SCStressPercentile(frames, 0.99)),
+        @"frameMaxMs": @(frames.lastObject.doubleValue),
+        @"jankyFrames": @(_jankyFrames),
+        @"droppedFrames": @(_droppedFrames),
+        @"setMarkersCalls": @(updates.count),
+        @"setMarkersP50Ms": @(SCStressPercentile(updates, 0.50)),
+        @"setMarkersP95Ms": @(SCStressPercentile(updates, 0.95)),
+        @"setMarkersMaxMs": @(updates.lastObject.doubleValue),
+        @"loadMs": @(_loadMilliseconds),
+        @"footprintBeforeMB": @(_footprintBefore / 1048576.0),
+        @"footprintLoadedMB": @(_footprintLoaded / 1048576.0),
+        @"footprintPeakMB": @(_footprintPeak / 1048576.0),
+    };
+    [_results addObject:result];
+
+    NSLog(@"[MapStress] %6lu %-11s %-7s frame p50 %5.1f p95 %5.1f p99 %5.1f max %6.1f ms, jank %4lu drop %4lu, "
+          @"setMarkers p50 %6.2f p95 %6.2f max %7.2f ms, load %7.1f ms, mem %.0f/%.0f/%.0f MB%@",
+          (unsigned long)_trackCount, _configuration.renderMode.UTF8String, [result[@"phase"] UTF8String],
+          [result[@"frameP50Ms"] doubleValue], [result[@"frameP95Ms"] doubleValue],
+          [result[@"frameP99Ms"] doubleValue], [result[@"frameMaxMs"] doubleValue],
+          (unsigned long)_jankyFrames, (unsigned long)_droppedFrames,
+          [result[@"setMarkersP50Ms"] doubleValue], [result[@"setMarkersP95Ms"] doubleValue],
+          [result[@"setMarkersMaxMs"] doubleValue], _loadMilliseconds,
+          _footprintBefore / 1048576.0, _footprintLoaded / 1048576.0, _footprintPeak / 1048576.0,
+          _mapReady ? @"" : @" (style never loaded)");
+}
+
+- (void)finish {
+    _phase = SCMapLibreStressPhaseDone;
+    [_displayLink invalidate];
+    _displayLink = nil;
+
+    [_map valdi_setMarkers:@[]];
+    [_map removeFromSuperview];
+    _map = nil;
+
+    // Report after this display link callback has unwound; the completion releases the run
+    void (^completion)(NSArray<NSDictionary *> *) = _completion;
+    NSArray<NSDictionary *> *results = [_results copy];
+    _completion = nil;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        completion(results);
+    });
+}
+
+@end
+
+#pragma mark - SCMapLibreStressBenchmark
+
+@implementation SCMapLibreStressBenchmark
+
++ (void)load {
+    __block id observer = [[NSNotificationCenter defaultCenter]
+        addObserverForName:UIApplicationDidFinishLaunchingNotification
+                    object:nil
+                     queue:[NSOperationQueue mainQueue]
+                usingBlock:^(NSNotification *note) {
+                    [[NSNotificationCenter defaultCenter] removeObserver:observer];
+                    observer = nil;
+                    // Give the app's own root view a moment to appear first
+                    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(1 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+                        [SCMapLibreStressBenchmark runIfRequestedAtLaunch];
+                    });
+                }];
+}
+
++ (NSArray<SCMapLibreStressConfiguration *> *)defaultMatrix {
+    NSMutableArray<SCMapLibreStressConfiguration *> *matrix = [NSMutableArray array];
+    for (NSString *mode in @[@"annotations", @"symbols", @"clusters"]) {
+        for (NSNumber *tracks in @[@1000, @5000, @20000]) {
+            [matrix addObject:[SCMapLibreStressConfiguration configurationWithTrackCount:tracks.unsignedIntegerValue
+                                                                              renderMode:mode]];
+        }
+    }
+    return matrix;
+}
+
++ (void)runConfigurations:(NSArray<SCMapLibreStressConfiguration *> *)configurations
+                   inView:(UIView *)hostView
+               completion:(void (^)(NSArray<NSDictionary *> *results))completion {
+    NSMutableArray<NSDictionary *> *results = [NSMutableArray array];
+    [self runConfigurations:configurations index:0 inView:hostView results:results completion:completion];
+}
+
++ (void)runConfigurations:(NSArray<SCMapLibreStressConfiguration *> *)configurations
+                    index:(NSUInteger)index
+                   inView:(UIView *)hostView
+                  results:(NSMutableArray<NSDictionary *> *)results
+               completion:(void (^)(NSArray<NSDictionary *> *results))completion {
+    if (index >= configurations.count) {
+        completion(results);
+        return;
+    }
+
+    // The run keeps itself alive through its display link until it finishes
+    __block SCMapLibreStressRun *run = [[SCMapLibreStressRun alloc]
+        initWithConfiguration:configurations[index]
+                     hostView:hostView
+                   completion:^(NSArray<NSDictionary *> *runResults) {
+                       [results addObjectsFromArray:runResults];
+                       run = nil;
+                       // Let the previous map's memory go before the next run measures its baseline
+                       dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kSettleDelay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+                           [self runConfigurations:configurations index:index + 1 inView:hostView results:results completion:completion];
+                       });
+                   }];
+    [run start];
+}
+
++ (void)runIfRequestedAtLaunch {
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    if (![defaults boolForKey:@"SCMapLibreStressBenchmark"]) {
+        return;
+    }
+
+    NSArray<NSString *> *trackCounts = [[defaults stringForKey:@"SCMapLibreStressTracks"] componentsSeparatedByString:@","];
+    NSArray<NSString *> *modes = [[defaults stringForKey:@"SCMapLibreStressModes"] componentsSeparatedByString:@","];
+    double rate = [defaults doubleForKey:@"SCMapLibreStressRate"];
+
+    NSMutableArray<SCMapLibreStressConfiguration *> *configurations = [NSMutableArray array];
+    for (SCMapLibreStressConfiguration *configuration in [self defaultMatrix]) {
+        NSString *tracks = [NSString stringWithFormat:@"%lu", (unsigned long)configuration.trackCount];
+        if ((trackCounts && ![trackCounts containsObject:tracks]) ||
+            (modes && ![modes containsObject:configuration.renderMode])) {
+            continue;
+        }
+        if (rate > 0) {
+            configuration.updatesPerSecond = rate;
+        }
+        [configurations addObject:configuration];
+    }
+    if (trackCounts) {
+        // Counts outside the default matrix
+        for (NSString *tracks in trackCounts) {
+            NSUInteger count = (NSUInteger)tracks.integerValue;
+            if (count == 0 || count == 1000 || count == 5000 || count == 20000) {
+                continue;
+            }
+            for (NSString *mode in modes ?: @[@"annotations", @"symbols", @"clusters"]) {
+                SCMapLibreStressConfiguration *configuration = [SCMapLibreStressConfiguration configurationWithTrackCount:count
+                                                                                                               renderMode:mode];
+                if (rate > 0) {
+                    configuration.updatesPerSecond = rate;
+                }
+                [configurations addObject:configuration];
+            }
+        }
+    }
+
+    UIWindow *window = UIApplication.sharedApplication.keyWindow ?: UIApplication.sharedApplication.windows.firstObject;
+    if (!window) {
+        NSLog(@"[MapStress] No window to run in");
+        return;
+    }
+
+    UIView *hostView = [[UIView alloc] initWithFrame:window.bounds];
+    hostView.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
+    hostView.backgroundColor = [UIColor blackColor];
+    [window addSubview:hostView];
+
+    NSLog(@"[MapStress] Running %lu configurations", (unsigned long)configurations.count);
+    [self runConfigurations:configurations inView:hostView completion:^(NSArray<NSDictionary *> *results) {
+        [hostView removeFromSuperview];
+        NSData *json = [NSJSONSerialization dataWithJSONObject:results options:NSJSONWritingPrettyPrinted error:nil];
+        NSLog(@"[MapStress] Done\n%@", json ? [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding] : results);
+    }];
+}
+
+@end
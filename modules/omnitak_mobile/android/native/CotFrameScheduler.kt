@@ -0,0 +1,190 @@
+package com.engindearing.omnitak.native
+
+import android.os.Handler
+import android.os.Looper
+import android.os.SystemClock
+import android.util.Log
+import android.view.Choreographer
+
+/**
+ * CotFrameScheduler - Paces track updates to the display refresh rate
+ *
+ * Updates can be submitted from any thread at message rate. They are keyed by
+ * track uid: a newer update for a uid that hasn't been flushed yet replaces the
+ * pending one (counted as merged). Once per vsync, on the main thread, up to
+ * [Config.maxUpdatesPerFrame] pending updates are handed to `onFrame` in one call.
+ *
+ * If a flush overruns [Config.frameBudgetMs], the scheduler backs off and skips
+ * 1, 2, 4... frames (up to [Config.maxBackoffFrames]) before the next flush,
+ * merging everything that arrives meanwhile. Flushes within budget shrink the
+ * backoff again.
+ */
+class CotFrameScheduler<T>(
+    private val config: Config = Config(),
+    private val onFrame: (List<T>) -> Unit
+) {
+
+    companion object {
+        private const val TAG = "OmniTAKNative"
+    }
+
+    data class Config(
+        val maxUpdatesPerFrame: Int = 256,
+        val maxPending: Int = 16384,
+        val frameBudgetMs: Double = 8.0,
+        val maxBackoffFrames: Int = 8
+    )
+
+    data class Stats(
+        val submitted: Long,
+        val delivered: Long,
+        val merged: Long,
+        val dropped: Long,
+        val skippedFrames: Long,
+        val pending: Int,
+        val backoffFrames: Int
+    )
+
+    private val lock = Any()
+
+    // Insertion-ordered, so tracks are flushed oldest-first; replacing a value keeps its slot
+    private val pending = LinkedHashMap<String, T>()
+
+    private var frameScheduled = false
+    private var backoffFrames = 0
+    private var framesToSkip = 0
+
+    private var submitted = 0L
+    private var delivered = 0L
+    private var merged = 0L
+    private var dropped = 0L
+    private var skippedFrames = 0L
+
+    @Volatile
+    private var stopped = false
+
+    private val mainHandler = Handler(Looper.getMainLooper())
+
+    private val frameCallback = Choreographer.FrameCallback { doFrame() }
+
+    private val scheduleFrame = Runnable { Choreographer.getInstance().postFrameCallback(frameCallback) }
+
+    /** Queue [update] for track [uid], replacing any update for it not yet flushed */
+    fun submit(uid: String, update: T) {
+        if (stopped) {
+            return
+        }
+
+        val post: Boolean
+        synchronized(lock) {
+            submitted++
+            if (pending.put(uid, update) != null) {
+                merged++
+            } else if (pending.size > config.maxPending) {
+                // Shed the stalest track rather than grow without bound
+                val eldest = pending.keys.iterator()
+                eldest.next()
+                eldest.remove()
+                dropped++
+            }
+
+            post = !frameScheduled
+            frameScheduled = true
+        }
+
+        if (post) {
+            mainHandler.post(scheduleFrame)
+        }
+    }
+
+    /**
+     * Hand [update] for track [uid] to `onFrame` right away, on the calling thread, and
+     * drop any update for it still pending so an older one can't follow. For urgent
+     * events (see OmniTAKNativeBridge.enablePriorityLanes); call on the main thread.
+     */
+    fun deliverNow(uid: String, update: T) {
+        if (stopped) {
+            return
+        }
+
+        synchronized(lock) {
+            submitted++
+            if (pending.remove(uid) != null) {
+                merged++
+            }
+            delivered++
+        }
+        try {
+            onFrame(listOf(update))
+        } catch (e: Exception) {
+            Log.e(TAG, "Error in frame callback", e)
+        }
+    }
+
+    fun getStats(): Stats = synchronized(lock) {
+        Stats(submitted, delivered, merged, dropped, skippedFrames, pending.size, backoffFrames)
+    }
+
+    /** Drop pending updates and stop scheduling frames */
+    fun stop() {
+        stopped = true
+        synchronized(lock) {
+            pending.clear()
+            frameScheduled = false
+        }
+        mainHandler.removeCallbacks(scheduleFrame)
+        mainHandler.post { Choreographer.getInstance().removeFrameCallback(frameCallback) }
+    }
+
+    // Runs on the main thread once per vsync while updates are pending
+    private fun doFrame() {
+        if (stopped) {
+            return
+        }
+
+        val batch: List<T>
+        synchronized(lock) {
+            if (framesToSkip > 0) {
+                framesToSkip--
+                skippedFrames++
+                Choreographer.getInstance().postFrameCallback(frameCallback)
+                return
+            }
+
+            val count = minOf(pending.size, config.maxUpdatesPerFrame)
+            val taken = ArrayList<T>(count)
+            val iterator = pending.values.iterator()
+            while (taken.size < count) {
+                taken.add(iterator.next())
+                iterator.remove()
+            }
+            batch = taken
+            delivered += count
+        }
+
+        val startMs = SystemClock.elapsedRealtimeNanos() / 1_000_000.0
+        if (batch.isNotEmpty()) {
+            try {
+                onFrame(batch)
+            } catch (e: Exception) {
+                Log.e(TAG, "Error in frame callback", e)
+            }
+        }
+        val elapsedMs = SystemClock.elapsedRealtimeNanos() / 1_000_000.0 - startMs
+
+        synchronized(lock) {
+            backoffFrames = if (elapsedMs > config.frameBudgetMs) {
+                if (backoffFrames == 0) 1 else minOf(backoffFrames * 2, config.maxBackoffFrames)
+            } else {
+                backoffFrames / 2
+            }
+            framesToSkip = backoffFrames
+
+            if (pending.isEmpty()) {
+                frameScheduled = false
+            } else {
+                Choreographer.getInstance().postFrameCallback(frameCallback)
+            }
+        }
+    }
+}
@@ -1,9 +1,18 @@
 package com.engindearing.omnitak.native
 
+import android.os.Handler
+import android.os.Looper
 import android.util.Log
 import kotlinx.coroutines.*
+import java.io.File
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.time.Instant
+import java.util.BitSet
 import java.util.UUID
 import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.ConcurrentLinkedQueue
+import java.util.concurrent.atomic.AtomicBoolean
 import kotlin.coroutines.resume
 
 /**
@@ -17,7 +26,7 @@ import kotlin.coroutines.resume
  * - Certificate storage
  * - Async/coroutine integration
  */
-class OmniTAKNativeBridge {
+class OmniTAKNativeBridge(private val snapshotFile: File? = null) {
 
     companion object {
         private const val TAG = "OmniTAKNative"
@@ -26,9 +35,14 @@ class OmniTAKNativeBridge {
         @Volatile
         private var instance: OmniTAKNativeBridge? = null
 
-        fun getInstance(): OmniTAKNativeBridge {
+        /**
+         * The first call creates the bridge. Pass [snapshotFile] there (e.g.
+         * `File(context.filesDir, "tracks.snapshot")`) to keep a native track snapshot
+         * across restarts; later calls return the existing bridge unchanged.
+         */
+        fun getInstance(snapshotFile: File? = null): OmniTAKNativeBridge {
             return instance ?: synchronized(this) {
-                instance ?: OmniTAKNativeBridge().also { instance = it }
+                instance ?: OmniTAKNativeBridge(snapshotFile).also { instance = it }
             }
         }
 
@@ -46,31 +60,114 @@ class OmniTAKNativeBridge {
 
     // MARK: - Native Method Declarations
 
-    // Initialize the native library
-    private external fun nativeInit(): Int
+    // Initialize the native library, restoring the track snapshot at `snapshotPath` if given
+    private external fun nativeInit(snapshotPath: String?): Int
 
     // Shutdown the native library
     private external fun nativeShutdown()
 
-    // Connect to TAK server
-    private external fun nativeConnect(
+    // Start a connect on a native thread and return its pending id at once;
+    // onConnectComplete(pendingId, connectionId) follows, with 0 on failure
+    private external fun nativeConnectAsync(
         host: String,
         port: Int,
         protocol: Int,
         useTls: Boolean,
-        certPem: String?,
-        keyPem: String?,
-        caPem: String?
+        certHandle: Long,
+        reconnect: Boolean,
+        reconnectDelayMs: Int
     ): Long
 
-    // Disconnect from server
+    // Validate and cache a client certificate; returns a handle for nativeConnectAsync (0 = none)
+    private external fun nativeImportCertificate(certPem: String, keyPem: String, caPem: String?): Long
+
+    // Drop a certificate handle
+    private external fun nativeReleaseCertificate(certHandle: Long): Int
+
+    // Disconnect from server. Waits for upcalls in flight to return, so never call it
+    // synchronously from inside one (the upcall thread would wait on itself)
     private external fun nativeDisconnect(connectionId: Long): Int
 
     // Send CoT message
     private external fun nativeSendCot(connectionId: Long, cotXml: String): Int
 
+    // Send UTF-8 CoT bytes from a direct ByteBuffer region without a String round trip.
+    // A NUL byte right after the region lets the native side skip its staging copy.
+    private external fun nativeSendCotBytes(connectionId: Long, buffer: ByteBuffer, offset: Int, length: Int): Int
+
+    // Send UTF-8 CoT bytes from a byte array region
+    private external fun nativeSendCotArray(connectionId: Long, bytes: ByteArray, offset: Int, length: Int): Int
+
+    // Send many CoT messages in one JNI crossing. Both return a per-item result
+    // bitmap (bit i set = item i sent) in BitSet.valueOf(long[]) layout, or null
+    // when the arguments are invalid.
+    // regions holds (offset, length) pairs into the packed direct buffer.
+    private external fun nativeSendCotBatch(connectionId: Long, buffer: ByteBuffer, regions: IntArray): LongArray?
+    private external fun nativeSendCotStrings(connectionId: Long, cotXmls: Array<String>): LongArray?
+
     // Register callback for receiving CoT messages
-    private external fun nativeRegisterCallback(connectionId: Long): Int
+    // batchSize <= 1 delivers every message through onCotReceived; larger values
+    // deliver through onCotBatch every batchSize messages or flushIntervalMs.
+    // deliveryMode DIRECT delivers native slabs through onCotSlab instead,
+    // PARSED delivers natively parsed records through onCotEvents.
+    private external fun nativeRegisterCallback(
+        connectionId: Long,
+        batchSize: Int,
+        flushIntervalMs: Int,
+        deliveryMode: Int
+    ): Int
+
+    // Return a slab delivered through onCotSlab to the native pool
+    private external fun nativeReleaseSlab(slabId: Int)
+
+    // Coalesce inbound events by uid across all connections; 0 disables
+    private external fun nativeSetCoalescing(windowMs: Int): Int
+
+    // Deliver events at or above this priority through onCotPriority; -1 = off
+    private external fun nativeSetPriorityLanes(urgentPriority: Int, hasCallback: Boolean): Int
+
+    // Merge all connections into one deduplicated stream through onCotFanIn
+    private external fun nativeSetFanIn(enabled: Boolean, flushIntervalMs: Int, windowMs: Int): Int
+
+    // Track stale times natively and report expired tracks through onCotExpired
+    private external fun nativeSetTrackExpiry(enabled: Boolean)
+
+    // Number of tracks currently held by the native track store
+    private external fun nativeGetTrackCount(): Int
+
+    // Index track positions in the native track store
+    private external fun nativeSetTrackIndex(enabled: Boolean)
+
+    // Uids of up to `limit` indexed tracks inside the box
+    private external fun nativeQueryRegion(
+        minLat: Double,
+        minLon: Double,
+        maxLat: Double,
+        maxLon: Double,
+        limit: Int
+    ): Array<String>?
+
+    // Maintain per-zoom clusters of indexed track positions
+    private external fun nativeSetTrackClustering(enabled: Boolean)
+
+    // Up to `limit` clusters at `zoom` overlapping the box
+    private external fun nativeQueryClusters(
+        zoom: Int,
+        minLat: Double,
+        minLon: Double,
+        maxLat: Double,
+        maxLon: Double,
+        limit: Int
+    ): TrackClustersNative?
+
+    // Zoom at which the cluster at (lat, lon) on `zoom` splits up
+    private external fun nativeGetClusterExpansionZoom(zoom: Int, lat: Double, lon: Double): Int
+
+    // Every track in the snapshot file; null only if the arrays couldn't be allocated
+    private external fun nativeGetSnapshotTracks(): SnapshotTracksNative?
+
+    // Empty the snapshot file
+    private external fun nativeClearTrackSnapshot()
 
     // Unregister callback
     private external fun nativeUnregisterCallback(connectionId: Long): Int
@@ -78,11 +175,19 @@ class OmniTAKNativeBridge {
     // Get connection status
     private external fun nativeGetStatus(connectionId: Long): ConnectionStatusNative?
 
+    // Slab pool and coalescer counters, in PoolStats field order
+    private external fun nativeGetPoolStats(): LongArray?
+
     // Get library version
     private external fun nativeVersion(): String
 
     // MARK: - Data Classes
 
+    /**
+     * With [reconnect] set, the native layer keeps the connection id alive across link
+     * drops: it retries with jittered exponential backoff starting at [reconnectDelayMs]
+     * (capped at a minute) and queues sends meanwhile, flushing them once reconnected.
+     */
     data class ServerConfig(
         val host: String,
         val port: Int,
@@ -93,6 +198,76 @@ class OmniTAKNativeBridge {
         val reconnectDelayMs: Int = 5000
     )
 
+    /**
+     * Inbound delivery lane of a CoT event, by type (see cot_priority.h).
+     * Declared most urgent first; values match the native CotPriority.
+     */
+    enum class PriorityLane(val value: Int) {
+        EMERGENCY(0), // b-a-* alarms: 911, in contact, cancel, geofence
+        CHAT(1),      // b-t-f* GeoChat and receipts
+        TASKING(2),   // t-* tasking, except pings
+        OTHER(3),     // Drawings, markers, routes, pings, untyped events
+        PLI(4);       // a-* position reports
+
+        companion object {
+            fun fromValue(value: Int): PriorityLane = values().firstOrNull { it.value == value } ?: OTHER
+        }
+    }
+
+    /**
+     * A group of nearby tracks at one zoom level. A cluster of one track carries
+     * its [uid] and exact position; larger clusters sit at their centroid.
+     */
+    data class TrackCluster(
+        val lat: Double,
+        val lon: Double,
+        val count: Int,
+        val uid: String?
+    )
+
+    /**
+     * The last known state of a track, as saved in the snapshot file. [uid] is the raw
+     * attribute value, as in [ExpiredTrack]; [lat] and [lon] are null for tracks that
+     * never had a `<point>`, and [callsign] is empty without a `<contact>`.
+     */
+    data class SnapshotTrack(
+        val uid: String,
+        val type: String,
+        val callsign: String,
+        val lat: Double?,
+        val lon: Double?,
+        val staleMs: Long,
+        val updatedMs: Long
+    )
+
+    /**
+     * An event from the fan-in stream. [sourceConnectionId] is the connection it arrived
+     * on first; copies from other connections were dropped natively.
+     */
+    data class FanInEvent(
+        val sourceConnectionId: Long,
+        val cotXml: String
+    )
+
+    /**
+     * A track whose CoT stale time has passed, as reported by the native track store.
+     * For events that carried no stale time, [staleMs] is the default expiry.
+     */
+    data class ExpiredTrack(
+        val uid: String,
+        val staleMs: Long
+    )
+
+    /**
+     * Batched delivery settings for a connection.
+     * Messages are flushed once maxMessages are buffered or the oldest buffered
+     * message has waited flushIntervalMs, whichever comes first.
+     */
+    data class BatchConfig(
+        val maxMessages: Int = 64,
+        val flushIntervalMs: Int = 50
+    )
+
     data class ConnectionInfo(
         val id: Long,
         val status: String,
@@ -102,25 +277,271 @@ class OmniTAKNativeBridge {
         val latencyMs: Int,
         val messagesReceived: Long,
         val messagesSent: Long,
-        val lastError: String? = null
+        val lastError: String? = null,
+        val metrics: ConnectionMetrics? = null
+    )
+
+    /**
+     * Bridge-side counters for one connection, collected natively since connect.
+     *
+     * [rttMicros] is smoothed over TAK ping round trips (see [sendPing]) and stays 0
+     * until the first reply. Upcall times cover each JNI call into this bridge, so a
+     * high [upcallP99Micros] points at slow Kotlin callbacks rather than the network.
+     * [nativeQueueDepth] counts messages buffered for the next batched upcall;
+     * [uiQueueDepth] those waiting in a frame-paced callback's scheduler.
+     * For reconnecting connections, [outboundQueued] counts sends held while the link is
+     * down and [outboundDropped] position reports dropped from a full queue.
+     * [nativeAllocations] counts heap allocations the bridge made for this connection's
+     * inbound buffers (new slabs, grown staging buffers) and should level off once the
+     * pool has warmed up; see [getPoolStats] for the shared pool.
+     */
+    data class ConnectionMetrics(
+        val bytesSent: Long,
+        val bytesReceived: Long,
+        val sendFailures: Long,
+        val rttMicros: Long,
+        val nativeQueueDepth: Int,
+        val uiQueueDepth: Int,
+        val upcalls: Long,
+        val upcallP50Micros: Long,
+        val upcallP99Micros: Long,
+        val upcallMaxMicros: Long,
+        val coalesced: Long,
+        val duplicates: Long,
+        val dropped: Long,
+        val outboundQueued: Int = 0,
+        val outboundDropped: Long = 0,
+        val reconnects: Long = 0,
+        val nativeAllocations: Long = 0,
+        val nativeAllocatedBytes: Long = 0
+    )
+
+    /**
+     * Counters for the inbound buffer pool shared by all connections.
+     *
+     * [allocations] and [allocatedBytes] only grow while the pool warms up or a burst
+     * needs more slabs than it has seen before; in steady state slabs are [reuses].
+     * [coalescerAllocations] counts the coalescer's per-track buffers the same way.
+     */
+    data class PoolStats(
+        val slabs: Long,
+        val slabsInUse: Long,
+        val peakSlabsInUse: Long,
+        val allocations: Long,
+        val allocatedBytes: Long,
+        val reuses: Long,
+        val coalescerAllocations: Long
     )
 
-    // Native status structure (matches C struct)
+    // Native status structure (matches C struct plus the bridge's counters)
     private data class ConnectionStatusNative(
         val isConnected: Int,
         val messagesSent: Long,
         val messagesReceived: Long,
-        val lastErrorCode: Int
+        val lastErrorCode: Int,
+        val bytesSent: Long,
+        val bytesReceived: Long,
+        val sendFailures: Long,
+        val rttMicros: Long,
+        val queueDepth: Int,
+        val upcalls: Long,
+        val upcallP50Micros: Long,
+        val upcallP99Micros: Long,
+        val upcallMaxMicros: Long,
+        val coalesced: Long,
+        val duplicates: Long,
+        val dropped: Long,
+        val outboundQueued: Int,
+        val outboundDropped: Long,
+        val reconnects: Long,
+        val nativeAllocations: Long,
+        val nativeAllocatedBytes: Long
     )
 
-    private data class CertificateBundle(
-        val certPem: String,
-        val keyPem: String,
-        val caPem: String?
+    // (lat, lon, count) triples in `values`; uids[i] is set for single tracks only
+    private class TrackClustersNative(
+        val values: DoubleArray,
+        val uids: Array<String?>
     )
 
+    // Parallel arrays; (lat, lon) pairs in `positions`, (stale, updated) pairs in `times`
+    private class SnapshotTracksNative(
+        val uids: Array<String>,
+        val types: Array<String>,
+        val callsigns: Array<String>,
+        val positions: DoubleArray,
+        val times: LongArray
+    )
+
+    /**
+     * Zero-copy view over a batch of CoT messages held in native memory.
+     *
+     * The buffer is a direct ByteBuffer over a pooled native slab containing the
+     * raw UTF-8 payloads plus an offsets table (layout in cot_slab_pool.h).
+     * Callers must call [release] exactly once when done; the buffer must not be
+     * touched afterwards because the slab is reused for later messages.
+     */
+    class CotSlab internal constructor(
+        private val bridge: OmniTAKNativeBridge,
+        val slabId: Int,
+        buffer: ByteBuffer
+    ) {
+        private val buffer: ByteBuffer = buffer.order(ByteOrder.nativeOrder())
+
+        // Releasing twice would free a slab the pool may already have handed out again
+        private val released = AtomicBoolean(false)
+
+        val size: Int
+            get() = buffer.getInt(0)
+
+        /** Read-only view over the UTF-8 bytes of message [index], without copying */
+        fun bytes(index: Int): ByteBuffer {
+            checkIndex(index)
+            val entry = HEADER_SIZE + index * ENTRY_SIZE
+            val offset = buffer.getInt(entry)
+            val length = buffer.getInt(entry + 4)
+            val view = buffer.duplicate()
+            view.limit(offset + length)
+            view.position(offset)
+            return view.slice().asReadOnlyBuffer()
+        }
+
+        /** Decode message [index] into a String (copies) */
+        fun getString(index: Int): String {
+            return Charsets.UTF_8.decode(bytes(index)).toString()
+        }
+
+        fun release() {
+            if (released.compareAndSet(false, true)) {
+                bridge.nativeReleaseSlab(slabId)
+            }
+        }
+
+        private fun checkIndex(index: Int) {
+            check(!released.get()) { "CotSlab $slabId used after release" }
+            if (index < 0 || index >= size) {
+                throw IndexOutOfBoundsException("Index $index out of range for slab of size $size")
+            }
+        }
+
+        private companion object {
+            // Must match kSlabHeaderSize / kSlabEntrySize in cot_slab_pool.h
+            const val HEADER_SIZE = 8
+            const val ENTRY_SIZE = 8
+        }
+    }
+
+    /**
+     * Natively parsed CoT events, backed by native memory.
+     *
+     * [records] is a packed array of fixed-size records (layout in cot_parser.h)
+     * holding uid, type, how, time/start/stale, point and callsign. The raw XML of
+     * each event is kept in the same native slab and only decoded when [xml] is
+     * called, so the common PLI path never touches XML on the JVM.
+     * Callers must call [release] exactly once when done.
+     */
+    class CotEventBatch internal constructor(
+        private val bridge: OmniTAKNativeBridge,
+        val slabId: Int,
+        records: ByteBuffer,
+        xml: ByteBuffer
+    ) {
+        private val records: ByteBuffer = records.order(ByteOrder.nativeOrder())
+        private val slab = CotSlab(bridge, slabId, xml)
+
+        val size: Int = records.capacity() / RECORD_SIZE
+
+        fun isValid(index: Int): Boolean = flags(index) and FLAG_VALID != 0
+        fun hasPoint(index: Int): Boolean = flags(index) and FLAG_HAS_POINT != 0
+        fun isTruncated(index: Int): Boolean = flags(index) and FLAG_TRUNCATED != 0
+
+        fun uid(index: Int): String = cString(index, OFFSET_UID, UID_SIZE)
+        fun type(index: Int): String = cString(index, OFFSET_TYPE, TYPE_SIZE)
+        fun how(index: Int): String = cString(index, OFFSET_HOW, HOW_SIZE)
+        fun callsign(index: Int): String? {
+            if (flags(index) and FLAG_HAS_CONTACT == 0) return null
+            return cString(index, OFFSET_CALLSIGN, CALLSIGN_SIZE)
+        }
+
+        fun lat(index: Int): Double = records.getDouble(base(index) + OFFSET_LAT)
+        fun lon(index: Int): Double = records.getDouble(base(index) + OFFSET_LON)
+        fun hae(index: Int): Double = records.getDouble(base(index) + OFFSET_HAE)
+        fun ce(index: Int): Double = records.getDouble(base(index) + OFFSET_CE)
+        fun le(index: Int): Double = records.getDouble(base(index) + OFFSET_LE)
+
+        /** Times are Unix epoch milliseconds, 0 when absent */
+        fun timeMs(index: Int): Long = records.getLong(base(index) + OFFSET_TIME)
+        fun startMs(index: Int): Long = records.getLong(base(index) + OFFSET_START)
+        fun staleMs(index: Int): Long = records.getLong(base(index) + OFFSET_STALE)
+
+        /** Raw XML of event [index], decoded on demand */
+        fun xml(index: Int): String = slab.getString(index)
+
+        /** Read-only view over the raw XML bytes of event [index] */
+        fun xmlBytes(index: Int): ByteBuffer = slab.bytes(index)
+
+        fun release() {
+            slab.release()
+        }
+
+        private fun flags(index: Int): Int = records.getInt(base(index) + OFFSET_FLAGS)
+
+        private fun base(index: Int): Int {
+            if (index < 0 || index >= size) {
+                throw IndexOutOfBoundsException("Index $index out of range for batch of size $size")
+            }
+            return index * RECORD_SIZE
+        }
+
+        private fun cString(index: Int, offset: Int, capacity: Int): String {
+            val start = base(index) + offset
+            var length = 0
+            while (length < capacity && records.get(start + length) != 0.toByte()) {
+                length++
+            }
+            val bytes = ByteArray(length)
+            for (i in 0 until length) {
+                bytes[i] = records.get(start + i)
+            }
+            return String(bytes, Charsets.UTF_8)
+        }
+
+        private companion object {
+            // Must match CotEventRecord in cot_parser.h
+            const val RECORD_SIZE = 256
+            const val OFFSET_LAT = 0
+            const val OFFSET_LON = 8
+            const val OFFSET_HAE = 16
+            const val OFFSET_CE = 24
+            const val OFFSET_LE = 32
+            const val OFFSET_TIME = 40
+            const val OFFSET_START = 48
+            const val OFFSET_STALE = 56
+            const val OFFSET_FLAGS = 64
+            const val OFFSET_UID = 72
+            const val UID_SIZE = 64
+            const val OFFSET_TYPE = 136
+            const val TYPE_SIZE = 40
+            const val OFFSET_HOW = 176
+            const val HOW_SIZE = 8
+            const val OFFSET_CALLSIGN = 184
+            const val CALLSIGN_SIZE = 72
+
+            const val FLAG_VALID = 1 shl 0
+            const val FLAG_HAS_POINT = 1 shl 1
+            const val FLAG_HAS_CONTACT = 1 shl 2
+            const val FLAG_TRUNCATED = 1 shl 3
+        }
+    }
+
     // MARK: - Protocol Constants
 
+    private object DeliveryMode {
+        const val STRING = 0
+        const val DIRECT = 1
+        const val PARSED = 2
+    }
+
     private object Protocol {
         const val TCP = 0
         const val UDP = 1
@@ -150,15 +571,46 @@ class OmniTAKNativeBridge {
 
     // MARK: - Instance State
 
-    // Certificate storage
-    private val certificates = ConcurrentHashMap<String, CertificateBundle>()
+    // Certificate id -> native certificate handle (the PEM itself lives natively)
+    private val certificates = ConcurrentHashMap<String, Long>()
 
     // Callback storage: connection_id -> callback
     private val callbacks = ConcurrentHashMap<Long, (String) -> Unit>()
 
+    // Zero-copy callback storage: connection_id -> slab callback
+    private val slabCallbacks = ConcurrentHashMap<Long, (CotSlab) -> Unit>()
+
+    // Parsed callback storage: connection_id -> event batch callback
+    private val eventCallbacks = ConcurrentHashMap<Long, (CotEventBatch) -> Unit>()
+
+    // Connection ID -> frame scheduler for frame-paced delivery
+    private val frameSchedulers = ConcurrentHashMap<Long, CotFrameScheduler<String>>()
+
+    // Expired track callback, shared by all connections
+    @Volatile
+    private var expiryCallback: ((List<ExpiredTrack>) -> Unit)? = null
+
     // Connection metadata
     private val connections = ConcurrentHashMap<Long, ServerConfig>()
 
+    // Urgent lane: events from onCotPriority wait here (in arrival order) for one drain
+    // posted to the front of the main looper's queue
+    private data class PriorityEvent(val connectionId: Long, val lane: PriorityLane, val cotXml: String)
+    private val priorityQueue = ConcurrentLinkedQueue<PriorityEvent>()
+    private val priorityDrainPosted = AtomicBoolean(false)
+    private val mainHandler by lazy { Handler(Looper.getMainLooper()) }
+
+    @Volatile
+    private var priorityCallback: ((Long, PriorityLane, String) -> Unit)? = null
+
+    // Fan-in stream callback, replacing per-connection callbacks while set
+    @Volatile
+    private var fanInCallback: ((List<FanInEvent>) -> Unit)? = null
+
+    // Async connects in flight: pending id -> completion, called on the native thread.
+    // The config is recorded in connections before the completion runs.
+    private val pendingConnects = ConcurrentHashMap<Long, Pair<ServerConfig, (Long) -> Unit>>()
+
     // Initialization state
     @Volatile
     private var isInitialized = false
@@ -178,7 +630,7 @@ class OmniTAKNativeBridge {
 
         synchronized(initLock) {
             if (!isInitialized) {
-                val result = nativeInit()
+                val result = nativeInit(snapshotFile?.absolutePath)
                 if (result == 0) {
                     isInitialized = true
                     Log.i(TAG, "Native library initialized successfully")
@@ -196,39 +648,97 @@ class OmniTAKNativeBridge {
         return nativeVersion()
     }
 
-    suspend fun connect(config: ServerConfig): Long? = withContext(Dispatchers.IO) {
-        ensureInitialized()
+    /**
+     * Connect without holding a thread while the TCP connect and TLS handshake run.
+     * Cancelling the caller disconnects the connection if it still comes up.
+     */
+    suspend fun connect(config: ServerConfig): Long? = suspendCancellableCoroutine { cont ->
+        val pendingId = startConnect(config) { connectionId ->
+            cont.resume(connectionId) {
+                if (connectionId != null) {
+                    scope.launch { disconnect(connectionId) }
+                }
+            }
+        }
+        if (pendingId == null) {
+            cont.resume(null)
+        }
+    }
 
+    /**
+     * Bring up several servers at once. Each connect runs in parallel, so the total wait
+     * is roughly the slowest handshake rather than the sum of them. Results are in the
+     * order of `configs`, with null for each server that failed.
+     */
+    suspend fun connectAll(configs: List<ServerConfig>): List<Long?> = coroutineScope {
+        configs.map { config -> async { connect(config) } }.awaitAll()
+    }
+
+    /**
+     * Callback form of [connect]. Returns a pending id (or null if the connect couldn't
+     * start) and calls `onComplete` on the main thread with the connection id, or null.
+     */
+    fun connectAsync(config: ServerConfig, onComplete: (Long?) -> Unit): Long? {
+        return startConnect(config) { connectionId ->
+            scope.launch(Dispatchers.Main) {
+                try {
+                    onComplete(connectionId)
+                } catch (e: Exception) {
+                    Log.e(TAG, "Error in connect callback", e)
+                }
+            }
+        }
+    }
+
+    // Helper: start a native async connect and return its pending id, or null.
+    // `completion` runs on the native connect thread.
+    private fun startConnect(config: ServerConfig, completion: (Long?) -> Unit): Long? {
         try {
+            ensureInitialized()
+
             val protocolId = Protocol.fromString(config.protocol)
 
-            // Get certificate bundle if specified
-            val certBundle = config.certificateId?.let { certificates[it] }
-
-            val connectionId = nativeConnect(
-                host = config.host,
-                port = config.port,
-                protocol = protocolId,
-                useTls = config.useTls,
-                certPem = certBundle?.certPem,
-                keyPem = certBundle?.keyPem,
-                caPem = certBundle?.caPem
-            )
+            // Native handle of the certificate, if specified
+            val certHandle = config.certificateId?.let { certId ->
+                certificates[certId] ?: run {
+                    Log.w(TAG, "Unknown certificate $certId, connecting without it")
+                    null
+                }
+            } ?: 0L
 
-            if (connectionId > 0) {
-                connections[connectionId] = config
-                Log.i(TAG, "Connected successfully: $connectionId")
-                connectionId
-            } else {
-                Log.e(TAG, "Connection failed")
-                null
+            // The native connect can finish before nativeConnectAsync returns, so the
+            // completion is keyed by a lock held across the call
+            synchronized(pendingConnects) {
+                val pendingId = nativeConnectAsync(
+                    host = config.host,
+                    port = config.port,
+                    protocol = protocolId,
+                    useTls = config.useTls,
+                    certHandle = certHandle,
+                    reconnect = config.reconnect,
+                    reconnectDelayMs = config.reconnectDelayMs
+                )
+                if (pendingId <= 0) {
+                    Log.e(TAG, "Connect could not start: $pendingId")
+                    return null
+                }
+                pendingConnects[pendingId] = config to { connectionId ->
+                    completion(if (connectionId > 0) connectionId else null)
+                }
+                return pendingId
             }
         } catch (e: Exception) {
             Log.e(TAG, "Connect exception", e)
-            null
+            return null
         }
     }
 
+    /**
+     * Disconnect and drop the connection's callbacks. The native side waits for upcalls
+     * already delivering on the connection to return, so the JNI upcalls below must never
+     * block on this (e.g. with runBlocking): their thread would wait on itself. Callbacks
+     * are dispatched to the main thread and can call it freely.
+     */
     suspend fun disconnect(connectionId: Long): Unit = withContext(Dispatchers.IO) {
         try {
             val result = nativeDisconnect(connectionId)
@@ -236,6 +746,9 @@ class OmniTAKNativeBridge {
             // Clean up
             connections.remove(connectionId)
             callbacks.remove(connectionId)
+            slabCallbacks.remove(connectionId)
+            eventCallbacks.remove(connectionId)
+            frameSchedulers.remove(connectionId)?.stop()
 
             if (result == 0) {
                 Log.i(TAG, "Disconnected: $connectionId")
@@ -247,6 +760,10 @@ class OmniTAKNativeBridge {
         }
     }
 
+    /**
+     * Send one CoT event. On a reconnecting connection that is down the event is queued
+     * and this returns true; it returns false if the event's queue is full, or for pings.
+     */
     suspend fun sendCot(connectionId: Long, cotXml: String): Boolean = withContext(Dispatchers.IO) {
         try {
             val result = nativeSendCot(connectionId, cotXml)
@@ -265,11 +782,146 @@ class OmniTAKNativeBridge {
         }
     }
 
-    fun registerCotCallback(connectionId: Long, callback: (String) -> Unit) {
+    /**
+     * Send UTF-8 encoded CoT from [buffer] without converting through a String.
+     * Direct buffers are read in place; heap buffers are sent from their backing array.
+     */
+    suspend fun sendCot(
+        connectionId: Long,
+        buffer: ByteBuffer,
+        offset: Int = buffer.position(),
+        length: Int = buffer.remaining()
+    ): Boolean = withContext(Dispatchers.IO) {
+        try {
+            val result = when {
+                buffer.isDirect -> nativeSendCotBytes(connectionId, buffer, offset, length)
+                buffer.hasArray() -> nativeSendCotArray(
+                    connectionId,
+                    buffer.array(),
+                    buffer.arrayOffset() + offset,
+                    length
+                )
+                else -> throw IllegalArgumentException("Read-only heap buffers are not supported")
+            }
+            val success = (result == 0)
+
+            if (success) {
+                Log.d(TAG, "CoT bytes sent on connection $connectionId")
+            } else {
+                Log.e(TAG, "Failed to send CoT bytes on connection $connectionId: $result")
+            }
+
+            success
+        } catch (e: Exception) {
+            Log.e(TAG, "SendCot exception", e)
+            false
+        }
+    }
+
+    suspend fun sendCot(
+        connectionId: Long,
+        bytes: ByteArray,
+        offset: Int = 0,
+        length: Int = bytes.size - offset
+    ): Boolean = withContext(Dispatchers.IO) {
+        try {
+            val result = nativeSendCotArray(connectionId, bytes, offset, length)
+            val success = (result == 0)
+
+            if (!success) {
+                Log.e(TAG, "Failed to send CoT bytes on connection $connectionId: $result")
+            }
+
+            success
+        } catch (e: Exception) {
+            Log.e(TAG, "SendCot exception", e)
+            false
+        }
+    }
+
+    /**
+     * Send a TAK ping (t-x-c-t). The server's t-x-c-t-r reply updates the connection's
+     * round-trip estimate, reported as [ConnectionInfo.latencyMs].
+     */
+    suspend fun sendPing(connectionId: Long): Boolean {
+        val now = Instant.now()
+        val time = now.toString()
+        val stale = now.plusSeconds(20).toString()
+        val ping = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" +
+            "<event version=\"2.0\" uid=\"${UUID.randomUUID()}-ping\" type=\"t-x-c-t\" how=\"h-g-i-g-o\" " +
+            "time=\"$time\" start=\"$time\" stale=\"$stale\">" +
+            "<point lat=\"0.0\" lon=\"0.0\" hae=\"0.0\" ce=\"9999999.0\" le=\"9999999.0\"/><detail/></event>"
+        return sendCot(connectionId, ping)
+    }
+
+    /**
+     * Send many CoT messages in a single native call.
+     * Returns a BitSet with bit i set when cotXmls[i] was sent.
+     */
+    suspend fun sendCotBatch(connectionId: Long, cotXmls: List<String>): BitSet = withContext(Dispatchers.IO) {
+        try {
+            val bitmap = nativeSendCotStrings(connectionId, cotXmls.toTypedArray())
+            batchResult(connectionId, bitmap, cotXmls.size)
+        } catch (e: Exception) {
+            Log.e(TAG, "SendCotBatch exception", e)
+            BitSet()
+        }
+    }
+
+    /**
+     * Send many UTF-8 CoT messages packed into one direct [buffer].
+     * [regions] holds (offset, length) pairs, one per message. Terminating each
+     * message with a 0 byte lets the native side send it without copying.
+     * Returns a BitSet with bit i set when message i was sent.
+     */
+    suspend fun sendCotBatch(
+        connectionId: Long,
+        buffer: ByteBuffer,
+        regions: IntArray
+    ): BitSet = withContext(Dispatchers.IO) {
+        require(buffer.isDirect) { "sendCotBatch requires a direct ByteBuffer" }
+        require(regions.size % 2 == 0) { "regions must hold (offset, length) pairs" }
+
+        try {
+            val bitmap = nativeSendCotBatch(connectionId, buffer, regions)
+            batchResult(connectionId, bitmap, regions.size / 2)
+        } catch (e: Exception) {
+            Log.e(TAG, "SendCotBatch exception", e)
+            BitSet()
+        }
+    }
+
+    private fun batchResult(connectionId: Long, bitmap: LongArray?, count: Int): BitSet {
+        val sent = bitmap?.let { BitSet.valueOf(it) } ?: BitSet()
+        val sentCount = sent.cardinality()
+
+        if (sentCount == count) {
+            Log.d(TAG, "CoT batch of $count sent on connection $connectionId")
+        } else {
+            Log.e(TAG, "Sent $sentCount of $count CoT messages on connection $connectionId")
+        }
+
+        return sent
+    }
+
+    fun registerCotCallback(
+        connectionId: Long,
+        batchConfig: BatchConfig? = null,
+        callback: (String) -> Unit
+    ) {
         callbacks[connectionId] = callback
 
+        slabCallbacks.remove(connectionId)
+        eventCallbacks.remove(connectionId)
+        frameSchedulers.remove(connectionId)?.stop()
+
         // Register with native layer
-        val result = nativeRegisterCallback(connectionId)
+        val result = nativeRegisterCallback(
+            connectionId,
+            batchConfig?.maxMessages ?: 0,
+            batchConfig?.flushIntervalMs ?: 0,
+            DeliveryMode.STRING
+        )
 
         if (result == 0) {
             Log.i(TAG, "Callback registered for connection $connectionId")
@@ -278,6 +930,279 @@ class OmniTAKNativeBridge {
         }
     }
 
+    /**
+     * Register a zero-copy callback. Messages are delivered as [CotSlab]s over
+     * native memory, avoiding a Java String per message. The callback runs on the
+     * main thread and must call [CotSlab.release] once it's done with the slab.
+     * Slabs that never reach the callback because of [shutdown] are released for it.
+     */
+    fun registerCotSlabCallback(
+        connectionId: Long,
+        batchConfig: BatchConfig? = null,
+        callback: (CotSlab) -> Unit
+    ) {
+        slabCallbacks[connectionId] = callback
+        callbacks.remove(connectionId)
+        eventCallbacks.remove(connectionId)
+        frameSchedulers.remove(connectionId)?.stop()
+
+        val result = nativeRegisterCallback(
+            connectionId,
+            batchConfig?.maxMessages ?: 0,
+            batchConfig?.flushIntervalMs ?: 0,
+            DeliveryMode.DIRECT
+        )
+
+        if (result == 0) {
+            Log.i(TAG, "Slab callback registered for connection $connectionId")
+        } else {
+            Log.e(TAG, "Failed to register slab callback for connection $connectionId: $result")
+        }
+    }
+
+    /**
+     * Register a callback for natively parsed events. Each [CotEventBatch] exposes
+     * uid/type/time/point/callsign without any XML parsing on the JVM; the raw XML
+     * is still available lazily. The callback runs on the main thread and must call
+     * [CotEventBatch.release] once it's done with the batch.
+     */
+    fun registerCotEventCallback(
+        connectionId: Long,
+        batchConfig: BatchConfig? = null,
+        callback: (CotEventBatch) -> Unit
+    ) {
+        eventCallbacks[connectionId] = callback
+        callbacks.remove(connectionId)
+        slabCallbacks.remove(connectionId)
+        frameSchedulers.remove(connectionId)?.stop()
+
+        val result = nativeRegisterCallback(
+            connectionId,
+            batchConfig?.maxMessages ?: 0,
+            batchConfig?.flushIntervalMs ?: 0,
+            DeliveryMode.PARSED
+        )
+
+        if (result == 0) {
+            Log.i(TAG, "Event callback registered for connection $connectionId")
+        } else {
+            Log.e(TAG, "Failed to register event callback for connection $connectionId: $result")
+        }
+    }
+
+    /**
+     * Register a callback that receives map updates at display rate instead of
+     * message rate. Messages are keyed by event uid; each vsync, [callback] gets
+     * the latest message of up to [CotFrameScheduler.Config.maxUpdatesPerFrame]
+     * tracks on the main thread. Use the returned scheduler's stats to watch
+     * merged and dropped updates.
+     */
+    fun registerFramePacedCallback(
+        connectionId: Long,
+        frameConfig: CotFrameScheduler.Config = CotFrameScheduler.Config(),
+        batchConfig: BatchConfig? = null,
+        callback: (List<String>) -> Unit
+    ): CotFrameScheduler<String> {
+        val scheduler = CotFrameScheduler(frameConfig, callback)
+        frameSchedulers.put(connectionId, scheduler)?.stop()
+        callbacks.remove(connectionId)
+        slabCallbacks.remove(connectionId)
+        eventCallbacks.remove(connectionId)
+
+        val result = nativeRegisterCallback(
+            connectionId,
+            batchConfig?.maxMessages ?: 0,
+            batchConfig?.flushIntervalMs ?: 0,
+            DeliveryMode.STRING
+        )
+
+        if (result == 0) {
+            Log.i(TAG, "Frame-paced callback registered for connection $connectionId")
+        } else {
+            Log.e(TAG, "Failed to register frame-paced callback for connection $connectionId: $result")
+        }
+        return scheduler
+    }
+
+    /**
+     * Coalesce inbound events natively before they reach any callback. Within each
+     * [windowMs] window, every event uid (across all connections) produces at most
+     * one delivery carrying its latest update; exact duplicates are dropped.
+     * Use a frame-sized window (e.g. 16 ms) for map updates. 0 disables coalescing.
+     */
+    fun setCoalescingWindow(windowMs: Int): Boolean {
+        val result = nativeSetCoalescing(windowMs)
+        if (result != 0) {
+            Log.e(TAG, "Failed to set coalescing window to $windowMs ms: $result")
+        }
+        return result == 0
+    }
+
+    /**
+     * Give urgent events their own lane. Events classified [urgent] or more urgent skip
+     * coalescing, batching and frame pacing: the native layer hands each one over as
+     * soon as it arrives, and it runs on the main thread ahead of anything already
+     * queued there (e.g. thousands of PLI updates during a flood). Urgent events go to
+     * [callback] if given, otherwise to the connection's String or frame-paced callback
+     * (frame-paced ones are delivered at once, outside the frame). Without [callback],
+     * connections using slab or parsed delivery keep urgent events on their normal path.
+     */
+    fun enablePriorityLanes(
+        urgent: PriorityLane = PriorityLane.TASKING,
+        callback: ((connectionId: Long, lane: PriorityLane, cotXml: String) -> Unit)? = null
+    ): Boolean {
+        priorityCallback = callback
+        val result = nativeSetPriorityLanes(urgent.value, callback != null)
+        if (result != 0) {
+            Log.e(TAG, "Failed to enable priority lanes: $result")
+        }
+        return result == 0
+    }
+
+    /** Send every event down its connection's normal delivery path again */
+    fun disablePriorityLanes() {
+        nativeSetPriorityLanes(-1, false)
+        priorityCallback = null
+    }
+
+    /**
+     * Merge every connection (TAK server, SA multicast, mesh) into one stream. Each
+     * event is delivered once however many connections carry it: natively, a second
+     * copy with the same uid and CoT time within [dedupWindowMs] is dropped, as is a
+     * copy older than the newest event seen for its uid. Whatever is left reaches
+     * [callback] in arrival order, every [flushIntervalMs], on the main thread, with
+     * the connection each event came from.
+     *
+     * While enabled, connections need no callback registration of their own, and those
+     * that have one stop receiving events. Copies dropped count as duplicates in each
+     * connection's metrics. Priority lanes still apply to the merged stream.
+     */
+    fun enableFanIn(
+        flushIntervalMs: Int = 50,
+        dedupWindowMs: Int = 30_000,
+        callback: (List<FanInEvent>) -> Unit
+    ): Boolean {
+        fanInCallback = callback
+        val result = nativeSetFanIn(true, flushIntervalMs, dedupWindowMs)
+        if (result != 0) {
+            Log.e(TAG, "Failed to enable fan-in: $result")
+            fanInCallback = null
+        }
+        return result == 0
+    }
+
+    /** Hand events back to the per-connection callbacks */
+    fun disableFanIn() {
+        nativeSetFanIn(false, 0, 0)
+        fanInCallback = null
+    }
+
+    /**
+     * Track stale times natively across all connections. Once an event's stale time
+     * passes without a newer update for its uid, [callback] receives it in a list of
+     * expired tracks (on the main thread, checked about once per second), so the UI
+     * can drop markers without scanning them. Events without a stale time expire 10
+     * minutes after their last update. Passing null disables tracking.
+     */
+    fun setExpiryCallback(callback: ((List<ExpiredTrack>) -> Unit)?) {
+        expiryCallback = callback
+        nativeSetTrackExpiry(callback != null)
+    }
+
+    /** Number of tracks held by the native track store */
+    fun getTrackCount(): Int = nativeGetTrackCount()
+
+    /**
+     * Index the latest `<point>` of every track natively so [queryTracksInRegion]
+     * can answer viewport queries without the UI holding every marker. Tracks
+     * are still pruned at their stale time while the index is enabled.
+     */
+    fun setTrackIndexEnabled(enabled: Boolean) {
+        nativeSetTrackIndex(enabled)
+    }
+
+    /**
+     * Uids of up to [limit] tracks whose latest position is inside the box, e.g.
+     * the visible map bounds plus a margin. A box with [minLon] > [maxLon] wraps
+     * across the antimeridian. Empty unless the track index is enabled.
+     */
+    suspend fun queryTracksInRegion(
+        minLat: Double,
+        minLon: Double,
+        maxLat: Double,
+        maxLon: Double,
+        limit: Int = 1000
+    ): List<String> = withContext(Dispatchers.IO) {
+        nativeQueryRegion(minLat, minLon, maxLat, maxLon, limit)?.toList() ?: emptyList()
+    }
+
+    /**
+     * Cluster track positions natively for every zoom level up to 16. Each update
+     * only adjusts the clusters the track leaves and enters, so [queryClusters] is
+     * cheap to call on every camera change even with thousands of moving tracks.
+     */
+    fun setTrackClusteringEnabled(enabled: Boolean) {
+        nativeSetTrackClustering(enabled)
+    }
+
+    /**
+     * Clusters at integer [zoom] overlapping the box, e.g. the visible map bounds.
+     * Clusters are roughly 64 screen pixels across; above zoom 16 every track is
+     * returned on its own. Empty unless clustering is enabled.
+     */
+    suspend fun queryClusters(
+        zoom: Int,
+        minLat: Double,
+        minLon: Double,
+        maxLat: Double,
+        maxLon: Double,
+        limit: Int = 1000
+    ): List<TrackCluster> = withContext(Dispatchers.IO) {
+        val native = nativeQueryClusters(zoom, minLat, minLon, maxLat, maxLon, limit)
+            ?: return@withContext emptyList()
+        List(native.uids.size) { i ->
+            TrackCluster(
+                lat = native.values[i * 3],
+                lon = native.values[i * 3 + 1],
+                count = native.values[i * 3 + 2].toInt(),
+                uid = native.uids[i]
+            )
+        }
+    }
+
+    /** Zoom to animate to when [cluster], queried at [zoom], is tapped so it splits up */
+    fun getClusterExpansionZoom(zoom: Int, cluster: TrackCluster): Int =
+        nativeGetClusterExpansionZoom(zoom, cluster.lat, cluster.lon)
+
+    /**
+     * Tracks in the snapshot file given to [getInstance]. Right after launch these are
+     * the tracks that were still live when the process last ran, restored before any
+     * connection comes up, so the map can draw them at once; after that the snapshot
+     * follows every tracked event. Stale tracks are dropped on load and as they expire.
+     * Empty without a snapshot file.
+     */
+    suspend fun getSnapshotTracks(): List<SnapshotTrack> = withContext(Dispatchers.IO) {
+        val native = nativeGetSnapshotTracks() ?: return@withContext emptyList()
+        List(native.uids.size) { i ->
+            val lat = native.positions[i * 2]
+            val lon = native.positions[i * 2 + 1]
+            SnapshotTrack(
+                uid = native.uids[i],
+                type = native.types[i],
+                callsign = native.callsigns[i],
+                lat = if (lat.isNaN()) null else lat,
+                lon = if (lon.isNaN()) null else lon,
+                staleMs = native.times[i * 2],
+                updatedMs = native.times[i * 2 + 1]
+            )
+        }
+    }
+
+    /** Forget every saved track, e.g. after switching to another server */
+    fun clearTrackSnapshot() {
+        nativeClearTrackSnapshot()
+    }
+
     suspend fun getConnectionStatus(connectionId: Long): ConnectionInfo? = withContext(Dispatchers.IO) {
         try {
             val nativeStatus = nativeGetStatus(connectionId)
@@ -286,16 +1211,40 @@ class OmniTAKNativeBridge {
             if (nativeStatus != null && config != null) {
                 ConnectionInfo(
                     id = connectionId,
-                    status = if (nativeStatus.isConnected != 0) "connected" else "disconnected",
+                    status = when {
+                        nativeStatus.isConnected != 0 -> "connected"
+                        config.reconnect -> "reconnecting"
+                        else -> "disconnected"
+                    },
                     host = config.host,
                     port = config.port,
                     protocol = config.protocol,
-                    latencyMs = 0, // Not provided by native layer yet
+                    latencyMs = (nativeStatus.rttMicros / 1000).toInt(),
                     messagesReceived = nativeStatus.messagesReceived,
                     messagesSent = nativeStatus.messagesSent,
                     lastError = if (nativeStatus.lastErrorCode != 0) {
                         "Error code: ${nativeStatus.lastErrorCode}"
-                    } else null
+                    } else null,
+                    metrics = ConnectionMetrics(
+                        bytesSent = nativeStatus.bytesSent,
+                        bytesReceived = nativeStatus.bytesReceived,
+                        sendFailures = nativeStatus.sendFailures,
+                        rttMicros = nativeStatus.rttMicros,
+                        nativeQueueDepth = nativeStatus.queueDepth,
+                        uiQueueDepth = frameSchedulers[connectionId]?.getStats()?.pending ?: 0,
+                        upcalls = nativeStatus.upcalls,
+                        upcallP50Micros = nativeStatus.upcallP50Micros,
+                        upcallP99Micros = nativeStatus.upcallP99Micros,
+                        upcallMaxMicros = nativeStatus.upcallMaxMicros,
+                        coalesced = nativeStatus.coalesced,
+                        duplicates = nativeStatus.duplicates,
+                        dropped = nativeStatus.dropped,
+                        outboundQueued = nativeStatus.outboundQueued,
+                        outboundDropped = nativeStatus.outboundDropped,
+                        reconnects = nativeStatus.reconnects,
+                        nativeAllocations = nativeStatus.nativeAllocations,
+                        nativeAllocatedBytes = nativeStatus.nativeAllocatedBytes
+                    )
                 )
             } else {
                 Log.w(TAG, "Failed to get status for connection $connectionId")
@@ -307,28 +1256,107 @@ class OmniTAKNativeBridge {
         }
     }
 
+    /** Inbound buffer pool counters shared by all connections */
+    fun getPoolStats(): PoolStats? {
+        val values = nativeGetPoolStats() ?: return null
+        return PoolStats(
+            slabs = values[0],
+            slabsInUse = values[1],
+            peakSlabsInUse = values[2],
+            allocations = values[3],
+            allocatedBytes = values[4],
+            reuses = values[5],
+            coalescerAllocations = values[6]
+        )
+    }
+
     suspend fun importCertificate(
         certPem: String,
         keyPem: String,
         caPem: String? = null
     ): String = withContext(Dispatchers.IO) {
+        // Validated and cached natively once; connects then pass only the handle
+        val handle = nativeImportCertificate(certPem, keyPem, caPem)
+        if (handle <= 0) {
+            throw IllegalArgumentException("Invalid certificate PEM")
+        }
+
         // Generate unique ID
         val certId = UUID.randomUUID().toString()
-
-        val bundle = CertificateBundle(
-            certPem = certPem,
-            keyPem = keyPem,
-            caPem = caPem
-        )
-
-        certificates[certId] = bundle
+        certificates[certId] = handle
 
         Log.i(TAG, "Certificate imported: $certId")
         certId
     }
 
+    /**
+     * Forget an imported certificate. Existing connections, including their automatic
+     * reconnects and connects already in progress, keep using it until they are
+     * disconnected, when the native copy of the key is wiped. Connects started after
+     * this call that name it go out without a client certificate.
+     */
+    fun releaseCertificate(certId: String): Boolean {
+        val handle = certificates.remove(certId) ?: return false
+        return nativeReleaseCertificate(handle) == 0
+    }
+
     // MARK: - Callback from JNI
 
+    /**
+     * Called from JNI on the connect thread when an async connect finishes
+     */
+    @Suppress("unused")
+    private fun onConnectComplete(pendingId: Long, connectionId: Long) {
+        val pending = synchronized(pendingConnects) { pendingConnects.remove(pendingId) }
+        if (pending == null) {
+            Log.w(TAG, "No listener for pending connect $pendingId")
+            return
+        }
+        val (config, completion) = pending
+
+        if (connectionId > 0) {
+            connections[connectionId] = config
+            Log.i(TAG, "Connected successfully: $connectionId")
+        } else {
+            Log.e(TAG, "Connection to ${config.host}:${config.port} failed")
+        }
+        completion(connectionId)
+    }
+
+    /**
+     * Called from JNI on the Rust I/O thread for each urgent event (see [enablePriorityLanes])
+     */
+    @Suppress("unused")
+    private fun onCotPriority(connectionId: Long, lane: Int, cotXml: String) {
+        priorityQueue.add(PriorityEvent(connectionId, PriorityLane.fromValue(lane), cotXml))
+
+        // One drain at the front of the main queue takes every urgent event queued by then;
+        // posting each event at the front instead would run them in reverse order
+        if (priorityDrainPosted.compareAndSet(false, true)) {
+            mainHandler.postAtFrontOfQueue { drainPriorityEvents() }
+        }
+    }
+
+    private fun drainPriorityEvents() {
+        priorityDrainPosted.set(false)
+        while (true) {
+            val event = priorityQueue.poll() ?: break
+            try {
+                val callback = priorityCallback
+                if (callback != null) {
+                    callback(event.connectionId, event.lane, event.cotXml)
+                } else {
+                    fanInCallback?.invoke(listOf(FanInEvent(event.connectionId, event.cotXml)))
+                        ?: callbacks[event.connectionId]?.invoke(event.cotXml)
+                        ?: frameSchedulers[event.connectionId]?.deliverNow(eventUid(event.cotXml) ?: event.cotXml, event.cotXml)
+                        ?: Log.w(TAG, "No callback for ${event.lane} event on connection ${event.connectionId}")
+                }
+            } catch (e: Exception) {
+                Log.e(TAG, "Error in priority CoT callback", e)
+            }
+        }
+    }
+
     /**
      * Called from JNI when a CoT message is received
      * This method is called on a native thread, so we dispatch to Kotlin coroutines
@@ -337,6 +1365,13 @@ class OmniTAKNativeBridge {
     private fun onCotReceived(connectionId: Long, cotXml: String) {
         Log.d(TAG, "CoT received on connection $connectionId")
 
+        // Frame-paced delivery queues on this thread; the scheduler hops to main per vsync
+        val scheduler = frameSchedulers[connectionId]
+        if (scheduler != null) {
+            scheduler.submit(eventUid(cotXml) ?: cotXml, cotXml)
+            return
+        }
+
         // Get callback and invoke on main dispatcher
         val callback = callbacks[connectionId]
         if (callback != null) {
@@ -352,6 +1387,170 @@ class OmniTAKNativeBridge {
         }
     }
 
+    /**
+     * Called from JNI with a batch of CoT messages when batched delivery is enabled
+     * The whole batch is handed to the main dispatcher in a single launch
+     */
+    @Suppress("unused")
+    private fun onCotBatch(connectionId: Long, cotXmls: Array<String>) {
+        Log.d(TAG, "CoT batch of ${cotXmls.size} received on connection $connectionId")
+
+        val scheduler = frameSchedulers[connectionId]
+        if (scheduler != null) {
+            for (cotXml in cotXmls) {
+                scheduler.submit(eventUid(cotXml) ?: cotXml, cotXml)
+            }
+            return
+        }
+
+        val callback = callbacks[connectionId]
+        if (callback != null) {
+            scope.launch(Dispatchers.Main) {
+                for (cotXml in cotXmls) {
+                    try {
+                        callback(cotXml)
+                    } catch (e: Exception) {
+                        Log.e(TAG, "Error in CoT callback", e)
+                    }
+                }
+            }
+        } else {
+            Log.w(TAG, "No callback registered for connection $connectionId")
+        }
+    }
+
+    // uid attribute of the <event> start tag, or null. Messages without one are keyed by
+    // their full text, so they are only merged with identical copies.
+    private fun eventUid(cotXml: String): String? {
+        val start = cotXml.indexOf("<event")
+        if (start < 0) {
+            return null
+        }
+        val end = cotXml.indexOf('>', start).let { if (it < 0) cotXml.length else it }
+
+        var index = cotXml.indexOf("uid=", start)
+        while (index in start until end) {
+            // Skip attributes that merely end in "uid", e.g. parent_uid
+            val boundary = cotXml[index - 1]
+            if ((boundary == ' ' || boundary == '\t' || boundary == '\n' || boundary == '\r') && index + 4 < end) {
+                val quote = cotXml[index + 4]
+                if (quote == '"' || quote == '\'') {
+                    val close = cotXml.indexOf(quote, index + 5)
+                    if (close in 0 until end) {
+                        return cotXml.substring(index + 5, close)
+                    }
+                }
+                return null
+            }
+            index = cotXml.indexOf("uid=", index + 4)
+        }
+        return null
+    }
+
+    /**
+     * Called from JNI with a native slab when direct delivery is enabled
+     * Ownership of the slab passes to the callback, which releases it
+     */
+    @Suppress("unused")
+    private fun onCotSlab(connectionId: Long, slabId: Int, buffer: ByteBuffer) {
+        val slab = CotSlab(this, slabId, buffer)
+        Log.d(TAG, "CoT slab of ${slab.size} received on connection $connectionId")
+
+        val callback = slabCallbacks[connectionId]
+        if (callback != null) {
+            launchWithSlab(slab::release) {
+                try {
+                    callback(slab)
+                } catch (e: Exception) {
+                    Log.e(TAG, "Error in CoT slab callback", e)
+                    slab.release()
+                }
+            }
+        } else {
+            Log.w(TAG, "No slab callback registered for connection $connectionId")
+            slab.release()
+        }
+    }
+
+    /**
+     * Called from JNI with natively parsed events when parsed delivery is enabled
+     * Ownership of the slab passes to the callback, which releases it
+     */
+    @Suppress("unused")
+    private fun onCotEvents(connectionId: Long, slabId: Int, records: ByteBuffer, xml: ByteBuffer) {
+        val batch = CotEventBatch(this, slabId, records, xml)
+        Log.d(TAG, "${batch.size} parsed CoT events received on connection $connectionId")
+
+        val callback = eventCallbacks[connectionId]
+        if (callback != null) {
+            launchWithSlab(batch::release) {
+                try {
+                    callback(batch)
+                } catch (e: Exception) {
+                    Log.e(TAG, "Error in CoT event callback", e)
+                    batch.release()
+                }
+            }
+        } else {
+            Log.w(TAG, "No event callback registered for connection $connectionId")
+            batch.release()
+        }
+    }
+
+    /**
+     * Run [deliver] on the main thread, handing it a native slab. If the launch is
+     * cancelled before [deliver] starts (e.g. by shutdown()), [release] returns the
+     * slab to the pool, which is static and outlives the bridge: a slab lost here
+     * would be gone for good.
+     */
+    private fun launchWithSlab(release: () -> Unit, deliver: () -> Unit) {
+        var delivered = false
+        scope.launch(Dispatchers.Main) {
+            delivered = true
+            deliver()
+        }.invokeOnCompletion {
+            if (!delivered) {
+                release()
+            }
+        }
+    }
+
+    /**
+     * Called from JNI by the flush thread with the fan-in events queued since its last tick
+     */
+    @Suppress("unused")
+    private fun onCotFanIn(sources: LongArray, cotXmls: Array<String>) {
+        Log.d(TAG, "Fan-in batch of ${cotXmls.size} events")
+
+        val callback = fanInCallback ?: return
+        val events = cotXmls.indices.map { FanInEvent(sources[it], cotXmls[it]) }
+        scope.launch(Dispatchers.Main) {
+            try {
+                callback(events)
+            } catch (e: Exception) {
+                Log.e(TAG, "Error in fan-in callback", e)
+            }
+        }
+    }
+
+    /**
+     * Called from JNI by the flush thread with tracks whose stale time has passed
+     */
+    @Suppress("unused")
+    private fun onCotExpired(uids: Array<String>, staleMs: LongArray) {
+        Log.d(TAG, "${uids.size} tracks expired")
+
+        val callback = expiryCallback ?: return
+        val expired = uids.indices.map { ExpiredTrack(uids[it], staleMs[it]) }
+        scope.launch(Dispatchers.Main) {
+            try {
+                callback(expired)
+            } catch (e: Exception) {
+                Log.e(TAG, "Error in expiry callback", e)
+            }
+        }
+    }
+
     // MARK: - Cleanup
 
     fun shutdown() {
@@ -359,6 +1558,15 @@ class OmniTAKNativeBridge {
         nativeShutdown()
         isInitialized = false
         callbacks.clear()
+        slabCallbacks.clear()
+        eventCallbacks.clear()
+        frameSchedulers.values.forEach { it.stop() }
+        frameSchedulers.clear()
+        expiryCallback = null
+        priorityCallback = null
+        priorityQueue.clear()
+        fanInCallback = null
+        pendingConnects.clear()
         connections.clear()
         certificates.clear()
         Log.i(TAG, "Shutdown complete")
@@ -372,13 +1580,39 @@ class OmniTAKNativeBridge {
  */
 object OmniTAKNativeModule {
 
-    private val bridge = OmniTAKNativeBridge.getInstance()
+    // Set by initialize() before the bridge is first used
+    @Volatile
+    private var snapshotFile: File? = null
+
+    private val bridgeInstance = lazy { OmniTAKNativeBridge.getInstance(snapshotFile) }
+    private val bridge by bridgeInstance
+
+    /**
+     * Set up the bridge: `snapshotPath` (e.g. a file under the app's filesDir) keeps a
+     * native track snapshot across restarts, see [OmniTAKNativeBridge.getSnapshotTracks].
+     * Call before any other function here; returns false once the bridge already exists.
+     */
+    fun initialize(options: Map<String, Any?>): Boolean {
+        if (bridgeInstance.isInitialized()) {
+            Log.w("OmniTAKNative", "initialize called after the bridge was created; options ignored")
+            return false
+        }
+        snapshotFile = (options["snapshotPath"] as? String)?.let { File(it) }
+        bridge
+        return true
+    }
 
     suspend fun connect(config: Map<String, Any?>): Long? {
         val serverConfig = parseServerConfig(config) ?: return null
         return bridge.connect(serverConfig)
     }
 
+    suspend fun connectAll(configs: List<Map<String, Any?>>): List<Long?> {
+        val serverConfigs = configs.map { parseServerConfig(it) }
+        val connected = bridge.connectAll(serverConfigs.filterNotNull()).iterator()
+        return serverConfigs.map { if (it != null) connected.next() else null }
+    }
+
     suspend fun disconnect(connectionId: Long) {
         bridge.disconnect(connectionId)
     }
@@ -387,8 +1621,127 @@ object OmniTAKNativeModule {
         return bridge.sendCot(connectionId, cotXml)
     }
 
+    suspend fun sendPing(connectionId: Long): Boolean {
+        return bridge.sendPing(connectionId)
+    }
+
+    suspend fun sendCotBatch(connectionId: Long, cotXmls: List<String>): List<Boolean> {
+        val sent = bridge.sendCotBatch(connectionId, cotXmls)
+        return cotXmls.indices.map { sent.get(it) }
+    }
+
     fun registerCotCallback(connectionId: Long, callback: (String) -> Unit) {
-        bridge.registerCotCallback(connectionId, callback)
+        bridge.registerCotCallback(connectionId, callback = callback)
+    }
+
+    fun registerCotCallback(
+        connectionId: Long,
+        options: Map<String, Any?>,
+        callback: (String) -> Unit
+    ) {
+        bridge.registerCotCallback(connectionId, parseBatchConfig(options), callback)
+    }
+
+    fun setCoalescingWindow(windowMs: Int): Boolean {
+        return bridge.setCoalescingWindow(windowMs)
+    }
+
+    fun setPriorityLanes(
+        options: Map<String, Any?>?,
+        callback: ((Map<String, Any?>) -> Unit)? = null
+    ): Boolean {
+        if (options == null) {
+            bridge.disablePriorityLanes()
+            return true
+        }
+        val urgent = (options["urgent"] as? String)?.let { name ->
+            OmniTAKNativeBridge.PriorityLane.values().firstOrNull { it.name.equals(name, ignoreCase = true) }
+        } ?: OmniTAKNativeBridge.PriorityLane.TASKING
+        if (callback == null) {
+            return bridge.enablePriorityLanes(urgent)
+        }
+        return bridge.enablePriorityLanes(urgent) { connectionId, lane, cotXml ->
+            callback(mapOf("connectionId" to connectionId, "lane" to lane.name, "cotXml" to cotXml))
+        }
+    }
+
+    fun setFanIn(options: Map<String, Any?>?, callback: ((List<Map<String, Any?>>) -> Unit)?): Boolean {
+        if (options == null || callback == null) {
+            bridge.disableFanIn()
+            return true
+        }
+        val flushIntervalMs = (options["flushIntervalMs"] as? Number)?.toInt() ?: 50
+        val dedupWindowMs = (options["dedupWindowMs"] as? Number)?.toInt() ?: 30_000
+        return bridge.enableFanIn(flushIntervalMs, dedupWindowMs) { events ->
+            callback(events.map { mapOf("sourceConnectionId" to it.sourceConnectionId, "cotXml" to it.cotXml) })
+        }
+    }
+
+    fun setTrackIndexEnabled(enabled: Boolean) {
+        bridge.setTrackIndexEnabled(enabled)
+    }
+
+    suspend fun queryTracksInRegion(region: Map<String, Any?>): List<String> {
+        val minLat = (region["minLat"] as? Number)?.toDouble() ?: return emptyList()
+        val minLon = (region["minLon"] as? Number)?.toDouble() ?: return emptyList()
+        val maxLat = (region["maxLat"] as? Number)?.toDouble() ?: return emptyList()
+        val maxLon = (region["maxLon"] as? Number)?.toDouble() ?: return emptyList()
+        val limit = (region["limit"] as? Number)?.toInt() ?: 1000
+        return bridge.queryTracksInRegion(minLat, minLon, maxLat, maxLon, limit)
+    }
+
+    fun setTrackClusteringEnabled(enabled: Boolean) {
+        bridge.setTrackClusteringEnabled(enabled)
+    }
+
+    suspend fun queryClusters(region: Map<String, Any?>): List<Map<String, Any?>> {
+        val zoom = (region["zoom"] as? Number)?.toInt() ?: return emptyList()
+        val minLat = (region["minLat"] as? Number)?.toDouble() ?: return emptyList()
+        val minLon = (region["minLon"] as? Number)?.toDouble() ?: return emptyList()
+        val maxLat = (region["maxLat"] as? Number)?.toDouble() ?: return emptyList()
+        val maxLon = (region["maxLon"] as? Number)?.toDouble() ?: return emptyList()
+        val limit = (region["limit"] as? Number)?.toInt() ?: 1000
+
+        return bridge.queryClusters(zoom, minLat, minLon, maxLat, maxLon, limit).map { cluster ->
+            mapOf(
+                "latitude" to cluster.lat,
+                "longitude" to cluster.lon,
+                "count" to cluster.count,
+                "id" to cluster.uid,
+                "expansionZoom" to if (cluster.count > 1) bridge.getClusterExpansionZoom(zoom, cluster) else null
+            )
+        }
+    }
+
+    suspend fun getSnapshotTracks(): List<Map<String, Any?>> {
+        return bridge.getSnapshotTracks().map { track ->
+            mapOf(
+                "id" to track.uid,
+                "type" to track.type,
+                "callsign" to track.callsign,
+                "latitude" to track.lat,
+                "longitude" to track.lon,
+                "staleMs" to track.staleMs,
+                "updatedMs" to track.updatedMs
+            )
+        }
+    }
+
+    fun clearTrackSnapshot() {
+        bridge.clearTrackSnapshot()
+    }
+
+    fun getPoolStats(): Map<String, Long>? {
+        val stats = bridge.getPoolStats() ?: return null
+        return mapOf(
+            "slabs" to stats.slabs,
+            "slabsInUse" to stats.slabsInUse,
+            "peakSlabsInUse" to stats.peakSlabsInUse,
+            "allocations" to stats.allocations,
+            "allocatedBytes" to stats.allocatedBytes,
+            "reuses" to stats.reuses,
+            "coalescerAllocations" to stats.coalescerAllocations
+        )
     }
 
     suspend fun getConnectionStatus(connectionId: Long): Map<String, Any?>? {
@@ -403,7 +1756,29 @@ object OmniTAKNativeModule {
             "latencyMs" to info.latencyMs,
             "messagesReceived" to info.messagesReceived,
             "messagesSent" to info.messagesSent,
-            "lastError" to info.lastError
+            "lastError" to info.lastError,
+            "metrics" to info.metrics?.let { metrics ->
+                mapOf(
+                    "bytesSent" to metrics.bytesSent,
+                    "bytesReceived" to metrics.bytesReceived,
+                    "sendFailures" to metrics.sendFailures,
+                    "rttMicros" to metrics.rttMicros,
+                    "nativeQueueDepth" to metrics.nativeQueueDepth,
+                    "uiQueueDepth" to metrics.uiQueueDepth,
+                    "upcalls" to metrics.upcalls,
+                    "upcallP50Micros" to metrics.upcallP50Micros,
+                    "upcallP99Micros" to metrics.upcallP99Micros,
+                    "upcallMaxMicros" to metrics.upcallMaxMicros,
+                    "coalesced" to metrics.coalesced,
+                    "duplicates" to metrics.duplicates,
+                    "dropped" to metrics.dropped,
+                    "outboundQueued" to metrics.outboundQueued,
+                    "outboundDropped" to metrics.outboundDropped,
+                    "reconnects" to metrics.reconnects,
+                    "nativeAllocations" to metrics.nativeAllocations,
+                    "nativeAllocatedBytes" to metrics.nativeAllocatedBytes
+                )
+            }
         )
     }
 
@@ -415,6 +1790,19 @@ object OmniTAKNativeModule {
         return bridge.importCertificate(certPem, keyPem, caPem)
     }
 
+    fun releaseCertificate(certId: String): Boolean {
+        return bridge.releaseCertificate(certId)
+    }
+
+    private fun parseBatchConfig(options: Map<String, Any?>): OmniTAKNativeBridge.BatchConfig? {
+        val maxMessages = (options["batchSize"] as? Number)?.toInt() ?: return null
+        val flushIntervalMs = (options["flushIntervalMs"] as? Number)?.toInt() ?: 50
+        return OmniTAKNativeBridge.BatchConfig(
+            maxMessages = maxMessages,
+            flushIntervalMs = flushIntervalMs
+        )
+    }
+
     private fun parseServerConfig(config: Map<String, Any?>): OmniTAKNativeBridge.ServerConfig? {
         try {
             val host = config["host"] as? String ?: return null
@@ -0,0 +1,258 @@
+/**
+ * connection_table.h - Read-mostly connection registry for the JNI bridge
+ *
+ * Rust I/O threads look up their connection on every inbound message, while
+ * registrations change only on connect/disconnect. This table keeps the read
+ * path wait-free:
+ *
+ * - Entries live in a fixed-size open-addressing table indexed by connection
+ *   id. Keys and values are atomics, so lookups take no locks and probe at
+ *   most kCapacity slots.
+ * - Readers enter an epoch by bumping one of two counters on a per-thread
+ *   shard (so I/O threads don't contend on a single cache line).
+ * - Writers are serialized by a mutex. Removed values are only handed back
+ *   to the caller after a grace period: the writer flips the epoch and waits
+ *   for every reader that might still see the old value to leave.
+ *   Writers therefore block while an upcall on that connection is in flight,
+ *   and must never run on a thread inside a ReadGuard (it would wait on itself).
+ *
+ * Values must only be dereferenced inside a ReadGuard.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+template <typename T>
+class ConnectionTable {
+public:
+    static const size_t kCapacity = 256;
+    static const size_t kReaderShards = 16;
+
+    ConnectionTable() {
+        for (auto& slot : slots_) {
+            slot.key.store(kEmptyKey, std::memory_order_relaxed);
+            slot.value.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ConnectionTable(const ConnectionTable&) = delete;
+    ConnectionTable& operator=(const ConnectionTable&) = delete;
+
+    // RAII epoch section. Pointers returned by find()/for_each() stay valid until it ends.
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const ConnectionTable& table)
+            : counter_(table.enter()) {}
+        ~ReadGuard() { counter_->fetch_sub(1, std::memory_order_seq_cst); }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+    private:
+        std::atomic<uint32_t>* counter_;
+    };
+
+    // Lock-free lookup. Must be called inside a ReadGuard.
+    T* find(uint64_t id) const {
+        if (id == kEmptyKey || id == kTombstoneKey) {
+            return nullptr;
+        }
+
+        size_t index = slot_index(id);
+        for (size_t probe = 0; probe < kCapacity; ++probe) {
+            const Slot& slot = slots_[(index + probe) & (kCapacity - 1)];
+            uint64_t key = slot.key.load(std::memory_order_seq_cst);
+            if (key == id) {
+                return slot.value.load(std::memory_order_seq_cst);
+            }
+            if (key == kEmptyKey) {
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    // Visit every live entry. Must be called inside a ReadGuard.
+    void for_each(const std::function<void(uint64_t, T&)>& visit) const {
+        for (const Slot& slot : slots_) {
+            uint64_t key = slot.key.load(std::memory_order_seq_cst);
+            if (key == kEmptyKey || key == kTombstoneKey) {
+                continue;
+            }
+            T* value = slot.value.load(std::memory_order_seq_cst);
+            if (value) {
+                visit(key, *value);
+            }
+        }
+    }
+
+    // Insert or replace the value for `id`. On success returns true and hands back the
+    // previous value (if any) once no reader can observe it. Returns false when the
+    // table is full, in which case `value` is left untouched.
+    bool replace(uint64_t id, std::unique_ptr<T>& value, std::unique_ptr<T>& previous) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+
+        Slot* target = nullptr;
+        Slot* firstFree = nullptr;
+        size_t index = slot_index(id);
+
+        for (size_t probe = 0; probe < kCapacity; ++probe) {
+            Slot& slot = slots_[(index + probe) & (kCapacity - 1)];
+            uint64_t key = slot.key.load(std::memory_order_relaxed);
+            if (key == id) {
+                target = &slot;
+                break;
+            }
+            if (key == kTombstoneKey && !firstFree) {
+                firstFree = &slot;
+            }
+            if (key == kEmptyKey) {
+                if (!firstFree) {
+                    firstFree = &slot;
+                }
+                break;
+            }
+        }
+
+        if (target) {
+            T* old = target->value.exchange(value.release(), std::memory_order_seq_cst);
+            synchronize();
+            previous.reset(old);
+            return true;
+        }
+
+        if (!firstFree) {
+            return false;
+        }
+
+        // Publish the value before the key so readers never see a key without one
+        firstFree->value.store(value.release(), std::memory_order_seq_cst);
+        firstFree->key.store(id, std::memory_order_seq_cst);
+        previous.reset();
+        return true;
+    }
+
+    // Remove `id` and return its value once no reader can observe it
+    std::unique_ptr<T> remove(uint64_t id) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+
+        Slot* slot = find_slot_locked(id);
+        if (!slot) {
+            return nullptr;
+        }
+
+        T* old = slot->value.exchange(nullptr, std::memory_order_seq_cst);
+        slot->key.store(kTombstoneKey, std::memory_order_seq_cst);
+
+        // A run of tombstones ending at an empty slot is on no live entry's probe
+        // path, so it can be emptied again. Without this, connect/disconnect churn
+        // would fill the table with tombstones and every miss would probe all of it.
+        size_t index = (size_t)(slot - slots_);
+        if (slots_[(index + 1) & (kCapacity - 1)].key.load(std::memory_order_relaxed) == kEmptyKey) {
+            for (size_t run = 0; run < kCapacity; ++run) {
+                Slot& tail = slots_[index];
+                if (tail.key.load(std::memory_order_relaxed) != kTombstoneKey) {
+                    break;
+                }
+                tail.key.store(kEmptyKey, std::memory_order_seq_cst);
+                index = (index - 1) & (kCapacity - 1);
+            }
+        }
+
+        synchronize();
+        return std::unique_ptr<T>(old);
+    }
+
+    // Remove every entry and return the values once no reader can observe them
+    std::vector<std::unique_ptr<T>> clear() {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+
+        std::vector<std::unique_ptr<T>> removed;
+        for (Slot& slot : slots_) {
+            T* old = slot.value.exchange(nullptr, std::memory_order_seq_cst);
+            slot.key.store(kEmptyKey, std::memory_order_seq_cst);
+            if (old) {
+                removed.emplace_back(old);
+            }
+        }
+        synchronize();
+        return removed;
+    }
+
+private:
+    static const uint64_t kEmptyKey = 0; // Rust never hands out connection id 0
+    static const uint64_t kTombstoneKey = UINT64_MAX;
+
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "kCapacity must be a power of two");
+
+    struct Slot {
+        std::atomic<uint64_t> key;
+        std::atomic<T*> value;
+    };
+
+    // Two epoch counters per shard, padded to avoid false sharing between I/O threads
+    struct alignas(64) ReaderShard {
+        std::atomic<uint32_t> active[2] = {{0}, {0}};
+    };
+
+    static size_t slot_index(uint64_t id) {
+        // Fibonacci hashing spreads sequential ids across the table
+        return (size_t)((id * 11400714819323198485ULL) >> 56) & (kCapacity - 1);
+    }
+
+    static size_t reader_shard_index() {
+        static std::atomic<size_t> next_shard{0};
+        static thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kReaderShards;
+        return shard;
+    }
+
+    std::atomic<uint32_t>* enter() const {
+        ReaderShard& shard = shards_[reader_shard_index()];
+        uint32_t parity = epoch_.load(std::memory_order_seq_cst) & 1;
+        std::atomic<uint32_t>* counter = &shard.active[parity];
+        counter->fetch_add(1, std::memory_order_seq_cst);
+        return counter;
+    }
+
+    // Wait until every reader that entered before this call has left.
+    // The epoch is flipped twice: a reader may have sampled the parity just
+    // before a flip and registered on the previous counter, so draining a
+    // single counter is not enough. Called with write_mutex_ held.
+    void synchronize() {
+        for (int flip = 0; flip < 2; ++flip) {
+            uint32_t oldParity = epoch_.fetch_add(1, std::memory_order_seq_cst) & 1;
+            for (ReaderShard& shard : shards_) {
+                while (shard.active[oldParity].load(std::memory_order_seq_cst) != 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    Slot* find_slot_locked(uint64_t id) {
+        size_t index = slot_index(id);
+        for (size_t probe = 0; probe < kCapacity; ++probe) {
+            Slot& slot = slots_[(index + probe) & (kCapacity - 1)];
+            uint64_t key = slot.key.load(std::memory_order_relaxed);
+            if (key == id) {
+                return &slot;
+            }
+            if (key == kEmptyKey) {
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    Slot slots_[kCapacity];
+    mutable ReaderShard shards_[kReaderShards];
+    std::atomic<uint32_t> epoch_{0};
+    std::mutex write_mutex_;
+};
@@ -0,0 +1,54 @@
+/**
+ * cot_backoff.h - Jittered exponential backoff for reconnect attempts
+ *
+ * The nth delay is drawn uniformly from [d/2, d] with d = min(base * 2^n, max)
+ * ("equal jitter"). When a radio link drops, every connection fails at once;
+ * the random half of each delay spreads their reconnects out instead of
+ * sending them all at the server together, while the fixed half keeps a
+ * flapping link from being hammered.
+ *
+ * Not thread-safe; each reconnecting connection owns one.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+class CotBackoff {
+public:
+    CotBackoff(uint32_t base_ms, uint32_t max_ms, uint64_t seed)
+        : base_ms_(base_ms > 0 ? base_ms : 1),
+          max_ms_(max_ms > base_ms_ ? max_ms : base_ms_),
+          state_(seed != 0 ? seed : 0x9E3779B97F4A7C15ULL) {}
+
+    // Delay before the next attempt; each call doubles the ceiling up to max_ms
+    uint32_t next_delay_ms() {
+        uint64_t ceiling = (uint64_t)base_ms_ << (attempts_ < 31 ? attempts_ : 31);
+        if (ceiling > max_ms_) {
+            ceiling = max_ms_;
+        }
+        ++attempts_;
+
+        uint64_t half = ceiling / 2;
+        return (uint32_t)(ceiling - half + next_random() % (half + 1));
+    }
+
+    // Call once connected again
+    void reset() { attempts_ = 0; }
+
+    uint32_t attempts() const { return attempts_; }
+
+private:
+    // xorshift64*
+    uint64_t next_random() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    uint32_t base_ms_;
+    uint32_t max_ms_;
+    uint32_t attempts_ = 0;
+    uint64_t state_;
+};
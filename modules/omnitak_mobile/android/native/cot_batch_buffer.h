@@ -0,0 +1,126 @@
+/**
+ * cot_batch_buffer.h - Per-connection buffer for batched CoT delivery
+ *
+ * Accumulates inbound CoT payloads so the JNI bridge can hand them to Kotlin
+ * in a single upcall. Payloads are copied straight from the Rust callback
+ * into pooled slabs (see cot_slab_pool.h); a flush hands over the filled
+ * slabs in arrival order.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "cot_slab_pool.h"
+
+class CotBatchBuffer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CotBatchBuffer(CotSlabPool& pool, size_t max_messages, uint32_t flush_interval_ms)
+        : pool_(pool),
+          max_messages_(max_messages > 0 ? max_messages : 1),
+          flush_interval_(std::chrono::milliseconds(flush_interval_ms)) {}
+
+    ~CotBatchBuffer() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (CotSlab* slab : ready_) {
+            pool_.release(slab->id);
+        }
+        if (current_) {
+            pool_.release(current_->id);
+        }
+    }
+
+    size_t max_messages() const { return max_messages_; }
+    std::chrono::milliseconds flush_interval() const { return flush_interval_; }
+
+    // Append a payload. Returns true when max_messages is reached (or a slab
+    // filled up) and the buffer should be flushed by the caller.
+    // Payloads are dropped (and `*dropped` set) if the slab pool is exhausted.
+    // `*allocated` is set when a slab had to be allocated rather than reused.
+    bool push(const char* cot_xml, size_t length, bool* dropped = nullptr, bool* allocated = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (current_ && !current_->append(cot_xml, length)) {
+            ready_.push_back(current_);
+            current_ = nullptr;
+        }
+
+        if (!current_) {
+            current_ = pool_.acquire(length, allocated);
+            if (!current_) {
+                ++dropped_;
+                if (dropped) {
+                    *dropped = true;
+                }
+                return !ready_.empty();
+            }
+            current_->append(cot_xml, length);
+        }
+
+        if (count_ == 0) {
+            first_pending_ = Clock::now();
+        }
+        ++count_;
+        return count_ >= max_messages_ || !ready_.empty();
+    }
+
+    // True when the oldest pending message has waited at least flush_interval
+    bool is_due(Clock::time_point now) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_ > 0 && now - first_pending_ >= flush_interval_;
+    }
+
+    // Move all pending slabs, oldest first, into `out`. The caller owns them
+    // afterwards and must release them back to the pool.
+    size_t drain(std::vector<CotSlab*>& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t drained = count_;
+        out.clear();
+        out.swap(ready_);
+        if (current_) {
+            out.push_back(current_);
+            current_ = nullptr;
+        }
+        count_ = 0;
+        return drained;
+    }
+
+    // Number of payloads waiting for the next flush
+    size_t pending() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_;
+    }
+
+    // Number of payloads dropped because no slab was available
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+
+    // Held for the duration of a flush so batches are delivered in order
+    // even when the size trigger and the interval timer race.
+    std::mutex& flush_mutex() { return flush_mutex_; }
+
+    // Scratch vector used with drain(); only touched under flush_mutex()
+    std::vector<CotSlab*>& flush_scratch() { return flush_scratch_; }
+
+private:
+    CotSlabPool& pool_;
+    const size_t max_messages_;
+    const std::chrono::milliseconds flush_interval_;
+
+    std::mutex mutex_;
+    std::vector<CotSlab*> ready_; // Full slabs waiting for the next flush
+    CotSlab* current_ = nullptr;  // Slab currently being filled
+    size_t count_ = 0;
+    uint64_t dropped_ = 0;
+    Clock::time_point first_pending_;
+
+    std::mutex flush_mutex_;
+    std::vector<CotSlab*> flush_scratch_;
+};
@@ -0,0 +1,179 @@
+/**
+ * cot_certificate_store.cpp - Native cache of imported client certificates
+ */
+
+#include "cot_certificate_store.h"
+
+#include <cstring>
+
+static const char kBegin[] = "-----BEGIN ";
+static const char kEnd[] = "-----END ";
+static const char kDashes[] = "-----";
+
+// Helper: Length of a line without trailing whitespace, including the "\r" of CRLF input
+static size_t trim_line(const char* text, size_t length) {
+    while (length > 0 && (text[length - 1] == '\r' || text[length - 1] == ' ' || text[length - 1] == '\t')) {
+        --length;
+    }
+    return length;
+}
+
+// Helper: Append every PEM block of `pem` to `out`, normalized to LF line endings.
+// `accept` decides whether a block label is allowed; any block it rejects, or a
+// block without its END line, fails the whole input. Returns the number of blocks,
+// or -1 on failure.
+template <typename Accept>
+static long parse_pem_blocks(const char* pem, std::string& out, Accept accept) {
+    long blocks = 0;
+    bool inBlock = false;
+    std::string label;
+
+    const char* line = pem;
+    while (*line) {
+        const char* newline = strchr(line, '\n');
+        size_t length = trim_line(line, newline ? (size_t)(newline - line) : strlen(line));
+
+        // Leading whitespace is tolerated on every line
+        while (length > 0 && (*line == ' ' || *line == '\t')) {
+            ++line;
+            --length;
+        }
+
+        const size_t beginLength = sizeof(kBegin) - 1;
+        const size_t endLength = sizeof(kEnd) - 1;
+        const size_t dashesLength = sizeof(kDashes) - 1;
+
+        if (!inBlock) {
+            // Text outside blocks (e.g. "Bag Attributes" from openssl) is dropped
+            if (length > beginLength + dashesLength && memcmp(line, kBegin, beginLength) == 0 &&
+                memcmp(line + length - dashesLength, kDashes, dashesLength) == 0) {
+                label.assign(line + beginLength, length - beginLength - dashesLength);
+                if (!accept(label)) {
+                    return -1;
+                }
+                inBlock = true;
+                out.append(line, length);
+                out.push_back('\n');
+            }
+        } else if (length >= endLength && memcmp(line, kEnd, endLength) == 0) {
+            if (length != endLength + label.size() + dashesLength ||
+                memcmp(line + endLength, label.data(), label.size()) != 0) {
+                return -1; // END doesn't match its BEGIN
+            }
+            inBlock = false;
+            ++blocks;
+            out.append(line, length);
+            out.push_back('\n');
+        } else {
+            // Blank lines stay: legacy encrypted keys separate Proc-Type headers with one
+            out.append(line, length);
+            out.push_back('\n');
+        }
+
+        if (!newline) {
+            break;
+        }
+        line = newline + 1;
+    }
+
+    return inBlock ? -1 : blocks;
+}
+
+// Helper: Overwrite a secret in place. Volatile stores can't be dropped as dead
+// writes the way a memset right before a free can.
+static void scrub(std::string& secret) {
+    volatile char* bytes = &secret[0];
+    for (size_t i = 0; i < secret.size(); ++i) {
+        bytes[i] = 0;
+    }
+}
+
+CotCertificate::~CotCertificate() {
+    scrub(key_pem);
+}
+
+static bool is_certificate_label(const std::string& label) {
+    return label == "CERTIFICATE" || label == "TRUSTED CERTIFICATE";
+}
+
+// PKCS#8 ("PRIVATE KEY", "ENCRYPTED PRIVATE KEY") and legacy "RSA/EC PRIVATE KEY"
+static bool is_key_label(const std::string& label) {
+    static const char kSuffix[] = "PRIVATE KEY";
+    const size_t suffixLength = sizeof(kSuffix) - 1;
+    return label.size() >= suffixLength &&
+           label.compare(label.size() - suffixLength, suffixLength, kSuffix) == 0;
+}
+
+uint64_t CotCertificateStore::import(const char* cert_pem, const char* key_pem, const char* ca_pem,
+                                     Error* error) {
+    auto certificate = std::make_shared<CotCertificate>();
+    *error = Error::None;
+
+    long chain = cert_pem ? parse_pem_blocks(cert_pem, certificate->cert_pem, is_certificate_label) : -1;
+    if (chain <= 0) {
+        *error = Error::InvalidCertificate;
+        return 0;
+    }
+    certificate->chain_length = (size_t)chain;
+
+    // Room for the normalized key up front (at most one extra LF), so appending
+    // never reallocates and leaves key fragments in freed memory
+    if (key_pem) {
+        certificate->key_pem.reserve(strlen(key_pem) + 1);
+    }
+    long keys = key_pem ? parse_pem_blocks(key_pem, certificate->key_pem, is_key_label) : -1;
+    if (keys != 1) {
+        *error = Error::InvalidKey;
+        return 0;
+    }
+
+    if (ca_pem) {
+        long cas = parse_pem_blocks(ca_pem, certificate->ca_pem, is_certificate_label);
+        if (cas <= 0) {
+            *error = Error::InvalidCa;
+            return 0;
+        }
+        certificate->has_ca = true;
+        certificate->ca_count = (size_t)cas;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t handle = next_handle_++;
+    certificates_.emplace(handle, std::move(certificate));
+    return handle;
+}
+
+std::shared_ptr<const CotCertificate> CotCertificateStore::find(uint64_t handle) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = certificates_.find(handle);
+    return it != certificates_.end() ? it->second : nullptr;
+}
+
+bool CotCertificateStore::release(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return certificates_.erase(handle) > 0;
+}
+
+void CotCertificateStore::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    certificates_.clear();
+}
+
+size_t CotCertificateStore::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return certificates_.size();
+}
+
+const char* CotCertificateStore::error_message(Error error) {
+    switch (error) {
+        case Error::None:
+            return "ok";
+        case Error::InvalidCertificate:
+            return "certificate must contain one or more CERTIFICATE blocks";
+        case Error::InvalidKey:
+            return "key must contain exactly one PRIVATE KEY block";
+        case Error::InvalidCa:
+            return "CA must contain one or more CERTIFICATE blocks";
+    }
+    return "unknown error";
+}
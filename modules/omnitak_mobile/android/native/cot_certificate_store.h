@@ -0,0 +1,72 @@
+/**
+ * cot_certificate_store.h - Native cache of imported client certificates
+ *
+ * Client certificates are imported once and referred to by an opaque handle
+ * afterwards. On import, each PEM input is split into its blocks, each block
+ * label is checked (CERTIFICATE for the client chain and CA, any *PRIVATE KEY
+ * for the key) and the blocks are re-serialized with LF line endings and no
+ * surrounding text. Connects look a bundle up by handle and hand its C
+ * strings straight to Rust, so neither connects nor reconnect storms copy
+ * PEM across JNI again.
+ *
+ * Bundles are immutable and shared: a connect in progress, and a link that
+ * reconnects with the bundle, keeps it alive even if the handle is released
+ * meanwhile. The private key is wiped when the last reference drops.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct CotCertificate {
+    std::string cert_pem;  // Client certificate chain
+    std::string key_pem;   // Private key
+    std::string ca_pem;    // Trusted CA certificates; empty when has_ca is false
+    bool has_ca = false;
+    size_t chain_length = 0; // Certificates in cert_pem
+    size_t ca_count = 0;     // Certificates in ca_pem
+
+    CotCertificate() = default;
+    CotCertificate(const CotCertificate&) = delete;
+    CotCertificate& operator=(const CotCertificate&) = delete;
+    ~CotCertificate(); // Zeroes key_pem before its buffer is freed
+};
+
+class CotCertificateStore {
+public:
+    enum class Error {
+        None,
+        InvalidCertificate, // No CERTIFICATE block, or a block of another kind
+        InvalidKey,         // Not exactly one PRIVATE KEY block
+        InvalidCa,          // Present but without CERTIFICATE blocks
+    };
+
+    CotCertificateStore() = default;
+    CotCertificateStore(const CotCertificateStore&) = delete;
+    CotCertificateStore& operator=(const CotCertificateStore&) = delete;
+
+    // Validate and cache a bundle. Returns its handle (> 0), or 0 with `error` set.
+    // `ca_pem` may be null.
+    uint64_t import(const char* cert_pem, const char* key_pem, const char* ca_pem, Error* error);
+
+    // nullptr for an unknown or released handle
+    std::shared_ptr<const CotCertificate> find(uint64_t handle) const;
+
+    // Returns false for an unknown handle
+    bool release(uint64_t handle);
+
+    void clear();
+    size_t size() const;
+
+    static const char* error_message(Error error);
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, std::shared_ptr<const CotCertificate>> certificates_;
+    uint64_t next_handle_ = 1;
+};
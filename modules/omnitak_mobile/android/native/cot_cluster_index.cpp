@@ -0,0 +1,195 @@
+/**
+ * cot_cluster_index.cpp - Incremental per-zoom clustering of track positions
+ */
+
+#include "cot_cluster_index.h"
+
+#include <cmath>
+
+const int CotClusterIndex::kMaxZoom;
+
+// Cells per axis at a zoom level: 2^zoom tiles, four cells per tile
+static uint32_t grid_size(int zoom) {
+    return 1u << (zoom + 2);
+}
+
+static uint32_t clamp_cell(double value, uint32_t size) {
+    if (!(value > 0)) {
+        return 0;
+    }
+    return value >= size ? size - 1 : (uint32_t)value;
+}
+
+static uint32_t column_for(int zoom, double lon) {
+    uint32_t size = grid_size(zoom);
+    return clamp_cell(std::floor((lon + 180.0) / 360.0 * size), size);
+}
+
+// Web Mercator row, 0 at the north edge
+static uint32_t row_for(int zoom, double lat) {
+    const double kMaxLatitude = 85.0511287798;
+    double clamped = lat < -kMaxLatitude ? -kMaxLatitude : (lat > kMaxLatitude ? kMaxLatitude : lat);
+    double radians = clamped * M_PI / 180.0;
+    double y = (1.0 - std::log(std::tan(radians) + 1.0 / std::cos(radians)) / M_PI) / 2.0;
+
+    uint32_t size = grid_size(zoom);
+    return clamp_cell(std::floor(y * size), size);
+}
+
+static uint64_t cell_key(uint32_t x, uint32_t y) {
+    return ((uint64_t)y << 32) | x;
+}
+
+void CotClusterIndex::add(uint64_t key, double lat, double lon) {
+    for (int zoom = 0; zoom <= kMaxZoom; ++zoom) {
+        Cell& cell = levels_[zoom][cell_key(column_for(zoom, lon), row_for(zoom, lat))];
+        ++cell.count;
+        cell.lat_sum += lat;
+        cell.lon_sum += lon;
+        cell.key_sum += key;
+    }
+}
+
+void CotClusterIndex::remove(uint64_t key, double lat, double lon) {
+    for (int zoom = 0; zoom <= kMaxZoom; ++zoom) {
+        auto it = levels_[zoom].find(cell_key(column_for(zoom, lon), row_for(zoom, lat)));
+        if (it == levels_[zoom].end()) {
+            continue;
+        }
+
+        Cell& cell = it->second;
+        if (--cell.count == 0) {
+            levels_[zoom].erase(it);
+            continue;
+        }
+        cell.lat_sum -= lat;
+        cell.lon_sum -= lon;
+        cell.key_sum -= key;
+    }
+}
+
+void CotClusterIndex::move(uint64_t key, double old_lat, double old_lon, double lat, double lon) {
+    for (int zoom = 0; zoom <= kMaxZoom; ++zoom) {
+        uint64_t from = cell_key(column_for(zoom, old_lon), row_for(zoom, old_lat));
+        uint64_t to = cell_key(column_for(zoom, lon), row_for(zoom, lat));
+
+        // Most updates stay in the same cell at all but the finest levels
+        Level& level = levels_[zoom];
+        if (from == to) {
+            auto it = level.find(to);
+            if (it != level.end()) {
+                it->second.lat_sum += lat - old_lat;
+                it->second.lon_sum += lon - old_lon;
+            }
+            continue;
+        }
+
+        auto it = level.find(from);
+        if (it != level.end()) {
+            Cell& cell = it->second;
+            if (--cell.count == 0) {
+                level.erase(it);
+            } else {
+                cell.lat_sum -= old_lat;
+                cell.lon_sum -= old_lon;
+                cell.key_sum -= key;
+            }
+        }
+
+        Cell& cell = level[to];
+        ++cell.count;
+        cell.lat_sum += lat;
+        cell.lon_sum += lon;
+        cell.key_sum += key;
+    }
+}
+
+void CotClusterIndex::clear() {
+    for (Level& level : levels_) {
+        level.clear();
+    }
+}
+
+size_t CotClusterIndex::query(int zoom, double min_lat, double min_lon, double max_lat, double max_lon,
+                              size_t limit, std::vector<Cluster>& out) const {
+    zoom = zoom < 0 ? 0 : (zoom > kMaxZoom ? kMaxZoom : zoom);
+
+    uint32_t minY = row_for(zoom, max_lat);
+    uint32_t maxY = row_for(zoom, min_lat);
+    uint32_t minX = column_for(zoom, min_lon);
+    uint32_t maxX = column_for(zoom, max_lon);
+
+    if (min_lon > max_lon) {
+        size_t matched = query_range(zoom, minX, grid_size(zoom) - 1, minY, maxY, limit, 0, out);
+        return query_range(zoom, 0, maxX, minY, maxY, limit, matched, out);
+    }
+    return query_range(zoom, minX, maxX, minY, maxY, limit, 0, out);
+}
+
+size_t CotClusterIndex::query_range(int zoom, uint32_t min_x, uint32_t max_x, uint32_t min_y, uint32_t max_y,
+                                    size_t limit, size_t matched, std::vector<Cluster>& out) const {
+    const Level& level = levels_[zoom];
+
+    auto emit = [&](const Cell& cell) {
+        if (matched++ < limit) {
+            out.push_back({cell.lat_sum / cell.count, cell.lon_sum / cell.count, cell.count, cell.key_sum});
+        }
+    };
+
+    // Low zooms have few occupied cells; scanning them beats probing the box
+    double cellCount = (double)(max_x - min_x + 1) * (double)(max_y - min_y + 1);
+    if (cellCount > (double)level.size()) {
+        for (const auto& pair : level) {
+            uint32_t x = (uint32_t)pair.first;
+            uint32_t y = (uint32_t)(pair.first >> 32);
+            if (x >= min_x && x <= max_x && y >= min_y && y <= max_y) {
+                emit(pair.second);
+            }
+        }
+        return matched;
+    }
+
+    for (uint32_t y = min_y; y <= max_y; ++y) {
+        for (uint32_t x = min_x; x <= max_x; ++x) {
+            auto it = level.find(cell_key(x, y));
+            if (it != level.end()) {
+                emit(it->second);
+            }
+        }
+    }
+    return matched;
+}
+
+int CotClusterIndex::expansion_zoom(int zoom, double lat, double lon) const {
+    zoom = zoom < 0 ? 0 : (zoom > kMaxZoom ? kMaxZoom : zoom);
+    uint32_t x = column_for(zoom, lon);
+    uint32_t y = row_for(zoom, lat);
+
+    for (int child = zoom + 1; child <= kMaxZoom; ++child) {
+        const Level& level = levels_[child];
+        int shift = child - zoom;
+        int occupied = 0;
+
+        // Same trade-off as query_range: probe the 4^shift children or scan the level
+        uint64_t childCount = 1ull << (2 * shift);
+        if (childCount > level.size()) {
+            for (const auto& pair : level) {
+                if (((uint32_t)pair.first >> shift) == x && ((uint32_t)(pair.first >> 32) >> shift) == y &&
+                    ++occupied > 1) {
+                    return child;
+                }
+            }
+            continue;
+        }
+
+        uint32_t side = 1u << shift;
+        for (uint32_t dy = 0; dy < side; ++dy) {
+            for (uint32_t dx = 0; dx < side; ++dx) {
+                if (level.count(cell_key((x << shift) + dx, (y << shift) + dy)) && ++occupied > 1) {
+                    return child;
+                }
+            }
+        }
+    }
+    return kMaxZoom + 1;
+}
@@ -0,0 +1,63 @@
+/**
+ * cot_cluster_index.h - Incremental per-zoom clustering of track positions
+ *
+ * Every zoom level from 0 to kMaxZoom keeps a grid of Web Mercator cells a
+ * quarter tile wide (about 64 screen pixels at that zoom). Each cell holds
+ * only a count and coordinate sums, so adding, moving or removing a track
+ * touches one cell per level: O(kMaxZoom) per update, never a rebuild.
+ * Clusters for a zoom are read straight off that level's cells.
+ *
+ * A cell also keeps the sum of its track keys: when it holds exactly one
+ * track, that sum is the track's key.
+ *
+ * Not thread-safe; CotTrackStore owns one and guards it with its mutex.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class CotClusterIndex {
+public:
+    static const int kMaxZoom = 16;
+
+    struct Cluster {
+        double lat;     // Centroid of the cell's tracks
+        double lon;
+        uint32_t count;
+        uint64_t key;   // The track's key when count == 1
+    };
+
+    void add(uint64_t key, double lat, double lon);
+    void remove(uint64_t key, double lat, double lon);
+    void move(uint64_t key, double old_lat, double old_lon, double lat, double lon);
+    void clear();
+
+    // Append up to `limit` clusters of level `zoom` (clamped to 0..kMaxZoom) whose
+    // cell overlaps the box and return how many there are in total. A box with
+    // min_lon > max_lon wraps across the antimeridian.
+    size_t query(int zoom, double min_lat, double min_lon, double max_lat, double max_lon,
+                 size_t limit, std::vector<Cluster>& out) const;
+
+    // Lowest zoom above `zoom` at which the cluster containing (lat, lon) splits
+    // into more than one cluster, or kMaxZoom + 1 if it never does
+    int expansion_zoom(int zoom, double lat, double lon) const;
+
+private:
+    struct Cell {
+        uint32_t count = 0;
+        double lat_sum = 0;
+        double lon_sum = 0;
+        uint64_t key_sum = 0;
+    };
+
+    using Level = std::unordered_map<uint64_t, Cell>;
+
+    size_t query_range(int zoom, uint32_t min_x, uint32_t max_x, uint32_t min_y, uint32_t max_y,
+                       size_t limit, size_t matched, std::vector<Cluster>& out) const;
+
+    Level levels_[kMaxZoom + 1];
+};
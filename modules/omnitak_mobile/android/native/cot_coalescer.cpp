@@ -0,0 +1,144 @@
+/**
+ * cot_coalescer.cpp - Inbound de-duplication and coalescing by CoT uid
+ */
+
+#include "cot_coalescer.h"
+
+#include <cstring>
+
+constexpr std::chrono::seconds CotCoalescer::kIdleTimeout;
+constexpr std::chrono::seconds CotCoalescer::kSweepInterval;
+
+// 64-bit FNV-1a; good enough to key tracks and spot identical payloads
+static uint64_t fnv1a(const char* data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+CotCoalescer::Result CotCoalescer::offer(uint64_t connection_id, const char* uid, size_t uid_length,
+                                         const char* xml, size_t length, Clock::time_point now) {
+    uint32_t windowMs = window_ms();
+    if (windowMs == 0) {
+        return Result::Deliver;
+    }
+    const auto window = std::chrono::milliseconds(windowMs);
+
+    uint64_t key = fnv1a(uid, uid_length);
+    uint64_t hash = fnv1a(xml, length);
+    Shard& shard = shards_[key % kShards];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.tracks.find(key);
+    if (it == shard.tracks.end()) {
+        if (shard.tracks.size() >= kMaxTracksPerShard) {
+            sweep_idle(shard, now);
+            if (shard.tracks.size() >= kMaxTracksPerShard) {
+                return Result::Deliver; // Too many live uids to track; pass through
+            }
+        }
+
+        Track& track = shard.tracks[key];
+        track.uid.assign(uid, uid_length);
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        track.last_hash = hash;
+        track.last_delivered = now;
+        track.last_seen = now;
+        return Result::Deliver;
+    }
+
+    Track& track = it->second;
+    if (track.uid.size() != uid_length || memcmp(track.uid.data(), uid, uid_length) != 0) {
+        return Result::Deliver; // Hash collision with another uid
+    }
+    track.last_seen = now;
+
+    if (hash == track.last_hash || (track.pending && hash == track.pending_hash)) {
+        duplicates_.fetch_add(1, std::memory_order_relaxed);
+        return Result::Duplicate;
+    }
+
+    if (!track.pending && now - track.last_delivered >= window) {
+        track.last_hash = hash;
+        track.last_delivered = now;
+        return Result::Deliver;
+    }
+
+    bool replaced = track.pending;
+    if (replaced) {
+        coalesced_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        track.pending = true;
+        shard.pending_keys.push_back(key);
+    }
+    track.pending_connection = connection_id;
+    track.pending_hash = hash;
+    if (length > track.pending_xml.capacity()) {
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+    }
+    track.pending_xml.assign(xml, length);
+    return replaced ? Result::Replaced : Result::Held;
+}
+
+size_t CotCoalescer::take_due(Clock::time_point now, std::vector<Pending>& out) {
+    const auto window = std::chrono::milliseconds(window_ms());
+    size_t count = 0;
+
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        for (size_t i = 0; i < shard.pending_keys.size();) {
+            auto it = shard.tracks.find(shard.pending_keys[i]);
+            if (it != shard.tracks.end() && now - it->second.last_delivered < window) {
+                ++i;
+                continue;
+            }
+
+            if (it != shard.tracks.end()) {
+                Track& track = it->second;
+                if (count == out.size()) {
+                    out.emplace_back();
+                }
+                Pending& pending = out[count++];
+                pending.connection_id = track.pending_connection;
+                pending.xml.swap(track.pending_xml);
+                track.pending_xml.clear();
+                track.pending = false;
+                track.last_hash = track.pending_hash;
+                track.last_delivered = now;
+            }
+
+            shard.pending_keys[i] = shard.pending_keys.back();
+            shard.pending_keys.pop_back();
+        }
+
+        if (now - shard.last_sweep >= kSweepInterval) {
+            sweep_idle(shard, now);
+        }
+    }
+    return count;
+}
+
+void CotCoalescer::clear() {
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.tracks.clear();
+        shard.pending_keys.clear();
+    }
+}
+
+// Drop tracks that haven't been seen for kIdleTimeout. Called with the shard locked.
+void CotCoalescer::sweep_idle(Shard& shard, Clock::time_point now) {
+    shard.last_sweep = now;
+    for (auto it = shard.tracks.begin(); it != shard.tracks.end();) {
+        if (!it->second.pending && now - it->second.last_seen > kIdleTimeout) {
+            it = shard.tracks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,106 @@
+/**
+ * cot_coalescer.h - Inbound de-duplication and coalescing by CoT uid
+ *
+ * Servers rebroadcast PLI several times per second, and federated setups
+ * deliver the same event over several connections. The coalescer sits in
+ * front of the per-connection delivery path and, per event uid (across all
+ * connections):
+ *
+ * - drops exact duplicates of the last delivered or pending event,
+ * - delivers the first update immediately if none went out within the window,
+ * - otherwise holds only the latest update until the window has elapsed.
+ *
+ * So each uid produces at most one upcall per window. Held events are picked
+ * up by the bridge's flush thread via take_due().
+ *
+ * Tracks are keyed by a 64-bit hash of the uid; the uid itself is kept to
+ * detect collisions, in which case the event simply bypasses coalescing.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CotCoalescer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Result {
+        Deliver,   // Hand the event on now
+        Held,      // Stored as the latest update for its uid
+        Replaced,  // Stored, replacing the update already held for its uid
+        Duplicate, // Identical to the last delivered or pending event
+    };
+
+    struct Pending {
+        uint64_t connection_id;
+        std::string xml;
+    };
+
+    CotCoalescer() = default;
+    CotCoalescer(const CotCoalescer&) = delete;
+    CotCoalescer& operator=(const CotCoalescer&) = delete;
+
+    // 0 disables coalescing; held events are still released by the next take_due()
+    void set_window(uint32_t window_ms) { window_ms_.store(window_ms, std::memory_order_relaxed); }
+    uint32_t window_ms() const { return window_ms_.load(std::memory_order_relaxed); }
+    bool enabled() const { return window_ms() > 0; }
+
+    // Offer an inbound event. `uid` is the raw uid attribute (see cot_parse_key).
+    Result offer(uint64_t connection_id, const char* uid, size_t uid_length,
+                 const char* xml, size_t length, Clock::time_point now);
+
+    // Hand every held event whose window has elapsed to the caller in out[0, count) and
+    // return the count. `out` is reused across calls and never shrunk: each held buffer
+    // is swapped with the one a returned entry used last time, so a steady stream of
+    // coalesced updates doesn't allocate.
+    size_t take_due(Clock::time_point now, std::vector<Pending>& out);
+
+    // Forget all tracks and held events
+    void clear();
+
+    uint64_t duplicates() const { return duplicates_.load(std::memory_order_relaxed); }
+    uint64_t coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+
+    // Held payloads that outgrew their track's buffer, plus tracks created for new uids
+    uint64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+
+private:
+    static const size_t kShards = 8;
+    static const size_t kMaxTracksPerShard = 2048;
+    static constexpr std::chrono::seconds kIdleTimeout{30};
+    static constexpr std::chrono::seconds kSweepInterval{5};
+
+    struct Track {
+        std::string uid;
+        uint64_t last_hash = 0;     // Hash of the last delivered event
+        Clock::time_point last_delivered;
+        Clock::time_point last_seen;
+        bool pending = false;
+        uint64_t pending_connection = 0;
+        uint64_t pending_hash = 0;
+        std::string pending_xml;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, Track> tracks;
+        std::vector<uint64_t> pending_keys;
+        Clock::time_point last_sweep;
+    };
+
+    static void sweep_idle(Shard& shard, Clock::time_point now);
+
+    Shard shards_[kShards];
+    std::atomic<uint32_t> window_ms_{0};
+    std::atomic<uint64_t> duplicates_{0};
+    std::atomic<uint64_t> coalesced_{0};
+    std::atomic<uint64_t> allocations_{0};
+};
@@ -0,0 +1,181 @@
+/**
+ * cot_connection_stats.h - Per-connection throughput and latency counters
+ *
+ * Updated from Rust I/O threads, the flush thread and JNI send calls, and read
+ * by nativeGetStatus. Every counter is a relaxed atomic, so recording never
+ * takes a lock or a syscall beyond reading the clock.
+ *
+ * Upcall durations go into a log-linear histogram: four buckets per power of
+ * two microseconds, so percentiles are accurate to within ~19%.
+ *
+ * The round-trip estimate follows the TAK ping convention: when a t-x-c-t
+ * ping is sent, the send time is remembered, and the next t-x-c-t-r reply
+ * yields a sample. Samples are smoothed like TCP's SRTT (1/8 gain).
+ *
+ * Native allocations count the slabs and record arrays this connection's
+ * deliveries had to take from the heap instead of the slab pool; once the
+ * pool is warm they stop growing.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+class CotConnectionStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Snapshot {
+        uint64_t bytes_sent;
+        uint64_t bytes_received;
+        uint64_t send_failures;
+        int64_t rtt_us;        // Smoothed round trip, 0 until the first ping reply
+        uint64_t upcalls;
+        int64_t upcall_p50_us;
+        int64_t upcall_p99_us;
+        int64_t upcall_max_us;
+        uint64_t coalesced;    // Superseded by a later update while held by the coalescer
+        uint64_t duplicates;   // Dropped by the coalescer as exact repeats
+        uint64_t dropped;      // Dropped because no slab was free
+        uint64_t native_allocations;
+        uint64_t native_allocated_bytes;
+    };
+
+    CotConnectionStats() = default;
+    CotConnectionStats(const CotConnectionStats&) = delete;
+    CotConnectionStats& operator=(const CotConnectionStats&) = delete;
+
+    void record_sent(size_t bytes) { bytes_sent_.fetch_add(bytes, std::memory_order_relaxed); }
+    void record_send_failure() { send_failures_.fetch_add(1, std::memory_order_relaxed); }
+    void record_received(size_t bytes) { bytes_received_.fetch_add(bytes, std::memory_order_relaxed); }
+    void record_coalesced() { coalesced_.fetch_add(1, std::memory_order_relaxed); }
+    void record_duplicate() { duplicates_.fetch_add(1, std::memory_order_relaxed); }
+    void record_dropped() { dropped_.fetch_add(1, std::memory_order_relaxed); }
+    void record_allocation(size_t bytes) {
+        native_allocations_.fetch_add(1, std::memory_order_relaxed);
+        native_allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void record_upcall(Clock::duration elapsed) {
+        int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        upcall_buckets_[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+
+        int64_t max = upcall_max_us_.load(std::memory_order_relaxed);
+        while (us > max && !upcall_max_us_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+        }
+    }
+
+    void record_ping_sent(Clock::time_point now) {
+        ping_sent_ns_.store(to_ns(now), std::memory_order_relaxed);
+    }
+
+    // The ping never went out (e.g. the connection is reconnecting)
+    void cancel_ping() { ping_sent_ns_.store(0, std::memory_order_relaxed); }
+
+    bool ping_outstanding() const { return ping_sent_ns_.load(std::memory_order_relaxed) != 0; }
+
+    void record_ping_reply(Clock::time_point now) {
+        int64_t sent = ping_sent_ns_.exchange(0, std::memory_order_relaxed);
+        if (sent == 0) {
+            return;
+        }
+
+        int64_t sample = (to_ns(now) - sent) / 1000;
+        int64_t rtt = rtt_us_.load(std::memory_order_relaxed);
+        int64_t smoothed;
+        do {
+            smoothed = rtt == 0 ? sample : rtt + (sample - rtt) / 8;
+        } while (!rtt_us_.compare_exchange_weak(rtt, smoothed, std::memory_order_relaxed));
+    }
+
+    Snapshot snapshot() const {
+        Snapshot out;
+        out.bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+        out.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+        out.send_failures = send_failures_.load(std::memory_order_relaxed);
+        out.rtt_us = rtt_us_.load(std::memory_order_relaxed);
+        out.coalesced = coalesced_.load(std::memory_order_relaxed);
+        out.duplicates = duplicates_.load(std::memory_order_relaxed);
+        out.dropped = dropped_.load(std::memory_order_relaxed);
+        out.native_allocations = native_allocations_.load(std::memory_order_relaxed);
+        out.native_allocated_bytes = native_allocated_bytes_.load(std::memory_order_relaxed);
+        out.upcall_max_us = upcall_max_us_.load(std::memory_order_relaxed);
+
+        uint64_t counts[kBuckets];
+        uint64_t total = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            counts[i] = upcall_buckets_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        out.upcalls = total;
+        out.upcall_p50_us = percentile(counts, total, 50);
+        out.upcall_p99_us = percentile(counts, total, 99);
+        return out;
+    }
+
+private:
+    static const int kSubBucketBits = 2;
+    static const size_t kSubBuckets = 1 << kSubBucketBits;
+    static const size_t kOctaves = 32; // Up to 2^32 us, over an hour
+    static const size_t kBuckets = kOctaves * kSubBuckets;
+
+    static int64_t to_ns(Clock::time_point time) {
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        return ns != 0 ? ns : 1; // 0 means "no ping outstanding"
+    }
+
+    // Values below kSubBuckets us map 1:1; above, each octave gets kSubBuckets buckets
+    static size_t bucket_index(int64_t us) {
+        if (us < (int64_t)kSubBuckets) {
+            return us < 0 ? 0 : (size_t)us;
+        }
+        int msb = 63 - __builtin_clzll((uint64_t)us);
+        size_t sub = (size_t)(us >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+        size_t index = (size_t)(msb - kSubBucketBits + 1) * kSubBuckets + sub;
+        return index < kBuckets ? index : kBuckets - 1;
+    }
+
+    // Smallest value that falls in `index`
+    static int64_t bucket_floor(size_t index) {
+        if (index < kSubBuckets) {
+            return (int64_t)index;
+        }
+        int msb = (int)(index / kSubBuckets) + kSubBucketBits - 1;
+        size_t sub = index & (kSubBuckets - 1);
+        return (int64_t)((kSubBuckets + sub) << (msb - kSubBucketBits));
+    }
+
+    // Midpoint of the bucket holding the given percentile
+    static int64_t percentile(const uint64_t* counts, uint64_t total, int pct) {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = (total * pct + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                int64_t low = bucket_floor(i);
+                int64_t high = i + 1 < kBuckets ? bucket_floor(i + 1) : low;
+                return low + (high - low) / 2;
+            }
+        }
+        return bucket_floor(kBuckets - 1);
+    }
+
+    std::atomic<uint64_t> bytes_sent_{0};
+    std::atomic<uint64_t> bytes_received_{0};
+    std::atomic<uint64_t> send_failures_{0};
+    std::atomic<uint64_t> coalesced_{0};
+    std::atomic<uint64_t> duplicates_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> native_allocations_{0};
+    std::atomic<uint64_t> native_allocated_bytes_{0};
+    std::atomic<int64_t> ping_sent_ns_{0};
+    std::atomic<int64_t> rtt_us_{0};
+    std::atomic<int64_t> upcall_max_us_{0};
+    std::atomic<uint64_t> upcall_buckets_[kBuckets] = {};
+};
@@ -0,0 +1,148 @@
+/**
+ * cot_fan_in.cpp - One deduplicated inbound stream across all connections
+ */
+
+#include "cot_fan_in.h"
+
+#include <cstring>
+
+constexpr std::chrono::seconds CotFanIn::kSweepInterval;
+
+// 64-bit FNV-1a; keys uids and fingerprints events without a time
+static uint64_t fnv1a(const char* data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+CotFanIn::Result CotFanIn::admit(const char* uid, size_t uid_length, int64_t time_ms,
+                                 const char* xml, size_t length, Clock::time_point now) {
+    if (!uid) {
+        return Result::Accepted;
+    }
+    const auto window = std::chrono::milliseconds(window_ms_.load(std::memory_order_relaxed));
+
+    uint64_t key = fnv1a(uid, uid_length);
+    uint64_t hash = time_ms > 0 ? 0 : fnv1a(xml, length);
+    Shard& shard = shards_[key % kShards];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.uids.find(key);
+    if (it == shard.uids.end()) {
+        if (shard.uids.size() >= kMaxUidsPerShard) {
+            sweep_idle(shard, now);
+            if (shard.uids.size() >= kMaxUidsPerShard) {
+                return Result::Accepted; // Too many live uids to remember; pass through
+            }
+        }
+
+        Seen& seen = shard.uids[key];
+        seen.uid.assign(uid, uid_length);
+        seen.time_ms = time_ms;
+        seen.hash = hash;
+        seen.first_seen = now;
+        seen.last_seen = now;
+        return Result::Accepted;
+    }
+
+    Seen& seen = it->second;
+    if (seen.uid.size() != uid_length || memcmp(seen.uid.data(), uid, uid_length) != 0) {
+        return Result::Accepted; // Hash collision with another uid
+    }
+    seen.last_seen = now;
+
+    // Once the window has passed the uid starts over, so a re-sent event shows up again
+    if (now - seen.first_seen < window) {
+        if (time_ms > 0 && seen.time_ms > 0) {
+            if (time_ms < seen.time_ms) {
+                return Result::Older;
+            }
+            if (time_ms == seen.time_ms) {
+                return Result::Duplicate;
+            }
+        } else if (time_ms == 0 && seen.time_ms == 0 && hash == seen.hash) {
+            return Result::Duplicate;
+        }
+    }
+
+    seen.time_ms = time_ms;
+    seen.hash = hash;
+    seen.first_seen = now;
+    return Result::Accepted;
+}
+
+bool CotFanIn::push(uint64_t source, const char* xml, size_t length, uint64_t* dropped_source) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+
+    bool full = count_ == queue_.size();
+    if (full) {
+        // Overwrite the oldest event
+        *dropped_source = queue_[head_].source;
+        head_ = (head_ + 1) % queue_.size();
+        --count_;
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Event& event = queue_[(head_ + count_) % queue_.size()];
+    event.source = source;
+    event.xml.assign(xml, length);
+    ++count_;
+    return !full;
+}
+
+size_t CotFanIn::take(Clock::time_point now, std::vector<Event>& out) {
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (out.size() < count_) {
+            out.resize(count_);
+        }
+        for (; count < count_; ++count) {
+            Event& event = queue_[(head_ + count) % queue_.size()];
+            out[count].source = event.source;
+            out[count].xml.swap(event.xml);
+            event.xml.clear();
+        }
+        head_ = 0;
+        count_ = 0;
+    }
+
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (now - shard.last_sweep >= kSweepInterval) {
+            sweep_idle(shard, now);
+        }
+    }
+    return count;
+}
+
+void CotFanIn::clear() {
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.uids.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    for (Event& event : queue_) {
+        event.xml.clear();
+    }
+    head_ = 0;
+    count_ = 0;
+}
+
+// Forget uids not seen for a whole window. Called with the shard locked.
+void CotFanIn::sweep_idle(Shard& shard, Clock::time_point now) {
+    const auto window = std::chrono::milliseconds(window_ms_.load(std::memory_order_relaxed));
+    shard.last_sweep = now;
+    for (auto it = shard.uids.begin(); it != shard.uids.end();) {
+        if (now - it->second.last_seen > window) {
+            it = shard.uids.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
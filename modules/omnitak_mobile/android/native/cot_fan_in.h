@@ -0,0 +1,105 @@
+/**
+ * cot_fan_in.h - One deduplicated inbound stream across all connections
+ *
+ * A TAK server, SA multicast and a mesh gateway commonly carry the same
+ * events, so each arrives two or three times over different connections.
+ * With fan-in enabled, every connection's events pass through one
+ * CotFanIn, which per event uid (across all connections):
+ *
+ * - drops an event whose CoT time was already seen within the window,
+ * - drops an event older than the newest one seen, so a slow path (e.g.
+ *   the mesh) can't move a track back,
+ * - passes everything else on.
+ *
+ * Identity is the uid and CoT time rather than the bytes, since gateways
+ * re-encode events on the way through. Events without a time fall back to
+ * comparing a hash of their content; events without a uid always pass.
+ *
+ * Accepted events wait in a bounded queue, in arrival order and tagged with
+ * the connection they came from, until the bridge's flush thread takes them.
+ * When the queue is full the oldest event is dropped.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CotFanIn {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Result {
+        Accepted,  // First sighting; queue or deliver it
+        Duplicate, // Same uid and time (or content) as an event already seen
+        Older,     // Older than the newest event seen for its uid
+    };
+
+    struct Event {
+        uint64_t source; // Connection the event arrived on first
+        std::string xml;
+    };
+
+    explicit CotFanIn(size_t queue_capacity) : queue_(queue_capacity) {}
+    CotFanIn(const CotFanIn&) = delete;
+    CotFanIn& operator=(const CotFanIn&) = delete;
+
+    // How long an event's identity is remembered after it was first seen
+    void set_window(uint32_t window_ms) { window_ms_.store(window_ms, std::memory_order_relaxed); }
+
+    // Decide whether an event is new. `uid` is the raw uid attribute (see cot_parse_key),
+    // `time_ms` its CoT time or 0.
+    Result admit(const char* uid, size_t uid_length, int64_t time_ms,
+                 const char* xml, size_t length, Clock::time_point now);
+
+    // Queue an accepted event. If the queue was full its oldest event is dropped: the
+    // call returns false and sets `dropped_source` to that event's connection.
+    bool push(uint64_t source, const char* xml, size_t length, uint64_t* dropped_source);
+
+    // Hand every queued event to the caller in out[0, count), oldest first, and return
+    // the count. Buffers are swapped as in CotCoalescer::take_due, so a steady stream
+    // doesn't allocate. Also forgets uids not seen for the window.
+    size_t take(Clock::time_point now, std::vector<Event>& out);
+
+    // Forget all uids and queued events
+    void clear();
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static const size_t kShards = 8;
+    static const size_t kMaxUidsPerShard = 2048;
+    static constexpr std::chrono::seconds kSweepInterval{5};
+
+    struct Seen {
+        std::string uid;
+        int64_t time_ms = 0;  // Newest CoT time seen
+        uint64_t hash = 0;    // Content hash of that event, for events without a time
+        Clock::time_point first_seen;
+        Clock::time_point last_seen;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, Seen> uids;
+        Clock::time_point last_sweep;
+    };
+
+    void sweep_idle(Shard& shard, Clock::time_point now);
+
+    Shard shards_[kShards];
+    std::atomic<uint32_t> window_ms_{30000};
+    std::atomic<uint64_t> dropped_{0};
+
+    // Ring buffer of queued events; entries keep their buffers between uses
+    std::mutex queue_mutex_;
+    std::vector<Event> queue_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+};
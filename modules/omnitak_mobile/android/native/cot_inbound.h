@@ -0,0 +1,64 @@
+/**
+ * cot_inbound.h - Stage order of one inbound CoT message
+ *
+ * cot_callback_bridge and the native throughput benchmark run every inbound
+ * message through the same stages, in this order:
+ *
+ *   count -> key parse -> fan-in dedup -> track store -> fan-in queue
+ *         -> priority lane -> coalescing -> delivery
+ *
+ * cot_process_inbound fixes the order and which stages a message reaches.
+ * The stages themselves belong to the caller, so the benchmark can leave out
+ * the ones it doesn't measure and stop where the bridge makes its JNI upcall,
+ * while still following any change to the bridge's sequence.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "cot_parser.h"
+#include "cot_trace.h"
+
+// `Stages` provides, in call order:
+//
+//   void received(size_t length)
+//   bool parse_key(const char* xml, size_t length, CotEventKey* key) - false when unkeyed
+//   bool admit(const CotEventKey& key, const char* xml, size_t length) - false drops a copy
+//   void track(const CotEventKey& key)
+//   bool fan_in(const CotEventKey* key, const char* xml, size_t length) - true when queued
+//   bool deliver_urgent(const CotEventKey& key, const char* xml) - true when delivered
+//   bool hold(const CotEventKey& key, const char* xml, size_t length) - true when coalesced
+//   void deliver(const char* xml, size_t length)
+//
+// `key` is null for fan_in when the message has no usable key. `cot_xml` must be
+// NUL-terminated.
+template <typename Stages>
+void cot_process_inbound(Stages& stages, const char* cot_xml, size_t length) {
+    stages.received(length);
+
+    // Events without a uid can't be tracked or coalesced and always go straight through
+    CotEventKey key;
+    bool keyed = stages.parse_key(cot_xml, length, &key);
+
+    // Everything from here on belongs to this event; tag it with its correlation id
+    COT_TRACE_SCOPE("cot_rx", keyed ? key.uid : "", keyed ? key.uid_length : 0);
+
+    // Copies of an event another connection already delivered, or older than it, stop here
+    if (keyed && !stages.admit(key, cot_xml, length)) {
+        return;
+    }
+    if (keyed) {
+        stages.track(key);
+    }
+
+    // Every connection's events merge here, ahead of the per-connection paths
+    if (stages.fan_in(keyed ? &key : nullptr, cot_xml, length)) {
+        return;
+    }
+
+    if (keyed && (stages.deliver_urgent(key, cot_xml) || stages.hold(key, cot_xml, length))) {
+        return;
+    }
+    stages.deliver(cot_xml, length);
+}
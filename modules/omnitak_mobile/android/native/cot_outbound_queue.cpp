@@ -0,0 +1,80 @@
+/**
+ * cot_outbound_queue.cpp - Bounded outbound queue for a connection that is down
+ */
+
+#include "cot_outbound_queue.h"
+
+#include <iterator>
+
+std::deque<CotOutboundQueue::Entry>::iterator CotOutboundQueue::find_uid(std::deque<Entry>& lane,
+                                                                         const std::string& uid) {
+    if (uid.empty()) {
+        return lane.end();
+    }
+    for (auto it = lane.begin(); it != lane.end(); ++it) {
+        if (it->uid == uid) {
+            return it;
+        }
+    }
+    return lane.end();
+}
+
+CotOutboundQueue::Result CotOutboundQueue::push(CotPriority priority, const char* uid, size_t uid_length,
+                                                const char* xml, size_t length) {
+    std::deque<Entry>& lane = lanes_[(size_t)priority];
+    bool pli = priority == CotPriority::Pli;
+
+    if (pli && uid_length > 0) {
+        // Lanes are short (lane_capacity_), so a scan is cheaper than keeping an index
+        std::string key(uid, uid_length);
+        auto it = find_uid(lane, key);
+        if (it != lane.end()) {
+            // The new report goes to the back, keeping the lane in send order
+            lane.erase(it);
+            lane.push_back(Entry{priority, std::move(key), std::string(xml, length)});
+            return Result::Replaced;
+        }
+    }
+
+    Result result = Result::Queued;
+    if (lane.size() >= lane_capacity_) {
+        if (!pli) {
+            return Result::Full;
+        }
+        lane.pop_front();
+        --size_;
+        ++dropped_;
+        result = Result::DroppedOldest;
+    }
+
+    lane.push_back(Entry{priority, pli ? std::string(uid, uid_length) : std::string(), std::string(xml, length)});
+    ++size_;
+    return result;
+}
+
+void CotOutboundQueue::drain(std::vector<Entry>& out) {
+    for (std::deque<Entry>& lane : lanes_) {
+        out.insert(out.end(), std::make_move_iterator(lane.begin()), std::make_move_iterator(lane.end()));
+        lane.clear();
+    }
+    size_ = 0;
+}
+
+void CotOutboundQueue::restore(std::vector<Entry>& entries, size_t from) {
+    // Walk backwards so each lane ends up in its original order
+    for (size_t i = entries.size(); i > from; --i) {
+        Entry& entry = entries[i - 1];
+        std::deque<Entry>& lane = lanes_[(size_t)entry.priority];
+
+        if (entry.priority == CotPriority::Pli && find_uid(lane, entry.uid) != lane.end()) {
+            continue; // A newer report for this uid was queued meanwhile
+        }
+        if (lane.size() >= lane_capacity_) {
+            // Restored entries are the oldest, so they are the ones that don't fit
+            ++dropped_;
+            continue;
+        }
+        lane.push_front(std::move(entry));
+        ++size_;
+    }
+}
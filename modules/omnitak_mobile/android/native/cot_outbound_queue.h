@@ -0,0 +1,71 @@
+/**
+ * cot_outbound_queue.h - Bounded outbound queue for a connection that is down
+ *
+ * While a reconnecting connection is down, sends are held here instead of
+ * failing, one lane per CotPriority, and handed back in priority order when
+ * it comes up again:
+ *
+ * - Lanes are bounded. A full PLI lane drops its oldest report; the other
+ *   lanes refuse new messages so the sender sees the failure.
+ * - A position report replaces any queued report with the same uid, so a
+ *   link that comes back after a minute sends each unit's latest position
+ *   once, not a minute of history.
+ * - A flush that fails halfway puts the unsent tail back at the front.
+ *
+ * Not thread-safe; guarded by the owning connection's mutex.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "cot_priority.h"
+
+class CotOutboundQueue {
+public:
+    enum class Result {
+        Queued,
+        Replaced,      // Superseded a queued report with the same uid
+        DroppedOldest, // Queued, the lane's oldest report was dropped to make room
+        Full,          // Lane full; not queued
+    };
+
+    struct Entry {
+        CotPriority priority;
+        std::string uid;
+        std::string xml;
+    };
+
+    explicit CotOutboundQueue(size_t lane_capacity) : lane_capacity_(lane_capacity > 0 ? lane_capacity : 1) {}
+
+    CotOutboundQueue(const CotOutboundQueue&) = delete;
+    CotOutboundQueue& operator=(const CotOutboundQueue&) = delete;
+
+    // `uid` is only used for PLI and may be empty
+    Result push(CotPriority priority, const char* uid, size_t uid_length, const char* xml, size_t length);
+
+    // Move every entry into `out` (appended), most urgent lane first, oldest first within a lane
+    void drain(std::vector<Entry>& out);
+
+    // Put back entries [from, end) of a drained batch that could not be sent, ahead of
+    // anything queued since. Reports superseded in the meantime are dropped.
+    void restore(std::vector<Entry>& entries, size_t from);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Reports dropped to make room since construction
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    std::deque<Entry>::iterator find_uid(std::deque<Entry>& lane, const std::string& uid);
+
+    size_t lane_capacity_;
+    std::deque<Entry> lanes_[kCotPriorityCount];
+    size_t size_ = 0;
+    uint64_t dropped_ = 0;
+};
@@ -0,0 +1,481 @@
+/**
+ * cot_parser.cpp - Native pre-parse of CoT events into fixed-layout records
+ *
+ * This is deliberately not a general XML parser: it locates the <event>,
+ * <point> and <contact> start tags and reads their attributes, which covers
+ * everything CotEventRecord carries. Anything else in <detail> is left to
+ * consumers of the raw XML. Byte searches go through cot_scanner so they
+ * run 16 bytes at a time where SIMD is available.
+ */
+
+#include "cot_parser.h"
+#include "cot_scanner.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// MARK: - Scanning helpers
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_name_end(char c) {
+    return is_space(c) || c == '>' || c == '/';
+}
+
+// Find the start of `<name` (followed by whitespace, '/' or '>') in [p, end)
+static const char* find_start_tag(const CotScanner& scanner, const char* p, const char* end, const char* name) {
+    size_t nameLength = strlen(name);
+
+    while (p < end) {
+        // Match '<' together with the first letter of the name so the many other
+        // tags in <detail> are mostly skipped in bulk
+        const char* lt = scanner.find_pair(p, end, '<', name[0]);
+        if (!lt) {
+            return nullptr;
+        }
+
+        const char* tagName = lt + 1;
+        if ((size_t)(end - tagName) > nameLength &&
+            memcmp(tagName, name, nameLength) == 0 &&
+            is_name_end(tagName[nameLength])) {
+            return lt;
+        }
+        p = lt + 1;
+    }
+    return nullptr;
+}
+
+// Find the '>' closing a start tag, skipping over quoted attribute values
+static const char* find_tag_end(const CotScanner& scanner, const char* p, const char* end) {
+    while (p < end) {
+        const char* hit = scanner.find_any3(p, end, '>', '"', '\'');
+        if (!hit || *hit == '>') {
+            return hit;
+        }
+        const char* close = (const char*)memchr(hit + 1, *hit, end - hit - 1);
+        if (!close) {
+            return nullptr;
+        }
+        p = close + 1;
+    }
+    return nullptr;
+}
+
+// Call `visit(name, nameLength, value, valueLength)` for each attribute in [p, end)
+template <typename Visitor>
+static void for_each_attribute(const CotScanner& scanner, const char* p, const char* end, Visitor visit) {
+    while (p < end) {
+        while (p < end && (is_space(*p) || *p == '/')) {
+            ++p;
+        }
+        if (p >= end) {
+            return;
+        }
+
+        // The '=' ends the name; a quote before it means the tag is malformed
+        const char* name = p;
+        const char* equals = scanner.find_any3(p, end, '=', '"', '\'');
+        if (!equals || *equals != '=') {
+            return;
+        }
+        const char* nameEnd = equals;
+        while (nameEnd > name && is_space(nameEnd[-1])) {
+            --nameEnd;
+        }
+        size_t nameLength = nameEnd - name;
+
+        p = equals + 1;
+        while (p < end && is_space(*p)) {
+            ++p;
+        }
+        if (p >= end || (*p != '"' && *p != '\'')) {
+            return;
+        }
+
+        char quote = *p++;
+        const char* value = p;
+        const char* close = (const char*)memchr(p, quote, end - p);
+        if (!close) {
+            return;
+        }
+
+        visit(name, nameLength, value, (size_t)(close - value));
+        p = close + 1;
+    }
+}
+
+static bool name_is(const char* name, size_t length, const char* expected) {
+    return strlen(expected) == length && memcmp(name, expected, length) == 0;
+}
+
+// MARK: - Value conversion
+
+// Append a code point as UTF-8. Returns the number of bytes written (0 if it doesn't fit).
+static size_t encode_utf8(uint32_t cp, char* out, size_t room) {
+    if (cp < 0x80 && room >= 1) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800 && room >= 2) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000 && cp >= 0x800 && room >= 3) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    if (cp >= 0x10000 && cp <= 0x10FFFF && room >= 4) {
+        out[0] = (char)(0xF0 | (cp >> 18));
+        out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = (char)(0x80 | (cp & 0x3F));
+        return 4;
+    }
+    return 0;
+}
+
+// Decode one XML entity starting at '&'. Returns the code point and advances `p`,
+// or returns 0 (leaving `p` untouched) if it isn't a recognized entity.
+static uint32_t decode_entity(const char*& p, const char* end) {
+    const char* semi = (const char*)memchr(p, ';', end - p);
+    if (!semi || semi - p > 10) {
+        return 0;
+    }
+
+    const char* body = p + 1;
+    size_t length = semi - body;
+    uint32_t cp = 0;
+
+    if (name_is(body, length, "amp")) {
+        cp = '&';
+    } else if (name_is(body, length, "lt")) {
+        cp = '<';
+    } else if (name_is(body, length, "gt")) {
+        cp = '>';
+    } else if (name_is(body, length, "quot")) {
+        cp = '"';
+    } else if (name_is(body, length, "apos")) {
+        cp = '\'';
+    } else if (length > 1 && body[0] == '#') {
+        bool hex = body[1] == 'x' || body[1] == 'X';
+        char* parsedEnd = nullptr;
+        unsigned long value = strtoul(body + (hex ? 2 : 1), &parsedEnd, hex ? 16 : 10);
+        if (parsedEnd != semi || value == 0) {
+            return 0;
+        }
+        cp = (uint32_t)value;
+    } else {
+        return 0;
+    }
+
+    p = semi + 1;
+    return cp;
+}
+
+// Copy an attribute value into a fixed buffer, decoding entities. Truncates on a
+// UTF-8 boundary and sets kCotFlagTruncated if the value doesn't fit.
+static void copy_value(char* dst, size_t capacity, const char* value, size_t length, uint32_t* flags) {
+    const char* p = value;
+    const char* end = value + length;
+    size_t used = 0;
+    size_t room = capacity - 1;
+
+    while (p < end) {
+        size_t written;
+        if (*p == '&') {
+            const char* entityStart = p;
+            uint32_t cp = decode_entity(p, end);
+            if (cp != 0) {
+                written = encode_utf8(cp, dst + used, room - used);
+                if (written == 0) {
+                    p = entityStart;
+                    *flags |= kCotFlagTruncated;
+                    break;
+                }
+                used += written;
+                continue;
+            }
+        }
+
+        // Copy a whole UTF-8 sequence at a time so truncation never splits one
+        unsigned char lead = (unsigned char)*p;
+        size_t sequence = lead < 0x80 ? 1 : lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+        if (sequence > (size_t)(end - p)) {
+            sequence = (size_t)(end - p);
+        }
+        if (used + sequence > room) {
+            *flags |= kCotFlagTruncated;
+            break;
+        }
+        memcpy(dst + used, p, sequence);
+        used += sequence;
+        p += sequence;
+    }
+
+    dst[used] = '\0';
+}
+
+static double parse_double(const char* value, size_t length) {
+    if (length == 0) {
+        return NAN;
+    }
+    // The value is always followed by its closing quote, so strtod stops in bounds
+    char* parsedEnd = nullptr;
+    double result = strtod(value, &parsedEnd);
+    if (parsedEnd == value || parsedEnd > value + length) {
+        return NAN;
+    }
+    return result;
+}
+
+static bool parse_digits(const char*& p, const char* end, int count, int* out) {
+    int value = 0;
+    for (int i = 0; i < count; ++i) {
+        if (p >= end || *p < '0' || *p > '9') {
+            return false;
+        }
+        value = value * 10 + (*p++ - '0');
+    }
+    *out = value;
+    return true;
+}
+
+static bool expect(const char*& p, const char* end, char c) {
+    if (p >= end || *p != c) {
+        return false;
+    }
+    ++p;
+    return true;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (Howard Hinnant's algorithm)
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+bool cot_parse_time(const char* text, size_t length, int64_t* out_ms) {
+    const char* p = text;
+    const char* end = text + length;
+    int year, month, day, hour, minute, second;
+
+    if (!parse_digits(p, end, 4, &year) || !expect(p, end, '-') ||
+        !parse_digits(p, end, 2, &month) || !expect(p, end, '-') ||
+        !parse_digits(p, end, 2, &day) || !(expect(p, end, 'T') || expect(p, end, ' ')) ||
+        !parse_digits(p, end, 2, &hour) || !expect(p, end, ':') ||
+        !parse_digits(p, end, 2, &minute) || !expect(p, end, ':') ||
+        !parse_digits(p, end, 2, &second)) {
+        return false;
+    }
+
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+
+    // Fractional seconds: keep millisecond precision, ignore the rest
+    int64_t millis = 0;
+    if (p < end && *p == '.') {
+        ++p;
+        int digits = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 3) {
+                millis = millis * 10 + (*p - '0');
+            }
+            ++digits;
+            ++p;
+        }
+        for (; digits < 3; ++digits) {
+            millis *= 10;
+        }
+    }
+
+    int64_t offsetMinutes = 0;
+    if (p < end && (*p == '+' || *p == '-')) {
+        int sign = *p++ == '-' ? -1 : 1;
+        int offsetHours, offsetMins = 0;
+        if (!parse_digits(p, end, 2, &offsetHours)) {
+            return false;
+        }
+        expect(p, end, ':');
+        parse_digits(p, end, 2, &offsetMins);
+        offsetMinutes = sign * (offsetHours * 60 + offsetMins);
+    }
+
+    int64_t days = days_from_civil(year, (unsigned)month, (unsigned)day);
+    int64_t seconds = days * 86400 + hour * 3600 + minute * 60 + second - offsetMinutes * 60;
+    *out_ms = seconds * 1000 + millis;
+    return true;
+}
+
+// MARK: - Event parsing
+
+bool cot_parse_key(const char* xml, size_t length, CotEventKey* out, bool with_point, bool with_contact) {
+    const CotScanner& scanner = cot_scanner_default();
+    const char* end = xml + length;
+
+    out->uid = nullptr;
+    out->uid_length = 0;
+    out->type = nullptr;
+    out->type_length = 0;
+    out->time_ms = 0;
+    out->stale_ms = 0;
+    out->has_point = false;
+    out->lat = out->lon = NAN;
+    out->callsign = nullptr;
+    out->callsign_length = 0;
+
+    const char* event = find_start_tag(scanner, xml, end, "event");
+    const char* eventEnd = event ? find_tag_end(scanner, event, end) : nullptr;
+    if (!eventEnd) {
+        return false;
+    }
+
+    for_each_attribute(scanner, event + 6, eventEnd, [&](const char* name, size_t nameLength,
+                                                         const char* value, size_t valueLength) {
+        if (!out->uid && name_is(name, nameLength, "uid") && valueLength > 0) {
+            out->uid = value;
+            out->uid_length = valueLength;
+        } else if (!out->type && name_is(name, nameLength, "type")) {
+            out->type = value;
+            out->type_length = valueLength;
+        } else if (name_is(name, nameLength, "time")) {
+            cot_parse_time(value, valueLength, &out->time_ms);
+        } else if (name_is(name, nameLength, "stale")) {
+            cot_parse_time(value, valueLength, &out->stale_ms);
+        }
+    });
+
+    bool hasBody = out->uid && eventEnd[-1] != '/';
+    if (with_point && hasBody) {
+        const char* point = find_start_tag(scanner, eventEnd + 1, end, "point");
+        const char* pointEnd = point ? find_tag_end(scanner, point, end) : nullptr;
+        if (pointEnd) {
+            for_each_attribute(scanner, point + 6, pointEnd, [&](const char* name, size_t nameLength,
+                                                                 const char* value, size_t valueLength) {
+                if (name_is(name, nameLength, "lat")) {
+                    out->lat = parse_double(value, valueLength);
+                } else if (name_is(name, nameLength, "lon")) {
+                    out->lon = parse_double(value, valueLength);
+                }
+            });
+            out->has_point = !std::isnan(out->lat) && !std::isnan(out->lon);
+        }
+    }
+
+    if (with_contact && hasBody) {
+        const char* contact = find_start_tag(scanner, eventEnd + 1, end, "contact");
+        const char* contactEnd = contact ? find_tag_end(scanner, contact, end) : nullptr;
+        if (contactEnd) {
+            for_each_attribute(scanner, contact + 8, contactEnd, [&](const char* name, size_t nameLength,
+                                                                     const char* value, size_t valueLength) {
+                if (!out->callsign && name_is(name, nameLength, "callsign")) {
+                    out->callsign = value;
+                    out->callsign_length = valueLength;
+                }
+            });
+        }
+    }
+
+    return out->uid != nullptr;
+}
+
+bool cot_copy_value(char* dst, size_t capacity, const char* value, size_t length) {
+    uint32_t flags = 0;
+    copy_value(dst, capacity, value, length, &flags);
+    return (flags & kCotFlagTruncated) == 0;
+}
+
+bool cot_parse_event(const char* xml, size_t length, CotEventRecord* out) {
+    return cot_parse_event_with(cot_scanner_default(), xml, length, out);
+}
+
+bool cot_parse_event_with(const CotScanner& scanner, const char* xml, size_t length, CotEventRecord* out) {
+    memset(out, 0, sizeof(*out));
+    out->lat = out->lon = out->hae = out->ce = out->le = NAN;
+    out->xml_length = (uint32_t)length;
+
+    const char* end = xml + length;
+    const char* event = find_start_tag(scanner, xml, end, "event");
+    if (!event) {
+        return false;
+    }
+
+    const char* eventEnd = find_tag_end(scanner, event, end);
+    if (!eventEnd) {
+        return false;
+    }
+    out->flags |= kCotFlagValid;
+
+    uint32_t* flags = &out->flags;
+    for_each_attribute(scanner, event + 6, eventEnd, [&](const char* name, size_t nameLength,
+                                                const char* value, size_t valueLength) {
+        if (name_is(name, nameLength, "uid")) {
+            copy_value(out->uid, sizeof(out->uid), value, valueLength, flags);
+        } else if (name_is(name, nameLength, "type")) {
+            copy_value(out->type, sizeof(out->type), value, valueLength, flags);
+        } else if (name_is(name, nameLength, "how")) {
+            copy_value(out->how, sizeof(out->how), value, valueLength, flags);
+        } else if (name_is(name, nameLength, "time")) {
+            cot_parse_time(value, valueLength, &out->time_ms);
+        } else if (name_is(name, nameLength, "start")) {
+            cot_parse_time(value, valueLength, &out->start_ms);
+        } else if (name_is(name, nameLength, "stale")) {
+            cot_parse_time(value, valueLength, &out->stale_ms);
+        }
+    });
+
+    // Self-closing <event/> has no children
+    if (eventEnd > event && eventEnd[-1] == '/') {
+        return true;
+    }
+
+    const char* body = eventEnd + 1;
+
+    const char* point = find_start_tag(scanner, body, end, "point");
+    if (point) {
+        const char* pointEnd = find_tag_end(scanner, point, end);
+        if (pointEnd) {
+            out->flags |= kCotFlagHasPoint;
+            for_each_attribute(scanner, point + 6, pointEnd, [&](const char* name, size_t nameLength,
+                                                        const char* value, size_t valueLength) {
+                if (name_is(name, nameLength, "lat")) {
+                    out->lat = parse_double(value, valueLength);
+                } else if (name_is(name, nameLength, "lon")) {
+                    out->lon = parse_double(value, valueLength);
+                } else if (name_is(name, nameLength, "hae")) {
+                    out->hae = parse_double(value, valueLength);
+                } else if (name_is(name, nameLength, "ce")) {
+                    out->ce = parse_double(value, valueLength);
+                } else if (name_is(name, nameLength, "le")) {
+                    out->le = parse_double(value, valueLength);
+                }
+            });
+        }
+    }
+
+    const char* contact = find_start_tag(scanner, body, end, "contact");
+    if (contact) {
+        const char* contactEnd = find_tag_end(scanner, contact, end);
+        if (contactEnd) {
+            for_each_attribute(scanner, contact + 8, contactEnd, [&](const char* name, size_t nameLength,
+                                                            const char* value, size_t valueLength) {
+                if (name_is(name, nameLength, "callsign")) {
+                    out->flags |= kCotFlagHasContact;
+                    copy_value(out->callsign, sizeof(out->callsign), value, valueLength, flags);
+                }
+            });
+        }
+    }
+
+    return true;
+}
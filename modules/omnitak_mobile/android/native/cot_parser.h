@@ -0,0 +1,80 @@
+/**
+ * cot_parser.h - Native pre-parse of CoT events into fixed-layout records
+ *
+ * CoT events are small, regular XML documents. For the common cases (PLI,
+ * chat, markers) the UI only needs a handful of fields, so the bridge pulls
+ * them out natively and hands Kotlin a packed array of CotEventRecord
+ * instead of making the JVM parse the XML.
+ *
+ * The record layout is shared with CotEventBatch in OmniTAKNativeBridge.kt.
+ * All fields use native byte order; strings are NUL-terminated UTF-8 and are
+ * truncated (with kCotFlagTruncated set) if they don't fit.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct CotScanner;
+
+// CotEventRecord.flags
+static const uint32_t kCotFlagValid = 1u << 0;     // An <event> element was found
+static const uint32_t kCotFlagHasPoint = 1u << 1;  // A <point> element was found
+static const uint32_t kCotFlagHasContact = 1u << 2; // A <contact callsign=...> was found
+static const uint32_t kCotFlagTruncated = 1u << 3; // At least one string field was cut off
+
+struct CotEventRecord {
+    double lat;         // offset 0   (NaN when absent)
+    double lon;         // offset 8
+    double hae;         // offset 16
+    double ce;          // offset 24
+    double le;          // offset 32
+    int64_t time_ms;    // offset 40  (Unix epoch milliseconds, 0 when absent)
+    int64_t start_ms;   // offset 48
+    int64_t stale_ms;   // offset 56
+    uint32_t flags;     // offset 64
+    uint32_t xml_length; // offset 68 (length of the source XML in bytes)
+    char uid[64];       // offset 72
+    char type[40];      // offset 136
+    char how[8];        // offset 176
+    char callsign[72];  // offset 184
+};
+
+static_assert(sizeof(CotEventRecord) == 256, "CotEventRecord layout is shared with Kotlin");
+
+// Parse a CoT event. Always fills `out`; returns false (and clears kCotFlagValid)
+// when no <event> element could be found.
+bool cot_parse_event(const char* xml, size_t length, CotEventRecord* out);
+
+// Same as cot_parse_event with an explicit scanner implementation (see cot_scanner.h)
+bool cot_parse_event_with(const CotScanner& scanner, const char* xml, size_t length, CotEventRecord* out);
+
+// Identity of an event, as needed to key it natively without a full parse
+struct CotEventKey {
+    const char* uid;   // Raw (still entity-encoded) uid attribute, points into the XML
+    size_t uid_length;
+    const char* type;  // Raw type attribute, nullptr when absent
+    size_t type_length;
+    int64_t time_ms;   // Unix epoch milliseconds, 0 when absent
+    int64_t stale_ms;
+    bool has_point;    // Only filled in when requested
+    double lat;
+    double lon;
+    const char* callsign; // Raw <contact callsign=...>, only when requested; nullptr when absent
+    size_t callsign_length;
+};
+
+// Read only the uid, type, time and stale attributes of the <event> element, plus the <point>
+// position when `with_point` is set and the contact callsign when `with_contact` is.
+// Returns false if there is no <event> element or it has no uid.
+bool cot_parse_key(const char* xml, size_t length, CotEventKey* out, bool with_point = false,
+                   bool with_contact = false);
+
+// Copy a raw attribute value into `dst` as NUL-terminated UTF-8, decoding XML entities.
+// Returns false if it had to be truncated to fit `capacity` bytes.
+bool cot_copy_value(char* dst, size_t capacity, const char* value, size_t length);
+
+// Parse an ISO-8601 UTC timestamp ("2024-05-01T12:34:56.789Z") into Unix epoch
+// milliseconds. Numeric offsets (+hh:mm) are honoured. Returns false on malformed input.
+bool cot_parse_time(const char* text, size_t length, int64_t* out_ms);
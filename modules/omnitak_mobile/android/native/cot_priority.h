@@ -0,0 +1,69 @@
+/**
+ * cot_priority.h - Delivery priority of a CoT event by its type
+ *
+ * TAK types are dash-separated and hierarchical, so a prefix match on the
+ * raw type attribute is enough:
+ *
+ * - Emergency: alarms, "b-a-*" (911 "b-a-o-tbl", "b-a-o-pan", cancel "b-a-o-can", geofence)
+ * - Chat:      GeoChat and its receipts, "b-t-f*"
+ * - Tasking:   "t-*", except TAK pings ("t-x-c-t*"), which are Other
+ * - Pli:       atoms, "a-*" (position reports of units, own and others)
+ * - Other:     everything else (drawings, markers, routes, ...) and untyped events
+ *
+ * Lower values are more urgent.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+enum class CotPriority : uint8_t {
+    Emergency = 0,
+    Chat = 1,
+    Tasking = 2,
+    Other = 3,
+    Pli = 4,
+};
+
+static const size_t kCotPriorityCount = 5;
+
+static inline bool cot_type_has_prefix(const char* type, size_t length, const char* prefix) {
+    size_t prefixLength = strlen(prefix);
+    return length >= prefixLength && memcmp(type, prefix, prefixLength) == 0;
+}
+
+// `type` is the raw type attribute (see CotEventKey); nullptr classifies as Other
+static inline CotPriority cot_classify(const char* type, size_t length) {
+    if (!type || length < 2 || type[1] != '-') {
+        return CotPriority::Other;
+    }
+    switch (type[0]) {
+        case 'a':
+            return CotPriority::Pli;
+        case 'b':
+            if (cot_type_has_prefix(type, length, "b-a-")) {
+                return CotPriority::Emergency;
+            }
+            if (cot_type_has_prefix(type, length, "b-t-f")) {
+                return CotPriority::Chat;
+            }
+            return CotPriority::Other;
+        case 't':
+            return cot_type_has_prefix(type, length, "t-x-c-t") ? CotPriority::Other : CotPriority::Tasking;
+        default:
+            return CotPriority::Other;
+    }
+}
+
+static inline const char* cot_priority_name(CotPriority priority) {
+    switch (priority) {
+        case CotPriority::Emergency: return "emergency";
+        case CotPriority::Chat: return "chat";
+        case CotPriority::Tasking: return "tasking";
+        case CotPriority::Other: return "other";
+        case CotPriority::Pli: return "pli";
+    }
+    return "other";
+}
@@ -0,0 +1,159 @@
+/**
+ * cot_scanner.cpp - Bulk byte scanning for the native CoT parse path
+ *
+ * The SIMD paths handle whole 16-byte blocks and leave the tail (fewer than
+ * 16 bytes, or 17 for find_pair, which also reads the following byte) to
+ * the scalar loop, so no load ever goes past `end`.
+ */
+
+#include "cot_scanner.h"
+
+#include <cstdint>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define COT_SCANNER_NEON 1
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define COT_SCANNER_SSE42 1
+#endif
+
+// MARK: - Scalar
+
+static const char* scalar_find_pair(const char* p, const char* end, char a, char b) {
+    for (; p + 1 < end; ++p) {
+        if (p[0] == a && p[1] == b) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+static const char* scalar_find_any3(const char* p, const char* end, char a, char b, char c) {
+    for (; p < end; ++p) {
+        char ch = *p;
+        if (ch == a || ch == b || ch == c) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+static const CotScanner kScalarScanner = {
+    "scalar",
+    scalar_find_pair,
+    scalar_find_any3,
+};
+
+const CotScanner& cot_scanner_scalar() {
+    return kScalarScanner;
+}
+
+// MARK: - NEON
+
+#if defined(COT_SCANNER_NEON)
+
+// Index of the first set lane in a comparison mask, or -1 if none is set.
+// vshrn packs each 8-bit lane into 4 bits of a 64-bit scalar.
+static inline int neon_first_lane(uint8x16_t mask) {
+    uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(mask), 4)), 0);
+    if (bits == 0) {
+        return -1;
+    }
+    return __builtin_ctzll(bits) >> 2;
+}
+
+static const char* neon_find_pair(const char* p, const char* end, char a, char b) {
+    const uint8x16_t va = vdupq_n_u8((uint8_t)a);
+    const uint8x16_t vb = vdupq_n_u8((uint8_t)b);
+
+    while (end - p >= 17) {
+        uint8x16_t first = vld1q_u8((const uint8_t*)p);
+        uint8x16_t second = vld1q_u8((const uint8_t*)p + 1);
+        uint8x16_t match = vandq_u8(vceqq_u8(first, va), vceqq_u8(second, vb));
+        int lane = neon_first_lane(match);
+        if (lane >= 0) {
+            return p + lane;
+        }
+        p += 16;
+    }
+    return scalar_find_pair(p, end, a, b);
+}
+
+static const char* neon_find_any3(const char* p, const char* end, char a, char b, char c) {
+    const uint8x16_t va = vdupq_n_u8((uint8_t)a);
+    const uint8x16_t vb = vdupq_n_u8((uint8_t)b);
+    const uint8x16_t vc = vdupq_n_u8((uint8_t)c);
+
+    while (end - p >= 16) {
+        uint8x16_t block = vld1q_u8((const uint8_t*)p);
+        uint8x16_t match = vorrq_u8(vorrq_u8(vceqq_u8(block, va), vceqq_u8(block, vb)), vceqq_u8(block, vc));
+        int lane = neon_first_lane(match);
+        if (lane >= 0) {
+            return p + lane;
+        }
+        p += 16;
+    }
+    return scalar_find_any3(p, end, a, b, c);
+}
+
+static const CotScanner kSimdScanner = {
+    "neon",
+    neon_find_pair,
+    neon_find_any3,
+};
+
+#endif
+
+// MARK: - SSE4.2
+
+#if defined(COT_SCANNER_SSE42)
+
+static const char* sse42_find_pair(const char* p, const char* end, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+
+    while (end - p >= 17) {
+        __m128i first = _mm_loadu_si128((const __m128i*)p);
+        __m128i second = _mm_loadu_si128((const __m128i*)(p + 1));
+        __m128i match = _mm_and_si128(_mm_cmpeq_epi8(first, va), _mm_cmpeq_epi8(second, vb));
+        int bits = _mm_movemask_epi8(match);
+        if (bits != 0) {
+            return p + __builtin_ctz((unsigned)bits);
+        }
+        p += 16;
+    }
+    return scalar_find_pair(p, end, a, b);
+}
+
+static const char* sse42_find_any3(const char* p, const char* end, char a, char b, char c) {
+    // PCMPESTRI with an explicit-length needle set, so NUL bytes in the data are handled
+    const __m128i set = _mm_setr_epi8(a, b, c, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const int mode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT;
+
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)p);
+        int index = _mm_cmpestri(set, 3, block, 16, mode);
+        if (index < 16) {
+            return p + index;
+        }
+        p += 16;
+    }
+    return scalar_find_any3(p, end, a, b, c);
+}
+
+static const CotScanner kSimdScanner = {
+    "sse4.2",
+    sse42_find_pair,
+    sse42_find_any3,
+};
+
+#endif
+
+const CotScanner& cot_scanner_default() {
+#if defined(COT_SCANNER_NEON) || defined(COT_SCANNER_SSE42)
+    return kSimdScanner;
+#else
+    return kScalarScanner;
+#endif
+}
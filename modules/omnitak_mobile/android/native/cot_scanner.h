@@ -0,0 +1,32 @@
+/**
+ * cot_scanner.h - Bulk byte scanning for the native CoT parse path
+ *
+ * cot_parser spends nearly all of its time looking for a few bytes: the '<'
+ * that opens <event>/<point>/<contact>, the quotes around attribute values
+ * and the '>' that closes a start tag. These primitives check 16 bytes per
+ * step with NEON (arm64-v8a) or SSE4.2 (x86_64) and fall back to a scalar
+ * loop elsewhere (armeabi-v7a, x86).
+ *
+ * Both implementations are always compiled so they can be compared against
+ * each other (see benchmark/cot_scanner_benchmark.cpp).
+ */
+
+#pragma once
+
+#include <cstddef>
+
+struct CotScanner {
+    const char* name;
+
+    // First position i in [p, end - 1) with p[i] == a and p[i + 1] == b
+    const char* (*find_pair)(const char* p, const char* end, char a, char b);
+
+    // First byte in [p, end) equal to a, b or c
+    const char* (*find_any3)(const char* p, const char* end, char a, char b, char c);
+};
+
+// Portable byte-at-a-time implementation
+const CotScanner& cot_scanner_scalar();
+
+// Best implementation for the target ABI (the scalar one when no SIMD is available)
+const CotScanner& cot_scanner_default();
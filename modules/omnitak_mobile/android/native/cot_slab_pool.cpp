@@ -0,0 +1,188 @@
+/**
+ * cot_slab_pool.cpp - Pooled native slabs for inbound CoT payloads
+ */
+
+#include "cot_slab_pool.h"
+
+#include <cstring>
+#include <android/log.h>
+
+#define LOG_TAG "OmniTAK-JNI"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+static uint32_t read_u32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void write_u32(uint8_t* p, uint32_t value) {
+    memcpy(p, &value, sizeof(value));
+}
+
+// MARK: - CotSlab
+
+uint32_t CotSlab::count() const {
+    return read_u32(data.get());
+}
+
+uint32_t CotSlab::used() const {
+    return read_u32(data.get() + 4);
+}
+
+void CotSlab::reset() {
+    write_u32(data.get(), 0);
+    write_u32(data.get() + 4, kSlabPayloadOffset);
+}
+
+bool CotSlab::append(const char* bytes, size_t length) {
+    uint32_t n = count();
+    uint32_t offset = used();
+
+    if (n >= kSlabMaxEntries || offset + length + 1 > capacity) {
+        return false;
+    }
+
+    uint8_t* base = data.get();
+    memcpy(base + offset, bytes, length);
+    base[offset + length] = '\0';
+
+    uint8_t* entryPtr = base + kSlabHeaderSize + n * kSlabEntrySize;
+    write_u32(entryPtr, offset);
+    write_u32(entryPtr + 4, (uint32_t)length);
+
+    write_u32(base, n + 1);
+    write_u32(base + 4, (uint32_t)(offset + length + 1));
+    return true;
+}
+
+const char* CotSlab::entry(uint32_t index) const {
+    const uint8_t* entryPtr = data.get() + kSlabHeaderSize + index * kSlabEntrySize;
+    return (const char*)(data.get() + read_u32(entryPtr));
+}
+
+uint32_t CotSlab::entry_length(uint32_t index) const {
+    const uint8_t* entryPtr = data.get() + kSlabHeaderSize + index * kSlabEntrySize;
+    return read_u32(entryPtr + 4);
+}
+
+// MARK: - CotSlabPool
+
+CotSlabPool::CotSlabPool(size_t slab_size, size_t max_slabs)
+    : slab_size_(slab_size > kSlabPayloadOffset ? slab_size : kSlabPayloadOffset * 2),
+      max_slabs_(max_slabs) {}
+
+CotSlab* CotSlabPool::allocate_locked(size_t capacity, bool pooled) {
+    uint32_t id;
+    if (!vacant_ids_.empty()) {
+        id = vacant_ids_.back();
+        vacant_ids_.pop_back();
+    } else if (slabs_.size() < max_slabs_) {
+        id = (uint32_t)slabs_.size();
+        slabs_.emplace_back();
+    } else {
+        return nullptr;
+    }
+
+    auto slab = std::make_unique<CotSlab>();
+    slab->id = id;
+    slab->capacity = capacity;
+    slab->pooled = pooled;
+    slab->data.reset(new uint8_t[capacity]);
+    slabs_[id] = std::move(slab);
+
+    ++stats_.allocations;
+    stats_.allocated_bytes += capacity;
+    ++stats_.slabs;
+    return slabs_[id].get();
+}
+
+CotSlab* CotSlabPool::acquire(size_t payload_length, bool* allocated) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    CotSlab* slab = nullptr;
+    size_t needed = kSlabPayloadOffset + payload_length + 1;
+
+    bool fresh = true;
+    if (needed > slab_size_) {
+        // Large payloads (e.g. drawing shapes) get a dedicated slab
+        slab = allocate_locked(needed, false);
+    } else if (!free_ids_.empty()) {
+        slab = slabs_[free_ids_.back()].get();
+        free_ids_.pop_back();
+        fresh = false;
+        ++stats_.reuses;
+    } else {
+        slab = allocate_locked(slab_size_, true);
+    }
+
+    if (!slab) {
+        if (!exhausted_logged_) {
+            LOGW("CoT slab pool exhausted (%zu slabs checked out)", slabs_.size());
+            exhausted_logged_ = true;
+        }
+        return nullptr;
+    }
+
+    slab->in_use = true;
+    slab->reset();
+    if (++stats_.in_use > stats_.peak_in_use) {
+        stats_.peak_in_use = stats_.in_use;
+    }
+    if (allocated) {
+        *allocated = fresh;
+    }
+    return slab;
+}
+
+void CotSlabPool::release(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (id >= slabs_.size() || !slabs_[id] || !slabs_[id]->in_use) {
+        return;
+    }
+    slabs_[id]->in_use = false;
+    --stats_.in_use;
+
+    if (slabs_[id]->pooled) {
+        free_ids_.push_back(id);
+    } else {
+        slabs_[id].reset();
+        vacant_ids_.push_back(id);
+        --stats_.slabs;
+    }
+    exhausted_logged_ = false;
+}
+
+void CotSlabPool::reserve(size_t free_slabs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Ids for the whole pool up front, so releases never grow free_ids_ either
+    free_ids_.reserve(max_slabs_);
+    vacant_ids_.reserve(max_slabs_);
+
+    while (free_ids_.size() < free_slabs) {
+        CotSlab* slab = allocate_locked(slab_size_, true);
+        if (!slab) {
+            break;
+        }
+        free_ids_.push_back(slab->id);
+    }
+}
+
+bool CotSlabPool::ensure_records(CotSlab* slab) {
+    if (slab->records) {
+        return false;
+    }
+    slab->records.reset(new CotEventRecord[kSlabMaxEntries]);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.allocations;
+    stats_.allocated_bytes += kSlabMaxEntries * sizeof(CotEventRecord);
+    return true;
+}
+
+CotSlabPool::Stats CotSlabPool::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
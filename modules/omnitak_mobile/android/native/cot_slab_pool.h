@@ -0,0 +1,104 @@
+/**
+ * cot_slab_pool.h - Pooled native slabs for inbound CoT payloads
+ *
+ * A slab is a single block of native memory holding a small header, an
+ * offsets table and the raw UTF-8 bytes of several CoT messages:
+ *
+ *   [0..4)   uint32 entry count
+ *   [4..8)   uint32 bytes used (header + table + payload)
+ *   [8..)    kSlabMaxEntries x { uint32 offset, uint32 length }
+ *   [kSlabPayloadOffset..) payloads, each followed by a NUL terminator
+ *
+ * Offsets are relative to the start of the slab and lengths exclude the
+ * terminator. All fields use native byte order. The layout is exposed to
+ * Kotlin as a direct ByteBuffer, so it must stay in sync with CotSlab in
+ * OmniTAKNativeBridge.kt.
+ *
+ * Slabs (and their parsed record arrays) are only allocated while the pool
+ * warms up or for oversized payloads; afterwards every acquire reuses a
+ * released slab. The pool counts both, so callers can check that steady-state
+ * delivery doesn't touch the heap.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cot_parser.h"
+
+static const uint32_t kSlabMaxEntries = 256;
+static const uint32_t kSlabHeaderSize = 8;
+static const uint32_t kSlabEntrySize = 8;
+static const uint32_t kSlabPayloadOffset = kSlabHeaderSize + kSlabMaxEntries * kSlabEntrySize;
+
+struct CotSlab {
+    uint32_t id = 0;
+    size_t capacity = 0;
+    bool pooled = true; // Oversized slabs are freed on release instead of reused
+    bool in_use = false;
+    std::unique_ptr<uint8_t[]> data;
+    std::unique_ptr<CotEventRecord[]> records; // Parsed delivery only; one per entry, allocated on first use
+
+    uint32_t count() const;
+    uint32_t used() const;
+
+    // Start over with an empty slab
+    void reset();
+
+    // Copy a payload into the slab. Returns false if it doesn't fit.
+    bool append(const char* bytes, size_t length);
+
+    const char* entry(uint32_t index) const;
+    uint32_t entry_length(uint32_t index) const;
+};
+
+class CotSlabPool {
+public:
+    struct Stats {
+        uint64_t allocations;     // Slabs and record arrays allocated from the heap
+        uint64_t allocated_bytes;
+        uint64_t reuses;          // Acquires served from the free list
+        uint32_t slabs;           // Slabs currently allocated
+        uint32_t in_use;          // Slabs checked out right now
+        uint32_t peak_in_use;
+    };
+
+    CotSlabPool(size_t slab_size, size_t max_slabs);
+
+    // Get an empty slab that can hold at least `payload_length` bytes (plus terminator).
+    // Returns nullptr when every slab is checked out. `*allocated` (if given) is set when
+    // the slab had to be allocated rather than reused.
+    CotSlab* acquire(size_t payload_length, bool* allocated = nullptr);
+
+    // Return a slab to the pool. Safe to call with unknown ids.
+    void release(uint32_t id);
+
+    // Allocate pooled slabs up front until at least `free_slabs` are free (within
+    // max_slabs), so the first messages of a new connection don't allocate
+    void reserve(size_t free_slabs);
+
+    // Give a checked-out slab its parsed record array. Returns true if it was allocated
+    // now; slabs keep theirs across reuse.
+    bool ensure_records(CotSlab* slab);
+
+    Stats stats();
+
+    size_t slab_size() const { return slab_size_; }
+
+private:
+    CotSlab* allocate_locked(size_t capacity, bool pooled);
+
+    const size_t slab_size_;
+    const size_t max_slabs_;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<CotSlab>> slabs_; // Indexed by slab id
+    std::vector<uint32_t> free_ids_;              // Ids of pooled slabs ready for reuse
+    std::vector<uint32_t> vacant_ids_;            // Ids with no slab (freed oversized slabs)
+    bool exhausted_logged_ = false;
+    Stats stats_ = {};
+};
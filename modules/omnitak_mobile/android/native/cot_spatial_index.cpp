@@ -0,0 +1,74 @@
+/**
+ * cot_spatial_index.cpp - Grid index over track positions
+ */
+
+#include "cot_spatial_index.h"
+
+CotSpatialIndex::CotSpatialIndex(double cell_degrees)
+    : cell_degrees_(cell_degrees > 0 ? cell_degrees : 1.0) {}
+
+int32_t CotSpatialIndex::row_for(double lat) const {
+    double clamped = lat < -90.0 ? -90.0 : (lat > 90.0 ? 90.0 : lat);
+    return (int32_t)std::floor((clamped + 90.0) / cell_degrees_);
+}
+
+int32_t CotSpatialIndex::column_for(double lon) const {
+    double clamped = lon < -180.0 ? -180.0 : (lon > 180.0 ? 180.0 : lon);
+    return (int32_t)std::floor((clamped + 180.0) / cell_degrees_);
+}
+
+void CotSpatialIndex::insert(uint64_t key, double lat, double lon) {
+    uint64_t cell = cell_key(row_for(lat), column_for(lon));
+
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        Entry& entry = it->second;
+        entry.lat = lat;
+        entry.lon = lon;
+        if (entry.cell == cell) {
+            return; // Moved within its cell: nothing to relink
+        }
+        unlink(entry);
+        std::vector<uint64_t>& keys = cells_[cell];
+        entry.cell = cell;
+        entry.slot = (uint32_t)keys.size();
+        keys.push_back(key);
+        return;
+    }
+
+    std::vector<uint64_t>& keys = cells_[cell];
+    entries_[key] = Entry{lat, lon, cell, (uint32_t)keys.size()};
+    keys.push_back(key);
+}
+
+void CotSpatialIndex::remove(uint64_t key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return;
+    }
+    unlink(it->second);
+    entries_.erase(it);
+}
+
+void CotSpatialIndex::clear() {
+    cells_.clear();
+    entries_.clear();
+}
+
+// Remove an entry's key from its cell by swapping in the cell's last key
+void CotSpatialIndex::unlink(const Entry& entry) {
+    auto cell = cells_.find(entry.cell);
+    if (cell == cells_.end()) {
+        return;
+    }
+
+    std::vector<uint64_t>& keys = cell->second;
+    uint64_t last = keys.back();
+    keys[entry.slot] = last;
+    entries_[last].slot = entry.slot;
+    keys.pop_back();
+
+    if (keys.empty()) {
+        cells_.erase(cell);
+    }
+}
@@ -0,0 +1,102 @@
+/**
+ * cot_spatial_index.h - Grid index over track positions
+ *
+ * Tracks are bucketed into fixed lat/lon cells (a geohash-style grid), so an
+ * update is O(1) and a viewport query only touches the cells it overlaps.
+ * Cells are sparse: only cells holding at least one track take memory.
+ *
+ * Not thread-safe; CotTrackStore owns one and guards it with its mutex.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class CotSpatialIndex {
+public:
+    explicit CotSpatialIndex(double cell_degrees);
+
+    // Insert `key` at the given position, moving it if it's already indexed
+    void insert(uint64_t key, double lat, double lon);
+
+    void remove(uint64_t key);
+    void clear();
+
+    size_t size() const { return entries_.size(); }
+
+    // Call `visit(key, lat, lon)` for each track inside the box until it returns false.
+    // A box with min_lon > max_lon wraps across the antimeridian.
+    template <typename Visitor>
+    void query(double min_lat, double min_lon, double max_lat, double max_lon, Visitor visit) const {
+        if (min_lon > max_lon) {
+            if (query_range(min_lat, min_lon, max_lat, 180.0, visit)) {
+                query_range(min_lat, -180.0, max_lat, max_lon, visit);
+            }
+            return;
+        }
+        query_range(min_lat, min_lon, max_lat, max_lon, visit);
+    }
+
+private:
+    struct Entry {
+        double lat;
+        double lon;
+        uint64_t cell;
+        uint32_t slot; // Index of the key within its cell's vector
+    };
+
+    int32_t row_for(double lat) const;
+    int32_t column_for(double lon) const;
+
+    static uint64_t cell_key(int32_t row, int32_t column) {
+        return ((uint64_t)(uint32_t)row << 32) | (uint32_t)column;
+    }
+
+    void unlink(const Entry& entry);
+
+    // Returns false once the visitor asked to stop
+    template <typename Visitor>
+    bool query_range(double min_lat, double min_lon, double max_lat, double max_lon, Visitor& visit) const {
+        auto inside = [&](const Entry& entry) {
+            return entry.lat >= min_lat && entry.lat <= max_lat && entry.lon >= min_lon && entry.lon <= max_lon;
+        };
+
+        int32_t minRow = row_for(min_lat), maxRow = row_for(max_lat);
+        int32_t minColumn = column_for(min_lon), maxColumn = column_for(max_lon);
+        double cellCount = (double)(maxRow - minRow + 1) * (double)(maxColumn - minColumn + 1);
+
+        // Large boxes over a sparse grid: a linear scan beats probing empty cells
+        if (cellCount > (double)cells_.size()) {
+            for (const auto& pair : entries_) {
+                if (inside(pair.second) && !visit(pair.first, pair.second.lat, pair.second.lon)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        for (int32_t row = minRow; row <= maxRow; ++row) {
+            for (int32_t column = minColumn; column <= maxColumn; ++column) {
+                auto cell = cells_.find(cell_key(row, column));
+                if (cell == cells_.end()) {
+                    continue;
+                }
+                for (uint64_t key : cell->second) {
+                    const Entry& entry = entries_.at(key);
+                    if (inside(entry) && !visit(key, entry.lat, entry.lon)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    const double cell_degrees_;
+    std::unordered_map<uint64_t, std::vector<uint64_t>> cells_;
+    std::unordered_map<uint64_t, Entry> entries_;
+};
@@ -0,0 +1,79 @@
+/**
+ * cot_trace.cpp - ATrace entry points, resolved at runtime
+ */
+
+#include "cot_trace.h"
+
+#if OMNITAK_TRACE
+
+#include <cstdio>
+#include <dlfcn.h>
+
+namespace {
+
+struct ATraceApi {
+    bool (*is_enabled)() = nullptr;
+    void (*begin_section)(const char*) = nullptr;
+    void (*end_section)() = nullptr;
+
+    ATraceApi() {
+        // libandroid.so is always loaded into app processes; this only takes a reference
+        void* library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+        if (!library) {
+            return;
+        }
+        is_enabled = reinterpret_cast<bool (*)()>(dlsym(library, "ATrace_isEnabled"));
+        begin_section = reinterpret_cast<void (*)(const char*)>(dlsym(library, "ATrace_beginSection"));
+        end_section = reinterpret_cast<void (*)()>(dlsym(library, "ATrace_endSection"));
+        if (!is_enabled || !begin_section || !end_section) {
+            is_enabled = nullptr;
+        }
+    }
+};
+
+const ATraceApi& atrace() {
+    static const ATraceApi api;
+    return api;
+}
+
+// atrace truncates section names beyond this
+const size_t kMaxSectionName = 128;
+
+} // namespace
+
+bool cot_trace_enabled() {
+    const ATraceApi& api = atrace();
+    return api.is_enabled && api.is_enabled();
+}
+
+CotTraceSection::CotTraceSection(const char* name) : active_(cot_trace_enabled()) {
+    if (active_) {
+        atrace().begin_section(name);
+    }
+}
+
+CotTraceSection::CotTraceSection(const char* name, const char* uid, size_t uid_length)
+    : active_(cot_trace_enabled()) {
+    if (active_) {
+        char section[kMaxSectionName];
+        snprintf(section, sizeof(section), "%s cid=%08x uid=%.*s", name,
+                 cot_trace_correlation_id(uid, uid_length), (int)uid_length, uid);
+        atrace().begin_section(section);
+    }
+}
+
+CotTraceSection::CotTraceSection(const char* name, const char* detail) : active_(cot_trace_enabled()) {
+    if (active_) {
+        char section[kMaxSectionName];
+        snprintf(section, sizeof(section), "%s %s", name, detail);
+        atrace().begin_section(section);
+    }
+}
+
+CotTraceSection::~CotTraceSection() {
+    if (active_) {
+        atrace().end_section();
+    }
+}
+
+#endif
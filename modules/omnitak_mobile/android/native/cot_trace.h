@@ -0,0 +1,73 @@
+/**
+ * cot_trace.h - Compile-time-gated ATrace sections for the CoT hot path
+ *
+ * Built with -DOMNITAK_TRACE=1 (CMake option OMNITAK_ENABLE_TRACING), the
+ * COT_TRACE_* macros emit ATrace sections that show up in Perfetto and
+ * systrace under the app's process. Otherwise they expand to nothing, so
+ * release builds carry no tracing code at all.
+ *
+ * ATrace only exists from API 23 while the library targets API 21, so the
+ * entry points are resolved from libandroid.so at first use. When they are
+ * missing, or no trace is being recorded, a section costs one load and
+ * branch; names are only formatted while a trace is running.
+ *
+ * Sections about a single event carry its correlation id, "cid=xxxxxxxx":
+ * the 32-bit FNV-1a hash of the event uid. SCMapLibreMapView uses the same
+ * hash as its os_signpost ids, so searching a trace for one cid follows a
+ * track from the Rust callback through send or delivery to the map.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef OMNITAK_TRACE
+#define OMNITAK_TRACE 0
+#endif
+
+// FNV-1a of the raw uid attribute. Always available, so ids can be logged or
+// passed on even when tracing is compiled out.
+static inline uint32_t cot_trace_correlation_id(const char* uid, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (uint8_t)uid[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+#if OMNITAK_TRACE
+
+// True while a trace is being recorded (and ATrace is available)
+bool cot_trace_enabled();
+
+// Begins a section on construction and ends it on destruction. Sections nest
+// per thread, so a scope must end on the thread that began it.
+class CotTraceSection {
+public:
+    explicit CotTraceSection(const char* name);
+    // "name cid=xxxxxxxx uid=..." for following a single event
+    CotTraceSection(const char* name, const char* uid, size_t uid_length);
+    // "name detail"
+    CotTraceSection(const char* name, const char* detail);
+    ~CotTraceSection();
+
+    CotTraceSection(const CotTraceSection&) = delete;
+    CotTraceSection& operator=(const CotTraceSection&) = delete;
+
+private:
+    bool active_;
+};
+
+#define COT_TRACE_CONCAT_INNER(a, b) a##b
+#define COT_TRACE_CONCAT(a, b) COT_TRACE_CONCAT_INNER(a, b)
+#define COT_TRACE_SCOPE(...) CotTraceSection COT_TRACE_CONCAT(cot_trace_section_, __LINE__)(__VA_ARGS__)
+#define COT_TRACE_ENABLED() cot_trace_enabled()
+
+#else
+
+#define COT_TRACE_SCOPE(...) ((void)0)
+#define COT_TRACE_ENABLED() false
+
+#endif
@@ -0,0 +1,261 @@
+/**
+ * cot_track_snapshot.cpp - Memory-mapped snapshot of the track store
+ */
+
+#include "cot_track_snapshot.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <android/log.h>
+
+#define LOG_TAG "OmniTAK-JNI"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// 64-bit FNV-1a of the uid; the record keeps the uid itself to detect collisions
+static uint64_t uid_key(const char* uid, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)uid[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool record_has_uid(const CotSnapshotRecord& record, const char* uid, size_t length) {
+    return length < sizeof(record.uid) && memcmp(record.uid, uid, length) == 0 && record.uid[length] == '\0';
+}
+
+CotTrackSnapshot::~CotTrackSnapshot() {
+    close();
+}
+
+bool CotTrackSnapshot::open(const char* path, int64_t now_ms, std::vector<Track>& restored) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+
+    size_t size = sizeof(CotSnapshotHeader) + capacity_ * sizeof(CotSnapshotRecord);
+    int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOGE("Failed to open track snapshot %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    CotSnapshotHeader existing;
+    bool valid = fstat(fd, &st) == 0 && (size_t)st.st_size == size &&
+                 pread(fd, &existing, sizeof(existing), 0) == (ssize_t)sizeof(existing) &&
+                 existing.magic == kCotSnapshotMagic && existing.version == kCotSnapshotVersion &&
+                 existing.record_size == sizeof(CotSnapshotRecord) && existing.capacity == capacity_ &&
+                 existing.high_water <= capacity_;
+
+    // Anything else starts over from an empty file
+    if (!valid && ftruncate(fd, 0) != 0) {
+        LOGE("Failed to reset track snapshot: %s", strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    // Reserve the blocks up front: a write fault on a full disk would be SIGBUS, not an error
+    int error = posix_fallocate(fd, 0, (off_t)size);
+    if (error != 0) {
+        LOGE("Failed to allocate track snapshot (%zu bytes): %s", size, strerror(error));
+        ::close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        LOGE("Failed to map track snapshot: %s", strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    map_ = (uint8_t*)map;
+    map_size_ = size;
+    header_ = (CotSnapshotHeader*)map_;
+    records_ = (CotSnapshotRecord*)(map_ + sizeof(CotSnapshotHeader));
+    if (!valid) {
+        memset(header_, 0, sizeof(CotSnapshotHeader));
+        header_->magic = kCotSnapshotMagic;
+        header_->version = kCotSnapshotVersion;
+        header_->record_size = sizeof(CotSnapshotRecord);
+        header_->capacity = (uint32_t)capacity_;
+    }
+
+    // Only slots below the high-water mark were ever written
+    for (uint32_t slot = 0; slot < header_->high_water; ++slot) {
+        CotSnapshotRecord& record = records_[slot];
+        if (record.sequence == 0) {
+            free_slots_.push_back(slot);
+            continue;
+        }
+
+        size_t uidLength = strnlen(record.uid, sizeof(record.uid));
+        bool live = (record.sequence & 1) == 0 && uidLength > 0 && uidLength < sizeof(record.uid) &&
+                    (record.stale_ms <= 0 || record.stale_ms > now_ms);
+        if (!live || !slots_.emplace(uid_key(record.uid, uidLength), slot).second) {
+            record.sequence = 0;
+            free_slots_.push_back(slot);
+            continue;
+        }
+
+        record.type[sizeof(record.type) - 1] = '\0';
+        record.callsign[sizeof(record.callsign) - 1] = '\0';
+        bool hasPoint = (record.flags & kCotSnapshotHasPoint) != 0;
+        restored.push_back({std::string(record.uid, uidLength), record.type, record.callsign,
+                            record.stale_ms, record.updated_ms, hasPoint, record.lat, record.lon});
+    }
+
+    open_.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void CotTrackSnapshot::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    open_.store(false, std::memory_order_relaxed);
+
+    msync(map_, map_size_, MS_SYNC);
+    munmap(map_, map_size_);
+    ::close(fd_);
+
+    fd_ = -1;
+    map_ = nullptr;
+    map_size_ = 0;
+    header_ = nullptr;
+    records_ = nullptr;
+    slots_.clear();
+    free_slots_.clear();
+    full_logged_ = false;
+}
+
+bool CotTrackSnapshot::update(const CotEventKey& key, int64_t now_ms) {
+    if (!open_.load(std::memory_order_relaxed) || key.uid_length >= sizeof(CotSnapshotRecord::uid)) {
+        return false;
+    }
+    uint64_t hash = uid_key(key.uid, key.uid_length);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!records_) {
+        return false; // Closed since the check above
+    }
+
+    // Start from the current record so fields this event lacks keep their last value
+    CotSnapshotRecord next;
+    uint32_t slot;
+    auto it = slots_.find(hash);
+    if (it != slots_.end()) {
+        slot = it->second;
+        if (!record_has_uid(records_[slot], key.uid, key.uid_length)) {
+            return false; // Hash collision with another uid
+        }
+        next = records_[slot];
+    } else {
+        slot = allocate_slot_locked();
+        if (slot == UINT32_MAX) {
+            return false;
+        }
+        slots_.emplace(hash, slot);
+        memset(&next, 0, sizeof(next));
+        memcpy(next.uid, key.uid, key.uid_length);
+    }
+
+    next.stale_ms = key.stale_ms;
+    next.updated_ms = now_ms;
+    if (key.has_point) {
+        next.flags |= kCotSnapshotHasPoint;
+        next.lat = key.lat;
+        next.lon = key.lon;
+    }
+    if (key.type) {
+        cot_copy_value(next.type, sizeof(next.type), key.type, key.type_length);
+    }
+    if (key.callsign) {
+        cot_copy_value(next.callsign, sizeof(next.callsign), key.callsign, key.callsign_length);
+    }
+
+    // Odd while the body is rewritten; the fences keep the body between the two stores
+    CotSnapshotRecord& record = records_[slot];
+    uint32_t sequence = record.sequence;
+    record.sequence = sequence + 1;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy((uint8_t*)&record + sizeof(record.sequence), (const uint8_t*)&next + sizeof(next.sequence),
+           sizeof(next) - sizeof(next.sequence));
+    std::atomic_thread_fence(std::memory_order_release);
+    record.sequence = sequence + 2 == 0 ? 2 : sequence + 2;
+    return true;
+}
+
+void CotTrackSnapshot::remove(const char* uid, size_t uid_length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!records_) {
+        return;
+    }
+
+    auto it = slots_.find(uid_key(uid, uid_length));
+    if (it == slots_.end() || !record_has_uid(records_[it->second], uid, uid_length)) {
+        return;
+    }
+    records_[it->second].sequence = 0;
+    free_slots_.push_back(it->second);
+    slots_.erase(it);
+    full_logged_ = false;
+}
+
+void CotTrackSnapshot::tracks(std::vector<Track>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!records_) {
+        return;
+    }
+
+    out.reserve(out.size() + slots_.size());
+    for (const auto& pair : slots_) {
+        const CotSnapshotRecord& record = records_[pair.second];
+        out.push_back({record.uid, record.type, record.callsign, record.stale_ms, record.updated_ms,
+                       (record.flags & kCotSnapshotHasPoint) != 0, record.lat, record.lon});
+    }
+}
+
+void CotTrackSnapshot::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!records_) {
+        return;
+    }
+
+    memset(records_, 0, header_->high_water * sizeof(CotSnapshotRecord));
+    header_->high_water = 0;
+    slots_.clear();
+    free_slots_.clear();
+    full_logged_ = false;
+}
+
+size_t CotTrackSnapshot::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return slots_.size();
+}
+
+// Reuse an emptied slot, else take the next never-used one. Called with mutex_ held.
+uint32_t CotTrackSnapshot::allocate_slot_locked() {
+    if (!free_slots_.empty()) {
+        uint32_t slot = free_slots_.back();
+        free_slots_.pop_back();
+        return slot;
+    }
+    if (header_->high_water < capacity_) {
+        return header_->high_water++;
+    }
+    if (!full_logged_) {
+        LOGW("Track snapshot full (%zu tracks), not saving new uids", slots_.size());
+        full_logged_ = true;
+    }
+    return UINT32_MAX;
+}
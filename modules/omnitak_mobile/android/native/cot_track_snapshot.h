@@ -0,0 +1,126 @@
+/**
+ * cot_track_snapshot.h - Memory-mapped snapshot of the track store
+ *
+ * Keeps the last known uid, type, callsign, position and stale time of every
+ * track in a file, so a restarted process can show the previous picture
+ * before any connection is up. File layout (native byte order):
+ *
+ *   [0..256)  CotSnapshotHeader
+ *   [256..)   capacity x CotSnapshotRecord, one slot per track
+ *
+ * The file is mapped MAP_SHARED and every update rewrites one record in
+ * place, so writes cost a memcpy and no syscall, and land in the page cache
+ * where they survive the process being killed. The header and records are
+ * 256 bytes each, so no record straddles a page.
+ *
+ * A record's sequence is odd while it is being written and even once
+ * complete; 0 marks an empty slot. open() drops odd records, left by a
+ * process killed mid-write, and records whose stale time has passed.
+ *
+ * Shared by all connections; all methods are thread-safe.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cot_parser.h"
+
+static const uint32_t kCotSnapshotMagic = 0x4E53544F; // "OTSN"
+static const uint32_t kCotSnapshotVersion = 1;
+
+// CotSnapshotRecord.flags
+static const uint32_t kCotSnapshotHasPoint = 1u << 0;
+
+struct CotSnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t high_water;   // Slots [0, high_water) have been used at some point
+    uint8_t reserved[236];
+};
+
+struct CotSnapshotRecord {
+    uint32_t sequence;     // offset 0   (0 = empty slot, odd = being written)
+    uint32_t flags;        // offset 4
+    int64_t stale_ms;      // offset 8   (Unix epoch milliseconds, 0 = never)
+    int64_t updated_ms;    // offset 16  (when this record was last written)
+    double lat;            // offset 24
+    double lon;            // offset 32
+    char uid[64];          // offset 40  (raw attribute value, as in onCotExpired)
+    char type[40];         // offset 104
+    char callsign[72];     // offset 144 (decoded)
+    uint8_t reserved[40];  // offset 216
+};
+
+static_assert(sizeof(CotSnapshotHeader) == 256, "CotSnapshotHeader is part of the file format");
+static_assert(sizeof(CotSnapshotRecord) == 256, "CotSnapshotRecord is part of the file format");
+
+class CotTrackSnapshot {
+public:
+    struct Track {
+        std::string uid;
+        std::string type;
+        std::string callsign;
+        int64_t stale_ms;
+        int64_t updated_ms;
+        bool has_position;
+        double lat;
+        double lon;
+    };
+
+    explicit CotTrackSnapshot(size_t capacity) : capacity_(capacity) {}
+    ~CotTrackSnapshot();
+
+    CotTrackSnapshot(const CotTrackSnapshot&) = delete;
+    CotTrackSnapshot& operator=(const CotTrackSnapshot&) = delete;
+
+    // Map the snapshot at `path`, creating it (or starting over, if it has another
+    // format) as needed. Tracks still live at `now_ms` are kept and appended to
+    // `restored`. Returns false on I/O errors, leaving the snapshot closed.
+    bool open(const char* path, int64_t now_ms, std::vector<Track>& restored);
+
+    // Unmap the file, writing it back first. The file itself is kept.
+    void close();
+
+    bool is_open() const { return open_.load(std::memory_order_relaxed); }
+
+    // Write the latest state of the event's track. `key` needs its uid, and its point
+    // and callsign if they should be kept. Returns false if the snapshot is closed or
+    // full, or the uid doesn't fit a record.
+    bool update(const CotEventKey& key, int64_t now_ms);
+
+    // Forget the track for `uid` (raw attribute value)
+    void remove(const char* uid, size_t uid_length);
+
+    // Append every track in the snapshot to `out`
+    void tracks(std::vector<Track>& out);
+
+    // Empty the snapshot, keeping the file open
+    void clear();
+
+    size_t size();
+
+private:
+    uint32_t allocate_slot_locked();
+
+    const size_t capacity_;
+    std::atomic<bool> open_{false};
+
+    std::mutex mutex_;
+    int fd_ = -1;
+    uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+    CotSnapshotHeader* header_ = nullptr;
+    CotSnapshotRecord* records_ = nullptr;
+    std::unordered_map<uint64_t, uint32_t> slots_; // uid key -> slot
+    std::vector<uint32_t> free_slots_;             // Emptied slots below high_water
+    bool full_logged_ = false;
+};
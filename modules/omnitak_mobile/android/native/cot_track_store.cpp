@@ -0,0 +1,195 @@
+/**
+ * cot_track_store.cpp - Native track store with stale-time expiry
+ */
+
+#include "cot_track_store.h"
+
+#include <cstring>
+#include <android/log.h>
+
+#define LOG_TAG "OmniTAK-JNI"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+// 64-bit FNV-1a of the uid; the uid itself is kept to detect collisions
+static uint64_t uid_key(const char* uid, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)uid[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+constexpr double CotTrackStore::kIndexCellDegrees;
+
+bool CotTrackStore::update(const char* uid, size_t uid_length, int64_t stale_ms,
+                           bool has_position, double lat, double lon, int64_t now_ms) {
+    uint64_t key = uid_key(uid, uid_length);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = tracks_.find(key);
+    if (it == tracks_.end()) {
+        if (tracks_.size() >= max_tracks_) {
+            if (!full_logged_) {
+                LOGW("Track store full (%zu tracks), not tracking new uids", tracks_.size());
+                full_logged_ = true;
+            }
+            return false;
+        }
+        it = tracks_.emplace(key, Track()).first;
+        it->second.uid.assign(uid, uid_length);
+    } else if (it->second.uid.size() != uid_length ||
+               memcmp(it->second.uid.data(), uid, uid_length) != 0) {
+        return false; // Hash collision with another uid
+    }
+
+    Track& track = it->second;
+    if (has_position) {
+        index_.insert(key, lat, lon);
+        if (clustering_) {
+            if (track.has_position) {
+                clusters_.move(key, track.lat, track.lon, lat, lon);
+            } else {
+                clusters_.add(key, lat, lon);
+            }
+        }
+        track.has_position = true;
+        track.lat = lat;
+        track.lon = lon;
+    }
+
+    if (stale_ms <= 0) {
+        stale_ms = now_ms + default_ttl_ms_;
+    }
+
+    // Rebroadcasts of the same event keep their current heap entry
+    if (track.stale_ms == stale_ms) {
+        return true;
+    }
+    track.stale_ms = stale_ms;
+    ++track.generation;
+    heap_.push({stale_ms, key, track.generation});
+
+    // Superseded entries stay in the heap until popped; rebuild once they dominate
+    if (heap_.size() > tracks_.size() * 2 + 1024) {
+        compact_locked();
+    }
+    return true;
+}
+
+void CotTrackStore::take_expired(int64_t now_ms, std::vector<Expired>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    while (!heap_.empty() && heap_.top().stale_ms <= now_ms) {
+        HeapEntry entry = heap_.top();
+        heap_.pop();
+
+        auto it = tracks_.find(entry.key);
+        if (it == tracks_.end() || it->second.generation != entry.generation) {
+            continue; // Superseded by a newer stale time
+        }
+
+        if (it->second.has_position) {
+            index_.remove(entry.key);
+            if (clustering_) {
+                clusters_.remove(entry.key, it->second.lat, it->second.lon);
+            }
+        }
+        out.push_back({std::move(it->second.uid), it->second.stale_ms});
+        tracks_.erase(it);
+    }
+
+    if (tracks_.size() < max_tracks_) {
+        full_logged_ = false;
+    }
+}
+
+void CotTrackStore::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tracks_.clear();
+    heap_ = std::priority_queue<HeapEntry>();
+    index_.clear();
+    clusters_.clear();
+    full_logged_ = false;
+}
+
+size_t CotTrackStore::query_region(double min_lat, double min_lon, double max_lat, double max_lon,
+                                   size_t limit, std::vector<Position>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t matched = 0;
+    index_.query(min_lat, min_lon, max_lat, max_lon, [&](uint64_t key, double lat, double lon) {
+        if (matched++ < limit) {
+            out.push_back({tracks_[key].uid, lat, lon});
+        }
+        return true;
+    });
+    return matched;
+}
+
+void CotTrackStore::set_clustering(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enabled == clustering_) {
+        return;
+    }
+
+    clustering_ = enabled;
+    clusters_.clear();
+    if (enabled) {
+        for (const auto& pair : tracks_) {
+            if (pair.second.has_position) {
+                clusters_.add(pair.first, pair.second.lat, pair.second.lon);
+            }
+        }
+    }
+}
+
+size_t CotTrackStore::query_clusters(int zoom, double min_lat, double min_lon, double max_lat, double max_lon,
+                                     size_t limit, std::vector<Cluster>& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t matched = 0;
+    if (zoom > CotClusterIndex::kMaxZoom) {
+        index_.query(min_lat, min_lon, max_lat, max_lon, [&](uint64_t key, double lat, double lon) {
+            if (matched++ < limit) {
+                out.push_back({tracks_[key].uid, lat, lon, 1});
+            }
+            return true;
+        });
+        return matched;
+    }
+
+    std::vector<CotClusterIndex::Cluster> clusters;
+    matched = clusters_.query(zoom, min_lat, min_lon, max_lat, max_lon, limit, clusters);
+    for (const CotClusterIndex::Cluster& cluster : clusters) {
+        auto it = cluster.count == 1 ? tracks_.find(cluster.key) : tracks_.end();
+        if (it != tracks_.end()) {
+            // Report the exact position rather than the running centroid
+            out.push_back({it->second.uid, it->second.lat, it->second.lon, 1});
+        } else {
+            out.push_back({std::string(), cluster.lat, cluster.lon, cluster.count});
+        }
+    }
+    return matched;
+}
+
+int CotTrackStore::cluster_expansion_zoom(int zoom, double lat, double lon) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return clusters_.expansion_zoom(zoom, lat, lon);
+}
+
+size_t CotTrackStore::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tracks_.size();
+}
+
+// Rebuild the heap from the live tracks only. Called with mutex_ held.
+void CotTrackStore::compact_locked() {
+    std::vector<HeapEntry> entries;
+    entries.reserve(tracks_.size());
+    for (const auto& pair : tracks_) {
+        entries.push_back({pair.second.stale_ms, pair.first, pair.second.generation});
+    }
+    heap_ = std::priority_queue<HeapEntry>(std::less<HeapEntry>(), std::move(entries));
+}
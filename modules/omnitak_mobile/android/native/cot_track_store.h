@@ -0,0 +1,132 @@
+/**
+ * cot_track_store.h - Native track store with stale-time expiry
+ *
+ * Every inbound event with a uid and a stale time or position updates one
+ * track. A min-heap ordered by stale time lets the bridge find expired
+ * tracks in O(log n) per expiry, so consumers get a short "expired" list
+ * instead of scanning all their markers every tick. Positions are kept in
+ * a CotSpatialIndex for viewport queries and, while clustering is enabled,
+ * in a CotClusterIndex for per-zoom clusters.
+ *
+ * Events without a stale time (0) get one default_ttl_ms after the update
+ * that carried them, so a track whose sender stops without marking it stale
+ * still expires.
+ *
+ * Heap entries are never updated in place: a newer stale time pushes a new
+ * entry and bumps the track's generation, and entries with an old generation
+ * are skipped when popped. The heap is rebuilt when such entries pile up.
+ *
+ * Shared by all connections; all methods are thread-safe.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cot_cluster_index.h"
+#include "cot_spatial_index.h"
+
+class CotTrackStore {
+public:
+    struct Expired {
+        std::string uid;
+        int64_t stale_ms;
+    };
+
+    struct Position {
+        std::string uid;
+        double lat;
+        double lon;
+    };
+
+    // A single track is reported with count 1 and its uid; clusters have no uid
+    struct Cluster {
+        std::string uid;
+        double lat;
+        double lon;
+        uint32_t count;
+    };
+
+    static constexpr double kIndexCellDegrees = 0.25;
+
+    CotTrackStore(size_t max_tracks, int64_t default_ttl_ms)
+        : max_tracks_(max_tracks), default_ttl_ms_(default_ttl_ms > 0 ? default_ttl_ms : 1), index_(kIndexCellDegrees) {}
+
+    CotTrackStore(const CotTrackStore&) = delete;
+    CotTrackStore& operator=(const CotTrackStore&) = delete;
+
+    void set_enabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Record the latest stale time and position for `uid` (raw attribute value, see
+    // cot_parse_key). A stale time of 0 means now_ms + default_ttl_ms. Returns false
+    // if the store is full.
+    bool update(const char* uid, size_t uid_length, int64_t stale_ms,
+                bool has_position, double lat, double lon, int64_t now_ms);
+
+    // Append up to `limit` tracks inside the box to `out` and return how many tracks
+    // the box holds in total. min_lon > max_lon wraps across the antimeridian.
+    size_t query_region(double min_lat, double min_lon, double max_lat, double max_lon,
+                        size_t limit, std::vector<Position>& out);
+
+    // Maintain per-zoom clusters of the indexed positions. Enabling builds them from
+    // the current tracks once; after that every update adjusts them incrementally.
+    void set_clustering(bool enabled);
+
+    // Append up to `limit` clusters at `zoom` overlapping the box and return how many
+    // there are in total. Above CotClusterIndex::kMaxZoom every track is its own cluster.
+    size_t query_clusters(int zoom, double min_lat, double min_lon, double max_lat, double max_lon,
+                          size_t limit, std::vector<Cluster>& out);
+
+    // Zoom at which the cluster at (lat, lon) on `zoom` splits up
+    int cluster_expansion_zoom(int zoom, double lat, double lon);
+
+    // Remove every track whose stale time (given or defaulted) is at or before `now_ms`
+    // and append it to `out`
+    void take_expired(int64_t now_ms, std::vector<Expired>& out);
+
+    // Forget all tracks
+    void clear();
+
+    size_t size();
+
+private:
+    struct Track {
+        std::string uid;
+        int64_t stale_ms = 0;
+        uint32_t generation = 0;
+        bool has_position = false;
+        double lat = 0;
+        double lon = 0;
+    };
+
+    struct HeapEntry {
+        int64_t stale_ms;
+        uint64_t key;
+        uint32_t generation;
+
+        // std::priority_queue is a max-heap; invert so the earliest stale time is on top
+        bool operator<(const HeapEntry& other) const { return stale_ms > other.stale_ms; }
+    };
+
+    void compact_locked();
+
+    const size_t max_tracks_;
+    const int64_t default_ttl_ms_;
+    std::atomic<bool> enabled_{false};
+
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, Track> tracks_;
+    std::priority_queue<HeapEntry> heap_;
+    CotSpatialIndex index_;
+    CotClusterIndex clusters_;
+    bool clustering_ = false;
+    bool full_logged_ = false;
+};
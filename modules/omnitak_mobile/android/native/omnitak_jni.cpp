@@ -10,11 +10,35 @@
  */
 
 #include <jni.h>
+#include <cmath>
+#include <cstring>
 #include <string>
-#include <map>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <pthread.h>
 #include <android/log.h>
 
+#include "connection_table.h"
+#include "cot_backoff.h"
+#include "cot_batch_buffer.h"
+#include "cot_certificate_store.h"
+#include "cot_coalescer.h"
+#include "cot_connection_stats.h"
+#include "cot_fan_in.h"
+#include "cot_inbound.h"
+#include "cot_outbound_queue.h"
+#include "cot_parser.h"
+#include "cot_priority.h"
+#include "cot_slab_pool.h"
+#include "cot_track_snapshot.h"
+#include "cot_track_store.h"
+#include "cot_trace.h"
+
 // Import the C FFI header from Rust
 extern "C" {
     #include "omnitak_mobile.h"
@@ -28,14 +52,268 @@ extern "C" {
 
 // Global state for callback management
 struct CallbackContext {
-    JavaVM* jvm;
     jobject bridge_instance; // Global reference to OmniTAKNativeBridge instance
+    std::unique_ptr<CotBatchBuffer> batch; // Null for unbatched String delivery
+    int delivery_mode = 0; // One of kDeliveryMode*
 };
 
-static std::map<uint64_t, CallbackContext> g_callbacks;
-static std::mutex g_callbacks_mutex;
+// Connection id -> callback context. Lookups from Rust I/O threads are wait-free;
+// contexts may only be used inside a ConnectionTable::ReadGuard.
+using CallbackTable = ConnectionTable<CallbackContext>;
+static CallbackTable g_callbacks;
 static JavaVM* g_jvm = nullptr;
 
+// Connection id -> throughput/latency counters, from connect until nativeDisconnect.
+// Kept apart from the callback contexts so they cover sends and survive re-registration.
+using StatsTable = ConnectionTable<CotConnectionStats>;
+static StatsTable g_stats;
+
+// Uid -> stale time and position for every tracked event across all connections.
+// Expired tracks are reported to g_expiry_listener (a global ref to the bridge) by the
+// flush thread. g_expiry_mutex guards only the listener: the upcall runs unlocked, on a
+// local ref taken under it. The store runs while expiry reporting or the spatial index
+// is enabled.
+static const size_t kMaxTracks = 16384;
+static const int64_t kDefaultTrackTtlMs = 10 * 60 * 1000; // Events that carry no stale time
+static CotTrackStore g_track_store(kMaxTracks, kDefaultTrackTtlMs);
+static const int kExpiryTickMs = 1000;
+static std::mutex g_expiry_mutex;
+static jobject g_expiry_listener = nullptr;
+static std::atomic<bool> g_expiry_enabled{false};
+static std::atomic<bool> g_index_enabled{false};
+static std::atomic<bool> g_cluster_enabled{false};
+
+// Uid -> last known type, callsign, position and stale time, mapped from the file given
+// to nativeInit. Follows the track store, which runs while the snapshot is open.
+static CotTrackSnapshot g_track_snapshot(kMaxTracks);
+
+// Inbound priority lanes: events whose CotPriority is at or above this (numerically <=)
+// skip coalescing and batching and go straight to onCotPriority. -1 disables lanes.
+static std::atomic<int> g_urgent_priority{-1};
+// Whether Kotlin has a lane callback. Without one, urgent events on slab and parsed
+// connections stay on their normal path, since onCotPriority has nothing to hand them to.
+static std::atomic<bool> g_priority_callback{false};
+
+// Fan-in: while enabled, every connection is registered with Rust and its events are
+// merged into g_fan_in, deduplicated across connections, and delivered in arrival order
+// through onCotFanIn on g_fan_in_listener by the flush thread, in place of the
+// per-connection callbacks. g_fan_in_mutex guards only the listener, as g_expiry_mutex
+// does: a toggle racing with an upcall may let one more batch reach Kotlin, which drops
+// it once its callback is cleared.
+static const size_t kFanInQueueCapacity = 4096;
+static const int kMaxFanInWindowMs = 300000;
+static CotFanIn g_fan_in(kFanInQueueCapacity);
+static std::mutex g_fan_in_mutex;
+static jobject g_fan_in_listener = nullptr;
+static std::atomic<bool> g_fan_in_enabled{false};
+
+// JNI class/method IDs resolved once in JNI_OnLoad.
+// Method IDs stay valid for as long as the class is loaded, which we guarantee
+// by holding a global reference to the class.
+static jclass g_bridge_class = nullptr;
+static jmethodID g_on_cot_received = nullptr;
+static jmethodID g_on_cot_batch = nullptr;
+static jmethodID g_on_cot_slab = nullptr;
+static jmethodID g_on_cot_events = nullptr;
+static jmethodID g_on_cot_expired = nullptr;
+static jmethodID g_on_connect_complete = nullptr;
+static jmethodID g_on_cot_priority = nullptr;
+static jmethodID g_on_cot_fan_in = nullptr;
+static jclass g_string_class = nullptr;
+static jclass g_status_class = nullptr;
+static jmethodID g_status_constructor = nullptr;
+static jclass g_clusters_class = nullptr;
+static jmethodID g_clusters_constructor = nullptr;
+static jclass g_snapshot_class = nullptr;
+static jmethodID g_snapshot_constructor = nullptr;
+
+// Thread-local key used to detach Rust worker threads from the JVM when they exit.
+// Threads are attached on their first callback and stay attached for their lifetime.
+static pthread_key_t g_env_key;
+
+static void detach_thread_destructor(void* value) {
+    if (value && g_jvm) {
+        LOGD("Detaching native thread from JVM");
+        g_jvm->DetachCurrentThread();
+    }
+}
+
+// Helper: Get a JNIEnv for the current thread, attaching it permanently if needed
+static JNIEnv* get_jni_env() {
+    JNIEnv* env = nullptr;
+    int getEnvStat = g_jvm->GetEnv((void**)&env, JNI_VERSION_1_6);
+
+    if (getEnvStat == JNI_OK) {
+        return env;
+    }
+
+    if (getEnvStat != JNI_EDETACHED) {
+        LOGE("Failed to get JNI environment");
+        return nullptr;
+    }
+
+    LOGD("Attaching native thread to JVM");
+    if (g_jvm->AttachCurrentThread(&env, nullptr) != 0) {
+        LOGE("Failed to attach to JVM");
+        return nullptr;
+    }
+
+    // Register the env so the key destructor detaches this thread on exit
+    pthread_setspecific(g_env_key, env);
+    return env;
+}
+
+// Error codes returned by the bridge itself when a call is rejected before reaching Rust
+static const jint kErrorInvalidArgument = -1;
+static const jint kErrorRegistryFull = -2;
+static const jint kErrorQueueFull = -3;     // Reconnecting, and the message's outbound lane is full
+static const jint kErrorNotConnected = -4;  // Reconnecting, and the message isn't queued (pings)
+
+// Batched delivery limits
+static const int kMaxBatchSize = 1024;
+static const int kMinFlushIntervalMs = 1;
+
+// Delivery modes accepted by nativeRegisterCallback
+static const int kDeliveryModeString = 0; // String / String[] upcalls
+static const int kDeliveryModeDirect = 1; // Raw slabs as direct ByteBuffers
+static const int kDeliveryModeParsed = 2; // Natively parsed CotEventRecords plus the raw slab
+
+// Shared pool of native slabs backing batched and direct delivery.
+// Slabs handed to Kotlin stay checked out until nativeReleaseSlab. Each batched
+// registration tops the free list up to kReservedSlabs, so a connection's first
+// messages reuse slabs too.
+static const size_t kSlabSize = 64 * 1024;
+static const size_t kMaxSlabs = 64;
+static const size_t kReservedSlabs = 4;
+static CotSlabPool g_slab_pool(kSlabSize, kMaxSlabs);
+
+// Optional de-duplication/coalescing of inbound events by uid, shared by all connections
+static const int kMaxCoalesceWindowMs = 10000;
+static CotCoalescer g_coalescer;
+
+// Background thread that flushes batches whose flush interval has elapsed
+static std::thread g_flush_thread;
+static std::mutex g_flush_mutex;
+static std::condition_variable g_flush_cv;
+static bool g_flush_running = false;
+static std::atomic<int> g_flush_tick_ms{1000};
+
+// Connects started by nativeConnectAsync. Each runs the blocking omnitak_connect
+// (TCP plus any TLS handshake) on its own thread, so several servers come up in
+// parallel; nativeShutdown waits for any still in flight before shutting Rust down.
+struct PendingConnect {
+    jlong pending_id;
+    jobject bridge_instance; // Global ref, released after the completion upcall
+    std::string host;
+    uint16_t port;
+    int32_t protocol;
+    bool use_tls;
+    std::shared_ptr<const CotCertificate> certificate; // Null without a client certificate
+    bool reconnect;
+    uint32_t reconnect_delay_ms; // Base delay of the reconnect backoff
+};
+static std::atomic<jlong> g_next_pending_connect{1};
+static std::mutex g_connect_mutex;
+static std::condition_variable g_connect_cv;
+static int g_connects_in_flight = 0;
+// Bridge refs of connects whose thread couldn't get a JNIEnv to release them; the next
+// nativeConnectAsync or nativeShutdown deletes them. Guarded by g_connect_mutex.
+static std::vector<jobject> g_orphaned_refs;
+
+// Helper: Delete the refs g_orphaned_refs collected. Call with g_connect_mutex held.
+static void release_orphaned_refs(JNIEnv* env) {
+    for (jobject ref : g_orphaned_refs) {
+        env->DeleteGlobalRef(ref);
+    }
+    g_orphaned_refs.clear();
+}
+
+// Client certificates imported through nativeImportCertificate, referred to by handle on connect
+static CotCertificateStore g_certificates;
+
+// Reconnect supervision limits
+static const uint32_t kMinReconnectDelayMs = 100;
+static const uint32_t kMaxReconnectDelayMs = 60000;
+static const int kReconnectTickMs = 250;
+static const int kHealthCheckIntervalMs = 1000;
+static const size_t kOutboundLaneCapacity = 256;
+
+// A connection opened with reconnect enabled. Kotlin keeps using the id of the first
+// connect; `rust_id` follows each reconnect. When a send fails or the health check finds
+// the connection down, sends are queued and the reconnect thread retries with jittered
+// backoff. Once connected again the callback is re-registered and the queue is flushed.
+// Sends never hold the mutex (or a table guard): a send may block on the socket.
+struct ReconnectLink {
+    ReconnectLink(const PendingConnect& connect_args, uint64_t connection_id)
+        : args(connect_args),
+          rust_id(connection_id),
+          backoff(connect_args.reconnect_delay_ms, kMaxReconnectDelayMs,
+                  connection_id ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count()),
+          queue(kOutboundLaneCapacity) {
+        args.bridge_instance = nullptr;
+    }
+
+    PendingConnect args;
+    std::mutex mutex;            // Guards everything below
+    uint64_t rust_id;            // Current Rust connection; dead while !up
+    uint64_t stale_id = 0;      // Dead Rust connection still to be disconnected
+    bool up = true;
+    bool flushing = false;       // The queue is being sent; new sends queue behind it
+    bool attempting = false;     // A reconnect attempt is running
+    bool callback_registered = false;
+    CotBackoff backoff;
+    std::chrono::steady_clock::time_point next_attempt;
+    CotOutboundQueue queue;
+    uint64_t reconnects = 0;
+};
+
+using LinkTable = ConnectionTable<ReconnectLink>;
+static LinkTable g_links;
+
+// Background thread that health-checks links and starts reconnect attempts
+static std::thread g_reconnect_thread;
+static std::mutex g_reconnect_mutex;
+static std::condition_variable g_reconnect_cv;
+static bool g_reconnect_running = false;
+
+// Helper: Take a local ref to a listener global ref under the mutex guarding it, so the
+// upcall itself runs unlocked and doesn't serialize other threads or block the setter.
+// Null when no listener is set; otherwise the caller deletes the local ref.
+static jobject listener_local_ref(JNIEnv* env, std::mutex& mutex, const jobject& listener) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return listener ? env->NewLocalRef(listener) : nullptr;
+}
+
+// Helper: Run `update` on a connection's counters, if it has any
+template <typename Update>
+static void update_stats(uint64_t connection_id, Update update) {
+    StatsTable::ReadGuard guard(g_stats);
+    CotConnectionStats* stats = g_stats.find(connection_id);
+    if (stats) {
+        update(*stats);
+    }
+}
+
+// Helper: Record how long an upcall into Kotlin that began at `start` took
+static void record_upcall(uint64_t connection_id, CotConnectionStats::Clock::time_point start) {
+    CotConnectionStats::Clock::duration elapsed = CotConnectionStats::Clock::now() - start;
+    update_stats(connection_id, [&](CotConnectionStats& stats) { stats.record_upcall(elapsed); });
+}
+
+// Helper: Connection id passed to Rust as callback user_data. A reconnected connection
+// calls back with its new Rust id; user_data carries the id Kotlin knows it by. Null
+// (where a pointer can't hold the id) falls back to the Rust id.
+static void* connection_user_data(uint64_t connection_id) {
+    uintptr_t data = (uintptr_t)connection_id;
+    return (uint64_t)data == connection_id ? (void*)data : nullptr;
+}
+
+// Helper: Compare a raw CoT type attribute
+static bool cot_type_is(const CotEventKey& key, const char* type) {
+    size_t length = strlen(type);
+    return key.type && key.type_length == length && memcmp(key.type, type, length) == 0;
+}
+
 // Helper: Convert JNI string to C++ string
 static std::string jstring_to_string(JNIEnv* env, jstring jstr) {
     if (!jstr) return "";
@@ -52,66 +330,210 @@ static jstring string_to_jstring(JNIEnv* env, const char* str) {
     return env->NewStringUTF(str);
 }
 
-// C callback function that bridges to Java/Kotlin
-static void cot_callback_bridge(void* user_data, uint64_t connection_id, const char* cot_xml) {
-    LOGD("CoT callback triggered for connection %llu", (unsigned long long)connection_id);
+// Hand each slab to Kotlin as a direct ByteBuffer. Kotlin releases it with nativeReleaseSlab.
+static void deliver_cot_slabs(JNIEnv* env, uint64_t connection_id, const CallbackContext& context,
+                              const std::vector<CotSlab*>& slabs) {
+    for (CotSlab* slab : slabs) {
+        jobject jBuffer = env->NewDirectByteBuffer(slab->data.get(), (jlong)slab->used());
+        if (!jBuffer) {
+            LOGE("Failed to wrap CoT slab %u", slab->id);
+            env->ExceptionClear();
+            g_slab_pool.release(slab->id);
+            continue;
+        }
 
-    // Get callback context
-    CallbackContext context;
-    {
-        std::lock_guard<std::mutex> lock(g_callbacks_mutex);
-        auto it = g_callbacks.find(connection_id);
-        if (it == g_callbacks.end()) {
-            LOGE("No callback context found for connection %llu", (unsigned long long)connection_id);
-            return;
+        auto start = CotConnectionStats::Clock::now();
+        env->CallVoidMethod(
+            context.bridge_instance,
+            g_on_cot_slab,
+            (jlong)connection_id,
+            (jint)slab->id,
+            jBuffer
+        );
+        record_upcall(connection_id, start);
+
+        if (env->ExceptionCheck()) {
+            // Kotlin never took ownership, so the slab comes back to us
+            LOGE("Exception occurred in onCotSlab");
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+            g_slab_pool.release(slab->id);
         }
-        context = it->second;
+
+        env->DeleteLocalRef(jBuffer);
     }
+}
 
-    // Attach to JVM (this might be called from a native thread)
-    JNIEnv* env = nullptr;
-    int getEnvStat = context.jvm->GetEnv((void**)&env, JNI_VERSION_1_6);
-    bool needDetach = false;
+// Parse every entry of each slab into CotEventRecords and hand both the records and
+// the raw XML slab to Kotlin. The XML stays in native memory, so consumers that only
+// need the parsed fields never decode it. Kotlin releases the slab (and its records).
+static void deliver_cot_events(JNIEnv* env, uint64_t connection_id, const CallbackContext& context,
+                               const std::vector<CotSlab*>& slabs) {
+    for (CotSlab* slab : slabs) {
+        if (g_slab_pool.ensure_records(slab)) {
+            update_stats(connection_id, [](CotConnectionStats& stats) {
+                stats.record_allocation(kSlabMaxEntries * sizeof(CotEventRecord));
+            });
+        }
 
-    if (getEnvStat == JNI_EDETACHED) {
-        LOGD("Attaching to JVM for callback");
-        if (context.jvm->AttachCurrentThread(&env, nullptr) != 0) {
-            LOGE("Failed to attach to JVM");
-            return;
+        uint32_t entries = slab->count();
+        for (uint32_t i = 0; i < entries; ++i) {
+            if (!cot_parse_event(slab->entry(i), slab->entry_length(i), &slab->records[i])) {
+                LOGD("Entry %u of slab %u is not a CoT event", i, slab->id);
+            }
+        }
+
+        jobject jRecords = env->NewDirectByteBuffer(slab->records.get(),
+                                                    (jlong)(entries * sizeof(CotEventRecord)));
+        jobject jXml = jRecords ? env->NewDirectByteBuffer(slab->data.get(), (jlong)slab->used()) : nullptr;
+        if (!jXml) {
+            LOGE("Failed to wrap parsed CoT slab %u", slab->id);
+            env->ExceptionClear();
+            if (jRecords) {
+                env->DeleteLocalRef(jRecords);
+            }
+            g_slab_pool.release(slab->id);
+            continue;
+        }
+
+        auto start = CotConnectionStats::Clock::now();
+        env->CallVoidMethod(
+            context.bridge_instance,
+            g_on_cot_events,
+            (jlong)connection_id,
+            (jint)slab->id,
+            jRecords,
+            jXml
+        );
+        record_upcall(connection_id, start);
+
+        if (env->ExceptionCheck()) {
+            LOGE("Exception occurred in onCotEvents");
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+            g_slab_pool.release(slab->id);
+        }
+
+        env->DeleteLocalRef(jXml);
+        env->DeleteLocalRef(jRecords);
+    }
+}
+
+// Convert slab entries into a String[] for onCotBatch and recycle the slabs
+static void deliver_cot_strings(JNIEnv* env, uint64_t connection_id, const CallbackContext& context,
+                                const std::vector<CotSlab*>& slabs, size_t count) {
+    jobjectArray jBatch = env->NewObjectArray((jsize)count, g_string_class, nullptr);
+    if (!jBatch) {
+        LOGE("Failed to allocate CoT batch array");
+        env->ExceptionClear();
+        for (CotSlab* slab : slabs) {
+            g_slab_pool.release(slab->id);
         }
-        needDetach = true;
-    } else if (getEnvStat != JNI_OK) {
-        LOGE("Failed to get JNI environment");
         return;
     }
 
-    // Get the OmniTAKNativeBridge class and onCotReceived method
-    jclass bridgeClass = env->GetObjectClass(context.bridge_instance);
-    jmethodID onCotReceivedMethod = env->GetMethodID(
-        bridgeClass,
-        "onCotReceived",
-        "(JLjava/lang/String;)V"
+    jsize index = 0;
+    for (CotSlab* slab : slabs) {
+        uint32_t entries = slab->count();
+        for (uint32_t i = 0; i < entries && index < (jsize)count; ++i) {
+            // Slab entries are NUL-terminated, so no intermediate copy is needed
+            jstring jCotXml = string_to_jstring(env, slab->entry(i));
+            env->SetObjectArrayElement(jBatch, index++, jCotXml);
+            env->DeleteLocalRef(jCotXml);
+        }
+        g_slab_pool.release(slab->id);
+    }
+
+    auto start = CotConnectionStats::Clock::now();
+    env->CallVoidMethod(
+        context.bridge_instance,
+        g_on_cot_batch,
+        (jlong)connection_id,
+        jBatch
     );
+    record_upcall(connection_id, start);
 
-    if (!onCotReceivedMethod) {
-        LOGE("Failed to find onCotReceived method");
-        env->DeleteLocalRef(bridgeClass);
-        if (needDetach) {
-            context.jvm->DetachCurrentThread();
+    if (env->ExceptionCheck()) {
+        LOGE("Exception occurred in onCotBatch");
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+
+    env->DeleteLocalRef(jBatch);
+}
+
+// Deliver all pending messages of a batched connection
+static void flush_cot_batch(JNIEnv* env, uint64_t connection_id, const CallbackContext& context) {
+    CotBatchBuffer& batch = *context.batch;
+    std::lock_guard<std::mutex> flushLock(batch.flush_mutex());
+
+    std::vector<CotSlab*>& slabs = batch.flush_scratch();
+    size_t count = batch.drain(slabs);
+    if (slabs.empty()) {
+        return;
+    }
+
+    LOGD("Flushing %zu CoT messages for connection %llu", count, (unsigned long long)connection_id);
+    COT_TRACE_SCOPE("cot_flush_batch");
+
+    switch (context.delivery_mode) {
+        case kDeliveryModeDirect:
+            deliver_cot_slabs(env, connection_id, context, slabs);
+            break;
+        case kDeliveryModeParsed:
+            deliver_cot_events(env, connection_id, context, slabs);
+            break;
+        default:
+            deliver_cot_strings(env, connection_id, context, slabs, count);
+            break;
+    }
+}
+
+// Hand one inbound message to a connection's delivery path. `cot_xml` must be NUL-terminated.
+// Must be called inside a ReadGuard on g_callbacks.
+static void deliver_cot(uint64_t connection_id, CallbackContext& context, const char* cot_xml, size_t length) {
+    // Batched connections only cross into Kotlin once the batch is full;
+    // the flush thread picks up partial batches after the flush interval
+    if (context.batch) {
+        bool dropped = false;
+        bool allocated = false;
+        bool full = context.batch->push(cot_xml, length, &dropped, &allocated);
+        if (dropped) {
+            update_stats(connection_id, [](CotConnectionStats& stats) { stats.record_dropped(); });
+        }
+        if (allocated) {
+            size_t needed = kSlabPayloadOffset + length + 1;
+            size_t bytes = needed > g_slab_pool.slab_size() ? needed : g_slab_pool.slab_size();
+            update_stats(connection_id, [&](CotConnectionStats& stats) { stats.record_allocation(bytes); });
+        }
+        if (!full) {
+            return;
+        }
+        JNIEnv* env = get_jni_env();
+        if (env) {
+            flush_cot_batch(env, connection_id, context);
         }
         return;
     }
 
+    // Rust worker threads stay attached after their first callback
+    JNIEnv* env = get_jni_env();
+    if (!env) {
+        return;
+    }
+
     // Convert C string to JNI string
     jstring jCotXml = string_to_jstring(env, cot_xml);
 
     // Call the Kotlin callback method
+    auto start = CotConnectionStats::Clock::now();
     env->CallVoidMethod(
         context.bridge_instance,
-        onCotReceivedMethod,
+        g_on_cot_received,
         (jlong)connection_id,
         jCotXml
     );
+    record_upcall(connection_id, start);
 
     // Check for exceptions
     if (env->ExceptionCheck()) {
@@ -122,199 +544,1849 @@ static void cot_callback_bridge(void* user_data, uint64_t connection_id, const c
 
     // Cleanup
     env->DeleteLocalRef(jCotXml);
-    env->DeleteLocalRef(bridgeClass);
+}
 
-    if (needDetach) {
-        context.jvm->DetachCurrentThread();
+// Hand an urgent event to onCotPriority on the calling Rust thread, ahead of anything
+// batched or held for this connection. `cot_xml` must be NUL-terminated.
+static void deliver_cot_priority(uint64_t connection_id, jobject bridge_instance,
+                                 CotPriority priority, const char* cot_xml) {
+    JNIEnv* env = get_jni_env();
+    if (!env) {
+        return;
     }
-}
 
-// JNI_OnLoad - Called when library is loaded
-JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
-    LOGI("JNI_OnLoad called");
-    g_jvm = vm;
-    return JNI_VERSION_1_6;
-}
+    jstring jCotXml = string_to_jstring(env, cot_xml);
 
-// Native method implementations
+    auto start = CotConnectionStats::Clock::now();
+    env->CallVoidMethod(
+        bridge_instance,
+        g_on_cot_priority,
+        (jlong)connection_id,
+        (jint)priority,
+        jCotXml
+    );
+    record_upcall(connection_id, start);
 
-extern "C" JNIEXPORT jint JNICALL
-Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeInit(
-    JNIEnv* env,
-    jobject thiz
-) {
-    LOGI("nativeInit called");
-    int32_t result = omnitak_init();
-    LOGI("omnitak_init returned %d", result);
-    return (jint)result;
-}
+    if (env->ExceptionCheck()) {
+        LOGE("Exception occurred in onCotPriority");
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
 
-extern "C" JNIEXPORT void JNICALL
-Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeShutdown(
-    JNIEnv* env,
-    jobject thiz
-) {
-    LOGI("nativeShutdown called");
+    env->DeleteLocalRef(jCotXml);
+}
 
-    // Clean up all callbacks
-    {
-        std::lock_guard<std::mutex> lock(g_callbacks_mutex);
-        for (auto& pair : g_callbacks) {
-            env->DeleteGlobalRef(pair.second.bridge_instance);
+// Helper: Queue an event admitted by the fan-in for the next onCotFanIn upcall. Urgent
+// events (see g_urgent_priority) skip the queue and go out at once.
+static void queue_fan_in(uint64_t connection_id, const CotEventKey* key, const char* cot_xml,
+                         size_t length, int urgent_priority) {
+    if (key && urgent_priority >= 0) {
+        CotPriority priority = cot_classify(key->type, key->type_length);
+        if ((int)priority <= urgent_priority) {
+            JNIEnv* env = get_jni_env();
+            jobject listener = env ? listener_local_ref(env, g_fan_in_mutex, g_fan_in_listener) : nullptr;
+            if (listener) {
+                deliver_cot_priority(connection_id, listener, priority, cot_xml);
+                env->DeleteLocalRef(listener);
+            }
+            return;
         }
-        g_callbacks.clear();
     }
 
-    omnitak_shutdown();
-    LOGI("Shutdown complete");
+    uint64_t droppedSource = 0;
+    if (!g_fan_in.push(connection_id, cot_xml, length, &droppedSource)) {
+        update_stats(droppedSource, [](CotConnectionStats& dropped) { dropped.record_dropped(); });
+    }
 }
 
-extern "C" JNIEXPORT jlong JNICALL
-Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeConnect(
-    JNIEnv* env,
-    jobject thiz,
-    jstring host,
-    jint port,
-    jint protocol,
-    jboolean useTls,
-    jstring certPem,
-    jstring keyPem,
-    jstring caPem
-) {
-    LOGI("nativeConnect called");
-
-    // Convert strings
-    std::string hostStr = jstring_to_string(env, host);
-    const char* certPemStr = certPem ? jstring_to_string(env, certPem).c_str() : nullptr;
-    const char* keyPemStr = keyPem ? jstring_to_string(env, keyPem).c_str() : nullptr;
-    const char* caPemStr = caPem ? jstring_to_string(env, caPem).c_str() : nullptr;
-
-    LOGI("Connecting to %s:%d (protocol=%d, tls=%d)",
-         hostStr.c_str(), (int)port, (int)protocol, (int)useTls);
-
-    uint64_t connection_id = omnitak_connect(
-        hostStr.c_str(),
-        (uint16_t)port,
-        (int32_t)protocol,
-        useTls ? 1 : 0,
-        certPemStr,
-        keyPemStr,
-        caPemStr
-    );
+// Deliver coalesced events whose window has elapsed. Only called from the flush thread.
+static void deliver_coalesced(CotCoalescer::Clock::time_point now) {
+    // Entries keep their buffers between ticks; take_due swaps them with the held events
+    static std::vector<CotCoalescer::Pending> due;
+    size_t count = g_coalescer.take_due(now, due);
+    if (count == 0) {
+        return;
+    }
 
-    if (connection_id > 0) {
-        LOGI("Connected successfully: %llu", (unsigned long long)connection_id);
-    } else {
-        LOGE("Connection failed");
+    CallbackTable::ReadGuard guard(g_callbacks);
+    for (size_t i = 0; i < count; ++i) {
+        CotCoalescer::Pending& pending = due[i];
+        // The connection may have gone away while the event was held
+        CallbackContext* context = g_callbacks.find(pending.connection_id);
+        if (context) {
+            deliver_cot(pending.connection_id, *context, pending.xml.c_str(), pending.xml.size());
+        }
     }
+}
 
-    return (jlong)connection_id;
+// Helper: Unix epoch milliseconds, the clock CoT stale times use
+static int64_t wall_clock_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
 }
 
-extern "C" JNIEXPORT jint JNICALL
-Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeDisconnect(
-    JNIEnv* env,
-    jobject thiz,
-    jlong connectionId
-) {
-    LOGI("nativeDisconnect called for connection %lld", (long long)connectionId);
+// Report tracks whose stale time has passed in one onCotExpired upcall. Only called
+// from the flush thread.
+static void deliver_expired(JNIEnv* env) {
+    if (!g_track_store.enabled()) {
+        return;
+    }
 
-    int32_t result = omnitak_disconnect((uint64_t)connectionId);
+    static std::vector<CotTrackStore::Expired> expired;
+    expired.clear();
+    g_track_store.take_expired(wall_clock_ms(), expired);
+    if (expired.empty()) {
+        return;
+    }
 
-    // Clean up callback
-    {
-        std::lock_guard<std::mutex> lock(g_callbacks_mutex);
-        auto it = g_callbacks.find((uint64_t)connectionId);
-        if (it != g_callbacks.end()) {
-            env->DeleteGlobalRef(it->second.bridge_instance);
-            g_callbacks.erase(it);
-            LOGI("Callback cleaned up for connection %lld", (long long)connectionId);
+    if (g_track_snapshot.is_open()) {
+        for (const CotTrackStore::Expired& track : expired) {
+            g_track_snapshot.remove(track.uid.data(), track.uid.size());
         }
     }
 
-    return (jint)result;
-}
+    jobject listener = listener_local_ref(env, g_expiry_mutex, g_expiry_listener);
+    if (!listener) {
+        return;
+    }
 
-extern "C" JNIEXPORT jint JNICALL
-Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSendCot(
-    JNIEnv* env,
-    jobject thiz,
-    jlong connectionId,
-    jstring cotXml
-) {
-    std::string cotXmlStr = jstring_to_string(env, cotXml);
+    jsize count = (jsize)expired.size();
+    jobjectArray jUids = env->NewObjectArray(count, g_string_class, nullptr);
+    jlongArray jStale = jUids ? env->NewLongArray(count) : nullptr;
+    if (!jStale) {
+        LOGE("Failed to allocate expiry arrays");
+        env->ExceptionClear();
+        if (jUids) {
+            env->DeleteLocalRef(jUids);
+        }
+        env->DeleteLocalRef(listener);
+        return;
+    }
 
-    LOGD("Sending CoT on connection %lld", (long long)connectionId);
+    static std::vector<jlong> staleTimes;
+    staleTimes.resize(expired.size());
+    for (jsize i = 0; i < count; ++i) {
+        jstring jUid = string_to_jstring(env, expired[i].uid.c_str());
+        env->SetObjectArrayElement(jUids, i, jUid);
+        env->DeleteLocalRef(jUid);
+        staleTimes[i] = (jlong)expired[i].stale_ms;
+    }
+    env->SetLongArrayRegion(jStale, 0, count, staleTimes.data());
 
-    int32_t result = omnitak_send_cot((uint64_t)connectionId, cotXmlStr.c_str());
+    LOGD("Reporting %d expired tracks", (int)count);
+    env->CallVoidMethod(listener, g_on_cot_expired, jUids, jStale);
 
-    if (result != 0) {
-        LOGE("Failed to send CoT: %d", result);
+    if (env->ExceptionCheck()) {
+        LOGE("Exception occurred in onCotExpired");
+        env->ExceptionDescribe();
+        env->ExceptionClear();
     }
 
-    return (jint)result;
+    env->DeleteLocalRef(jStale);
+    env->DeleteLocalRef(jUids);
+    env->DeleteLocalRef(listener);
 }
 
-extern "C" JNIEXPORT jint JNICALL
-Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeRegisterCallback(
-    JNIEnv* env,
-    jobject thiz,
-    jlong connectionId
-) {
-    LOGI("nativeRegisterCallback called for connection %lld", (long long)connectionId);
+// Hand everything the fan-in queued since the last tick to one onCotFanIn upcall. Only
+// called from the flush thread.
+static void deliver_fan_in(JNIEnv* env) {
+    static std::vector<CotFanIn::Event> events;
+    size_t taken = g_fan_in.take(CotFanIn::Clock::now(), events);
+    if (taken == 0) {
+        return;
+    }
 
-    // Store callback context
-    {
-        std::lock_guard<std::mutex> lock(g_callbacks_mutex);
+    jobject listener = listener_local_ref(env, g_fan_in_mutex, g_fan_in_listener);
+    if (!listener) {
+        return;
+    }
+
+    jsize count = (jsize)taken;
+    jlongArray jSources = env->NewLongArray(count);
+    jobjectArray jCotXmls = jSources ? env->NewObjectArray(count, g_string_class, nullptr) : nullptr;
+    if (!jCotXmls) {
+        LOGE("Failed to allocate fan-in arrays");
+        env->ExceptionClear();
+        if (jSources) {
+            env->DeleteLocalRef(jSources);
+        }
+        env->DeleteLocalRef(listener);
+        return;
+    }
 
-        // Create global reference to bridge instance
-        jobject globalRef = env->NewGlobalRef(thiz);
+    static std::vector<jlong> sources;
+    sources.resize(taken);
+    for (jsize i = 0; i < count; ++i) {
+        jstring jCotXml = string_to_jstring(env, events[i].xml.c_str());
+        env->SetObjectArrayElement(jCotXmls, i, jCotXml);
+        env->DeleteLocalRef(jCotXml);
+        sources[i] = (jlong)events[i].source;
+    }
+    env->SetLongArrayRegion(jSources, 0, count, sources.data());
 
-        CallbackContext context;
-        context.jvm = g_jvm;
-        context.bridge_instance = globalRef;
+    env->CallVoidMethod(listener, g_on_cot_fan_in, jSources, jCotXmls);
 
-        g_callbacks[(uint64_t)connectionId] = context;
+    if (env->ExceptionCheck()) {
+        LOGE("Exception occurred in onCotFanIn");
+        env->ExceptionDescribe();
+        env->ExceptionClear();
     }
 
-    // Register with C layer
-    int32_t result = omnitak_register_callback(
-        (uint64_t)connectionId,
-        cot_callback_bridge,
-        nullptr // user_data not needed, we use global map
-    );
+    env->DeleteLocalRef(jCotXmls);
+    env->DeleteLocalRef(jSources);
+    env->DeleteLocalRef(listener);
+}
 
-    if (result == 0) {
-        LOGI("Callback registered successfully");
-    } else {
-        LOGE("Failed to register callback: %d", result);
+// Flush loop: wakes every g_flush_tick_ms and delivers batches that are due
+static void flush_thread_main() {
+    JNIEnv* env = get_jni_env();
+    if (!env) {
+        return;
     }
 
-    return (jint)result;
+    std::unique_lock<std::mutex> lock(g_flush_mutex);
+    while (g_flush_running) {
+        g_flush_cv.wait_for(lock, std::chrono::milliseconds(g_flush_tick_ms.load()));
+        if (!g_flush_running) {
+            break;
+        }
+        lock.unlock();
+
+        auto now = CotBatchBuffer::Clock::now();
+        deliver_coalesced(now);
+        deliver_fan_in(env);
+        deliver_expired(env);
+        {
+            CallbackTable::ReadGuard guard(g_callbacks);
+            g_callbacks.for_each([&](uint64_t connection_id, CallbackContext& context) {
+                if (context.batch && context.batch->is_due(now)) {
+                    flush_cot_batch(env, connection_id, context);
+                }
+            });
+        }
+
+        lock.lock();
+    }
 }
 
-extern "C" JNIEXPORT jint JNICALL
-Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeUnregisterCallback(
-    JNIEnv* env,
-    jobject thiz,
-    jlong connectionId
-) {
-    LOGI("nativeUnregisterCallback called for connection %lld", (long long)connectionId);
+// Start the flush thread (if needed) and make sure it ticks at least as often
+// as the shortest configured flush interval
+static void ensure_flush_thread(int flush_interval_ms) {
+    std::lock_guard<std::mutex> lock(g_flush_mutex);
 
-    // Unregister from C layer
-    int32_t result = omnitak_unregister_callback((uint64_t)connectionId);
+    int tick = g_flush_tick_ms.load();
+    if (flush_interval_ms < tick) {
+        g_flush_tick_ms.store(flush_interval_ms);
+        g_flush_cv.notify_all();
+    }
 
-    // Clean up callback context
+    if (!g_flush_running) {
+        g_flush_running = true;
+        g_flush_thread = std::thread(flush_thread_main);
+    }
+}
+
+static void stop_flush_thread() {
     {
-        std::lock_guard<std::mutex> lock(g_callbacks_mutex);
-        auto it = g_callbacks.find((uint64_t)connectionId);
-        if (it != g_callbacks.end()) {
-            env->DeleteGlobalRef(it->second.bridge_instance);
-            g_callbacks.erase(it);
+        std::lock_guard<std::mutex> lock(g_flush_mutex);
+        if (!g_flush_running) {
+            return;
         }
+        g_flush_running = false;
+        g_flush_cv.notify_all();
     }
-
-    return (jint)result;
+    g_flush_thread.join();
+    g_flush_tick_ms.store(1000);
+}
+
+// Run the track store while expiry reporting, the spatial index, clustering or the
+// snapshot needs it. The flush thread prunes stale tracks in every case so queries
+// never serve them.
+static void update_track_store_enabled() {
+    bool enabled = g_expiry_enabled.load() || g_index_enabled.load() || g_cluster_enabled.load() ||
+                   g_track_snapshot.is_open();
+    g_track_store.set_enabled(enabled);
+    if (enabled) {
+        ensure_flush_thread(kExpiryTickMs);
+    } else {
+        g_track_store.clear();
+    }
+}
+
+// The bridge's inbound stages, in the order cot_process_inbound runs them (see
+// cot_inbound.h). Built per message inside ReadGuards on g_callbacks and g_stats.
+struct BridgeInbound {
+    BridgeInbound(uint64_t id, CallbackContext* callback_context, CotConnectionStats* connection_stats,
+                  bool fan_in_enabled)
+        : connection_id(id),
+          context(callback_context),
+          stats(connection_stats),
+          fan_in_on(fan_in_enabled),
+          track_store(g_track_store.enabled()),
+          coalesce(g_coalescer.enabled()),
+          snapshot(g_track_snapshot.is_open()),
+          urgent_priority(g_urgent_priority.load(std::memory_order_relaxed)) {}
+
+    uint64_t connection_id;
+    CallbackContext* context; // Null when only fan-in takes this connection's events
+    CotConnectionStats* stats;
+    bool fan_in_on;
+    bool track_store;
+    bool coalesce;
+    bool snapshot;
+    int urgent_priority; // -1 without priority lanes
+
+    void received(size_t length) {
+        if (stats) {
+            stats->record_received(length);
+        }
+    }
+
+    bool parse_key(const char* cot_xml, size_t length, CotEventKey* key) {
+        bool pingReply = stats && stats->ping_outstanding();
+        bool withPoint = track_store && (g_index_enabled.load(std::memory_order_relaxed) ||
+                                         g_cluster_enabled.load(std::memory_order_relaxed) || snapshot);
+        bool keyed = (track_store || coalesce || pingReply || urgent_priority >= 0 || fan_in_on ||
+                      COT_TRACE_ENABLED()) &&
+                     cot_parse_key(cot_xml, length, key, withPoint, snapshot);
+        if (keyed && pingReply && cot_type_is(*key, "t-x-c-t-r")) {
+            stats->record_ping_reply(CotConnectionStats::Clock::now());
+        }
+        return keyed;
+    }
+
+    bool admit(const CotEventKey& key, const char* cot_xml, size_t length) {
+        if (!fan_in_on || g_fan_in.admit(key.uid, key.uid_length, key.time_ms, cot_xml, length,
+                                         CotFanIn::Clock::now()) == CotFanIn::Result::Accepted) {
+            return true;
+        }
+        if (stats) {
+            stats->record_duplicate();
+        }
+        return false;
+    }
+
+    void track(const CotEventKey& key) {
+        if (track_store && (key.stale_ms > 0 || key.has_point)) {
+            int64_t now = wall_clock_ms();
+            g_track_store.update(key.uid, key.uid_length, key.stale_ms, key.has_point, key.lat, key.lon, now);
+            if (snapshot) {
+                g_track_snapshot.update(key, now);
+            }
+        }
+    }
+
+    bool fan_in(const CotEventKey* key, const char* cot_xml, size_t length) {
+        if (!fan_in_on) {
+            return false;
+        }
+        queue_fan_in(connection_id, key, cot_xml, length, urgent_priority);
+        return true;
+    }
+
+    // Alerts and chat must not wait behind a PLI flood: no coalescing, no batch
+    bool deliver_urgent(const CotEventKey& key, const char* cot_xml) {
+        if (urgent_priority < 0 || (context->delivery_mode != kDeliveryModeString &&
+                                    !g_priority_callback.load(std::memory_order_relaxed))) {
+            return false;
+        }
+        CotPriority priority = cot_classify(key.type, key.type_length);
+        if ((int)priority > urgent_priority) {
+            return false;
+        }
+        deliver_cot_priority(connection_id, context->bridge_instance, priority, cot_xml);
+        return true;
+    }
+
+    bool hold(const CotEventKey& key, const char* cot_xml, size_t length) {
+        if (!coalesce) {
+            return false;
+        }
+        CotCoalescer::Result result = g_coalescer.offer(connection_id, key.uid, key.uid_length,
+                                                        cot_xml, length, CotCoalescer::Clock::now());
+        if (result == CotCoalescer::Result::Replaced && stats) {
+            stats->record_coalesced();
+        } else if (result == CotCoalescer::Result::Duplicate && stats) {
+            stats->record_duplicate();
+        }
+        return result != CotCoalescer::Result::Deliver;
+    }
+
+    void deliver(const char* cot_xml, size_t length) {
+        deliver_cot(connection_id, *context, cot_xml, length);
+    }
+};
+
+// C callback function that bridges to Java/Kotlin
+static void cot_callback_bridge(void* user_data, uint64_t connection_id, const char* cot_xml) {
+    if (user_data) {
+        connection_id = (uint64_t)(uintptr_t)user_data;
+    }
+    LOGD("CoT callback triggered for connection %llu", (unsigned long long)connection_id);
+
+    if (!cot_xml) {
+        return;
+    }
+
+    COT_TRACE_SCOPE("cot_callback_bridge");
+
+    // Get callback context. The guard keeps it alive (and its global ref valid)
+    // until this callback returns, without taking any lock. Fan-in needs none.
+    CallbackTable::ReadGuard guard(g_callbacks);
+    CallbackContext* context = g_callbacks.find(connection_id);
+    bool fanIn = g_fan_in_enabled.load(std::memory_order_relaxed);
+    if (!context && !fanIn) {
+        LOGE("No callback context found for connection %llu", (unsigned long long)connection_id);
+        return;
+    }
+
+    StatsTable::ReadGuard statsGuard(g_stats);
+    BridgeInbound stages(connection_id, context, g_stats.find(connection_id), fanIn);
+    cot_process_inbound(stages, cot_xml, strlen(cot_xml));
+}
+
+// Tear down a context that has been removed from g_callbacks. The table only hands
+// contexts back once no callback can still be using them.
+static void release_callback_context(JNIEnv* env, uint64_t connection_id,
+                                     std::unique_ptr<CallbackContext> context, bool flush) {
+    if (!context) {
+        return;
+    }
+
+    // Deliver whatever is still buffered before dropping the context
+    if (flush && context->batch) {
+        flush_cot_batch(env, connection_id, *context);
+    }
+    env->DeleteGlobalRef(context->bridge_instance);
+}
+
+// Helper: Blocking omnitak_connect with a connect's arguments; 0 on failure
+static uint64_t connect_raw(const PendingConnect& args) {
+    const CotCertificate* certificate = args.certificate.get();
+    return omnitak_connect(
+        args.host.c_str(),
+        args.port,
+        args.protocol,
+        args.use_tls ? 1 : 0,
+        certificate ? certificate->cert_pem.c_str() : nullptr,
+        certificate ? certificate->key_pem.c_str() : nullptr,
+        certificate && certificate->has_ca ? certificate->ca_pem.c_str() : nullptr
+    );
+}
+
+// Helper: Send on Rust connection `rust_id` and count the result against `connection_id`
+static int32_t send_on(uint64_t connection_id, uint64_t rust_id, const char* cot_xml, size_t length) {
+    int32_t result = omnitak_send_cot(rust_id, cot_xml);
+    update_stats(connection_id, [&](CotConnectionStats& stats) {
+        if (result == 0) {
+            stats.record_sent(length);
+        } else {
+            stats.record_send_failure();
+        }
+    });
+    return result;
+}
+
+// Helper: Take a link down and schedule its first reconnect attempt. Caller holds link.mutex.
+static void mark_link_down(uint64_t connection_id, ReconnectLink& link, std::chrono::steady_clock::time_point now) {
+    if (!link.up) {
+        return;
+    }
+    link.up = false;
+    link.flushing = false;
+    link.stale_id = link.rust_id;
+
+    // Even the first attempt is jittered, so links that dropped together don't reconnect together
+    uint32_t delayMs = link.backoff.next_delay_ms();
+    link.next_attempt = now + std::chrono::milliseconds(delayMs);
+    LOGI("Connection %llu down, reconnecting in %u ms", (unsigned long long)connection_id, delayMs);
+}
+
+// Helper: Hold a message for a link that is down. Caller holds link.mutex.
+static int32_t queue_outbound(uint64_t connection_id, ReconnectLink& link, const char* cot_xml, size_t length) {
+    CotEventKey key;
+    bool keyed = cot_parse_key(cot_xml, length, &key);
+    if (keyed && cot_type_has_prefix(key.type ? key.type : "", key.type_length, "t-x-c-t")) {
+        // A ping that waited for the reconnect would time nothing useful
+        update_stats(connection_id, [](CotConnectionStats& stats) { stats.cancel_ping(); });
+        return kErrorNotConnected;
+    }
+
+    CotPriority priority = keyed ? cot_classify(key.type, key.type_length) : CotPriority::Other;
+    CotOutboundQueue::Result result = link.queue.push(priority, keyed ? key.uid : "", keyed ? key.uid_length : 0,
+                                                      cot_xml, length);
+    if (result == CotOutboundQueue::Result::Full) {
+        LOGE("Outbound %s queue full for connection %llu", cot_priority_name(priority),
+             (unsigned long long)connection_id);
+        return kErrorQueueFull;
+    }
+    return 0;
+}
+
+// Helper: Send everything queued while a link was down, most urgent first, until the queue
+// stays empty. Sends run with no lock held; meanwhile new sends queue behind the flush
+// (link.flushing) to keep their order. Stops at the first failure, putting the rest back
+// and taking the link down again.
+static void flush_outbound_queue(uint64_t connection_id) {
+    std::vector<CotOutboundQueue::Entry> entries;
+    size_t total = 0;
+    size_t sentTotal = 0;
+
+    while (true) {
+        uint64_t rustId;
+        entries.clear();
+        {
+            LinkTable::ReadGuard guard(g_links);
+            ReconnectLink* link = g_links.find(connection_id);
+            if (!link) {
+                return; // Disconnected meanwhile; the queue went with it
+            }
+            std::lock_guard<std::mutex> lock(link->mutex);
+            if (!link->up || link->queue.empty()) {
+                link->flushing = false;
+                break;
+            }
+            link->queue.drain(entries);
+            rustId = link->rust_id;
+        }
+
+        size_t sent = 0;
+        while (sent < entries.size() &&
+               send_on(connection_id, rustId, entries[sent].xml.c_str(), entries[sent].xml.size()) == 0) {
+            ++sent;
+        }
+        total += entries.size();
+        sentTotal += sent;
+        if (sent == entries.size()) {
+            continue;
+        }
+
+        LinkTable::ReadGuard guard(g_links);
+        ReconnectLink* link = g_links.find(connection_id);
+        if (link) {
+            std::lock_guard<std::mutex> lock(link->mutex);
+            link->queue.restore(entries, sent);
+            if (link->rust_id == rustId) {
+                mark_link_down(connection_id, *link, std::chrono::steady_clock::now());
+            }
+            link->flushing = false;
+        }
+        break;
+    }
+    LOGI("Flushed %zu of %zu queued messages on connection %llu", sentTotal, total,
+         (unsigned long long)connection_id);
+}
+
+// Helper: Install the result of a reconnect attempt. Caller holds link.mutex. Returns true if
+// the caller must run flush_outbound_queue once it has released the lock and guard.
+static bool finish_reconnect(uint64_t connection_id, ReconnectLink& link, uint64_t rust_id) {
+    link.attempting = false;
+
+    if (rust_id == 0) {
+        uint32_t delayMs = link.backoff.next_delay_ms();
+        link.next_attempt = std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs);
+        LOGI("Reconnect %u of connection %llu failed, retrying in %u ms", link.backoff.attempts(),
+             (unsigned long long)connection_id, delayMs);
+        return false;
+    }
+
+    if (link.callback_registered) {
+        int32_t result = omnitak_register_callback(rust_id, cot_callback_bridge, connection_user_data(connection_id));
+        if (result != 0) {
+            LOGE("Failed to re-register callback for connection %llu: %d", (unsigned long long)connection_id, result);
+        }
+    }
+
+    link.rust_id = rust_id;
+    link.up = true;
+    link.backoff.reset();
+    ++link.reconnects;
+    LOGI("Connection %llu reconnected as %llu", (unsigned long long)connection_id, (unsigned long long)rust_id);
+
+    link.flushing = !link.queue.empty();
+    return link.flushing;
+}
+
+// Helper: Register cot_callback_bridge with a connection's current Rust connection. A
+// reconnecting link that is down registers once it is back up.
+static int32_t attach_rust_callback(uint64_t connection_id) {
+    LinkTable::ReadGuard guard(g_links);
+    ReconnectLink* link = g_links.find(connection_id);
+    std::unique_lock<std::mutex> linkLock;
+    if (link) {
+        linkLock = std::unique_lock<std::mutex>(link->mutex);
+        link->callback_registered = true;
+    }
+    if (link && !link->up) {
+        return 0;
+    }
+    return omnitak_register_callback(
+        link ? link->rust_id : connection_id,
+        cot_callback_bridge,
+        connection_user_data(connection_id) // Lookups use g_callbacks by this id
+    );
+}
+
+// Helper: Undo attach_rust_callback
+static int32_t detach_rust_callback(uint64_t connection_id) {
+    LinkTable::ReadGuard guard(g_links);
+    ReconnectLink* link = g_links.find(connection_id);
+    std::unique_lock<std::mutex> linkLock;
+    if (link) {
+        linkLock = std::unique_lock<std::mutex>(link->mutex);
+        link->callback_registered = false;
+    }
+    if (link && !link->up) {
+        return 0;
+    }
+    return omnitak_unregister_callback(link ? link->rust_id : connection_id);
+}
+
+// Body of a reconnect attempt's thread. The connect blocks, so it runs outside any
+// guard; the link is looked up again afterwards in case it was disconnected meanwhile.
+static void reconnect_attempt_main(uint64_t connection_id) {
+    PendingConnect args;
+    uint64_t staleId = 0;
+    bool found = false;
+    {
+        LinkTable::ReadGuard guard(g_links);
+        ReconnectLink* link = g_links.find(connection_id);
+        if (link) {
+            std::lock_guard<std::mutex> lock(link->mutex);
+            args = link->args;
+            staleId = link->stale_id;
+            link->stale_id = 0;
+            found = true;
+        }
+    }
+
+    if (found) {
+        if (staleId != 0) {
+            omnitak_disconnect(staleId);
+        }
+
+        uint64_t rustId = connect_raw(args);
+
+        bool installed = false;
+        bool flush = false;
+        {
+            LinkTable::ReadGuard guard(g_links);
+            ReconnectLink* link = g_links.find(connection_id);
+            if (link) {
+                std::lock_guard<std::mutex> lock(link->mutex);
+                flush = finish_reconnect(connection_id, *link, rustId);
+                installed = true;
+            }
+        }
+        if (!installed && rustId != 0) {
+            omnitak_disconnect(rustId);
+        }
+        if (flush) {
+            flush_outbound_queue(connection_id);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(g_connect_mutex);
+    --g_connects_in_flight;
+    g_connect_cv.notify_all();
+}
+
+// Reconnect loop: health-checks live links once a second and starts an attempt for each
+// down link whose backoff has elapsed
+static void reconnect_thread_main() {
+    auto nextHealthCheck = std::chrono::steady_clock::now();
+    std::vector<uint64_t> due;
+
+    std::unique_lock<std::mutex> lock(g_reconnect_mutex);
+    while (g_reconnect_running) {
+        g_reconnect_cv.wait_for(lock, std::chrono::milliseconds(kReconnectTickMs));
+        if (!g_reconnect_running) {
+            break;
+        }
+        lock.unlock();
+
+        auto now = std::chrono::steady_clock::now();
+        bool healthCheck = now >= nextHealthCheck;
+        if (healthCheck) {
+            nextHealthCheck = now + std::chrono::milliseconds(kHealthCheckIntervalMs);
+        }
+
+        due.clear();
+        {
+            LinkTable::ReadGuard guard(g_links);
+            g_links.for_each([&](uint64_t connection_id, ReconnectLink& link) {
+                std::lock_guard<std::mutex> linkLock(link.mutex);
+                if (link.up && healthCheck) {
+                    ConnectionStatus status;
+                    if (omnitak_get_status(link.rust_id, &status) != 0 || !status.is_connected) {
+                        mark_link_down(connection_id, link, now);
+                    }
+                }
+                if (!link.up && !link.attempting && now >= link.next_attempt) {
+                    link.attempting = true;
+                    due.push_back(connection_id);
+                }
+            });
+        }
+
+        for (uint64_t connection_id : due) {
+            {
+                std::lock_guard<std::mutex> connectLock(g_connect_mutex);
+                ++g_connects_in_flight;
+            }
+            std::thread(reconnect_attempt_main, connection_id).detach();
+        }
+
+        lock.lock();
+    }
+}
+
+static void ensure_reconnect_thread() {
+    std::lock_guard<std::mutex> lock(g_reconnect_mutex);
+    if (!g_reconnect_running) {
+        g_reconnect_running = true;
+        g_reconnect_thread = std::thread(reconnect_thread_main);
+    }
+}
+
+static void stop_reconnect_thread() {
+    {
+        std::lock_guard<std::mutex> lock(g_reconnect_mutex);
+        if (!g_reconnect_running) {
+            return;
+        }
+        g_reconnect_running = false;
+        g_reconnect_cv.notify_all();
+    }
+    g_reconnect_thread.join();
+}
+
+// JNI_OnLoad - Called when library is loaded
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
+    LOGI("JNI_OnLoad called");
+    g_jvm = vm;
+
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK) {
+        LOGE("Failed to get JNI environment in JNI_OnLoad");
+        return JNI_ERR;
+    }
+
+    if (pthread_key_create(&g_env_key, detach_thread_destructor) != 0) {
+        LOGE("Failed to create thread key");
+        return JNI_ERR;
+    }
+
+    // Resolve classes here: FindClass from a Rust thread would use the system
+    // class loader and fail to see application classes.
+    jclass bridgeClass = env->FindClass("com/engindearing/omnitak/native/OmniTAKNativeBridge");
+    if (!bridgeClass) {
+        LOGE("Failed to find OmniTAKNativeBridge class");
+        return JNI_ERR;
+    }
+    g_bridge_class = (jclass)env->NewGlobalRef(bridgeClass);
+    env->DeleteLocalRef(bridgeClass);
+
+    g_on_cot_received = env->GetMethodID(g_bridge_class, "onCotReceived", "(JLjava/lang/String;)V");
+    if (!g_on_cot_received) {
+        LOGE("Failed to find onCotReceived method");
+        return JNI_ERR;
+    }
+
+    g_on_cot_batch = env->GetMethodID(g_bridge_class, "onCotBatch", "(J[Ljava/lang/String;)V");
+    if (!g_on_cot_batch) {
+        LOGE("Failed to find onCotBatch method");
+        return JNI_ERR;
+    }
+
+    g_on_cot_slab = env->GetMethodID(g_bridge_class, "onCotSlab", "(JILjava/nio/ByteBuffer;)V");
+    if (!g_on_cot_slab) {
+        LOGE("Failed to find onCotSlab method");
+        return JNI_ERR;
+    }
+
+    g_on_cot_events = env->GetMethodID(g_bridge_class, "onCotEvents",
+                                       "(JILjava/nio/ByteBuffer;Ljava/nio/ByteBuffer;)V");
+    if (!g_on_cot_events) {
+        LOGE("Failed to find onCotEvents method");
+        return JNI_ERR;
+    }
+
+    g_on_cot_expired = env->GetMethodID(g_bridge_class, "onCotExpired", "([Ljava/lang/String;[J)V");
+    if (!g_on_cot_expired) {
+        LOGE("Failed to find onCotExpired method");
+        return JNI_ERR;
+    }
+
+    g_on_connect_complete = env->GetMethodID(g_bridge_class, "onConnectComplete", "(JJ)V");
+    if (!g_on_connect_complete) {
+        LOGE("Failed to find onConnectComplete method");
+        return JNI_ERR;
+    }
+
+    g_on_cot_priority = env->GetMethodID(g_bridge_class, "onCotPriority", "(JILjava/lang/String;)V");
+    if (!g_on_cot_priority) {
+        LOGE("Failed to find onCotPriority method");
+        return JNI_ERR;
+    }
+
+    g_on_cot_fan_in = env->GetMethodID(g_bridge_class, "onCotFanIn", "([J[Ljava/lang/String;)V");
+    if (!g_on_cot_fan_in) {
+        LOGE("Failed to find onCotFanIn method");
+        return JNI_ERR;
+    }
+
+    jclass stringClass = env->FindClass("java/lang/String");
+    if (!stringClass) {
+        LOGE("Failed to find String class");
+        return JNI_ERR;
+    }
+    g_string_class = (jclass)env->NewGlobalRef(stringClass);
+    env->DeleteLocalRef(stringClass);
+
+    jclass statusClass = env->FindClass(
+        "com/engindearing/omnitak/native/OmniTAKNativeBridge$ConnectionStatusNative"
+    );
+    if (!statusClass) {
+        LOGE("Failed to find ConnectionStatusNative class");
+        return JNI_ERR;
+    }
+    g_status_class = (jclass)env->NewGlobalRef(statusClass);
+    env->DeleteLocalRef(statusClass);
+
+    g_status_constructor = env->GetMethodID(g_status_class, "<init>", "(IJJIJJJJIJJJJJJJIJJJJ)V");
+    if (!g_status_constructor) {
+        LOGE("Failed to find ConnectionStatusNative constructor");
+        return JNI_ERR;
+    }
+
+    jclass clustersClass = env->FindClass(
+        "com/engindearing/omnitak/native/OmniTAKNativeBridge$TrackClustersNative"
+    );
+    if (!clustersClass) {
+        LOGE("Failed to find TrackClustersNative class");
+        return JNI_ERR;
+    }
+    g_clusters_class = (jclass)env->NewGlobalRef(clustersClass);
+    env->DeleteLocalRef(clustersClass);
+
+    g_clusters_constructor = env->GetMethodID(g_clusters_class, "<init>", "([D[Ljava/lang/String;)V");
+    if (!g_clusters_constructor) {
+        LOGE("Failed to find TrackClustersNative constructor");
+        return JNI_ERR;
+    }
+
+    jclass snapshotClass = env->FindClass(
+        "com/engindearing/omnitak/native/OmniTAKNativeBridge$SnapshotTracksNative"
+    );
+    if (!snapshotClass) {
+        LOGE("Failed to find SnapshotTracksNative class");
+        return JNI_ERR;
+    }
+    g_snapshot_class = (jclass)env->NewGlobalRef(snapshotClass);
+    env->DeleteLocalRef(snapshotClass);
+
+    g_snapshot_constructor = env->GetMethodID(
+        g_snapshot_class, "<init>", "([Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;[D[J)V"
+    );
+    if (!g_snapshot_constructor) {
+        LOGE("Failed to find SnapshotTracksNative constructor");
+        return JNI_ERR;
+    }
+
+    return JNI_VERSION_1_6;
+}
+
+// Native method implementations
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeInit(
+    JNIEnv* env,
+    jobject thiz,
+    jstring snapshotPath
+) {
+    LOGI("nativeInit called");
+    int32_t result = omnitak_init();
+    LOGI("omnitak_init returned %d", result);
+
+    // Restore the last picture before any connection can deliver newer events
+    if (result == 0 && snapshotPath) {
+        const char* path = env->GetStringUTFChars(snapshotPath, nullptr);
+        std::vector<CotTrackSnapshot::Track> restored;
+        if (g_track_snapshot.open(path, wall_clock_ms(), restored)) {
+            for (const CotTrackSnapshot::Track& track : restored) {
+                g_track_store.update(track.uid.data(), track.uid.size(), track.stale_ms,
+                                     track.has_position, track.lat, track.lon, track.updated_ms);
+            }
+            update_track_store_enabled();
+            LOGI("Restored %zu tracks from %s", restored.size(), path);
+        }
+        env->ReleaseStringUTFChars(snapshotPath, path);
+    }
+    return (jint)result;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeShutdown(
+    JNIEnv* env,
+    jobject thiz
+) {
+    LOGI("nativeShutdown called");
+
+    // Connects and reconnect attempts in flight still call into Rust; let them finish
+    // (and report) first. Stopping the reconnect thread first means no new attempts start.
+    stop_reconnect_thread();
+    {
+        std::unique_lock<std::mutex> lock(g_connect_mutex);
+        g_connect_cv.wait(lock, [] { return g_connects_in_flight == 0; });
+        release_orphaned_refs(env);
+    }
+
+    stop_flush_thread();
+    g_coalescer.clear();
+    g_expiry_enabled.store(false);
+    g_index_enabled.store(false);
+    g_cluster_enabled.store(false);
+    g_urgent_priority.store(-1);
+    g_priority_callback.store(false);
+    g_fan_in_enabled.store(false);
+    g_fan_in.clear();
+    {
+        std::lock_guard<std::mutex> lock(g_fan_in_mutex);
+        if (g_fan_in_listener) {
+            env->DeleteGlobalRef(g_fan_in_listener);
+            g_fan_in_listener = nullptr;
+        }
+    }
+    g_track_store.set_enabled(false);
+    g_track_store.set_clustering(false);
+    g_track_store.clear();
+    g_track_snapshot.close();
+    {
+        std::lock_guard<std::mutex> lock(g_expiry_mutex);
+        if (g_expiry_listener) {
+            env->DeleteGlobalRef(g_expiry_listener);
+            g_expiry_listener = nullptr;
+        }
+    }
+
+    // Clean up all callbacks
+    for (auto& context : g_callbacks.clear()) {
+        release_callback_context(env, 0, std::move(context), false);
+    }
+    g_stats.clear();
+    g_links.clear();
+    g_certificates.clear();
+
+    omnitak_shutdown();
+    LOGI("Shutdown complete");
+}
+
+// Validate and cache a client certificate bundle. Returns its handle (> 0) for nativeConnectAsync,
+// or kErrorInvalidArgument when the PEM doesn't hold the expected blocks.
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeImportCertificate(
+    JNIEnv* env,
+    jobject thiz,
+    jstring certPem,
+    jstring keyPem,
+    jstring caPem
+) {
+    if (!certPem || !keyPem) {
+        return kErrorInvalidArgument;
+    }
+
+    // Strings are read in place; the store keeps its own normalized copies
+    const char* cert = env->GetStringUTFChars(certPem, nullptr);
+    const char* key = env->GetStringUTFChars(keyPem, nullptr);
+    const char* ca = caPem ? env->GetStringUTFChars(caPem, nullptr) : nullptr;
+
+    CotCertificateStore::Error error;
+    uint64_t handle = g_certificates.import(cert, key, ca, &error);
+
+    env->ReleaseStringUTFChars(certPem, cert);
+    env->ReleaseStringUTFChars(keyPem, key);
+    if (ca) {
+        env->ReleaseStringUTFChars(caPem, ca);
+    }
+
+    if (handle == 0) {
+        LOGE("Certificate import failed: %s", CotCertificateStore::error_message(error));
+        return kErrorInvalidArgument;
+    }
+    LOGI("Certificate imported: handle %llu", (unsigned long long)handle);
+    return (jlong)handle;
+}
+
+// Drop a certificate handle. Connects already under way keep their bundle until they finish.
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeReleaseCertificate(
+    JNIEnv* env,
+    jobject thiz,
+    jlong certHandle
+) {
+    return g_certificates.release((uint64_t)certHandle) ? 0 : kErrorInvalidArgument;
+}
+
+// Helper: Copy connect arguments out of the JNI call and pin its certificate, if any, so an
+// async connect can use them from its own thread. Returns false for an unknown certificate handle.
+static bool read_connect_args(JNIEnv* env, jstring host, jint port, jint protocol, jboolean useTls,
+                              jlong certHandle, jboolean reconnect, jint reconnectDelayMs,
+                              PendingConnect* out) {
+    out->host = jstring_to_string(env, host);
+    out->port = (uint16_t)port;
+    out->protocol = (int32_t)protocol;
+    out->use_tls = useTls;
+    out->reconnect = reconnect;
+    out->reconnect_delay_ms = reconnectDelayMs < (jint)kMinReconnectDelayMs ? kMinReconnectDelayMs
+                            : reconnectDelayMs > (jint)kMaxReconnectDelayMs ? kMaxReconnectDelayMs
+                            : (uint32_t)reconnectDelayMs;
+    if (certHandle != 0) {
+        out->certificate = g_certificates.find((uint64_t)certHandle);
+        if (!out->certificate) {
+            LOGE("Unknown certificate handle %lld", (long long)certHandle);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Helper: Connect (blocking through any TLS handshake) and give the new connection its
+// counters, plus reconnect supervision when requested
+static uint64_t connect_instrumented(const PendingConnect& args) {
+    LOGI("Connecting to %s:%d (protocol=%d, tls=%d, reconnect=%d)",
+         args.host.c_str(), (int)args.port, (int)args.protocol, (int)args.use_tls, (int)args.reconnect);
+    COT_TRACE_SCOPE("connect", args.host.c_str());
+
+    uint64_t connection_id = connect_raw(args);
+
+    if (connection_id > 0) {
+        LOGI("Connected successfully: %llu", (unsigned long long)connection_id);
+
+        auto stats = std::make_unique<CotConnectionStats>();
+        std::unique_ptr<CotConnectionStats> previous;
+        if (!g_stats.replace(connection_id, stats, previous)) {
+            LOGE("Stats table full, connection %llu is not instrumented", (unsigned long long)connection_id);
+        }
+
+        if (args.reconnect) {
+            auto link = std::make_unique<ReconnectLink>(args, connection_id);
+            std::unique_ptr<ReconnectLink> previousLink;
+            if (g_links.replace(connection_id, link, previousLink)) {
+                ensure_reconnect_thread();
+            } else {
+                LOGE("Link table full, connection %llu won't reconnect", (unsigned long long)connection_id);
+            }
+        }
+
+        // Fan-in takes every connection's events, registered or not
+        if (g_fan_in_enabled.load()) {
+            attach_rust_callback(connection_id);
+        }
+    } else {
+        LOGE("Connection to %s:%d failed", args.host.c_str(), (int)args.port);
+    }
+    return connection_id;
+}
+
+// Body of an async connect's thread: connect, then report to onConnectComplete
+static void pending_connect_main(std::unique_ptr<PendingConnect> pending) {
+    uint64_t connection_id = connect_instrumented(*pending);
+
+    JNIEnv* env = get_jni_env();
+    if (!env) {
+        LOGE("Connect %lld can't report completion", (long long)pending->pending_id);
+        std::lock_guard<std::mutex> lock(g_connect_mutex);
+        g_orphaned_refs.push_back(pending->bridge_instance);
+        --g_connects_in_flight;
+        g_connect_cv.notify_all();
+        return;
+    }
+
+    env->CallVoidMethod(pending->bridge_instance, g_on_connect_complete,
+                        pending->pending_id, (jlong)connection_id);
+    if (env->ExceptionCheck()) {
+        LOGE("Exception occurred in onConnectComplete");
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+    env->DeleteGlobalRef(pending->bridge_instance);
+
+    std::lock_guard<std::mutex> lock(g_connect_mutex);
+    --g_connects_in_flight;
+    g_connect_cv.notify_all();
+}
+
+// Start a connect and return at once with a pending id. onConnectComplete(pendingId,
+// connectionId) follows from the connect's own thread, with connectionId 0 on failure.
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeConnectAsync(
+    JNIEnv* env,
+    jobject thiz,
+    jstring host,
+    jint port,
+    jint protocol,
+    jboolean useTls,
+    jlong certHandle,
+    jboolean reconnect,
+    jint reconnectDelayMs
+) {
+    if (!host) {
+        return kErrorInvalidArgument;
+    }
+
+    auto pending = std::make_unique<PendingConnect>();
+    if (!read_connect_args(env, host, port, protocol, useTls, certHandle, reconnect, reconnectDelayMs,
+                           pending.get())) {
+        return kErrorInvalidArgument;
+    }
+    pending->pending_id = g_next_pending_connect.fetch_add(1);
+    pending->bridge_instance = env->NewGlobalRef(thiz);
+    jlong pendingId = pending->pending_id;
+
+    LOGI("nativeConnectAsync %lld: %s:%d", (long long)pendingId, pending->host.c_str(), (int)port);
+
+    {
+        std::lock_guard<std::mutex> lock(g_connect_mutex);
+        release_orphaned_refs(env);
+        ++g_connects_in_flight;
+    }
+    std::thread(pending_connect_main, std::move(pending)).detach();
+    return pendingId;
+}
+
+// Blocks until upcalls in flight for the connection return (ConnectionTable::remove
+// waits out their read sections), so it must not be called from one of them.
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeDisconnect(
+    JNIEnv* env,
+    jobject thiz,
+    jlong connectionId
+) {
+    LOGI("nativeDisconnect called for connection %lld", (long long)connectionId);
+
+    // Stop supervision first so no reconnect replaces the connection being closed. An
+    // attempt already in flight finds the link gone and closes what it opened.
+    int32_t result = 0;
+    std::unique_ptr<ReconnectLink> link = g_links.remove((uint64_t)connectionId);
+    if (!link) {
+        result = omnitak_disconnect((uint64_t)connectionId);
+    } else if (link->up) {
+        result = omnitak_disconnect(link->rust_id);
+    } else if (link->stale_id != 0) {
+        omnitak_disconnect(link->stale_id);
+    }
+    if (link && !link->queue.empty()) {
+        LOGI("Dropping %zu queued messages for connection %lld", link->queue.size(), (long long)connectionId);
+    }
+
+    // Clean up callback
+    std::unique_ptr<CallbackContext> context = g_callbacks.remove((uint64_t)connectionId);
+    if (context) {
+        release_callback_context(env, (uint64_t)connectionId, std::move(context), true);
+        LOGI("Callback cleaned up for connection %lld", (long long)connectionId);
+    }
+    g_stats.remove((uint64_t)connectionId);
+
+    return (jint)result;
+}
+
+// Helper: Send a NUL-terminated payload of `length` bytes and count it against the
+// connection. Outbound TAK pings start a round-trip measurement. No guard or lock is
+// held across the send itself, which may block on the socket. On a reconnecting
+// connection that is down (or whose send just failed) the message is queued instead,
+// as it is while the queue is being flushed, so it can't overtake queued messages.
+static int32_t send_cot_counted(uint64_t connection_id, const char* cot_xml, size_t length) {
+    // Only pings carry this type, so regular sends cost one memmem (plus a key parse
+    // while tracing, for the correlation id)
+    bool maybePing = memmem(cot_xml, length, "t-x-c-t", 7) != nullptr;
+    CotEventKey key;
+    bool keyed = (maybePing || COT_TRACE_ENABLED()) && cot_parse_key(cot_xml, length, &key);
+
+    COT_TRACE_SCOPE("cot_tx", keyed ? key.uid : "", keyed ? key.uid_length : 0);
+
+    if (keyed && maybePing && cot_type_is(key, "t-x-c-t")) {
+        // Stamp before sending: the reply can arrive before omnitak_send_cot returns
+        auto now = CotConnectionStats::Clock::now();
+        update_stats(connection_id, [&](CotConnectionStats& stats) { stats.record_ping_sent(now); });
+    }
+
+    // Only the link's state is read under its lock; it is locked again to queue on failure.
+    // A link that reconnected meanwhile gets another try on its new Rust connection.
+    uint64_t failedId = 0;
+    while (true) {
+        uint64_t rustId = connection_id;
+        bool linked = false;
+        {
+            LinkTable::ReadGuard guard(g_links);
+            ReconnectLink* link = g_links.find(connection_id);
+            if (link) {
+                std::lock_guard<std::mutex> lock(link->mutex);
+                if (link->up && failedId != 0 && link->rust_id == failedId) {
+                    mark_link_down(connection_id, *link, std::chrono::steady_clock::now());
+                }
+                if (!link->up || link->flushing) {
+                    return queue_outbound(connection_id, *link, cot_xml, length);
+                }
+                rustId = link->rust_id;
+                linked = true;
+            } else if (failedId != 0) {
+                return kErrorNotConnected; // Disconnected during the send
+            }
+        }
+
+        int32_t result = send_on(connection_id, rustId, cot_xml, length);
+        if (result == 0 || !linked) {
+            return result;
+        }
+        failedId = rustId;
+    }
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSendCot(
+    JNIEnv* env,
+    jobject thiz,
+    jlong connectionId,
+    jstring cotXml
+) {
+    if (!cotXml) {
+        return kErrorInvalidArgument;
+    }
+
+    LOGD("Sending CoT on connection %lld", (long long)connectionId);
+    COT_TRACE_SCOPE("nativeSendCot");
+
+    // GetStringUTFChars is already NUL-terminated; hand it straight to Rust
+    const char* chars = env->GetStringUTFChars(cotXml, nullptr);
+    if (!chars) {
+        return kErrorInvalidArgument;
+    }
+    int32_t result = send_cot_counted((uint64_t)connectionId, chars, strlen(chars));
+    env->ReleaseStringUTFChars(cotXml, chars);
+
+    if (result != 0) {
+        LOGE("Failed to send CoT: %d", result);
+    }
+
+    return (jint)result;
+}
+
+// Per-thread staging buffer for byte sends. The Rust FFI only accepts NUL-terminated
+// strings, so payloads that aren't already terminated are copied here once; the
+// buffer keeps its capacity so steady-state sends don't allocate.
+static thread_local std::vector<char> t_send_buffer;
+
+// Helper: Terminate and send the first `length` bytes of t_send_buffer
+static int32_t send_staged_cot(uint64_t connection_id, size_t length) {
+    if (memchr(t_send_buffer.data(), '\0', length) != nullptr) {
+        LOGE("CoT payload contains an embedded NUL");
+        return kErrorInvalidArgument;
+    }
+
+    t_send_buffer[length] = '\0';
+    return send_cot_counted(connection_id, t_send_buffer.data(), length);
+}
+
+// Helper: Send a UTF-8 region of native memory. When `may_be_terminated` is set the
+// byte after the region is readable, and if it is a NUL the region is sent in place.
+static int32_t send_cot_region(uint64_t connection_id, const char* bytes, size_t length,
+                               bool may_be_terminated) {
+    if (may_be_terminated && bytes[length] == '\0' && memchr(bytes, '\0', length) == nullptr) {
+        // Caller left a terminator after the payload: zero-copy send
+        return send_cot_counted(connection_id, bytes, length);
+    }
+
+    t_send_buffer.resize(length + 1);
+    memcpy(t_send_buffer.data(), bytes, length);
+    return send_staged_cot(connection_id, length);
+}
+
+// Helper: Allocate the per-item result bitmap returned by the batch send calls.
+// Bit i of word i / 64 is set when item i was sent; the layout matches BitSet.valueOf(long[]).
+static jlongArray make_result_bitmap(JNIEnv* env, const std::vector<jlong>& words) {
+    jlongArray jBitmap = env->NewLongArray((jsize)words.size());
+    if (jBitmap && !words.empty()) {
+        env->SetLongArrayRegion(jBitmap, 0, (jsize)words.size(), words.data());
+    }
+    return jBitmap;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSendCotBytes(
+    JNIEnv* env,
+    jobject thiz,
+    jlong connectionId,
+    jobject buffer,
+    jint offset,
+    jint length
+) {
+    const char* base = buffer ? (const char*)env->GetDirectBufferAddress(buffer) : nullptr;
+    jlong capacity = buffer ? env->GetDirectBufferCapacity(buffer) : -1;
+
+    if (!base || offset < 0 || length < 0 || (jlong)offset + length > capacity) {
+        LOGE("nativeSendCotBytes: invalid buffer or range (offset=%d, length=%d)", (int)offset, (int)length);
+        return kErrorInvalidArgument;
+    }
+
+    LOGD("Sending %d CoT bytes on connection %lld", (int)length, (long long)connectionId);
+
+    bool terminated = (jlong)offset + length < capacity;
+    int32_t result = send_cot_region((uint64_t)connectionId, base + offset, (size_t)length, terminated);
+
+    if (result != 0) {
+        LOGE("Failed to send CoT: %d", result);
+    }
+
+    return (jint)result;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSendCotArray(
+    JNIEnv* env,
+    jobject thiz,
+    jlong connectionId,
+    jbyteArray bytes,
+    jint offset,
+    jint length
+) {
+    jsize arrayLength = bytes ? env->GetArrayLength(bytes) : -1;
+
+    if (arrayLength < 0 || offset < 0 || length < 0 || (jlong)offset + length > arrayLength) {
+        LOGE("nativeSendCotArray: invalid array or range (offset=%d, length=%d)", (int)offset, (int)length);
+        return kErrorInvalidArgument;
+    }
+
+    LOGD("Sending %d CoT bytes on connection %lld", (int)length, (long long)connectionId);
+
+    // Copy the region out of the Java heap once; Rust may block on the socket,
+    // so we can't hold a critical section across the send
+    t_send_buffer.resize((size_t)length + 1);
+    env->GetByteArrayRegion(bytes, offset, length, (jbyte*)t_send_buffer.data());
+
+    int32_t result = send_staged_cot((uint64_t)connectionId, (size_t)length);
+
+    if (result != 0) {
+        LOGE("Failed to send CoT: %d", result);
+    }
+
+    return (jint)result;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSendCotBatch(
+    JNIEnv* env,
+    jobject thiz,
+    jlong connectionId,
+    jobject buffer,
+    jintArray regions
+) {
+    const char* base = buffer ? (const char*)env->GetDirectBufferAddress(buffer) : nullptr;
+    jlong capacity = buffer ? env->GetDirectBufferCapacity(buffer) : -1;
+    jsize regionsLength = regions ? env->GetArrayLength(regions) : 0;
+
+    if (!base || regionsLength % 2 != 0) {
+        LOGE("nativeSendCotBatch: invalid buffer or regions array");
+        return nullptr;
+    }
+
+    // regions holds (offset, length) pairs into the packed buffer
+    size_t count = (size_t)regionsLength / 2;
+    std::vector<jint> pairs((size_t)regionsLength);
+    if (regionsLength > 0) {
+        env->GetIntArrayRegion(regions, 0, regionsLength, pairs.data());
+    }
+
+    LOGD("Sending batch of %zu CoT messages on connection %lld", count, (long long)connectionId);
+
+    std::vector<jlong> words((count + 63) / 64, 0);
+    size_t failures = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        jint offset = pairs[i * 2];
+        jint length = pairs[i * 2 + 1];
+
+        int32_t result = kErrorInvalidArgument;
+        if (offset >= 0 && length >= 0 && (jlong)offset + length <= capacity) {
+            bool terminated = (jlong)offset + length < capacity;
+            result = send_cot_region((uint64_t)connectionId, base + offset, (size_t)length, terminated);
+        }
+
+        if (result == 0) {
+            words[i / 64] |= (jlong)(1ULL << (i % 64));
+        } else {
+            ++failures;
+        }
+    }
+
+    if (failures > 0) {
+        LOGE("Failed to send %zu of %zu CoT messages", failures, count);
+    }
+
+    return make_result_bitmap(env, words);
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSendCotStrings(
+    JNIEnv* env,
+    jobject thiz,
+    jlong connectionId,
+    jobjectArray cotXmls
+) {
+    jsize count = cotXmls ? env->GetArrayLength(cotXmls) : 0;
+
+    LOGD("Sending batch of %d CoT messages on connection %lld", (int)count, (long long)connectionId);
+
+    std::vector<jlong> words(((size_t)count + 63) / 64, 0);
+    size_t failures = 0;
+
+    for (jsize i = 0; i < count; ++i) {
+        jstring cotXml = (jstring)env->GetObjectArrayElement(cotXmls, i);
+        const char* chars = cotXml ? env->GetStringUTFChars(cotXml, nullptr) : nullptr;
+
+        int32_t result = kErrorInvalidArgument;
+        if (chars) {
+            result = send_cot_counted((uint64_t)connectionId, chars, strlen(chars));
+            env->ReleaseStringUTFChars(cotXml, chars);
+        }
+        if (cotXml) {
+            env->DeleteLocalRef(cotXml);
+        }
+
+        if (result == 0) {
+            words[(size_t)i / 64] |= (jlong)(1ULL << (i % 64));
+        } else {
+            ++failures;
+        }
+    }
+
+    if (failures > 0) {
+        LOGE("Failed to send %zu of %d CoT messages", failures, (int)count);
+    }
+
+    return make_result_bitmap(env, words);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeRegisterCallback(
+    JNIEnv* env,
+    jobject thiz,
+    jlong connectionId,
+    jint batchSize,
+    jint flushIntervalMs,
+    jint deliveryMode
+) {
+    LOGI("nativeRegisterCallback called for connection %lld (batchSize=%d, flushIntervalMs=%d, mode=%d)",
+         (long long)connectionId, (int)batchSize, (int)flushIntervalMs, (int)deliveryMode);
+
+    if (deliveryMode < kDeliveryModeString || deliveryMode > kDeliveryModeParsed) {
+        LOGE("Unknown delivery mode %d", (int)deliveryMode);
+        return kErrorInvalidArgument;
+    }
+
+    // String mode with batchSize <= 1 keeps per-message delivery through onCotReceived.
+    // Direct and parsed modes always go through slabs, flushing every message when unbatched.
+    bool batched = batchSize > 1 || deliveryMode != kDeliveryModeString;
+    int maxMessages = batchSize > kMaxBatchSize ? kMaxBatchSize : (batchSize < 1 ? 1 : (int)batchSize);
+    int intervalMs = flushIntervalMs < kMinFlushIntervalMs ? kMinFlushIntervalMs : (int)flushIntervalMs;
+
+    // Store callback context
+    auto context = std::make_unique<CallbackContext>();
+    context->bridge_instance = env->NewGlobalRef(thiz); // Global reference to bridge instance
+    context->delivery_mode = (int)deliveryMode;
+    if (batched) {
+        context->batch = std::make_unique<CotBatchBuffer>(g_slab_pool, (size_t)maxMessages, (uint32_t)intervalMs);
+        g_slab_pool.reserve(kReservedSlabs);
+    }
+
+    // Replace (and release) any previous registration for this connection
+    std::unique_ptr<CallbackContext> previous;
+    if (!g_callbacks.replace((uint64_t)connectionId, context, previous)) {
+        LOGE("Callback table full, cannot register connection %lld", (long long)connectionId);
+        env->DeleteGlobalRef(context->bridge_instance);
+        return kErrorRegistryFull;
+    }
+    release_callback_context(env, (uint64_t)connectionId, std::move(previous), true);
+
+    if (batched) {
+        ensure_flush_thread(intervalMs);
+    }
+
+    // Register with C layer, on the current Rust connection of a reconnecting one
+    int32_t result = attach_rust_callback((uint64_t)connectionId);
+
+    if (result == 0) {
+        LOGI("Callback registered successfully");
+    } else {
+        LOGE("Failed to register callback: %d", result);
+    }
+
+    return (jint)result;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeUnregisterCallback(
+    JNIEnv* env,
+    jobject thiz,
+    jlong connectionId
+) {
+    LOGI("nativeUnregisterCallback called for connection %lld", (long long)connectionId);
+
+    // Unregister from C layer, unless fan-in still takes the connection's events
+    int32_t result = g_fan_in_enabled.load() ? 0 : detach_rust_callback((uint64_t)connectionId);
+
+    // Clean up callback context
+    release_callback_context(env, (uint64_t)connectionId, g_callbacks.remove((uint64_t)connectionId), true);
+
+    return (jint)result;
+}
+
+// Route events of `urgentPriority` or more urgent (a CotPriority value) through onCotPriority;
+// -1 turns priority lanes off. Without `hasCallback`, only String connections use the lanes.
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSetPriorityLanes(
+    JNIEnv* env,
+    jobject thiz,
+    jint urgentPriority,
+    jboolean hasCallback
+) {
+    LOGI("nativeSetPriorityLanes called (urgentPriority=%d, hasCallback=%d)", (int)urgentPriority, (int)hasCallback);
+
+    if (urgentPriority < -1 || urgentPriority >= (jint)kCotPriorityCount) {
+        LOGE("Invalid urgent priority %d", (int)urgentPriority);
+        return kErrorInvalidArgument;
+    }
+    g_priority_callback.store(hasCallback == JNI_TRUE);
+    g_urgent_priority.store((int)urgentPriority);
+    return 0;
+}
+
+// Merge every connection's events into one deduplicated stream delivered through onCotFanIn
+// each `flushIntervalMs`, remembering event identities for `windowMs`. Disabling hands
+// delivery back to the per-connection callbacks.
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSetFanIn(
+    JNIEnv* env,
+    jobject thiz,
+    jboolean enabled,
+    jint flushIntervalMs,
+    jint windowMs
+) {
+    LOGI("nativeSetFanIn called (enabled=%d, flushIntervalMs=%d, windowMs=%d)",
+         (int)enabled, (int)flushIntervalMs, (int)windowMs);
+
+    if (enabled && (windowMs <= 0 || windowMs > kMaxFanInWindowMs)) {
+        LOGE("Invalid fan-in window %d ms", (int)windowMs);
+        return kErrorInvalidArgument;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_fan_in_mutex);
+        if (g_fan_in_listener) {
+            env->DeleteGlobalRef(g_fan_in_listener);
+            g_fan_in_listener = nullptr;
+        }
+        if (enabled) {
+            g_fan_in_listener = env->NewGlobalRef(thiz);
+        }
+    }
+
+    // Every connection, from connect until disconnect, has an entry in g_stats
+    std::vector<uint64_t> connections;
+    {
+        StatsTable::ReadGuard guard(g_stats);
+        g_stats.for_each([&](uint64_t connection_id, CotConnectionStats&) { connections.push_back(connection_id); });
+    }
+
+    if (enabled) {
+        g_fan_in.set_window((uint32_t)windowMs);
+        g_fan_in_enabled.store(true);
+        ensure_flush_thread(flushIntervalMs < kMinFlushIntervalMs ? kMinFlushIntervalMs : (int)flushIntervalMs);
+        for (uint64_t connection_id : connections) {
+            attach_rust_callback(connection_id);
+        }
+        return 0;
+    }
+
+    g_fan_in_enabled.store(false);
+    for (uint64_t connection_id : connections) {
+        bool registered;
+        {
+            CallbackTable::ReadGuard guard(g_callbacks);
+            registered = g_callbacks.find(connection_id) != nullptr;
+        }
+        if (!registered) {
+            detach_rust_callback(connection_id);
+        }
+    }
+    g_fan_in.clear();
+    return 0;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSetCoalescing(
+    JNIEnv* env,
+    jobject thiz,
+    jint windowMs
+) {
+    LOGI("nativeSetCoalescing called (windowMs=%d)", (int)windowMs);
+
+    if (windowMs < 0 || windowMs > kMaxCoalesceWindowMs) {
+        LOGE("Invalid coalescing window %d", (int)windowMs);
+        return kErrorInvalidArgument;
+    }
+
+    g_coalescer.set_window((uint32_t)windowMs);
+
+    // Held events are released by the flush thread. After disabling, its next
+    // tick hands out whatever was still held.
+    if (windowMs > 0) {
+        ensure_flush_thread((int)windowMs);
+    }
+    return 0;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSetTrackExpiry(
+    JNIEnv* env,
+    jobject thiz,
+    jboolean enabled
+) {
+    LOGI("nativeSetTrackExpiry called (enabled=%d)", (int)enabled);
+
+    {
+        std::lock_guard<std::mutex> lock(g_expiry_mutex);
+        if (g_expiry_listener) {
+            env->DeleteGlobalRef(g_expiry_listener);
+            g_expiry_listener = nullptr;
+        }
+        if (enabled) {
+            g_expiry_listener = env->NewGlobalRef(thiz);
+        }
+    }
+
+    g_expiry_enabled.store(enabled);
+    update_track_store_enabled();
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSetTrackIndex(
+    JNIEnv* env,
+    jobject thiz,
+    jboolean enabled
+) {
+    LOGI("nativeSetTrackIndex called (enabled=%d)", (int)enabled);
+
+    g_index_enabled.store(enabled);
+    update_track_store_enabled();
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeQueryRegion(
+    JNIEnv* env,
+    jobject thiz,
+    jdouble minLat,
+    jdouble minLon,
+    jdouble maxLat,
+    jdouble maxLon,
+    jint limit
+) {
+    if (!g_index_enabled.load() || limit <= 0) {
+        return env->NewObjectArray(0, g_string_class, nullptr);
+    }
+
+    std::vector<CotTrackStore::Position> positions;
+    g_track_store.query_region(minLat, minLon, maxLat, maxLon, (size_t)limit, positions);
+
+    jobjectArray result = env->NewObjectArray((jsize)positions.size(), g_string_class, nullptr);
+    if (!result) {
+        return nullptr; // OutOfMemoryError pending
+    }
+    for (size_t i = 0; i < positions.size(); ++i) {
+        jstring uid = env->NewStringUTF(positions[i].uid.c_str());
+        if (!uid) {
+            return nullptr;
+        }
+        env->SetObjectArrayElement(result, (jsize)i, uid);
+        env->DeleteLocalRef(uid);
+    }
+    return result;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeGetTrackCount(
+    JNIEnv* env,
+    jobject thiz
+) {
+    return (jint)g_track_store.size();
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeSetTrackClustering(
+    JNIEnv* env,
+    jobject thiz,
+    jboolean enabled
+) {
+    LOGI("nativeSetTrackClustering called (enabled=%d)", (int)enabled);
+
+    g_cluster_enabled.store(enabled);
+    g_track_store.set_clustering(enabled);
+    update_track_store_enabled();
+}
+
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeQueryClusters(
+    JNIEnv* env,
+    jobject thiz,
+    jint zoom,
+    jdouble minLat,
+    jdouble minLon,
+    jdouble maxLat,
+    jdouble maxLon,
+    jint limit
+) {
+    std::vector<CotTrackStore::Cluster> clusters;
+    if (g_cluster_enabled.load() && limit > 0) {
+        g_track_store.query_clusters((int)zoom, minLat, minLon, maxLat, maxLon, (size_t)limit, clusters);
+    }
+
+    // Flattened as (lat, lon, count) triples plus a parallel uid array
+    jsize count = (jsize)clusters.size();
+    jdoubleArray jValues = env->NewDoubleArray(count * 3);
+    jobjectArray jUids = env->NewObjectArray(count, g_string_class, nullptr);
+    if (!jValues || !jUids) {
+        return nullptr; // OutOfMemoryError pending
+    }
+
+    std::vector<jdouble> values((size_t)count * 3);
+    for (jsize i = 0; i < count; ++i) {
+        const CotTrackStore::Cluster& cluster = clusters[i];
+        values[i * 3] = cluster.lat;
+        values[i * 3 + 1] = cluster.lon;
+        values[i * 3 + 2] = (jdouble)cluster.count;
+
+        if (!cluster.uid.empty()) {
+            jstring uid = env->NewStringUTF(cluster.uid.c_str());
+            if (!uid) {
+                return nullptr;
+            }
+            env->SetObjectArrayElement(jUids, i, uid);
+            env->DeleteLocalRef(uid);
+        }
+    }
+    env->SetDoubleArrayRegion(jValues, 0, count * 3, values.data());
+
+    jobject result = env->NewObject(g_clusters_class, g_clusters_constructor, jValues, jUids);
+    env->DeleteLocalRef(jValues);
+    env->DeleteLocalRef(jUids);
+    return result;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeGetClusterExpansionZoom(
+    JNIEnv* env,
+    jobject thiz,
+    jint zoom,
+    jdouble lat,
+    jdouble lon
+) {
+    return (jint)g_track_store.cluster_expansion_zoom((int)zoom, lat, lon);
+}
+
+// Every track in the snapshot: parallel uid/type/callsign arrays, (lat, lon) pairs
+// (NaN without a position) and (stale, updated) millisecond pairs
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeGetSnapshotTracks(
+    JNIEnv* env,
+    jobject thiz
+) {
+    std::vector<CotTrackSnapshot::Track> tracks;
+    g_track_snapshot.tracks(tracks);
+
+    jsize count = (jsize)tracks.size();
+    jobjectArray jUids = env->NewObjectArray(count, g_string_class, nullptr);
+    jobjectArray jTypes = jUids ? env->NewObjectArray(count, g_string_class, nullptr) : nullptr;
+    jobjectArray jCallsigns = jTypes ? env->NewObjectArray(count, g_string_class, nullptr) : nullptr;
+    jdoubleArray jPositions = jCallsigns ? env->NewDoubleArray(count * 2) : nullptr;
+    jlongArray jTimes = jPositions ? env->NewLongArray(count * 2) : nullptr;
+    if (!jTimes) {
+        return nullptr; // OutOfMemoryError pending
+    }
+
+    std::vector<jdouble> positions((size_t)count * 2);
+    std::vector<jlong> times((size_t)count * 2);
+    for (jsize i = 0; i < count; ++i) {
+        const CotTrackSnapshot::Track& track = tracks[i];
+        const char* strings[] = {track.uid.c_str(), track.type.c_str(), track.callsign.c_str()};
+        jobjectArray arrays[] = {jUids, jTypes, jCallsigns};
+        for (size_t j = 0; j < 3; ++j) {
+            jstring value = string_to_jstring(env, strings[j]);
+            if (!value) {
+                return nullptr;
+            }
+            env->SetObjectArrayElement(arrays[j], i, value);
+            env->DeleteLocalRef(value);
+        }
+
+        positions[i * 2] = track.has_position ? track.lat : NAN;
+        positions[i * 2 + 1] = track.has_position ? track.lon : NAN;
+        times[i * 2] = (jlong)track.stale_ms;
+        times[i * 2 + 1] = (jlong)track.updated_ms;
+    }
+    env->SetDoubleArrayRegion(jPositions, 0, count * 2, positions.data());
+    env->SetLongArrayRegion(jTimes, 0, count * 2, times.data());
+
+    jobject result = env->NewObject(g_snapshot_class, g_snapshot_constructor,
+                                    jUids, jTypes, jCallsigns, jPositions, jTimes);
+    env->DeleteLocalRef(jUids);
+    env->DeleteLocalRef(jTypes);
+    env->DeleteLocalRef(jCallsigns);
+    env->DeleteLocalRef(jPositions);
+    env->DeleteLocalRef(jTimes);
+    return result;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeClearTrackSnapshot(
+    JNIEnv* env,
+    jobject thiz
+) {
+    g_track_snapshot.clear();
+}
+
+// Slab pool and coalescer allocation counters, shared by all connections:
+// { slabs, slabsInUse, peakSlabsInUse, allocations, allocatedBytes, reuses, coalescerAllocations }
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeGetPoolStats(
+    JNIEnv* env,
+    jobject thiz
+) {
+    CotSlabPool::Stats pool = g_slab_pool.stats();
+    jlong values[] = {
+        (jlong)pool.slabs,
+        (jlong)pool.in_use,
+        (jlong)pool.peak_in_use,
+        (jlong)pool.allocations,
+        (jlong)pool.allocated_bytes,
+        (jlong)pool.reuses,
+        (jlong)g_coalescer.allocations(),
+    };
+
+    jsize count = (jsize)(sizeof(values) / sizeof(values[0]));
+    jlongArray jValues = env->NewLongArray(count);
+    if (jValues) {
+        env->SetLongArrayRegion(jValues, 0, count, values);
+    }
+    return jValues;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeReleaseSlab(
+    JNIEnv* env,
+    jobject thiz,
+    jint slabId
+) {
+    g_slab_pool.release((uint32_t)slabId);
 }
 
 extern "C" JNIEXPORT jobject JNICALL
@@ -325,42 +2397,83 @@ Java_com_engindearing_omnitak_native_OmniTAKNativeBridge_nativeGetStatus(
 ) {
     LOGD("nativeGetStatus called for connection %lld", (long long)connectionId);
 
+    // A reconnecting connection reports on its current Rust connection, and stays
+    // visible (as not connected) while it is down
+    bool linked = false;
+    bool linkUp = false;
+    uint64_t rustId = (uint64_t)connectionId;
+    size_t outboundQueued = 0;
+    uint64_t outboundDropped = 0;
+    uint64_t reconnects = 0;
+    {
+        LinkTable::ReadGuard guard(g_links);
+        ReconnectLink* link = g_links.find((uint64_t)connectionId);
+        if (link) {
+            std::lock_guard<std::mutex> lock(link->mutex);
+            linked = true;
+            linkUp = link->up;
+            rustId = link->rust_id;
+            outboundQueued = link->queue.size();
+            outboundDropped = link->queue.dropped();
+            reconnects = link->reconnects;
+        }
+    }
+
     ConnectionStatus status;
-    int32_t result = omnitak_get_status((uint64_t)connectionId, &status);
+    int32_t result = omnitak_get_status(rustId, &status);
 
-    if (result != 0) {
+    if (result != 0 && !linked) {
         LOGE("Failed to get status: %d", result);
         return nullptr;
     }
-
-    // Create ConnectionStatusNative object
-    jclass statusClass = env->FindClass(
-        "com/engindearing/omnitak/native/OmniTAKNativeBridge$ConnectionStatusNative"
-    );
-
-    if (!statusClass) {
-        LOGE("Failed to find ConnectionStatusNative class");
-        return nullptr;
+    if (result != 0) {
+        status = ConnectionStatus();
+        status.last_error_code = result;
+    }
+    if (linked && !linkUp) {
+        status.is_connected = 0;
     }
 
-    jmethodID constructor = env->GetMethodID(statusClass, "<init>", "(IJJI)V");
-    if (!constructor) {
-        LOGE("Failed to find ConnectionStatusNative constructor");
-        env->DeleteLocalRef(statusClass);
-        return nullptr;
+    CotConnectionStats::Snapshot counters = {};
+    update_stats((uint64_t)connectionId, [&](CotConnectionStats& stats) { counters = stats.snapshot(); });
+
+    // Messages buffered for the next batched upcall
+    size_t queueDepth = 0;
+    {
+        CallbackTable::ReadGuard guard(g_callbacks);
+        CallbackContext* context = g_callbacks.find((uint64_t)connectionId);
+        if (context && context->batch) {
+            queueDepth = context->batch->pending();
+        }
     }
 
+    // Create ConnectionStatusNative object
     jobject statusObject = env->NewObject(
-        statusClass,
-        constructor,
+        g_status_class,
+        g_status_constructor,
         (jint)status.is_connected,
         (jlong)status.messages_sent,
         (jlong)status.messages_received,
-        (jint)status.last_error_code
+        (jint)status.last_error_code,
+        (jlong)counters.bytes_sent,
+        (jlong)counters.bytes_received,
+        (jlong)counters.send_failures,
+        (jlong)counters.rtt_us,
+        (jint)queueDepth,
+        (jlong)counters.upcalls,
+        (jlong)counters.upcall_p50_us,
+        (jlong)counters.upcall_p99_us,
+        (jlong)counters.upcall_max_us,
+        (jlong)counters.coalesced,
+        (jlong)counters.duplicates,
+        (jlong)counters.dropped,
+        (jint)outboundQueued,
+        (jlong)outboundDropped,
+        (jlong)reconnects,
+        (jlong)counters.native_allocations,
+        (jlong)counters.native_allocated_bytes
     );
 
-    env->DeleteLocalRef(statusClass);
-
     return statusObject;
 }
 
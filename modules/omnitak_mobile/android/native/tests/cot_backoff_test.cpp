@@ -0,0 +1,91 @@
+/**
+ * cot_backoff_test.cpp - Jitter bounds of CotBackoff
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+
+#include "../cot_backoff.h"
+#include "cot_test.h"
+
+// Ceiling of the nth delay: min(base * 2^n, max)
+static uint64_t ceiling_for(uint32_t base_ms, uint32_t max_ms, uint32_t attempt) {
+    uint64_t ceiling = (uint64_t)base_ms << std::min<uint32_t>(attempt, 31);
+    return std::min<uint64_t>(ceiling, max_ms);
+}
+
+static void test_delays_within_equal_jitter_bounds() {
+    for (uint64_t seed = 1; seed <= 500; ++seed) {
+        CotBackoff backoff(1000, 60000, seed);
+        for (uint32_t attempt = 0; attempt < 12; ++attempt) {
+            uint64_t ceiling = ceiling_for(1000, 60000, attempt);
+            uint32_t delay = backoff.next_delay_ms();
+            CHECK(delay >= ceiling / 2 && delay <= ceiling);
+        }
+        CHECK_EQ(backoff.attempts(), 12u);
+    }
+}
+
+static void test_reset_restarts_ceiling() {
+    CotBackoff backoff(1000, 60000, 42);
+    for (int i = 0; i < 8; ++i) {
+        backoff.next_delay_ms();
+    }
+    backoff.reset();
+    CHECK_EQ(backoff.attempts(), 0u);
+    uint32_t delay = backoff.next_delay_ms();
+    CHECK(delay >= 500 && delay <= 1000);
+}
+
+static void test_arguments_are_clamped() {
+    // A zero base becomes 1 ms
+    CotBackoff zero(0, 0, 7);
+    CHECK(zero.next_delay_ms() <= 1);
+
+    // A maximum below the base is raised to the base
+    CotBackoff inverted(5000, 100, 7);
+    for (int i = 0; i < 5; ++i) {
+        uint32_t delay = inverted.next_delay_ms();
+        CHECK(delay >= 2500 && delay <= 5000);
+    }
+
+    // Seed 0 would stall xorshift; it is replaced
+    CotBackoff unseeded(1000, 60000, 0);
+    std::set<uint32_t> delays;
+    for (int i = 0; i < 20; ++i) {
+        unseeded.reset();
+        delays.insert(unseeded.next_delay_ms());
+    }
+    CHECK(delays.size() > 1);
+}
+
+static void test_jitter_spreads_connections() {
+    // Connections that fail together draw different delays
+    std::set<uint32_t> delays;
+    for (uint64_t seed = 1; seed <= 100; ++seed) {
+        CotBackoff backoff(1000, 60000, seed * 0x9E3779B97F4A7C15ULL);
+        delays.insert(backoff.next_delay_ms());
+    }
+    CHECK(delays.size() > 50);
+}
+
+static void test_many_attempts_stay_at_max() {
+    CotBackoff backoff(1000, 60000, 3);
+    for (int i = 0; i < 100; ++i) {
+        uint32_t delay = backoff.next_delay_ms();
+        CHECK(delay <= 60000);
+        if (i >= 6) {
+            CHECK(delay >= 30000);
+        }
+    }
+}
+
+int main() {
+    RUN_TEST(test_delays_within_equal_jitter_bounds);
+    RUN_TEST(test_reset_restarts_ceiling);
+    RUN_TEST(test_arguments_are_clamped);
+    RUN_TEST(test_jitter_spreads_connections);
+    RUN_TEST(test_many_attempts_stay_at_max);
+    return cot_test_result();
+}
@@ -0,0 +1,101 @@
+/**
+ * cot_cluster_index_test.cpp - Per-zoom cluster merging in CotClusterIndex
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "../cot_cluster_index.h"
+#include "cot_test.h"
+
+static std::vector<CotClusterIndex::Cluster> query(const CotClusterIndex& index, int zoom,
+                                                   double min_lat, double min_lon,
+                                                   double max_lat, double max_lon) {
+    std::vector<CotClusterIndex::Cluster> clusters;
+    size_t total = index.query(zoom, min_lat, min_lon, max_lat, max_lon, 100, clusters);
+    CHECK_EQ(total, clusters.size());
+    return clusters;
+}
+
+static bool near(double a, double b) {
+    return std::fabs(a - b) < 1e-9;
+}
+
+static void test_nearby_tracks_merge_at_low_zoom() {
+    CotClusterIndex index;
+    index.add(7, 10.0, 10.0);
+    index.add(9, 10.02, 10.04);
+
+    std::vector<CotClusterIndex::Cluster> low = query(index, 4, 0, 0, 20, 20);
+    CHECK_EQ(low.size(), 1u);
+    if (low.size() == 1) {
+        CHECK_EQ(low[0].count, 2u);
+        CHECK(near(low[0].lat, 10.01));
+        CHECK(near(low[0].lon, 10.02));
+    }
+
+    std::vector<CotClusterIndex::Cluster> high = query(index, CotClusterIndex::kMaxZoom, 0, 0, 20, 20);
+    CHECK_EQ(high.size(), 2u);
+    for (const CotClusterIndex::Cluster& cluster : high) {
+        CHECK_EQ(cluster.count, 1u);
+        CHECK(cluster.key == 7 || cluster.key == 9);
+    }
+}
+
+static void test_zoom_is_clamped() {
+    CotClusterIndex index;
+    index.add(1, 10.0, 10.0);
+    index.add(2, 10.02, 10.04);
+
+    CHECK_EQ(query(index, -3, -80, -180, 80, 180).size(), query(index, 0, -80, -180, 80, 180).size());
+    CHECK_EQ(query(index, 40, 0, 0, 20, 20).size(), 2u);
+}
+
+static void test_move_and_remove() {
+    CotClusterIndex index;
+    index.add(1, 10.0, 10.0);
+    index.add(2, 10.02, 10.04);
+
+    index.move(2, 10.02, 10.04, -40.0, -100.0);
+    std::vector<CotClusterIndex::Cluster> old_area = query(index, 4, 0, 0, 20, 20);
+    CHECK_EQ(old_area.size(), 1u);
+    CHECK(old_area.size() == 1 && old_area[0].count == 1 && old_area[0].key == 1);
+    CHECK_EQ(query(index, 4, -50, -110, -30, -90).size(), 1u);
+
+    index.remove(1, 10.0, 10.0);
+    CHECK(query(index, 4, 0, 0, 20, 20).empty());
+    CHECK(query(index, 0, -85, -180, 85, 180).size() == 1);
+}
+
+static void test_expansion_zoom_splits_cluster() {
+    CotClusterIndex index;
+    index.add(1, 10.0, 10.0);
+    index.add(2, 10.02, 10.04);
+
+    int zoom = index.expansion_zoom(0, 10.0, 10.0);
+    CHECK(zoom > 0 && zoom <= CotClusterIndex::kMaxZoom);
+    CHECK_EQ(query(index, zoom - 1, 0, 0, 20, 20).size(), 1u);
+    CHECK_EQ(query(index, zoom, 0, 0, 20, 20).size(), 2u);
+
+    // A lone track never splits
+    index.add(3, -40.0, -100.0);
+    CHECK_EQ(index.expansion_zoom(0, -40.0, -100.0), CotClusterIndex::kMaxZoom + 1);
+}
+
+static void test_antimeridian_wrap() {
+    CotClusterIndex index;
+    index.add(1, 0.0, 179.9);
+    index.add(2, 0.0, -179.9);
+    index.add(3, 0.0, 0.0);
+
+    CHECK_EQ(query(index, 10, -1, 179.0, 1, -179.0).size(), 2u);
+}
+
+int main() {
+    RUN_TEST(test_nearby_tracks_merge_at_low_zoom);
+    RUN_TEST(test_zoom_is_clamped);
+    RUN_TEST(test_move_and_remove);
+    RUN_TEST(test_expansion_zoom_splits_cluster);
+    RUN_TEST(test_antimeridian_wrap);
+    return cot_test_result();
+}
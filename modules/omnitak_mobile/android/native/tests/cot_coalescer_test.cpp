@@ -0,0 +1,133 @@
+/**
+ * cot_coalescer_test.cpp - Per-uid dedup and windowed coalescing of CotCoalescer
+ */
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../cot_coalescer.h"
+#include "cot_test.h"
+
+using Result = CotCoalescer::Result;
+using Clock = CotCoalescer::Clock;
+
+static Result offer(CotCoalescer& coalescer, uint64_t connection_id, const char* uid, const char* xml,
+                    Clock::time_point now) {
+    return coalescer.offer(connection_id, uid, strlen(uid), xml, strlen(xml), now);
+}
+
+static Clock::time_point at(Clock::time_point start, int ms) {
+    return start + std::chrono::milliseconds(ms);
+}
+
+static void test_disabled_delivers_everything() {
+    CotCoalescer coalescer;
+    Clock::time_point now = Clock::now();
+
+    CHECK(!coalescer.enabled());
+    CHECK(offer(coalescer, 1, "a", "<event/>", now) == Result::Deliver);
+    CHECK(offer(coalescer, 1, "a", "<event/>", now) == Result::Deliver);
+    CHECK_EQ(coalescer.duplicates(), 0u);
+}
+
+static void test_duplicates_dropped_by_uid() {
+    CotCoalescer coalescer;
+    coalescer.set_window(100);
+    Clock::time_point start = Clock::now();
+
+    CHECK(offer(coalescer, 1, "a", "<event v='1'/>", start) == Result::Deliver);
+    // The same event over another connection, even after the window
+    CHECK(offer(coalescer, 2, "a", "<event v='1'/>", at(start, 10)) == Result::Duplicate);
+    CHECK(offer(coalescer, 1, "a", "<event v='1'/>", at(start, 500)) == Result::Duplicate);
+    // Another uid with the same payload is its own track
+    CHECK(offer(coalescer, 1, "b", "<event v='1'/>", at(start, 10)) == Result::Deliver);
+    CHECK_EQ(coalescer.duplicates(), 2u);
+
+    // A copy of the held update is a duplicate too
+    CHECK(offer(coalescer, 1, "a", "<event v='2'/>", at(start, 510)) == Result::Deliver);
+    CHECK(offer(coalescer, 1, "a", "<event v='3'/>", at(start, 520)) == Result::Held);
+    CHECK(offer(coalescer, 2, "a", "<event v='3'/>", at(start, 530)) == Result::Duplicate);
+}
+
+static void test_window_flush() {
+    CotCoalescer coalescer;
+    coalescer.set_window(100);
+    Clock::time_point start = Clock::now();
+
+    CHECK(offer(coalescer, 1, "a", "<event v='1'/>", start) == Result::Deliver);
+    CHECK(offer(coalescer, 1, "a", "<event v='2'/>", at(start, 20)) == Result::Held);
+
+    std::vector<CotCoalescer::Pending> due;
+    CHECK_EQ(coalescer.take_due(at(start, 99), due), 0u);
+    CHECK_EQ(coalescer.take_due(at(start, 100), due), 1u);
+    CHECK(due[0].connection_id == 1 && due[0].xml == "<event v='2'/>");
+    CHECK_EQ(coalescer.take_due(at(start, 300), due), 0u);
+
+    // The flush counts as a delivery and starts a new window
+    CHECK(offer(coalescer, 1, "a", "<event v='3'/>", at(start, 150)) == Result::Held);
+    CHECK(offer(coalescer, 1, "a", "<event v='4'/>", at(start, 250)) == Result::Replaced);
+    CHECK(offer(coalescer, 1, "a", "<event v='5'/>", at(start, 260)) == Result::Replaced);
+    CHECK_EQ(coalescer.take_due(at(start, 200), due), 1u);
+    CHECK(offer(coalescer, 1, "a", "<event v='6'/>", at(start, 400)) == Result::Deliver);
+}
+
+static void test_latest_event_wins() {
+    CotCoalescer coalescer;
+    coalescer.set_window(100);
+    Clock::time_point start = Clock::now();
+
+    offer(coalescer, 1, "a", "<event v='1'/>", start);
+    CHECK(offer(coalescer, 1, "a", "<event v='2'/>", at(start, 10)) == Result::Held);
+    CHECK(offer(coalescer, 2, "a", "<event v='3'/>", at(start, 20)) == Result::Replaced);
+    CHECK(offer(coalescer, 3, "a", "<event v='4'/>", at(start, 30)) == Result::Replaced);
+    CHECK_EQ(coalescer.coalesced(), 2u);
+
+    // One upcall per window, carrying the newest update and its connection
+    std::vector<CotCoalescer::Pending> due;
+    CHECK_EQ(coalescer.take_due(at(start, 100), due), 1u);
+    CHECK(due[0].connection_id == 3 && due[0].xml == "<event v='4'/>");
+}
+
+static void test_take_due_reuses_buffers() {
+    CotCoalescer coalescer;
+    coalescer.set_window(100);
+    Clock::time_point start = Clock::now();
+
+    std::vector<CotCoalescer::Pending> due;
+    for (int round = 0; round < 3; ++round) {
+        Clock::time_point base = at(start, round * 1000);
+        offer(coalescer, 1, "a", round % 2 ? "<event v='1'/>" : "<event v='0'/>", base);
+        offer(coalescer, 1, "b", round % 2 ? "<event v='1'/>" : "<event v='0'/>", base);
+        offer(coalescer, 1, "a", "<event v='held'/>", at(base, 10));
+        offer(coalescer, 1, "b", "<event v='held'/>", at(base, 10));
+        CHECK_EQ(coalescer.take_due(at(base, 100), due), 2u);
+        CHECK(due[0].xml == "<event v='held'/>" && due[1].xml == "<event v='held'/>");
+    }
+    CHECK_EQ(due.size(), 2u);
+}
+
+static void test_clear_forgets_tracks() {
+    CotCoalescer coalescer;
+    coalescer.set_window(100);
+    Clock::time_point start = Clock::now();
+
+    offer(coalescer, 1, "a", "<event v='1'/>", start);
+    offer(coalescer, 1, "a", "<event v='2'/>", at(start, 10));
+    coalescer.clear();
+
+    std::vector<CotCoalescer::Pending> due;
+    CHECK_EQ(coalescer.take_due(at(start, 200), due), 0u);
+    CHECK(offer(coalescer, 1, "a", "<event v='1'/>", at(start, 20)) == Result::Deliver);
+}
+
+int main() {
+    RUN_TEST(test_disabled_delivers_everything);
+    RUN_TEST(test_duplicates_dropped_by_uid);
+    RUN_TEST(test_window_flush);
+    RUN_TEST(test_latest_event_wins);
+    RUN_TEST(test_take_due_reuses_buffers);
+    RUN_TEST(test_clear_forgets_tracks);
+    return cot_test_result();
+}
@@ -0,0 +1,108 @@
+/**
+ * cot_fan_in_test.cpp - Cross-connection dedup and queue order of CotFanIn
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../cot_fan_in.h"
+#include "cot_test.h"
+
+using Result = CotFanIn::Result;
+
+static Result admit(CotFanIn& fan_in, const char* uid, int64_t time_ms, const char* xml,
+                    CotFanIn::Clock::time_point now) {
+    return fan_in.admit(uid, uid ? strlen(uid) : 0, time_ms, xml, strlen(xml), now);
+}
+
+static void test_dedup_by_uid_and_time() {
+    CotFanIn fan_in(8);
+    CotFanIn::Clock::time_point now = CotFanIn::Clock::now();
+
+    CHECK(admit(fan_in, "a", 1000, "<event/>", now) == Result::Accepted);
+    // Gateways re-encode, so a different body with the same time is still a copy
+    CHECK(admit(fan_in, "a", 1000, "<event />", now) == Result::Duplicate);
+    CHECK(admit(fan_in, "a", 900, "<event/>", now) == Result::Older);
+    CHECK(admit(fan_in, "a", 1100, "<event/>", now) == Result::Accepted);
+    CHECK(admit(fan_in, "a", 1000, "<event/>", now) == Result::Older);
+    CHECK(admit(fan_in, "b", 1000, "<event/>", now) == Result::Accepted);
+}
+
+static void test_dedup_without_time_by_content() {
+    CotFanIn fan_in(8);
+    CotFanIn::Clock::time_point now = CotFanIn::Clock::now();
+
+    CHECK(admit(fan_in, "a", 0, "<event v='1'/>", now) == Result::Accepted);
+    CHECK(admit(fan_in, "a", 0, "<event v='1'/>", now) == Result::Duplicate);
+    CHECK(admit(fan_in, "a", 0, "<event v='2'/>", now) == Result::Accepted);
+}
+
+static void test_window_expiry_accepts_again() {
+    CotFanIn fan_in(8);
+    fan_in.set_window(100);
+    CotFanIn::Clock::time_point now = CotFanIn::Clock::now();
+
+    CHECK(admit(fan_in, "a", 1000, "<event/>", now) == Result::Accepted);
+    CHECK(admit(fan_in, "a", 1000, "<event/>", now + std::chrono::milliseconds(50)) == Result::Duplicate);
+    CHECK(admit(fan_in, "a", 1000, "<event/>", now + std::chrono::milliseconds(150)) == Result::Accepted);
+}
+
+static void test_events_without_uid_pass() {
+    CotFanIn fan_in(8);
+    CotFanIn::Clock::time_point now = CotFanIn::Clock::now();
+
+    CHECK(admit(fan_in, nullptr, 1000, "<event/>", now) == Result::Accepted);
+    CHECK(admit(fan_in, nullptr, 1000, "<event/>", now) == Result::Accepted);
+}
+
+static void test_take_keeps_arrival_order() {
+    CotFanIn fan_in(8);
+    uint64_t dropped_source = 0;
+    CHECK(fan_in.push(1, "one", 3, &dropped_source));
+    CHECK(fan_in.push(2, "two", 3, &dropped_source));
+    CHECK(fan_in.push(1, "three", 5, &dropped_source));
+
+    std::vector<CotFanIn::Event> events;
+    CHECK_EQ(fan_in.take(CotFanIn::Clock::now(), events), 3u);
+    CHECK(events[0].source == 1 && events[0].xml == "one");
+    CHECK(events[1].source == 2 && events[1].xml == "two");
+    CHECK(events[2].source == 1 && events[2].xml == "three");
+
+    CHECK_EQ(fan_in.take(CotFanIn::Clock::now(), events), 0u);
+}
+
+static void test_full_queue_drops_oldest() {
+    CotFanIn fan_in(2);
+    uint64_t dropped_source = 0;
+    CHECK(fan_in.push(1, "one", 3, &dropped_source));
+    CHECK(fan_in.push(2, "two", 3, &dropped_source));
+    CHECK(!fan_in.push(3, "three", 5, &dropped_source));
+    CHECK_EQ(dropped_source, 1u);
+    CHECK_EQ(fan_in.dropped(), 1u);
+
+    std::vector<CotFanIn::Event> events;
+    CHECK_EQ(fan_in.take(CotFanIn::Clock::now(), events), 2u);
+    CHECK(events[0].source == 2 && events[0].xml == "two");
+    CHECK(events[1].source == 3 && events[1].xml == "three");
+}
+
+static void test_clear_forgets_uids() {
+    CotFanIn fan_in(8);
+    CotFanIn::Clock::time_point now = CotFanIn::Clock::now();
+
+    CHECK(admit(fan_in, "a", 1000, "<event/>", now) == Result::Accepted);
+    fan_in.clear();
+    CHECK(admit(fan_in, "a", 1000, "<event/>", now) == Result::Accepted);
+}
+
+int main() {
+    RUN_TEST(test_dedup_by_uid_and_time);
+    RUN_TEST(test_dedup_without_time_by_content);
+    RUN_TEST(test_window_expiry_accepts_again);
+    RUN_TEST(test_events_without_uid_pass);
+    RUN_TEST(test_take_keeps_arrival_order);
+    RUN_TEST(test_full_queue_drops_oldest);
+    RUN_TEST(test_clear_forgets_uids);
+    return cot_test_result();
+}
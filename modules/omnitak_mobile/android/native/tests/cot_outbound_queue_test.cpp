@@ -0,0 +1,95 @@
+/**
+ * cot_outbound_queue_test.cpp - Lane bounds and ordering of CotOutboundQueue
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../cot_outbound_queue.h"
+#include "cot_test.h"
+
+using Result = CotOutboundQueue::Result;
+
+static Result push(CotOutboundQueue& queue, CotPriority priority, const char* uid, const char* xml) {
+    return queue.push(priority, uid, strlen(uid), xml, strlen(xml));
+}
+
+static std::vector<std::string> drain(CotOutboundQueue& queue) {
+    std::vector<CotOutboundQueue::Entry> entries;
+    queue.drain(entries);
+    std::vector<std::string> xml;
+    for (const CotOutboundQueue::Entry& entry : entries) {
+        xml.push_back(entry.xml);
+    }
+    return xml;
+}
+
+static void test_full_pli_lane_drops_oldest() {
+    CotOutboundQueue queue(2);
+    CHECK(push(queue, CotPriority::Pli, "a", "a1") == Result::Queued);
+    CHECK(push(queue, CotPriority::Pli, "b", "b1") == Result::Queued);
+    CHECK(push(queue, CotPriority::Pli, "c", "c1") == Result::DroppedOldest);
+    CHECK_EQ(queue.size(), 2u);
+    CHECK_EQ(queue.dropped(), 1u);
+    CHECK(drain(queue) == std::vector<std::string>({"b1", "c1"}));
+    CHECK(queue.empty());
+}
+
+static void test_full_lane_refuses_other_priorities() {
+    CotOutboundQueue queue(2);
+    CHECK(push(queue, CotPriority::Chat, "", "m1") == Result::Queued);
+    CHECK(push(queue, CotPriority::Chat, "", "m2") == Result::Queued);
+    CHECK(push(queue, CotPriority::Chat, "", "m3") == Result::Full);
+    CHECK_EQ(queue.dropped(), 0u);
+
+    // Lanes are bounded separately
+    CHECK(push(queue, CotPriority::Emergency, "", "sos") == Result::Queued);
+    CHECK(drain(queue) == std::vector<std::string>({"sos", "m1", "m2"}));
+}
+
+static void test_pli_replaces_same_uid() {
+    CotOutboundQueue queue(4);
+    push(queue, CotPriority::Pli, "a", "a1");
+    push(queue, CotPriority::Pli, "b", "b1");
+    CHECK(push(queue, CotPriority::Pli, "a", "a2") == Result::Replaced);
+    CHECK_EQ(queue.size(), 2u);
+    CHECK(drain(queue) == std::vector<std::string>({"b1", "a2"}));
+}
+
+static void test_drain_most_urgent_first() {
+    CotOutboundQueue queue(4);
+    push(queue, CotPriority::Pli, "a", "pli");
+    push(queue, CotPriority::Other, "", "other");
+    push(queue, CotPriority::Chat, "", "chat");
+    push(queue, CotPriority::Tasking, "", "tasking");
+    push(queue, CotPriority::Emergency, "", "sos");
+    CHECK(drain(queue) == std::vector<std::string>({"sos", "chat", "tasking", "other", "pli"}));
+}
+
+static void test_restore_puts_tail_back_first() {
+    CotOutboundQueue queue(4);
+    push(queue, CotPriority::Chat, "", "m1");
+    push(queue, CotPriority::Chat, "", "m2");
+    push(queue, CotPriority::Pli, "a", "a1");
+    push(queue, CotPriority::Pli, "b", "b1");
+
+    std::vector<CotOutboundQueue::Entry> batch;
+    queue.drain(batch);
+
+    // m1 was sent; meanwhile a new chat and a newer report for "a" were queued
+    push(queue, CotPriority::Chat, "", "m3");
+    push(queue, CotPriority::Pli, "a", "a2");
+    queue.restore(batch, 1);
+
+    CHECK(drain(queue) == std::vector<std::string>({"m2", "m3", "b1", "a2"}));
+}
+
+int main() {
+    RUN_TEST(test_full_pli_lane_drops_oldest);
+    RUN_TEST(test_full_lane_refuses_other_priorities);
+    RUN_TEST(test_pli_replaces_same_uid);
+    RUN_TEST(test_drain_most_urgent_first);
+    RUN_TEST(test_restore_puts_tail_back_first);
+    return cot_test_result();
+}
@@ -0,0 +1,114 @@
+/**
+ * cot_spatial_index_test.cpp - Box queries over CotSpatialIndex
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "../cot_spatial_index.h"
+#include "cot_test.h"
+
+static std::vector<uint64_t> query(const CotSpatialIndex& index, double min_lat, double min_lon,
+                                   double max_lat, double max_lon) {
+    std::vector<uint64_t> keys;
+    index.query(min_lat, min_lon, max_lat, max_lon, [&](uint64_t key, double, double) {
+        keys.push_back(key);
+        return true;
+    });
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+static void test_box_query() {
+    CotSpatialIndex index(0.25);
+    index.insert(1, 10.0, 20.0);
+    index.insert(2, 10.1, 20.1);
+    index.insert(3, -30.0, 40.0);
+
+    CHECK(query(index, 9.9, 19.9, 10.2, 20.2) == std::vector<uint64_t>({1, 2}));
+    CHECK(query(index, 10.05, 20.05, 10.2, 20.2) == std::vector<uint64_t>({2}));
+    CHECK(query(index, 0, 0, 1, 1).empty());
+    CHECK_EQ(index.size(), 3u);
+}
+
+static void test_reinsert_moves() {
+    CotSpatialIndex index(0.25);
+    index.insert(1, 10.0, 20.0);
+    index.insert(1, 50.0, 60.0);
+
+    CHECK(query(index, 9.9, 19.9, 10.1, 20.1).empty());
+    CHECK(query(index, 49.9, 59.9, 50.1, 60.1) == std::vector<uint64_t>({1}));
+    CHECK_EQ(index.size(), 1u);
+
+    index.remove(1);
+    CHECK(query(index, 49.9, 59.9, 50.1, 60.1).empty());
+    CHECK_EQ(index.size(), 0u);
+}
+
+static void test_remove_keeps_cell_neighbours() {
+    CotSpatialIndex index(0.25);
+    index.insert(1, 10.01, 20.01);
+    index.insert(2, 10.02, 20.02);
+    index.insert(3, 10.03, 20.03);
+
+    index.remove(1);
+    CHECK(query(index, 10.0, 20.0, 10.1, 20.1) == std::vector<uint64_t>({2, 3}));
+    index.insert(4, 10.04, 20.04);
+    index.remove(3);
+    CHECK(query(index, 10.0, 20.0, 10.1, 20.1) == std::vector<uint64_t>({2, 4}));
+}
+
+static void test_antimeridian_wrap() {
+    CotSpatialIndex index(0.25);
+    index.insert(1, 0.0, 179.5);
+    index.insert(2, 0.0, -179.5);
+    index.insert(3, 0.0, 0.0);
+
+    CHECK(query(index, -1, 179.0, 1, -179.0) == std::vector<uint64_t>({1, 2}));
+}
+
+static void test_visitor_stops() {
+    CotSpatialIndex index(0.25);
+    for (uint64_t key = 1; key <= 10; ++key) {
+        index.insert(key, 10.0 + key * 0.01, 20.0);
+    }
+
+    int visited = 0;
+    index.query(9.0, 19.0, 11.0, 21.0, [&](uint64_t, double, double) {
+        return ++visited < 3;
+    });
+    CHECK_EQ(visited, 3);
+}
+
+static void test_large_box_matches_cell_walk() {
+    CotSpatialIndex index(0.25);
+    auto lat_of = [](uint64_t key) { return 10.0 + (double)(key % 20) * 0.1; };
+    auto lon_of = [](uint64_t key) { return 20.0 + (double)(key / 20) * 0.1; };
+    for (uint64_t key = 0; key < 200; ++key) {
+        index.insert(key, lat_of(key), lon_of(key));
+    }
+
+    // The world box covers more cells than are occupied and scans every entry;
+    // the small box covers fewer and walks its cells
+    std::vector<uint64_t> world = query(index, -90, -180, 90, 180);
+    CHECK_EQ(world.size(), 200u);
+
+    std::vector<uint64_t> expected;
+    for (uint64_t key : world) {
+        if (lat_of(key) >= 10.35 && lat_of(key) <= 10.75 && lon_of(key) >= 20.25 && lon_of(key) <= 20.55) {
+            expected.push_back(key);
+        }
+    }
+    CHECK(!expected.empty());
+    CHECK(query(index, 10.35, 20.25, 10.75, 20.55) == expected);
+}
+
+int main() {
+    RUN_TEST(test_box_query);
+    RUN_TEST(test_reinsert_moves);
+    RUN_TEST(test_remove_keeps_cell_neighbours);
+    RUN_TEST(test_antimeridian_wrap);
+    RUN_TEST(test_visitor_stops);
+    RUN_TEST(test_large_box_matches_cell_walk);
+    return cot_test_result();
+}
@@ -0,0 +1,35 @@
+/**
+ * cot_test.h - Minimal checks for the native unit tests
+ *
+ * Each test is its own executable with no framework, so the tests build with
+ * the NDK alone. A failed CHECK prints where it happened and the test keeps
+ * going; main() returns cot_test_result(), non-zero if any check failed.
+ */
+
+#pragma once
+
+#include <cstdio>
+
+static int g_cot_test_failures = 0;
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++g_cot_test_failures;                                                    \
+        }                                                                             \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) CHECK((actual) == (expected))
+
+// Run one test function and print PASS or FAIL with its name
+#define RUN_TEST(test)                                                               \
+    do {                                                                             \
+        int failuresBefore = g_cot_test_failures;                                    \
+        test();                                                                      \
+        printf("%s %s\n", g_cot_test_failures == failuresBefore ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+static inline int cot_test_result() {
+    return g_cot_test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/**
+ * cot_track_store_test.cpp - Stale-time expiry of CotTrackStore
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../cot_track_store.h"
+#include "cot_test.h"
+
+static const int64_t kTtlMs = 1000;
+
+static bool update(CotTrackStore& store, const char* uid, int64_t stale_ms, int64_t now_ms = 0) {
+    return store.update(uid, strlen(uid), stale_ms, false, 0, 0, now_ms);
+}
+
+static std::vector<std::string> take_expired(CotTrackStore& store, int64_t now_ms) {
+    std::vector<CotTrackStore::Expired> expired;
+    store.take_expired(now_ms, expired);
+    std::vector<std::string> uids;
+    for (const CotTrackStore::Expired& track : expired) {
+        uids.push_back(track.uid);
+    }
+    return uids;
+}
+
+static void test_expires_in_stale_order() {
+    CotTrackStore store(16, kTtlMs);
+    update(store, "a", 100);
+    update(store, "b", 50);
+    update(store, "c", 200);
+
+    CHECK(take_expired(store, 49).empty());
+    CHECK(take_expired(store, 50) == std::vector<std::string>({"b"}));
+    CHECK(take_expired(store, 250) == std::vector<std::string>({"a", "c"}));
+    CHECK_EQ(store.size(), 0u);
+}
+
+static void test_newer_stale_time_supersedes() {
+    CotTrackStore store(16, kTtlMs);
+    update(store, "a", 100);
+    update(store, "a", 500);
+
+    // The entry for 100 is still in the heap but belongs to an old generation
+    CHECK(take_expired(store, 200).empty());
+    CHECK_EQ(store.size(), 1u);
+
+    std::vector<CotTrackStore::Expired> expired;
+    store.take_expired(500, expired);
+    CHECK_EQ(expired.size(), 1u);
+    CHECK(expired.size() == 1 && expired[0].stale_ms == 500);
+}
+
+static void test_rebroadcast_expires_once() {
+    CotTrackStore store(16, kTtlMs);
+    for (int i = 0; i < 10; ++i) {
+        update(store, "a", 100);
+    }
+    CHECK(take_expired(store, 100) == std::vector<std::string>({"a"}));
+    CHECK(take_expired(store, 1000).empty());
+}
+
+static void test_superseded_entries_are_compacted() {
+    CotTrackStore store(16, kTtlMs);
+    for (int64_t stale = 1; stale <= 5000; ++stale) {
+        update(store, "a", stale);
+        update(store, "b", stale);
+    }
+    CHECK(take_expired(store, 4999).empty());
+    CHECK_EQ(take_expired(store, 5000).size(), 2u);
+    CHECK(take_expired(store, 10000).empty());
+}
+
+static void test_missing_stale_time_gets_default_ttl() {
+    CotTrackStore store(16, kTtlMs);
+    update(store, "a", 0, 5000);
+    CHECK(take_expired(store, 5999).empty());
+
+    // Every update without a stale time re-arms the TTL
+    update(store, "a", 0, 5500);
+    CHECK(take_expired(store, 6000).empty());
+
+    std::vector<CotTrackStore::Expired> expired;
+    store.take_expired(6500, expired);
+    CHECK_EQ(expired.size(), 1u);
+    CHECK(expired.size() == 1 && expired[0].stale_ms == 6500);
+}
+
+static void test_expiry_leaves_the_index() {
+    CotTrackStore store(16, kTtlMs);
+    store.update("a", 1, 100, true, 10.0, 20.0, 0);
+
+    std::vector<CotTrackStore::Position> positions;
+    CHECK_EQ(store.query_region(9, 19, 11, 21, 10, positions), 1u);
+
+    take_expired(store, 100);
+    positions.clear();
+    CHECK_EQ(store.query_region(9, 19, 11, 21, 10, positions), 0u);
+}
+
+static void test_full_store_makes_room_after_expiry() {
+    CotTrackStore store(2, kTtlMs);
+    CHECK(update(store, "a", 100));
+    CHECK(update(store, "b", 200));
+    CHECK(!update(store, "c", 300));
+    CHECK(update(store, "a", 150)); // Known uids still update
+
+    take_expired(store, 150);
+    CHECK(update(store, "c", 300));
+    CHECK_EQ(store.size(), 2u);
+}
+
+int main() {
+    RUN_TEST(test_expires_in_stale_order);
+    RUN_TEST(test_newer_stale_time_supersedes);
+    RUN_TEST(test_rebroadcast_expires_once);
+    RUN_TEST(test_superseded_entries_are_compacted);
+    RUN_TEST(test_missing_stale_time_gets_default_ttl);
+    RUN_TEST(test_expiry_leaves_the_index);
+    RUN_TEST(test_full_store_makes_room_after_expiry);
+    return cot_test_result();
+}
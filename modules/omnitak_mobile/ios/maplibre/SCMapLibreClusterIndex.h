@@ -0,0 +1,54 @@
+//
+//  SCMapLibreClusterIndex.h
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Incremental per-zoom marker clustering for SCMapLibreTrackLayer.
+//
+
+#import <Foundation/Foundation.h>
+
+@import MapLibre;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Highest zoom level with clusters; above it every marker stands alone
+extern const NSInteger SCMapLibreClusterMaxZoom;
+
+/// A group of nearby markers at one zoom level
+@interface SCMapLibreCluster : NSObject
+
+/// Centroid of the cluster's markers
+@property (nonatomic, readonly) CLLocationCoordinate2D coordinate;
+@property (nonatomic, readonly) NSUInteger count;
+/// The marker's ID when count is 1
+@property (nonatomic, copy, readonly, nullable) NSString *markerId;
+
+@end
+
+/**
+ * SCMapLibreClusterIndex keeps, for every zoom level up to
+ * SCMapLibreClusterMaxZoom, a grid of Web Mercator cells a quarter tile wide
+ * (about 64pt). Each cell stores only a count and coordinate sums, so adding,
+ * moving or removing a marker touches one cell per level instead of
+ * re-clustering the whole set. Mirrors CotClusterIndex on Android.
+ */
+@interface SCMapLibreClusterIndex : NSObject
+
+- (void)addMarkerId:(NSString *)markerId coordinate:(CLLocationCoordinate2D)coordinate;
+- (void)moveMarkerId:(NSString *)markerId
+                from:(CLLocationCoordinate2D)oldCoordinate
+                  to:(CLLocationCoordinate2D)coordinate;
+- (void)removeMarkerId:(NSString *)markerId coordinate:(CLLocationCoordinate2D)coordinate;
+- (void)removeAllMarkers;
+
+/// Clusters of `zoom` (clamped to 0...SCMapLibreClusterMaxZoom) whose cell overlaps `bounds`.
+/// Longitudes are compared modulo 360, so bounds crossing the antimeridian work.
+- (NSArray<SCMapLibreCluster *> *)clustersAtZoom:(NSInteger)zoom inBounds:(MLNCoordinateBounds)bounds;
+
+/// Lowest zoom above `zoom` at which the cluster containing `coordinate` splits,
+/// or SCMapLibreClusterMaxZoom + 1 if it never does
+- (NSInteger)expansionZoomForClusterAtZoom:(NSInteger)zoom coordinate:(CLLocationCoordinate2D)coordinate;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,258 @@
+//
+//  SCMapLibreClusterIndex.m
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Implementation of incremental per-zoom marker clustering.
+//
+
+#import "SCMapLibreClusterIndex.h"
+
+const NSInteger SCMapLibreClusterMaxZoom = 16;
+
+static const double kMaxMercatorLatitude = 85.0511287798;
+
+@interface SCMapLibreCluster ()
+
+@property (nonatomic, assign) CLLocationCoordinate2D coordinate;
+@property (nonatomic, assign) NSUInteger count;
+@property (nonatomic, copy, nullable) NSString *markerId;
+
+@end
+
+@implementation SCMapLibreCluster
+@end
+
+// Running totals for one grid cell. serialSum is the marker serial when count is 1.
+@interface SCMapLibreClusterCell : NSObject {
+@public
+    NSUInteger count;
+    double latitudeSum;
+    double longitudeSum;
+    uint64_t serialSum;
+}
+@end
+
+@implementation SCMapLibreClusterCell
+@end
+
+@interface SCMapLibreClusterIndex ()
+
+@property (nonatomic, strong) NSArray<NSMutableDictionary<NSNumber *, SCMapLibreClusterCell *> *> *levels;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *serialsByMarkerId;
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSString *> *markerIdsBySerial;
+@property (nonatomic, assign) uint64_t nextSerial;
+
+@end
+
+@implementation SCMapLibreClusterIndex
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        NSMutableArray *levels = [NSMutableArray arrayWithCapacity:SCMapLibreClusterMaxZoom + 1];
+        for (NSInteger zoom = 0; zoom <= SCMapLibreClusterMaxZoom; zoom++) {
+            [levels addObject:[NSMutableDictionary dictionary]];
+        }
+        _levels = levels;
+        _serialsByMarkerId = [NSMutableDictionary dictionary];
+        _markerIdsBySerial = [NSMutableDictionary dictionary];
+        _nextSerial = 1;
+    }
+    return self;
+}
+
+#pragma mark - Grid
+
+// Cells per axis at a zoom level: 2^zoom tiles, four cells per tile
+static uint32_t SCGridSize(NSInteger zoom) {
+    return 1u << (zoom + 2);
+}
+
+static uint32_t SCClampCell(double value, uint32_t size) {
+    if (!(value > 0)) {
+        return 0;
+    }
+    return value >= size ? size - 1 : (uint32_t)value;
+}
+
+static double SCNormalizedLongitude(double longitude) {
+    return longitude - 360.0 * floor((longitude + 180.0) / 360.0);
+}
+
+static uint32_t SCColumnForLongitude(NSInteger zoom, double longitude) {
+    uint32_t size = SCGridSize(zoom);
+    return SCClampCell(floor((SCNormalizedLongitude(longitude) + 180.0) / 360.0 * size), size);
+}
+
+// Web Mercator row, 0 at the north edge
+static uint32_t SCRowForLatitude(NSInteger zoom, double latitude) {
+    double clamped = MAX(-kMaxMercatorLatitude, MIN(kMaxMercatorLatitude, latitude));
+    double radians = clamped * M_PI / 180.0;
+    double y = (1.0 - log(tan(radians) + 1.0 / cos(radians)) / M_PI) / 2.0;
+
+    uint32_t size = SCGridSize(zoom);
+    return SCClampCell(floor(y * size), size);
+}
+
+static NSNumber *SCCellKey(uint32_t x, uint32_t y) {
+    return @(((uint64_t)y << 32) | x);
+}
+
+static NSNumber *SCCellKeyForCoordinate(NSInteger zoom, CLLocationCoordinate2D coordinate) {
+    return SCCellKey(SCColumnForLongitude(zoom, coordinate.longitude), SCRowForLatitude(zoom, coordinate.latitude));
+}
+
+#pragma mark - Updates
+
+- (void)addSerial:(uint64_t)serial coordinate:(CLLocationCoordinate2D)coordinate toCellKey:(NSNumber *)cellKey zoom:(NSInteger)zoom {
+    NSMutableDictionary<NSNumber *, SCMapLibreClusterCell *> *level = _levels[zoom];
+    SCMapLibreClusterCell *cell = level[cellKey];
+    if (!cell) {
+        cell = [[SCMapLibreClusterCell alloc] init];
+        level[cellKey] = cell;
+    }
+    cell->count++;
+    cell->latitudeSum += coordinate.latitude;
+    cell->longitudeSum += coordinate.longitude;
+    cell->serialSum += serial;
+}
+
+- (void)removeSerial:(uint64_t)serial coordinate:(CLLocationCoordinate2D)coordinate fromCellKey:(NSNumber *)cellKey zoom:(NSInteger)zoom {
+    NSMutableDictionary<NSNumber *, SCMapLibreClusterCell *> *level = _levels[zoom];
+    SCMapLibreClusterCell *cell = level[cellKey];
+    if (!cell) {
+        return;
+    }
+    if (--cell->count == 0) {
+        [level removeObjectForKey:cellKey];
+        return;
+    }
+    cell->latitudeSum -= coordinate.latitude;
+    cell->longitudeSum -= coordinate.longitude;
+    cell->serialSum -= serial;
+}
+
+- (void)addMarkerId:(NSString *)markerId coordinate:(CLLocationCoordinate2D)coordinate {
+    if (_serialsByMarkerId[markerId]) {
+        return;
+    }
+
+    uint64_t serial = _nextSerial++;
+    _serialsByMarkerId[markerId] = @(serial);
+    _markerIdsBySerial[@(serial)] = markerId;
+
+    for (NSInteger zoom = 0; zoom <= SCMapLibreClusterMaxZoom; zoom++) {
+        [self addSerial:serial coordinate:coordinate toCellKey:SCCellKeyForCoordinate(zoom, coordinate) zoom:zoom];
+    }
+}
+
+- (void)moveMarkerId:(NSString *)markerId
+                from:(CLLocationCoordinate2D)oldCoordinate
+                  to:(CLLocationCoordinate2D)coordinate {
+    NSNumber *serialNumber = _serialsByMarkerId[markerId];
+    if (!serialNumber) {
+        [self addMarkerId:markerId coordinate:coordinate];
+        return;
+    }
+    uint64_t serial = [serialNumber unsignedLongLongValue];
+
+    for (NSInteger zoom = 0; zoom <= SCMapLibreClusterMaxZoom; zoom++) {
+        NSNumber *from = SCCellKeyForCoordinate(zoom, oldCoordinate);
+        NSNumber *to = SCCellKeyForCoordinate(zoom, coordinate);
+
+        // Most updates stay in the same cell at all but the finest levels
+        if ([from isEqualToNumber:to]) {
+            SCMapLibreClusterCell *cell = _levels[zoom][to];
+            if (!cell) {
+                continue;
+            }
+            cell->latitudeSum += coordinate.latitude - oldCoordinate.latitude;
+            cell->longitudeSum += coordinate.longitude - oldCoordinate.longitude;
+            continue;
+        }
+
+        [self removeSerial:serial coordinate:oldCoordinate fromCellKey:from zoom:zoom];
+        [self addSerial:serial coordinate:coordinate toCellKey:to zoom:zoom];
+    }
+}
+
+- (void)removeMarkerId:(NSString *)markerId coordinate:(CLLocationCoordinate2D)coordinate {
+    NSNumber *serialNumber = _serialsByMarkerId[markerId];
+    if (!serialNumber) {
+        return;
+    }
+    uint64_t serial = [serialNumber unsignedLongLongValue];
+
+    for (NSInteger zoom = 0; zoom <= SCMapLibreClusterMaxZoom; zoom++) {
+        [self removeSerial:serial coordinate:coordinate fromCellKey:SCCellKeyForCoordinate(zoom, coordinate) zoom:zoom];
+    }
+    [_serialsByMarkerId removeObjectForKey:markerId];
+    [_markerIdsBySerial removeObjectForKey:serialNumber];
+}
+
+- (void)removeAllMarkers {
+    for (NSMutableDictionary *level in _levels) {
+        [level removeAllObjects];
+    }
+    [_serialsByMarkerId removeAllObjects];
+    [_markerIdsBySerial removeAllObjects];
+}
+
+#pragma mark - Queries
+
+- (NSArray<SCMapLibreCluster *> *)clustersAtZoom:(NSInteger)zoom inBounds:(MLNCoordinateBounds)bounds {
+    zoom = MAX(0, MIN(SCMapLibreClusterMaxZoom, zoom));
+
+    uint32_t minY = SCRowForLatitude(zoom, bounds.ne.latitude);
+    uint32_t maxY = SCRowForLatitude(zoom, bounds.sw.latitude);
+    uint32_t minX = SCColumnForLongitude(zoom, bounds.sw.longitude);
+    uint32_t maxX = SCColumnForLongitude(zoom, bounds.ne.longitude);
+    BOOL allColumns = bounds.ne.longitude - bounds.sw.longitude >= 360.0;
+    BOOL wraps = !allColumns && minX > maxX;
+
+    NSMutableArray<SCMapLibreCluster *> *clusters = [NSMutableArray array];
+    [_levels[zoom] enumerateKeysAndObjectsUsingBlock:^(NSNumber *cellKey, SCMapLibreClusterCell *cell, BOOL *stop) {
+        uint64_t key = [cellKey unsignedLongLongValue];
+        uint32_t x = (uint32_t)key;
+        uint32_t y = (uint32_t)(key >> 32);
+        if (y < minY || y > maxY) {
+            return;
+        }
+        if (!allColumns && (wraps ? (x < minX && x > maxX) : (x < minX || x > maxX))) {
+            return;
+        }
+
+        SCMapLibreCluster *cluster = [[SCMapLibreCluster alloc] init];
+        cluster.coordinate = CLLocationCoordinate2DMake(cell->latitudeSum / cell->count,
+                                                        cell->longitudeSum / cell->count);
+        cluster.count = cell->count;
+        if (cell->count == 1) {
+            cluster.markerId = self.markerIdsBySerial[@(cell->serialSum)];
+        }
+        [clusters addObject:cluster];
+    }];
+    return clusters;
+}
+
+- (NSInteger)expansionZoomForClusterAtZoom:(NSInteger)zoom coordinate:(CLLocationCoordinate2D)coordinate {
+    zoom = MAX(0, MIN(SCMapLibreClusterMaxZoom, zoom));
+    uint32_t x = SCColumnForLongitude(zoom, coordinate.longitude);
+    uint32_t y = SCRowForLatitude(zoom, coordinate.latitude);
+
+    for (NSInteger child = zoom + 1; child <= SCMapLibreClusterMaxZoom; child++) {
+        NSInteger shift = child - zoom;
+        __block NSUInteger occupied = 0;
+        [_levels[child] enumerateKeysAndObjectsUsingBlock:^(NSNumber *cellKey, SCMapLibreClusterCell *cell, BOOL *stop) {
+            uint64_t key = [cellKey unsignedLongLongValue];
+            if (((uint32_t)key >> shift) == x && ((uint32_t)(key >> 32) >> shift) == y && ++occupied > 1) {
+                *stop = YES;
+            }
+        }];
+        if (occupied > 1) {
+            return child;
+        }
+    }
+    return SCMapLibreClusterMaxZoom + 1;
+}
+
+@end
@@ -0,0 +1,61 @@
+//
+//  SCMapLibreFrameScheduler.h
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Display-rate pacing of marker ops for SCMapLibreMapView.
+//
+
+#import <UIKit/UIKit.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * SCMapLibreFrameScheduler collects marker ops (same format as the `markerOps`
+ * attribute) as they arrive and hands them to its flush block once per
+ * display frame, driven by a CADisplayLink.
+ *
+ * Pending ops are keyed by marker ID. A later op for the same marker is merged
+ * into the pending one: updates fold their fields together, and a remove
+ * replaces whatever was pending. A `clear` discards everything pending. So each
+ * marker costs at most one op per frame however often it changes.
+ *
+ * At most maxUpdatesPerFrame markers are flushed per frame; the rest wait for
+ * the next one. If a flush overruns frameBudget, the scheduler skips 1, 2, 4...
+ * frames (up to maxBackoffFrames) before flushing again and merges in the
+ * meantime. Flushes that fit the budget halve the backoff.
+ *
+ * Main thread only. The display link is paused while nothing is pending.
+ */
+@interface SCMapLibreFrameScheduler : NSObject
+
+- (instancetype)initWithFlushBlock:(void (^)(NSArray<NSDictionary *> *ops))flushBlock NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, assign) NSUInteger maxUpdatesPerFrame; // Default 256
+@property (nonatomic, assign) CFTimeInterval frameBudget;     // Seconds, default 0.008
+@property (nonatomic, assign) NSUInteger maxBackoffFrames;   // Default 8
+
+/// Called at most once per second after a flush, with -statistics
+@property (nonatomic, copy, nullable) void (^statisticsBlock)(NSDictionary *statistics);
+
+@property (nonatomic, readonly) NSUInteger pendingCount;
+
+/// Queue ops for the next frame
+- (void)enqueueOps:(NSArray *)ops;
+
+/// Flush everything pending right away, ignoring the per-frame limit
+- (void)flushNow;
+
+/// Drop everything pending, e.g. when a full `markers` list replaces the set
+- (void)discardPending;
+
+/// Stop the display link and drop pending ops; the scheduler can't be reused
+- (void)invalidate;
+
+/// Counters: submitted, delivered, merged, dropped, skippedFrames, plus the
+/// current pending and backoffFrames
+- (NSDictionary<NSString *, NSNumber *> *)statistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,246 @@
+//
+//  SCMapLibreFrameScheduler.m
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Implementation of display-rate marker op pacing.
+//
+
+#import "SCMapLibreFrameScheduler.h"
+
+#import <QuartzCore/QuartzCore.h>
+
+static const CFTimeInterval kStatisticsInterval = 1.0;
+
+// CADisplayLink retains its target; this breaks the cycle with the scheduler
+@interface SCMapLibreDisplayLinkProxy : NSObject
+
+@property (nonatomic, weak) SCMapLibreFrameScheduler *scheduler;
+
+@end
+
+@interface SCMapLibreFrameScheduler ()
+
+@property (nonatomic, copy) void (^flushBlock)(NSArray<NSDictionary *> *ops);
+@property (nonatomic, strong, nullable) CADisplayLink *displayLink;
+
+// Pending op per marker, in first-queued order
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSMutableDictionary *> *pendingById;
+@property (nonatomic, strong) NSMutableArray<NSString *> *pendingOrder;
+// Markers removed and then re-added while pending: flushed as remove + add
+@property (nonatomic, strong) NSMutableSet<NSString *> *replacedIds;
+@property (nonatomic, assign) BOOL clearPending;
+
+@property (nonatomic, assign) NSUInteger backoffFrames;
+@property (nonatomic, assign) NSUInteger framesToSkip;
+@property (nonatomic, assign) CFTimeInterval lastStatisticsTime;
+@property (nonatomic, assign) BOOL invalidated;
+
+@property (nonatomic, assign) uint64_t submittedCount;
+@property (nonatomic, assign) uint64_t deliveredCount;
+@property (nonatomic, assign) uint64_t mergedCount;
+@property (nonatomic, assign) uint64_t droppedCount;
+@property (nonatomic, assign) uint64_t skippedFrameCount;
+
+- (void)displayLinkDidFire:(CADisplayLink *)displayLink;
+
+@end
+
+@implementation SCMapLibreDisplayLinkProxy
+
+- (void)displayLinkDidFire:(CADisplayLink *)displayLink {
+    [_scheduler displayLinkDidFire:displayLink];
+}
+
+@end
+
+@implementation SCMapLibreFrameScheduler
+
+- (instancetype)initWithFlushBlock:(void (^)(NSArray<NSDictionary *> *ops))flushBlock {
+    self = [super init];
+    if (self) {
+        _flushBlock = [flushBlock copy];
+        _maxUpdatesPerFrame = 256;
+        _frameBudget = 0.008;
+        _maxBackoffFrames = 8;
+        _pendingById = [NSMutableDictionary dictionary];
+        _pendingOrder = [NSMutableArray array];
+        _replacedIds = [NSMutableSet set];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_displayLink invalidate];
+}
+
+- (NSUInteger)pendingCount {
+    return _pendingOrder.count + (_clearPending ? 1 : 0);
+}
+
+#pragma mark - Queueing
+
+- (void)enqueueOps:(NSArray *)ops {
+    if (_invalidated) {
+        return;
+    }
+
+    for (NSDictionary *op in ops) {
+        if (![op isKindOfClass:[NSDictionary class]]) {
+            continue;
+        }
+
+        NSString *kind = op[@"op"];
+        if (![kind isKindOfClass:[NSString class]]) {
+            continue;
+        }
+        _submittedCount++;
+
+        if ([kind isEqualToString:@"clear"]) {
+            _droppedCount += _pendingOrder.count;
+            [self removeAllPending];
+            _clearPending = YES;
+            continue;
+        }
+
+        NSString *markerId = op[@"id"];
+        if (![markerId isKindOfClass:[NSString class]]) {
+            continue;
+        }
+
+        NSMutableDictionary *pending = _pendingById[markerId];
+        if (!pending) {
+            _pendingById[markerId] = [op mutableCopy];
+            [_pendingOrder addObject:markerId];
+            continue;
+        }
+        _mergedCount++;
+
+        BOOL isRemove = [kind isEqualToString:@"remove"];
+        BOOL pendingRemove = [pending[@"op"] isEqualToString:@"remove"];
+        if (isRemove) {
+            [_replacedIds removeObject:markerId];
+            _pendingById[markerId] = [op mutableCopy];
+        } else if (pendingRemove) {
+            // The marker must lose its old fields before the new ones apply
+            [_replacedIds addObject:markerId];
+            _pendingById[markerId] = [op mutableCopy];
+        } else {
+            // add + update stays an add; fields of the newer op win
+            NSString *pendingKind = pending[@"op"];
+            [pending addEntriesFromDictionary:op];
+            pending[@"op"] = [pendingKind isEqualToString:@"add"] ? pendingKind : kind;
+        }
+    }
+
+    if (self.pendingCount > 0) {
+        [self startDisplayLink];
+    }
+}
+
+- (void)removeAllPending {
+    [_pendingById removeAllObjects];
+    [_pendingOrder removeAllObjects];
+    [_replacedIds removeAllObjects];
+}
+
+- (void)discardPending {
+    _droppedCount += self.pendingCount;
+    [self removeAllPending];
+    _clearPending = NO;
+}
+
+- (void)invalidate {
+    _invalidated = YES;
+    [self removeAllPending];
+    _clearPending = NO;
+    [_displayLink invalidate];
+    _displayLink = nil;
+}
+
+#pragma mark - Flushing
+
+- (void)startDisplayLink {
+    if (!_displayLink) {
+        SCMapLibreDisplayLinkProxy *proxy = [[SCMapLibreDisplayLinkProxy alloc] init];
+        proxy.scheduler = self;
+        _displayLink = [CADisplayLink displayLinkWithTarget:proxy selector:@selector(displayLinkDidFire:)];
+        [_displayLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+    }
+    _displayLink.paused = NO;
+}
+
+- (void)displayLinkDidFire:(CADisplayLink *)displayLink {
+    if (_framesToSkip > 0) {
+        _framesToSkip--;
+        _skippedFrameCount++;
+        return;
+    }
+
+    CFTimeInterval start = CACurrentMediaTime();
+    [self flushUpTo:_maxUpdatesPerFrame];
+    CFTimeInterval elapsed = CACurrentMediaTime() - start;
+
+    if (elapsed > _frameBudget) {
+        _backoffFrames = _backoffFrames == 0 ? 1 : MIN(_backoffFrames * 2, _maxBackoffFrames);
+    } else {
+        _backoffFrames /= 2;
+    }
+    _framesToSkip = _backoffFrames;
+
+    if (_statisticsBlock && start - _lastStatisticsTime >= kStatisticsInterval) {
+        _lastStatisticsTime = start;
+        _statisticsBlock([self statistics]);
+    }
+
+    if (self.pendingCount == 0 && _framesToSkip == 0) {
+        displayLink.paused = YES;
+    }
+}
+
+- (void)flushNow {
+    [self flushUpTo:NSUIntegerMax];
+    _displayLink.paused = YES;
+}
+
+- (void)flushUpTo:(NSUInteger)limit {
+    NSUInteger count = MIN(_pendingOrder.count, MAX(limit, (NSUInteger)1));
+    if (count == 0 && !_clearPending) {
+        return;
+    }
+
+    NSMutableArray<NSDictionary *> *ops = [NSMutableArray arrayWithCapacity:count + 1];
+    if (_clearPending) {
+        [ops addObject:@{@"op": @"clear"}];
+        _clearPending = NO;
+    }
+
+    for (NSUInteger i = 0; i < count; i++) {
+        NSString *markerId = _pendingOrder[i];
+        if ([_replacedIds containsObject:markerId]) {
+            [ops addObject:@{@"op": @"remove", @"id": markerId}];
+            [_replacedIds removeObject:markerId];
+        }
+        [ops addObject:_pendingById[markerId]];
+        [_pendingById removeObjectForKey:markerId];
+    }
+    [_pendingOrder removeObjectsInRange:NSMakeRange(0, count)];
+
+    _deliveredCount += ops.count;
+    _flushBlock(ops);
+}
+
+#pragma mark - Statistics
+
+- (NSDictionary<NSString *, NSNumber *> *)statistics {
+    return @{
+        @"submitted": @(_submittedCount),
+        @"delivered": @(_deliveredCount),
+        @"merged": @(_mergedCount),
+        @"dropped": @(_droppedCount),
+        @"skippedFrames": @(_skippedFrameCount),
+        @"pending": @(self.pendingCount),
+        @"backoffFrames": @(_backoffFrames)
+    };
+}
+
+@end
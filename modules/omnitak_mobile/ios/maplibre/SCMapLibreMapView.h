@@ -23,18 +23,31 @@ NS_ASSUME_NONNULL_BEGIN
  * Features:
  * - Camera control (center, zoom, bearing, pitch)
  * - Marker/annotation management with custom icons
+ * - GPU-batched symbol rendering for large track sets (options.renderMode = "symbols")
+ * - Zoom-dependent marker clustering with expand-on-tap (options.renderMode = "clusters")
+ * - Display-rate pacing of markerOps (options.maxUpdatesPerFrame)
+ * - Dead reckoning of moving tracks between reports (options.deadReckoningHorizon)
  * - Touch event callbacks (tap, long press)
  * - MapLibre delegate event forwarding to TypeScript
- * - View pooling support for performance
+ * - View pooling support for performance, keeping map state per retentionKey
+ * - Offline tile packs: region prefetch into memory-mapped packs served without network
  *
  * Valdi Attributes:
  * - options: JSON object with map configuration
  * - markers: JSON array of marker definitions
+ * - markerOps: JSON array of incremental marker ops (add/update/remove/clear)
+ * - markerIds: string table (and marker set) for markerPositions
+ * - markerPositions: packed Float64 [markerIndex, lat, lon, heading] records
+ * - cameraPosition: packed Float64 [lat, lon, zoom, bearing, pitch, animated]
  * - camera: JSON object with camera position
+ * - retentionKey: keeps style, camera and markers across pool reuse for the same key
  * - onMapReady: Callback fired when map is ready
  * - onMarkerTap: Callback fired when marker is tapped
  * - onMapTap: Callback fired when map is tapped
  * - onCameraChanged: Callback fired when camera moves
+ * - onFrameStats: Callback with frame pacing counters, at most once per second
+ * - offlinePack: JSON object describing a region + zoom range to prefetch
+ * - onOfflinePackProgress: Callback with offline pack progress
  */
 @interface SCMapLibreMapView : SCValdiView <MLNMapViewDelegate>
 
@@ -6,20 +6,51 @@
 //
 
 #import "SCMapLibreMapView.h"
+#import "SCMapLibreFrameScheduler.h"
+#import "SCMapLibreOfflinePack.h"
+#import "SCMapLibreOfflineURLProtocol.h"
+#import "SCMapLibreTileStore.h"
+#import "SCMapLibreTrace.h"
+#import "SCMapLibreTrackLayer.h"
 #import "valdi_core/SCValdiAttributesBinderBase.h"
 #import "valdi_core/SCValdiAnimatorProtocol.h"
 #import "valdi_core/SCValdiViewLayoutAttributes.h"
 
 @import MapLibre;
 
-@interface SCMapLibreMapView ()
+static NSString *const kTrackLayerIdentifier = @"com.engindearing.omnitak.tracks";
+
+// Marker fields the track layer renders but an MLNPointAnnotation can't hold
+static NSArray<NSString *> *SCMarkerFieldsWithoutAnnotation(void) {
+    static NSArray<NSString *> *fields;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        fields = @[@"icon", @"type", @"heading", @"course", @"speed"];
+    });
+    return fields;
+}
+
+@interface SCMapLibreMapView () <UIGestureRecognizerDelegate>
 
 @property (nonatomic, strong, readwrite) MLNMapView *mapView;
 @property (nonatomic, strong) NSMutableDictionary<NSString *, MLNPointAnnotation *> *annotationsById;
+@property (nonatomic, strong) NSMapTable<MLNPointAnnotation *, NSString *> *markerIdsByAnnotation;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSMutableDictionary *> *markerFieldsById; // Kept for the move to trackLayer
+@property (nonatomic, strong, nullable) SCMapLibreTrackLayer *trackLayer; // Non-nil in symbol render mode
 @property (nonatomic, copy, nullable) void (^onMapReadyCallback)(void);
 @property (nonatomic, copy, nullable) void (^onMarkerTapCallback)(NSString *markerId);
 @property (nonatomic, copy, nullable) void (^onMapTapCallback)(NSDictionary *position);
 @property (nonatomic, copy, nullable) void (^onCameraChangedCallback)(NSDictionary *camera);
+@property (nonatomic, copy, nullable) void (^onFrameStatsCallback)(NSDictionary *stats);
+@property (nonatomic, copy, nullable) void (^onOfflinePackProgressCallback)(NSDictionary *progress);
+@property (nonatomic, strong, nullable) SCMapLibreOfflinePack *offlinePack;
+@property (nonatomic, copy, nullable) NSDictionary *offlinePackOptions; // Options offlinePack was started with
+@property (nonatomic, strong, nullable) SCMapLibreFrameScheduler *frameScheduler; // Non-nil when markerOps are frame-paced
+@property (nonatomic, copy) NSArray<NSString *> *markerIdTable; // Resolves markerPositions indexes
+@property (nonatomic, assign) NSTimeInterval deadReckoningHorizon; // Applied to trackLayer
+@property (nonatomic, copy, nullable) NSString *retentionKey;
+@property (nonatomic, copy, nullable) NSString *pooledRetentionKey; // Key the markers were kept for while pooled
+@property (nonatomic, assign) BOOL markersReplacedSinceReuse; // A full markers list arrived
 @property (nonatomic, assign) BOOL mapIsReady;
 
 @end
@@ -39,6 +70,11 @@
 
 - (void)setupDefaults {
     _annotationsById = [NSMutableDictionary dictionary];
+    _markerFieldsById = [NSMutableDictionary dictionary];
+    // Keyed by annotation identity so taps resolve their marker ID without a scan
+    _markerIdsByAnnotation = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+                                                   valueOptions:NSPointerFunctionsStrongMemory];
+    _markerIdTable = @[];
     // Use MapTiler's free OSM Bright style - no satellite warnings
     // Alternative: https://demotiles.maplibre.org/style.json
     _styleURL = @"https://tiles.openfreemap.org/styles/liberty";
@@ -54,6 +90,9 @@
         return;
     }
 
+    // Offline packs must be able to answer the very first style request
+    [SCMapLibreOfflineURLProtocol install];
+
     // Initialize MapLibre map view with default style
     NSURL *styleURL = [NSURL URLWithString:self.styleURL];
     _mapView = [[MLNMapView alloc] initWithFrame:self.bounds styleURL:styleURL];
@@ -66,6 +105,18 @@
     _mapView.centerCoordinate = CLLocationCoordinate2DMake(39.8283, -98.5795);
     _mapView.zoomLevel = 4.0;
 
+    // Symbol-rendered tracks have no annotation views, so taps are resolved with
+    // feature queries. Wait for double-tap-to-zoom to fail first.
+    UITapGestureRecognizer *tap = [[UITapGestureRecognizer alloc] initWithTarget:self action:@selector(handleMapTap:)];
+    tap.delegate = self;
+    for (UIGestureRecognizer *recognizer in _mapView.gestureRecognizers) {
+        if ([recognizer isKindOfClass:[UITapGestureRecognizer class]] &&
+            ((UITapGestureRecognizer *)recognizer).numberOfTapsRequired == 2) {
+            [tap requireGestureRecognizerToFail:recognizer];
+        }
+    }
+    [_mapView addGestureRecognizer:tap];
+
     [self addSubview:_mapView];
 }
 
@@ -84,25 +135,66 @@
 
 - (BOOL)willEnqueueIntoValdiPool {
     // Support view pooling for performance
+    if (_retentionKey) {
+        // Keep style, camera and markers for the next screen with the same key;
+        // its attributes then only reconcile what changed
+        [self cleanupCallbacks];
+        _pooledRetentionKey = _retentionKey;
+        _retentionKey = nil;
+        _markersReplacedSinceReuse = NO;
+        return YES;
+    }
+
     // Clean up before recycling
     [self cleanup];
     return YES;
 }
 
 - (void)cleanup {
+    [self removeAllMarkers];
+
+    // The render mode is re-applied from options on reuse
+    [_trackLayer detach];
+    _trackLayer = nil;
+
+    [self cleanupCallbacks];
+    [self removeOfflinePack];
+    _retentionKey = nil;
+    _pooledRetentionKey = nil;
+
+    _mapIsReady = NO;
+}
+
+- (void)removeAllMarkers {
     // Remove all annotations
     if (_mapView.annotations) {
         [_mapView removeAnnotations:_mapView.annotations];
     }
     [_annotationsById removeAllObjects];
+    [_markerIdsByAnnotation removeAllObjects];
+    [_markerFieldsById removeAllObjects];
+    _markerIdTable = @[];
+
+    [_trackLayer setMarkers:@[]];
+}
+
+- (void)cleanupCallbacks {
+    // Frame pacing is re-applied from options on reuse; apply what's still queued
+    [_frameScheduler flushNow];
+    [_frameScheduler invalidate];
+    _frameScheduler = nil;
+
+    // So is dead reckoning; a pooled map shouldn't keep its display link running
+    _deadReckoningHorizon = 0;
+    _trackLayer.deadReckoningHorizon = 0;
 
     // Clear callbacks
     _onMapReadyCallback = nil;
     _onMarkerTapCallback = nil;
     _onMapTapCallback = nil;
     _onCameraChangedCallback = nil;
-
-    _mapIsReady = NO;
+    _onFrameStatsCallback = nil;
+    _onOfflinePackProgressCallback = nil;
 }
 
 - (void)dealloc {
@@ -122,7 +214,8 @@
     if (style && [style isKindOfClass:[NSString class]]) {
         self.styleURL = style;
         NSURL *styleURL = [NSURL URLWithString:style];
-        if (styleURL) {
+        // Re-setting the same URL would reload the style and drop runtime layers
+        if (styleURL && ![_mapView.styleURL isEqual:styleURL]) {
             _mapView.styleURL = styleURL;
         }
     }
@@ -149,9 +242,103 @@
         _mapView.scaleBar.hidden = ![options[@"showScaleBar"] boolValue];
     }
 
+    // Apply marker render mode: "annotations" (default), "symbols" or "clusters"
+    NSString *renderMode = options[@"renderMode"];
+    if ([renderMode isKindOfClass:[NSString class]]) {
+        BOOL clustered = [renderMode isEqualToString:@"clusters"];
+        [self setSymbolRenderingEnabled:clustered || [renderMode isEqualToString:@"symbols"]];
+        _trackLayer.clustered = clustered;
+    } else if (options.count == 0) {
+        // Options were reset
+        [self setSymbolRenderingEnabled:NO];
+    }
+
+    // Pace markerOps to the display: at most this many markers change per frame
+    NSNumber *maxUpdatesPerFrame = options[@"maxUpdatesPerFrame"];
+    if ([maxUpdatesPerFrame isKindOfClass:[NSNumber class]]) {
+        [self setMaxUpdatesPerFrame:[maxUpdatesPerFrame unsignedIntegerValue]];
+    } else if (options.count == 0) {
+        [self setMaxUpdatesPerFrame:0];
+    }
+
+    // Extrapolate moving tracks along their course for up to this many seconds (symbol modes)
+    NSNumber *deadReckoningHorizon = options[@"deadReckoningHorizon"];
+    if ([deadReckoningHorizon isKindOfClass:[NSNumber class]]) {
+        _deadReckoningHorizon = [deadReckoningHorizon doubleValue];
+        _trackLayer.deadReckoningHorizon = _deadReckoningHorizon;
+    } else if (options.count == 0) {
+        _deadReckoningHorizon = 0;
+        _trackLayer.deadReckoningHorizon = 0;
+    }
+
     return YES;
 }
 
+// 0 turns frame pacing off and applies anything still pending
+- (void)setMaxUpdatesPerFrame:(NSUInteger)maxUpdatesPerFrame {
+    if (maxUpdatesPerFrame == 0) {
+        [_frameScheduler flushNow];
+        [_frameScheduler invalidate];
+        _frameScheduler = nil;
+        return;
+    }
+
+    if (!_frameScheduler) {
+        __weak SCMapLibreMapView *weakSelf = self;
+        _frameScheduler = [[SCMapLibreFrameScheduler alloc] initWithFlushBlock:^(NSArray<NSDictionary *> *ops) {
+            [weakSelf applyMarkerOps:ops];
+        }];
+        _frameScheduler.statisticsBlock = ^(NSDictionary *statistics) {
+            SCMapLibreMapView *strongSelf = weakSelf;
+            if (strongSelf.onFrameStatsCallback) {
+                strongSelf.onFrameStatsCallback(statistics);
+            }
+        };
+    }
+    _frameScheduler.maxUpdatesPerFrame = maxUpdatesPerFrame;
+}
+
+// Move the current markers between UIKit annotations and the GPU-batched track layer
+- (void)setSymbolRenderingEnabled:(BOOL)enabled {
+    if (enabled == (_trackLayer != nil)) {
+        return;
+    }
+
+    // Paced ops belong to the current renderer; apply them before migrating
+    [_frameScheduler flushNow];
+
+    if (enabled) {
+        NSMutableArray<NSDictionary *> *snapshots = [NSMutableArray arrayWithCapacity:_annotationsById.count];
+        [_annotationsById enumerateKeysAndObjectsUsingBlock:^(NSString *markerId, MLNPointAnnotation *annotation, BOOL *stop) {
+            // Icon, type and heading come from the marker data; the rest from the annotation
+            NSMutableDictionary *marker = [self.markerFieldsById[markerId] mutableCopy] ?: [NSMutableDictionary dictionary];
+            marker[@"id"] = markerId;
+            marker[@"latitude"] = @(annotation.coordinate.latitude);
+            marker[@"longitude"] = @(annotation.coordinate.longitude);
+            marker[@"title"] = annotation.title;
+            marker[@"subtitle"] = annotation.subtitle;
+            [snapshots addObject:marker];
+        }];
+        [self reconcileAnnotationsWithMarkers:@[] addedCount:NULL removedCount:NULL];
+
+        _trackLayer = [[SCMapLibreTrackLayer alloc] initWithIdentifier:kTrackLayerIdentifier];
+        _trackLayer.deadReckoningHorizon = _deadReckoningHorizon;
+        // Otherwise attached from mapView:didFinishLoadingStyle:
+        if (_mapView.style) {
+            [_trackLayer attachToStyle:_mapView.style];
+        }
+        if (!CGRectIsEmpty(_mapView.bounds)) {
+            [_trackLayer setViewport:_mapView.visibleCoordinateBounds zoomLevel:_mapView.zoomLevel];
+        }
+        [_trackLayer setMarkers:snapshots];
+    } else {
+        NSArray<NSDictionary *> *snapshots = [_trackLayer markerSnapshots];
+        [_trackLayer detach];
+        _trackLayer = nil;
+        [self reconcileAnnotationsWithMarkers:snapshots addedCount:NULL removedCount:NULL];
+    }
+}
+
 - (BOOL)valdi_setCamera:(NSDictionary *)camera {
     if (![camera isKindOfClass:[NSDictionary class]]) {
         return NO;
@@ -197,11 +384,154 @@
     return YES;
 }
 
+/**
+ * Apply a packed camera: six native-endian Float64s
+ * [latitude, longitude, zoom, bearing, pitch, animated]. NaN keeps the current
+ * value (latitude/longitude must both be set to move the center).
+ */
+- (BOOL)valdi_setCameraPosition:(NSData *)data {
+    if (![data isKindOfClass:[NSData class]] || data.length < 6 * sizeof(double)) {
+        return NO;
+    }
+
+    const double *values = data.bytes;
+    BOOL animated = !isnan(values[5]) && values[5] != 0;
+
+    MLNMapCamera *camera = [_mapView.camera copy];
+    if (!isnan(values[0]) && !isnan(values[1])) {
+        camera.centerCoordinate = CLLocationCoordinate2DMake(values[0], values[1]);
+    }
+    if (!isnan(values[3])) {
+        camera.heading = values[3];
+    }
+    if (!isnan(values[4])) {
+        camera.pitch = values[4];
+    }
+    [_mapView setCamera:camera animated:animated];
+
+    if (!isnan(values[2])) {
+        [_mapView setZoomLevel:values[2] animated:animated];
+    }
+    return YES;
+}
+
+#pragma mark - Markers
+
+// Apply the fields present in a marker dictionary to an annotation.
+// Returns NO if a coordinate is required but missing.
+- (BOOL)applyMarkerData:(NSDictionary *)markerData
+           toAnnotation:(MLNPointAnnotation *)annotation
+      requireCoordinate:(BOOL)requireCoordinate {
+    NSNumber *lat = markerData[@"latitude"];
+    NSNumber *lon = markerData[@"longitude"];
+
+    if (lat && lon) {
+        // Update position if changed
+        CLLocationCoordinate2D newCoord = CLLocationCoordinate2DMake([lat doubleValue], [lon doubleValue]);
+        if (annotation.coordinate.latitude != newCoord.latitude ||
+            annotation.coordinate.longitude != newCoord.longitude) {
+            annotation.coordinate = newCoord;
+        }
+    } else if (requireCoordinate) {
+        return NO;
+    }
+
+    // Update title if provided
+    NSString *title = markerData[@"title"];
+    if (title && [title isKindOfClass:[NSString class]]) {
+        annotation.title = title;
+    }
+
+    // Update subtitle if provided
+    NSString *subtitle = markerData[@"subtitle"];
+    if (subtitle && [subtitle isKindOfClass:[NSString class]]) {
+        annotation.subtitle = subtitle;
+    }
+
+    return YES;
+}
+
+// Remember the fields of a marker's data that its annotation drops, so switching
+// to symbol rendering keeps its icon and heading
+- (void)recordMarkerFields:(NSDictionary *)markerData forMarkerId:(NSString *)markerId {
+    NSMutableDictionary *fields = _markerFieldsById[markerId];
+    for (NSString *field in SCMarkerFieldsWithoutAnnotation()) {
+        id value = markerData[field];
+        if (!value) {
+            continue;
+        }
+        if (!fields) {
+            fields = [NSMutableDictionary dictionary];
+            _markerFieldsById[markerId] = fields;
+        }
+        fields[field] = value;
+    }
+}
+
+- (void)registerAnnotation:(MLNPointAnnotation *)annotation forMarkerId:(NSString *)markerId {
+    _annotationsById[markerId] = annotation;
+    [_markerIdsByAnnotation setObject:markerId forKey:annotation];
+}
+
+- (nullable MLNPointAnnotation *)unregisterMarkerId:(NSString *)markerId {
+    MLNPointAnnotation *annotation = _annotationsById[markerId];
+    if (annotation) {
+        [_annotationsById removeObjectForKey:markerId];
+        [_markerIdsByAnnotation removeObjectForKey:annotation];
+    }
+    [_markerFieldsById removeObjectForKey:markerId];
+    return annotation;
+}
+
 - (BOOL)valdi_setMarkers:(NSArray *)markers {
     if (![markers isKindOfClass:[NSArray class]]) {
         return NO;
     }
 
+#if SC_MAPLIBRE_SIGNPOSTS
+    os_log_t traceLog = SCMapLibreTraceLog();
+    os_signpost_id_t traceSignpost = os_signpost_id_generate(traceLog);
+    os_signpost_interval_begin(traceLog, traceSignpost, "setMarkers", "%lu markers", (unsigned long)markers.count);
+    if (os_signpost_enabled(traceLog)) {
+        // One event per marker on its correlation id's track, to line up with the bridge's cid
+        for (NSDictionary *markerData in markers) {
+            NSString *markerId = [markerData isKindOfClass:[NSDictionary class]] ? markerData[@"id"] : nil;
+            if ([markerId isKindOfClass:[NSString class]]) {
+                os_signpost_event_emit(traceLog, SCMapLibreTraceSignpostID(markerId), "marker",
+                                       "cid=%08x uid=%{public}@", SCMapLibreTraceCorrelationID(markerId), markerId);
+            }
+        }
+    }
+#endif
+
+    // A full list supersedes any ops still waiting for a frame
+    [_frameScheduler discardPending];
+    _markersReplacedSinceReuse = YES;
+
+    if (_trackLayer) {
+        [_trackLayer setMarkers:markers];
+#if SC_MAPLIBRE_SIGNPOSTS
+        os_signpost_interval_end(traceLog, traceSignpost, "setMarkers", "symbol layer");
+#endif
+        return YES;
+    }
+
+    NSUInteger addedCount = 0;
+    NSUInteger removedCount = 0;
+    [self reconcileAnnotationsWithMarkers:markers addedCount:&addedCount removedCount:&removedCount];
+
+#if SC_MAPLIBRE_SIGNPOSTS
+    os_signpost_interval_end(traceLog, traceSignpost, "setMarkers", "%lu added, %lu removed",
+                             (unsigned long)addedCount, (unsigned long)removedCount);
+#endif
+    return YES;
+}
+
+// Make the annotations match a full marker list. Shared by the markers attribute and
+// render-mode switches; only the former counts as a replacement for the retention key.
+- (void)reconcileAnnotationsWithMarkers:(NSArray *)markers
+                             addedCount:(nullable NSUInteger *)addedCount
+                           removedCount:(nullable NSUInteger *)removedCount {
     // Track which markers should exist
     NSMutableSet<NSString *> *newMarkerIds = [NSMutableSet set];
     NSMutableArray<MLNPointAnnotation *> *annotationsToAdd = [NSMutableArray array];
@@ -212,10 +542,7 @@
         }
 
         NSString *markerId = markerData[@"id"];
-        NSNumber *lat = markerData[@"latitude"];
-        NSNumber *lon = markerData[@"longitude"];
-
-        if (!markerId || !lat || !lon) {
+        if (!markerId || !markerData[@"latitude"] || !markerData[@"longitude"]) {
             continue;
         }
 
@@ -224,51 +551,22 @@
         // Check if marker already exists
         MLNPointAnnotation *existingAnnotation = _annotationsById[markerId];
         if (existingAnnotation) {
-            // Update position if changed
-            CLLocationCoordinate2D newCoord = CLLocationCoordinate2DMake([lat doubleValue], [lon doubleValue]);
-            if (existingAnnotation.coordinate.latitude != newCoord.latitude ||
-                existingAnnotation.coordinate.longitude != newCoord.longitude) {
-                existingAnnotation.coordinate = newCoord;
-            }
-
-            // Update title if provided
-            NSString *title = markerData[@"title"];
-            if (title && [title isKindOfClass:[NSString class]]) {
-                existingAnnotation.title = title;
-            }
-
-            // Update subtitle if provided
-            NSString *subtitle = markerData[@"subtitle"];
-            if (subtitle && [subtitle isKindOfClass:[NSString class]]) {
-                existingAnnotation.subtitle = subtitle;
-            }
+            [self applyMarkerData:markerData toAnnotation:existingAnnotation requireCoordinate:NO];
         } else {
             // Create new annotation
             MLNPointAnnotation *annotation = [[MLNPointAnnotation alloc] init];
-            annotation.coordinate = CLLocationCoordinate2DMake([lat doubleValue], [lon doubleValue]);
-
-            NSString *title = markerData[@"title"];
-            if (title && [title isKindOfClass:[NSString class]]) {
-                annotation.title = title;
-            }
-
-            NSString *subtitle = markerData[@"subtitle"];
-            if (subtitle && [subtitle isKindOfClass:[NSString class]]) {
-                annotation.subtitle = subtitle;
-            }
-
-            _annotationsById[markerId] = annotation;
+            [self applyMarkerData:markerData toAnnotation:annotation requireCoordinate:YES];
+            [self registerAnnotation:annotation forMarkerId:markerId];
             [annotationsToAdd addObject:annotation];
         }
+        [self recordMarkerFields:markerData forMarkerId:markerId];
     }
 
     // Remove markers that are no longer in the list
     NSMutableArray<MLNPointAnnotation *> *annotationsToRemove = [NSMutableArray array];
     for (NSString *existingId in [_annotationsById allKeys]) {
         if (![newMarkerIds containsObject:existingId]) {
-            MLNPointAnnotation *annotation = _annotationsById[existingId];
-            [annotationsToRemove addObject:annotation];
-            [_annotationsById removeObjectForKey:existingId];
+            [annotationsToRemove addObject:[self unregisterMarkerId:existingId]];
         }
     }
 
@@ -280,6 +578,321 @@
         [_mapView addAnnotations:annotationsToAdd];
     }
 
+    if (addedCount) {
+        *addedCount = annotationsToAdd.count;
+    }
+    if (removedCount) {
+        *removedCount = annotationsToRemove.count;
+    }
+}
+
+/**
+ * Apply incremental marker changes. Each op is a dictionary with an "op" key:
+ * - "add" / "update": upsert by "id"; fields other than "id" are optional on update
+ * - "remove": remove the marker with "id"
+ * - "clear": remove all markers (e.g. before a full resync)
+ * Only the markers named in the ops are touched, so cost scales with the
+ * number of changes rather than the number of markers on the map.
+ */
+- (BOOL)valdi_setMarkerOps:(NSArray *)ops {
+    if (![ops isKindOfClass:[NSArray class]]) {
+        return NO;
+    }
+
+    // With frame pacing on, ops reach the map once per display frame
+    if (_frameScheduler) {
+        [_frameScheduler enqueueOps:ops];
+        return YES;
+    }
+
+    [self applyMarkerOps:ops];
+    return YES;
+}
+
+- (void)applyMarkerOps:(NSArray *)ops {
+    if (_trackLayer) {
+        [_trackLayer applyMarkerOps:ops];
+        return;
+    }
+
+    NSMutableSet<MLNPointAnnotation *> *annotationsToAdd = [NSMutableSet set];
+    NSMutableArray<MLNPointAnnotation *> *annotationsToRemove = [NSMutableArray array];
+
+    for (NSDictionary *op in ops) {
+        if (![op isKindOfClass:[NSDictionary class]]) {
+            continue;
+        }
+
+        NSString *kind = op[@"op"];
+        if (![kind isKindOfClass:[NSString class]]) {
+            continue;
+        }
+
+        if ([kind isEqualToString:@"clear"]) {
+            [annotationsToRemove addObjectsFromArray:[_annotationsById allValues]];
+            [annotationsToRemove removeObjectsInArray:[annotationsToAdd allObjects]];
+            [annotationsToAdd removeAllObjects];
+            [_annotationsById removeAllObjects];
+            [_markerIdsByAnnotation removeAllObjects];
+            [_markerFieldsById removeAllObjects];
+            continue;
+        }
+
+        NSString *markerId = op[@"id"];
+        if (![markerId isKindOfClass:[NSString class]]) {
+            continue;
+        }
+
+        if ([kind isEqualToString:@"remove"]) {
+            MLNPointAnnotation *annotation = [self unregisterMarkerId:markerId];
+            if (!annotation) {
+                continue;
+            }
+            // Added earlier in this same batch: it never reached the map
+            if ([annotationsToAdd containsObject:annotation]) {
+                [annotationsToAdd removeObject:annotation];
+            } else {
+                [annotationsToRemove addObject:annotation];
+            }
+        } else if ([kind isEqualToString:@"add"] || [kind isEqualToString:@"update"]) {
+            MLNPointAnnotation *existingAnnotation = _annotationsById[markerId];
+            if (existingAnnotation) {
+                [self applyMarkerData:op toAnnotation:existingAnnotation requireCoordinate:NO];
+                [self recordMarkerFields:op forMarkerId:markerId];
+                continue;
+            }
+
+            MLNPointAnnotation *annotation = [[MLNPointAnnotation alloc] init];
+            if (![self applyMarkerData:op toAnnotation:annotation requireCoordinate:YES]) {
+                continue;
+            }
+            [self registerAnnotation:annotation forMarkerId:markerId];
+            [self recordMarkerFields:op forMarkerId:markerId];
+            [annotationsToAdd addObject:annotation];
+        }
+    }
+
+    // Apply changes to map
+    if (annotationsToRemove.count > 0) {
+        [_mapView removeAnnotations:annotationsToRemove];
+    }
+    if (annotationsToAdd.count > 0) {
+        [_mapView addAnnotations:[annotationsToAdd allObjects]];
+    }
+}
+
+/**
+ * Set the string table for markerPositions. It is also the marker set: markers
+ * whose ID is not in the table are removed. Send it only when tracks come or go.
+ */
+- (BOOL)valdi_setMarkerIds:(NSArray *)markerIds {
+    if (![markerIds isKindOfClass:[NSArray class]]) {
+        return NO;
+    }
+    for (id markerId in markerIds) {
+        if (![markerId isKindOfClass:[NSString class]]) {
+            return NO;
+        }
+    }
+
+    [_frameScheduler flushNow];
+    _markerIdTable = [markerIds copy];
+    NSSet<NSString *> *retained = [NSSet setWithArray:markerIds];
+
+    if (_trackLayer) {
+        [_trackLayer retainMarkerIds:retained];
+        return YES;
+    }
+
+    NSMutableArray<MLNPointAnnotation *> *annotationsToRemove = [NSMutableArray array];
+    for (NSString *existingId in [_annotationsById allKeys]) {
+        if (![retained containsObject:existingId]) {
+            MLNPointAnnotation *annotation = [self unregisterMarkerId:existingId];
+            if (annotation) {
+                [annotationsToRemove addObject:annotation];
+            }
+        }
+    }
+    if (annotationsToRemove.count > 0) {
+        [_mapView removeAnnotations:annotationsToRemove];
+    }
+    return YES;
+}
+
+/**
+ * Apply packed marker positions: SCMapLibreMarkerPosition records of
+ * [markerIndex, latitude, longitude, heading] as native-endian Float64s, with
+ * markerIndex into the markerIds table. Unknown markers are created. Nothing
+ * is parsed or boxed per field, so this suits high-rate track updates.
+ */
+- (BOOL)valdi_setMarkerPositions:(NSData *)data {
+    if (![data isKindOfClass:[NSData class]] || data.length % sizeof(SCMapLibreMarkerPosition) != 0) {
+        return NO;
+    }
+
+    // Keep ordering with any ops still waiting for a frame
+    [_frameScheduler flushNow];
+
+    const SCMapLibreMarkerPosition *positions = data.bytes;
+    NSUInteger count = data.length / sizeof(SCMapLibreMarkerPosition);
+    NSArray<NSString *> *markerIds = _markerIdTable;
+
+    if (_trackLayer) {
+        [_trackLayer applyPositions:positions count:count markerIds:markerIds];
+        return YES;
+    }
+
+    NSUInteger idCount = markerIds.count;
+    NSMutableArray<MLNPointAnnotation *> *annotationsToAdd = [NSMutableArray array];
+    for (NSUInteger i = 0; i < count; i++) {
+        const SCMapLibreMarkerPosition *position = &positions[i];
+        if (!(position->markerIndex >= 0 && position->markerIndex < idCount) ||
+            isnan(position->latitude) || isnan(position->longitude)) {
+            continue;
+        }
+
+        NSString *markerId = markerIds[(NSUInteger)position->markerIndex];
+        CLLocationCoordinate2D coordinate = CLLocationCoordinate2DMake(position->latitude, position->longitude);
+
+        MLNPointAnnotation *annotation = _annotationsById[markerId];
+        if (!annotation) {
+            annotation = [[MLNPointAnnotation alloc] init];
+            annotation.coordinate = coordinate;
+            [self registerAnnotation:annotation forMarkerId:markerId];
+            [annotationsToAdd addObject:annotation];
+        } else if (annotation.coordinate.latitude != coordinate.latitude ||
+                   annotation.coordinate.longitude != coordinate.longitude) {
+            annotation.coordinate = coordinate;
+        }
+
+        // Annotations don't rotate; keep the heading for symbol rendering, boxing it only when it changed
+        if (!isnan(position->heading)) {
+            NSMutableDictionary *fields = _markerFieldsById[markerId];
+            NSNumber *heading = fields[@"heading"];
+            if (!heading || [heading doubleValue] != position->heading) {
+                if (!fields) {
+                    fields = [NSMutableDictionary dictionary];
+                    _markerFieldsById[markerId] = fields;
+                }
+                fields[@"heading"] = @(position->heading);
+            }
+        }
+    }
+
+    if (annotationsToAdd.count > 0) {
+        [_mapView addAnnotations:annotationsToAdd];
+    }
+    return YES;
+}
+
+/**
+ * Key of the screen this map belongs to (e.g. a mission ID). A pooled map with
+ * a key keeps its style, camera and markers; when it's reused with the same key
+ * the marker attributes only reconcile the delta. Reuse with another key (or
+ * none) drops the kept markers unless a full `markers` list already replaced them;
+ * markerOps, markerIds and markerPositions are deltas and don't count.
+ */
+- (BOOL)valdi_setRetentionKey:(nullable NSString *)retentionKey {
+    if (retentionKey && ![retentionKey isKindOfClass:[NSString class]]) {
+        return NO;
+    }
+
+    NSString *pooledKey = _pooledRetentionKey;
+    _pooledRetentionKey = nil;
+    _retentionKey = [retentionKey copy];
+
+    if (pooledKey && ![pooledKey isEqualToString:retentionKey] && !_markersReplacedSinceReuse) {
+        [self removeAllMarkers];
+    }
+    return YES;
+}
+
+#pragma mark - Offline Packs
+
+/**
+ * Prefetch a region for offline use. Options: name (pack file, required),
+ * bounds {north, south, east, west}, minZoom (default 0), maxZoom (default 14),
+ * style (default: the map's style URL), tiles (tile URL templates; default:
+ * the style's sources), maxTiles and maxBytes (0 = unlimited).
+ *
+ * Packs on disk are served to MapLibre whether or not this attribute is set;
+ * the attribute only drives downloading.
+ */
+- (BOOL)valdi_setOfflinePack:(nullable NSDictionary *)options {
+    if ([options isEqualToDictionary:_offlinePackOptions]) {
+        return YES;
+    }
+
+    [self removeOfflinePack];
+    if (!options) {
+        return YES;
+    }
+
+    NSString *name = options[@"name"];
+    NSDictionary *bounds = options[@"bounds"];
+    if (![name isKindOfClass:[NSString class]] || ![bounds isKindOfClass:[NSDictionary class]]) {
+        return NO;
+    }
+
+    NSError *error = nil;
+    SCMapLibreTileStore *store = [SCMapLibreTileStore storeNamed:name error:&error];
+    if (!store) {
+        NSLog(@"[SCMapLibreMapView] Failed to open offline pack %@: %@", name, error.localizedDescription);
+        return NO;
+    }
+
+    MLNCoordinateBounds region;
+    region.sw = CLLocationCoordinate2DMake([bounds[@"south"] doubleValue], [bounds[@"west"] doubleValue]);
+    region.ne = CLLocationCoordinate2DMake([bounds[@"north"] doubleValue], [bounds[@"east"] doubleValue]);
+
+    NSString *style = [options[@"style"] isKindOfClass:[NSString class]] ? options[@"style"] : self.styleURL;
+    NSArray *tiles = [options[@"tiles"] isKindOfClass:[NSArray class]] ? options[@"tiles"] : nil;
+    NSUInteger minZoom = options[@"minZoom"] ? [options[@"minZoom"] unsignedIntegerValue] : 0;
+    NSUInteger maxZoom = options[@"maxZoom"] ? [options[@"maxZoom"] unsignedIntegerValue] : 14;
+
+    SCMapLibreOfflinePack *pack = [[SCMapLibreOfflinePack alloc] initWithStore:store
+                                                                     styleURL:style
+                                                             tileURLTemplates:tiles
+                                                                       bounds:region
+                                                                  minimumZoom:minZoom
+                                                                  maximumZoom:maxZoom];
+    pack.maxTiles = [options[@"maxTiles"] unsignedIntegerValue];
+    pack.maxBytes = [options[@"maxBytes"] unsignedLongLongValue];
+
+    __weak SCMapLibreMapView *weakSelf = self;
+    pack.progressBlock = ^(NSDictionary *progress) {
+        SCMapLibreMapView *view = weakSelf;
+        if (view.onOfflinePackProgressCallback) {
+            view.onOfflinePackProgressCallback(progress);
+        }
+    };
+
+    _offlinePack = pack;
+    _offlinePackOptions = [options copy];
+    [pack resume];
+    return YES;
+}
+
+// Stop the current pack's download. If it leaves its store mostly superseded
+// records (rewritten tiles and resources leave them behind), compact it in the background.
+- (void)removeOfflinePack {
+    SCMapLibreTileStore *store = _offlinePack.store;
+    [_offlinePack cancel];
+    _offlinePack = nil;
+    _offlinePackOptions = nil;
+
+    if (store && store.wastedByteCount > store.dataByteCount) {
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            NSError *error = nil;
+            if (![store compact:&error]) {
+                NSLog(@"[SCMapLibreMapView] Compacting offline pack %@ failed: %@", store.name, error.localizedDescription);
+            }
+        });
+    }
+}
+
+- (BOOL)valdi_setOnOfflinePackProgress:(void (^)(NSDictionary *))callback {
+    _onOfflinePackProgressCallback = [callback copy];
     return YES;
 }
 
@@ -309,6 +922,11 @@
     return YES;
 }
 
+- (BOOL)valdi_setOnFrameStats:(void (^)(NSDictionary *))callback {
+    _onFrameStatsCallback = [callback copy];
+    return YES;
+}
+
 #pragma mark - MLNMapViewDelegate
 
 - (void)mapViewDidFinishLoadingMap:(MLNMapView *)mapView {
@@ -319,15 +937,16 @@
     }
 }
 
+- (void)mapView:(MLNMapView *)mapView didFinishLoadingStyle:(MLNStyle *)style {
+    // A new style drops runtime sources and layers; put the tracks back
+    [_trackLayer attachToStyle:style];
+}
+
 - (void)mapView:(MLNMapView *)mapView didSelectAnnotation:(id<MLNAnnotation>)annotation {
     // Find marker ID by annotation
-    for (NSString *markerId in _annotationsById) {
-        if (_annotationsById[markerId] == annotation) {
-            if (_onMarkerTapCallback) {
-                _onMarkerTapCallback(markerId);
-            }
-            break;
-        }
+    NSString *markerId = [_markerIdsByAnnotation objectForKey:annotation];
+    if (markerId && _onMarkerTapCallback) {
+        _onMarkerTapCallback(markerId);
     }
 }
 
@@ -336,6 +955,9 @@
 }
 
 - (void)mapView:(MLNMapView *)mapView regionDidChangeAnimated:(BOOL)animated {
+    // Re-cull and re-cluster once the camera settles; the margin covers tracks during the gesture
+    [_trackLayer setViewport:mapView.visibleCoordinateBounds zoomLevel:mapView.zoomLevel];
+
     if (_onCameraChangedCallback) {
         NSDictionary *cameraInfo = @{
             @"latitude": @(mapView.centerCoordinate.latitude),
@@ -360,6 +982,13 @@
         return nil;
     }
 
+#if SC_MAPLIBRE_SIGNPOSTS
+    NSString *traceMarkerId = [_markerIdsByAnnotation objectForKey:(MLNPointAnnotation *)annotation] ?: @"";
+    os_signpost_id_t traceSignpost = SCMapLibreTraceSignpostID(traceMarkerId);
+    os_signpost_interval_begin(SCMapLibreTraceLog(), traceSignpost, "viewForAnnotation", "cid=%08x uid=%{public}@",
+                               SCMapLibreTraceCorrelationID(traceMarkerId), traceMarkerId);
+#endif
+
     // Reuse annotation views for performance
     static NSString *reuseIdentifier = @"com.engindearing.omnitak.marker";
     MLNAnnotationView *annotationView = [mapView dequeueReusableAnnotationViewWithIdentifier:reuseIdentifier];
@@ -382,9 +1011,37 @@
         annotationView.annotation = annotation;
     }
 
+#if SC_MAPLIBRE_SIGNPOSTS
+    os_signpost_interval_end(SCMapLibreTraceLog(), traceSignpost, "viewForAnnotation");
+#endif
     return annotationView;
 }
 
+#pragma mark - Gestures
+
+- (void)handleMapTap:(UITapGestureRecognizer *)recognizer {
+    if (!_trackLayer || recognizer.state != UIGestureRecognizerStateEnded) {
+        return;
+    }
+
+    // Tapping a cluster zooms in until it splits rather than selecting anything
+    CGPoint point = [recognizer locationInView:_mapView];
+    if ([_trackLayer expandClusterAtPoint:point inMapView:_mapView]) {
+        return;
+    }
+
+    NSString *markerId = [_trackLayer markerIdAtPoint:point inMapView:_mapView];
+    if (markerId && _onMarkerTapCallback) {
+        _onMarkerTapCallback(markerId);
+    }
+}
+
+- (BOOL)gestureRecognizer:(UIGestureRecognizer *)gestureRecognizer
+    shouldRecognizeSimultaneouslyWithGestureRecognizer:(UIGestureRecognizer *)otherGestureRecognizer {
+    // Don't interfere with MapLibre's own gestures
+    return YES;
+}
+
 #pragma mark - Valdi Attributes Binding
 
 + (void)bindAttributes:(id<SCValdiAttributesBinderProtocol>)attributesBinder {
@@ -427,6 +1084,22 @@
         [view valdi_setCamera:defaultCamera];
     }];
 
+    // Bind 'cameraPosition' attribute (packed Float64s, no JSON)
+    [attributesBinder bindAttribute:@"cameraPosition"
+           invalidateLayoutOnChange:NO
+                   withUntypedBlock:^BOOL(__kindof SCMapLibreMapView *view,
+                                         id attributeValue,
+                                         id<SCValdiAnimatorProtocol> animator) {
+        if ([attributeValue isKindOfClass:[NSData class]]) {
+            return [view valdi_setCameraPosition:attributeValue];
+        }
+        return NO;
+    }
+                         resetBlock:^(__kindof SCMapLibreMapView *view,
+                                     id<SCValdiAnimatorProtocol> animator) {
+        // The JSON camera attribute owns the default position
+    }];
+
     // Bind 'markers' attribute (JSON array)
     [attributesBinder bindAttribute:@"markers"
            invalidateLayoutOnChange:NO
@@ -443,6 +1116,87 @@
         [view valdi_setMarkers:@[]];
     }];
 
+    // Bind 'offlinePack' attribute (region prefetch into an on-disk tile pack)
+    [attributesBinder bindAttribute:@"offlinePack"
+           invalidateLayoutOnChange:NO
+                   withUntypedBlock:^BOOL(__kindof SCMapLibreMapView *view,
+                                         id attributeValue,
+                                         id<SCValdiAnimatorProtocol> animator) {
+        if ([attributeValue isKindOfClass:[NSDictionary class]]) {
+            return [view valdi_setOfflinePack:attributeValue];
+        }
+        return NO;
+    }
+                         resetBlock:^(__kindof SCMapLibreMapView *view,
+                                     id<SCValdiAnimatorProtocol> animator) {
+        // Stops downloading; the pack stays on disk and keeps serving tiles
+        [view valdi_setOfflinePack:nil];
+    }];
+
+    // Bind 'retentionKey' attribute (keeps markers across pool reuse)
+    [attributesBinder bindAttribute:@"retentionKey"
+           invalidateLayoutOnChange:NO
+                   withUntypedBlock:^BOOL(__kindof SCMapLibreMapView *view,
+                                         id attributeValue,
+                                         id<SCValdiAnimatorProtocol> animator) {
+        if ([attributeValue isKindOfClass:[NSString class]]) {
+            return [view valdi_setRetentionKey:attributeValue];
+        }
+        return NO;
+    }
+                         resetBlock:^(__kindof SCMapLibreMapView *view,
+                                     id<SCValdiAnimatorProtocol> animator) {
+        [view valdi_setRetentionKey:nil];
+    }];
+
+    // Bind 'markerIds' attribute (string table for markerPositions)
+    [attributesBinder bindAttribute:@"markerIds"
+           invalidateLayoutOnChange:NO
+                   withUntypedBlock:^BOOL(__kindof SCMapLibreMapView *view,
+                                         id attributeValue,
+                                         id<SCValdiAnimatorProtocol> animator) {
+        if ([attributeValue isKindOfClass:[NSArray class]]) {
+            return [view valdi_setMarkerIds:attributeValue];
+        }
+        return NO;
+    }
+                         resetBlock:^(__kindof SCMapLibreMapView *view,
+                                     id<SCValdiAnimatorProtocol> animator) {
+        [view valdi_setMarkerIds:@[]];
+    }];
+
+    // Bind 'markerPositions' attribute (packed Float64 records, no JSON)
+    [attributesBinder bindAttribute:@"markerPositions"
+           invalidateLayoutOnChange:NO
+                   withUntypedBlock:^BOOL(__kindof SCMapLibreMapView *view,
+                                         id attributeValue,
+                                         id<SCValdiAnimatorProtocol> animator) {
+        if ([attributeValue isKindOfClass:[NSData class]]) {
+            return [view valdi_setMarkerPositions:attributeValue];
+        }
+        return NO;
+    }
+                         resetBlock:^(__kindof SCMapLibreMapView *view,
+                                     id<SCValdiAnimatorProtocol> animator) {
+        // Positions are deltas; markerIds decides which markers exist
+    }];
+
+    // Bind 'markerOps' attribute (JSON array of add/update/remove/clear ops)
+    [attributesBinder bindAttribute:@"markerOps"
+           invalidateLayoutOnChange:NO
+                   withUntypedBlock:^BOOL(__kindof SCMapLibreMapView *view,
+                                         id attributeValue,
+                                         id<SCValdiAnimatorProtocol> animator) {
+        if ([attributeValue isKindOfClass:[NSArray class]]) {
+            return [view valdi_setMarkerOps:attributeValue];
+        }
+        return NO;
+    }
+                         resetBlock:^(__kindof SCMapLibreMapView *view,
+                                     id<SCValdiAnimatorProtocol> animator) {
+        // Ops are deltas; there is nothing to undo when the attribute is unset
+    }];
+
     // Bind callback attributes
     [attributesBinder bindAttribute:@"onMapReady"
            invalidateLayoutOnChange:NO
@@ -504,6 +1258,37 @@
         [view valdi_setOnCameraChanged:nil];
     }];
 
+    [attributesBinder bindAttribute:@"onFrameStats"
+           invalidateLayoutOnChange:NO
+                   withUntypedBlock:^BOOL(__kindof SCMapLibreMapView *view,
+                                         id attributeValue,
+                                         id<SCValdiAnimatorProtocol> animator) {
+        if ([attributeValue isKindOfClass:NSClassFromString(@"NSBlock")]) {
+            return [view valdi_setOnFrameStats:attributeValue];
+        }
+        return NO;
+    }
+                         resetBlock:^(__kindof SCMapLibreMapView *view,
+                                     id<SCValdiAnimatorProtocol> animator) {
+        [view valdi_setOnFrameStats:nil];
+    }];
+
+    // Bind 'onOfflinePackProgress' callback
+    [attributesBinder bindAttribute:@"onOfflinePackProgress"
+           invalidateLayoutOnChange:NO
+                   withUntypedBlock:^BOOL(__kindof SCMapLibreMapView *view,
+                                         id attributeValue,
+                                         id<SCValdiAnimatorProtocol> animator) {
+        if ([attributeValue isKindOfClass:NSClassFromString(@"NSBlock")]) {
+            return [view valdi_setOnOfflinePackProgress:attributeValue];
+        }
+        return NO;
+    }
+                         resetBlock:^(__kindof SCMapLibreMapView *view,
+                                     id<SCValdiAnimatorProtocol> animator) {
+        [view valdi_setOnOfflinePackProgress:nil];
+    }];
+
     // Map view should fill available space
     [attributesBinder setMeasureDelegate:^CGSize(id<SCValdiViewLayoutAttributes> attributes,
                                                  CGSize maxSize,
@@ -0,0 +1,71 @@
+//
+//  SCMapLibreOfflinePack.h
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Region + zoom range prefetch into an SCMapLibreTileStore.
+//
+
+#import <Foundation/Foundation.h>
+
+@import MapLibre;
+
+@class SCMapLibreTileStore;
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, SCMapLibreOfflinePackState) {
+    SCMapLibreOfflinePackStateInactive,
+    SCMapLibreOfflinePackStateDownloading,
+    SCMapLibreOfflinePackStateComplete,
+    SCMapLibreOfflinePackStateBudgetExceeded, // Stopped at maxTiles or maxBytes
+    SCMapLibreOfflinePackStateCancelled,
+    SCMapLibreOfflinePackStateFailed,         // No style or tile templates could be loaded
+};
+
+/**
+ * SCMapLibreOfflinePack downloads everything MapLibre needs to show a region
+ * offline into a tile store: the style, its TileJSON, sprites and Latin glyph
+ * ranges, then every tile of every source from minimumZoom to maximumZoom
+ * over the bounds, lowest zoom first.
+ *
+ * Tiles and resources already in the store are skipped, so resuming an
+ * interrupted pack only fetches what's missing. Tiles the server reports as
+ * empty (204/404) are stored empty, so panning over them needs no network
+ * either. Downloading stops early once maxTiles tiles or maxBytes downloaded
+ * bytes are reached.
+ *
+ * Progress dictionaries have: state, totalTiles, completedTiles,
+ * downloadedTiles, cachedTiles, failedTiles, downloadedBytes, storeBytes.
+ */
+@interface SCMapLibreOfflinePack : NSObject
+
+- (instancetype)initWithStore:(SCMapLibreTileStore *)store
+                     styleURL:(nullable NSString *)styleURL
+             tileURLTemplates:(nullable NSArray<NSString *> *)tileURLTemplates
+                       bounds:(MLNCoordinateBounds)bounds
+                  minimumZoom:(NSUInteger)minimumZoom
+                  maximumZoom:(NSUInteger)maximumZoom NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, strong, readonly) SCMapLibreTileStore *store;
+
+/// Tile budget for this download; 0 means no limit
+@property (nonatomic, assign) NSUInteger maxTiles;
+/// Downloaded byte budget for this download; 0 means no limit
+@property (nonatomic, assign) unsigned long long maxBytes;
+/// Default 6
+@property (nonatomic, assign) NSUInteger maxConcurrentDownloads;
+
+/// Called on the main queue at most 4 times per second, and once when the pack stops
+@property (nonatomic, copy, nullable) void (^progressBlock)(NSDictionary *progress);
+
+@property (nonatomic, readonly) SCMapLibreOfflinePackState state;
+
+- (void)resume;
+- (void)cancel;
+
+- (NSDictionary *)progress;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,561 @@
+//
+//  SCMapLibreOfflinePack.m
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Implementation of offline pack prefetch.
+//
+
+#import "SCMapLibreOfflinePack.h"
+#import "SCMapLibreTileStore.h"
+
+static const CFTimeInterval kProgressInterval = 0.25;
+static const double kMaxMercatorLatitude = 85.0511287798;
+
+// Glyph ranges covering Latin, Latin-1 and Latin Extended; other scripts load on demand
+static const NSUInteger kPrefetchedGlyphRanges = 4;
+
+static NSString *SCOfflinePackStateName(SCMapLibreOfflinePackState state) {
+    switch (state) {
+        case SCMapLibreOfflinePackStateInactive: return @"inactive";
+        case SCMapLibreOfflinePackStateDownloading: return @"downloading";
+        case SCMapLibreOfflinePackStateComplete: return @"complete";
+        case SCMapLibreOfflinePackStateBudgetExceeded: return @"budgetExceeded";
+        case SCMapLibreOfflinePackStateCancelled: return @"cancelled";
+        case SCMapLibreOfflinePackStateFailed: return @"failed";
+    }
+    return @"inactive";
+}
+
+static NSUInteger SCTileColumn(NSUInteger zoom, double longitude) {
+    NSUInteger size = (NSUInteger)1 << zoom;
+    double normalized = longitude - 360.0 * floor((longitude + 180.0) / 360.0);
+    double x = floor((normalized + 180.0) / 360.0 * size);
+    return x <= 0 ? 0 : MIN((NSUInteger)x, size - 1);
+}
+
+// Web Mercator row, 0 at the north edge
+static NSUInteger SCTileRow(NSUInteger zoom, double latitude) {
+    NSUInteger size = (NSUInteger)1 << zoom;
+    double clamped = MAX(-kMaxMercatorLatitude, MIN(kMaxMercatorLatitude, latitude));
+    double radians = clamped * M_PI / 180.0;
+    double y = floor((1.0 - log(tan(radians) + 1.0 / cos(radians)) / M_PI) / 2.0 * size);
+    return y <= 0 ? 0 : MIN((NSUInteger)y, size - 1);
+}
+
+static NSString *SCTileURL(NSString *template, NSUInteger zoom, NSUInteger x, NSUInteger y) {
+    NSString *URL = [template stringByReplacingOccurrencesOfString:@"{z}" withString:@(zoom).stringValue];
+    URL = [URL stringByReplacingOccurrencesOfString:@"{x}" withString:@(x).stringValue];
+    return [URL stringByReplacingOccurrencesOfString:@"{y}" withString:@(y).stringValue];
+}
+
+static BOOL SCIsWebURL(id value) {
+    if (![value isKindOfClass:[NSString class]]) {
+        return NO;
+    }
+    return [value hasPrefix:@"https://"] || [value hasPrefix:@"http://"];
+}
+
+@interface SCMapLibreOfflinePack ()
+
+@property (nonatomic, strong, readwrite) SCMapLibreTileStore *store;
+@property (nonatomic, copy, nullable) NSString *styleURL;
+@property (nonatomic, copy) NSArray<NSString *> *requestedTemplates;
+@property (nonatomic, assign) MLNCoordinateBounds bounds;
+@property (nonatomic, assign) NSUInteger minimumZoom;
+@property (nonatomic, assign) NSUInteger maximumZoom;
+
+@property (atomic, assign, readwrite) SCMapLibreOfflinePackState state;
+
+// Everything below is only touched on `queue`
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong, nullable) NSURLSession *session;
+@property (nonatomic, strong) NSMutableOrderedSet<NSString *> *templates;
+@property (nonatomic, copy) NSArray<NSNumber *> *sources; // Store source index per template
+@property (nonatomic, assign) NSUInteger pendingResources;
+@property (nonatomic, assign) NSUInteger inFlight;
+
+// Tile cursor: zoom, then source, then column, then row
+@property (nonatomic, assign) NSUInteger cursorZoom;
+@property (nonatomic, assign) NSUInteger cursorSource;
+@property (nonatomic, assign) NSUInteger cursorColumn;
+@property (nonatomic, assign) NSUInteger cursorRow;
+@property (nonatomic, assign) BOOL cursorDone;
+
+@property (nonatomic, assign) NSUInteger totalTiles;
+@property (nonatomic, assign) NSUInteger startedTiles;
+@property (nonatomic, assign) NSUInteger downloadedTiles;
+@property (nonatomic, assign) NSUInteger cachedTiles;
+@property (nonatomic, assign) NSUInteger failedTiles;
+@property (nonatomic, assign) unsigned long long downloadedBytes;
+@property (nonatomic, assign) CFTimeInterval lastProgressTime;
+
+@end
+
+@implementation SCMapLibreOfflinePack
+
+- (instancetype)initWithStore:(SCMapLibreTileStore *)store
+                     styleURL:(nullable NSString *)styleURL
+             tileURLTemplates:(nullable NSArray<NSString *> *)tileURLTemplates
+                       bounds:(MLNCoordinateBounds)bounds
+                  minimumZoom:(NSUInteger)minimumZoom
+                  maximumZoom:(NSUInteger)maximumZoom {
+    self = [super init];
+    if (self) {
+        _store = store;
+        _styleURL = [styleURL copy];
+        _requestedTemplates = [tileURLTemplates copy] ?: @[];
+        _bounds = bounds;
+        _maximumZoom = MIN(maximumZoom, SCMapLibreTileStoreMaxZoom);
+        _minimumZoom = MIN(minimumZoom, _maximumZoom);
+        _maxConcurrentDownloads = 6;
+        _queue = dispatch_queue_create("com.engindearing.omnitak.offline-pack", DISPATCH_QUEUE_SERIAL);
+        _templates = [NSMutableOrderedSet orderedSet];
+        _sources = @[];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_session invalidateAndCancel];
+}
+
+#pragma mark - Control
+
+- (void)resume {
+    dispatch_async(_queue, ^{
+        if (self.state == SCMapLibreOfflinePackStateDownloading) {
+            return;
+        }
+        self.state = SCMapLibreOfflinePackStateDownloading;
+        [self resetCounters];
+
+        NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+        delegateQueue.underlyingQueue = self.queue;
+        delegateQueue.maxConcurrentOperationCount = 1;
+        self.session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]
+                                                     delegate:nil
+                                                delegateQueue:delegateQueue];
+
+        [self.templates removeAllObjects];
+        [self.templates addObjectsFromArray:self.requestedTemplates];
+        [self loadStyle];
+    });
+}
+
+- (void)cancel {
+    dispatch_async(_queue, ^{
+        if (self.state != SCMapLibreOfflinePackStateDownloading) {
+            return;
+        }
+        [self finishWithState:SCMapLibreOfflinePackStateCancelled];
+    });
+}
+
+- (void)resetCounters {
+    _pendingResources = 0;
+    _inFlight = 0;
+    _cursorZoom = _minimumZoom;
+    _cursorSource = 0;
+    _cursorColumn = 0;
+    _cursorRow = 0;
+    _cursorDone = NO;
+    _totalTiles = 0;
+    _startedTiles = 0;
+    _downloadedTiles = 0;
+    _cachedTiles = 0;
+    _failedTiles = 0;
+    _downloadedBytes = 0;
+    _lastProgressTime = 0;
+}
+
+- (void)finishWithState:(SCMapLibreOfflinePackState)state {
+    self.state = state;
+    [_session invalidateAndCancel];
+    _session = nil;
+    _inFlight = 0;
+    [self reportProgress:YES];
+}
+
+#pragma mark - Style Resources
+
+- (void)fetchResource:(NSString *)URL completion:(void (^)(NSData *_Nullable data))completion {
+    NSData *stored = [_store resourceForURL:URL];
+    if (stored) {
+        completion(stored);
+        return;
+    }
+
+    NSURL *resourceURL = [NSURL URLWithString:URL];
+    if (!resourceURL) {
+        completion(nil);
+        return;
+    }
+
+    __weak SCMapLibreOfflinePack *weakSelf = self;
+    NSURLSessionDataTask *task = [_session dataTaskWithURL:resourceURL
+                                         completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        SCMapLibreOfflinePack *pack = weakSelf;
+        if (!pack || pack.state != SCMapLibreOfflinePackStateDownloading) {
+            return;
+        }
+        NSInteger status = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)response).statusCode : 0;
+        if (error || status != 200 || !data) {
+            NSLog(@"[SCMapLibreOfflinePack] Failed to fetch %@ (%ld)", URL, (long)status);
+            completion(nil);
+            return;
+        }
+        pack.downloadedBytes += data.length;
+        [pack.store writeResource:data forURL:URL];
+        completion(data);
+    }];
+    if (!task) {
+        completion(nil);
+        return;
+    }
+    [task resume];
+}
+
+- (void)loadStyle {
+    if (!SCIsWebURL(_styleURL)) {
+        [self startTiles];
+        return;
+    }
+
+    [self fetchResource:_styleURL completion:^(NSData *_Nullable data) {
+        NSDictionary *style = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+        if (![style isKindOfClass:[NSDictionary class]]) {
+            [self startTiles];
+            return;
+        }
+        [self loadResourcesOfStyle:style];
+    }];
+}
+
+- (void)loadResourcesOfStyle:(NSDictionary *)style {
+    NSMutableOrderedSet<NSString *> *resources = [NSMutableOrderedSet orderedSet];
+    NSMutableOrderedSet<NSString *> *tileJSONs = [NSMutableOrderedSet orderedSet];
+    BOOL explicitTemplates = _requestedTemplates.count > 0;
+
+    NSDictionary *sources = style[@"sources"];
+    if ([sources isKindOfClass:[NSDictionary class]]) {
+        for (NSDictionary *source in sources.allValues) {
+            if (![source isKindOfClass:[NSDictionary class]] || explicitTemplates) {
+                continue;
+            }
+            NSArray *tiles = source[@"tiles"];
+            if ([tiles isKindOfClass:[NSArray class]] && SCIsWebURL(tiles.firstObject)) {
+                [_templates addObject:tiles.firstObject];
+            } else if (SCIsWebURL(source[@"url"])) {
+                [tileJSONs addObject:source[@"url"]];
+            }
+        }
+    }
+
+    // Sprites: one base URL, or [{id, url}] in newer styles
+    NSMutableArray<NSString *> *spriteBases = [NSMutableArray array];
+    id sprite = style[@"sprite"];
+    if (SCIsWebURL(sprite)) {
+        [spriteBases addObject:sprite];
+    } else if ([sprite isKindOfClass:[NSArray class]]) {
+        for (NSDictionary *entry in sprite) {
+            if ([entry isKindOfClass:[NSDictionary class]] && SCIsWebURL(entry[@"url"])) {
+                [spriteBases addObject:entry[@"url"]];
+            }
+        }
+    }
+    for (NSString *base in spriteBases) {
+        for (NSString *suffix in @[@".json", @".png", @"@2x.json", @"@2x.png"]) {
+            [resources addObject:[base stringByAppendingString:suffix]];
+        }
+    }
+
+    // Glyphs for every literal font stack the layers use
+    NSString *glyphs = style[@"glyphs"];
+    if (SCIsWebURL(glyphs)) {
+        NSMutableCharacterSet *unreserved = [NSMutableCharacterSet alphanumericCharacterSet];
+        [unreserved addCharactersInString:@"-_.~"];
+        for (NSString *fontStack in [self fontStacksOfStyle:style]) {
+            NSString *encoded = [fontStack stringByAddingPercentEncodingWithAllowedCharacters:unreserved];
+            NSString *base = [glyphs stringByReplacingOccurrencesOfString:@"{fontstack}" withString:encoded];
+            for (NSUInteger range = 0; range < kPrefetchedGlyphRanges; range++) {
+                NSString *rangeName = [NSString stringWithFormat:@"%lu-%lu",
+                                       (unsigned long)(range * 256), (unsigned long)(range * 256 + 255)];
+                [resources addObject:[base stringByReplacingOccurrencesOfString:@"{range}" withString:rangeName]];
+            }
+        }
+    }
+
+    _pendingResources = resources.count + tileJSONs.count;
+    if (_pendingResources == 0) {
+        [self startTiles];
+        return;
+    }
+
+    for (NSString *URL in resources) {
+        [self fetchResource:URL completion:^(NSData *_Nullable data) {
+            [self resourceDidFinish];
+        }];
+    }
+    for (NSString *URL in tileJSONs) {
+        [self fetchResource:URL completion:^(NSData *_Nullable data) {
+            NSDictionary *tileJSON = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+            NSArray *tiles = [tileJSON isKindOfClass:[NSDictionary class]] ? tileJSON[@"tiles"] : nil;
+            if ([tiles isKindOfClass:[NSArray class]] && SCIsWebURL(tiles.firstObject)) {
+                [self.templates addObject:tiles.firstObject];
+            }
+            [self resourceDidFinish];
+        }];
+    }
+}
+
+- (NSOrderedSet<NSString *> *)fontStacksOfStyle:(NSDictionary *)style {
+    NSMutableOrderedSet<NSString *> *fontStacks = [NSMutableOrderedSet orderedSet];
+    NSArray *layers = style[@"layers"];
+    if (![layers isKindOfClass:[NSArray class]]) {
+        return fontStacks;
+    }
+
+    for (NSDictionary *layer in layers) {
+        NSDictionary *layout = [layer isKindOfClass:[NSDictionary class]] ? layer[@"layout"] : nil;
+        NSArray *fonts = [layout isKindOfClass:[NSDictionary class]] ? layout[@"text-font"] : nil;
+        if (![fonts isKindOfClass:[NSArray class]]) {
+            continue;
+        }
+        // ["literal", [...]] expressions wrap the same array
+        if ([fonts.firstObject isEqual:@"literal"] && fonts.count == 2 && [fonts[1] isKindOfClass:[NSArray class]]) {
+            fonts = fonts[1];
+        }
+
+        BOOL literal = fonts.count > 0;
+        for (id font in fonts) {
+            literal = literal && [font isKindOfClass:[NSString class]];
+        }
+        if (literal) {
+            [fontStacks addObject:[fonts componentsJoinedByString:@","]];
+        }
+    }
+    return fontStacks;
+}
+
+- (void)resourceDidFinish {
+    if (--_pendingResources == 0) {
+        [self startTiles];
+    }
+}
+
+#pragma mark - Tiles
+
+- (void)startTiles {
+    if (self.state != SCMapLibreOfflinePackStateDownloading) {
+        return;
+    }
+
+    // Keep the store's source indexes stable; new templates go after the existing ones
+    NSMutableArray<NSString *> *storeTemplates = [_store.tileURLTemplates mutableCopy];
+    NSMutableArray<NSNumber *> *sources = [NSMutableArray arrayWithCapacity:_templates.count];
+    for (NSString *template in _templates) {
+        if (![template containsString:@"{z}"] || ![template containsString:@"{x}"] || ![template containsString:@"{y}"]) {
+            NSLog(@"[SCMapLibreOfflinePack] Skipping unsupported tile template %@", template);
+            continue;
+        }
+        NSUInteger source = [storeTemplates indexOfObject:template];
+        if (source == NSNotFound) {
+            source = storeTemplates.count;
+            [storeTemplates addObject:template];
+        }
+        [sources addObject:@(source)];
+    }
+
+    if (sources.count == 0) {
+        NSLog(@"[SCMapLibreOfflinePack] No tile templates for pack %@", _store.name);
+        [self finishWithState:SCMapLibreOfflinePackStateFailed];
+        return;
+    }
+    if (![storeTemplates isEqualToArray:_store.tileURLTemplates] || ![_styleURL ?: @"" isEqualToString:_store.styleURL ?: @""]) {
+        [_store setTileURLTemplates:storeTemplates styleURL:_styleURL];
+    }
+    _sources = sources;
+    [_templates removeAllObjects];
+    for (NSNumber *source in sources) {
+        [_templates addObject:storeTemplates[source.unsignedIntegerValue]];
+    }
+
+    NSUInteger total = 0;
+    for (NSUInteger zoom = _minimumZoom; zoom <= _maximumZoom; zoom++) {
+        total += [self columnCountAtZoom:zoom] * [self rowCountAtZoom:zoom];
+    }
+    total *= sources.count;
+    _totalTiles = _maxTiles > 0 ? MIN(total, _maxTiles) : total;
+
+    [self reportProgress:YES];
+    [self pump];
+}
+
+- (NSUInteger)firstColumnAtZoom:(NSUInteger)zoom {
+    return SCTileColumn(zoom, _bounds.sw.longitude);
+}
+
+// Bounds with west > east cross the antimeridian and wrap around column 0
+- (NSUInteger)columnCountAtZoom:(NSUInteger)zoom {
+    NSUInteger size = (NSUInteger)1 << zoom;
+    if (_bounds.ne.longitude - _bounds.sw.longitude >= 360.0) {
+        return size;
+    }
+    NSUInteger first = SCTileColumn(zoom, _bounds.sw.longitude);
+    NSUInteger last = SCTileColumn(zoom, _bounds.ne.longitude);
+    return last >= first ? last - first + 1 : size - first + last + 1;
+}
+
+- (NSUInteger)firstRowAtZoom:(NSUInteger)zoom {
+    return SCTileRow(zoom, _bounds.ne.latitude);
+}
+
+- (NSUInteger)rowCountAtZoom:(NSUInteger)zoom {
+    return SCTileRow(zoom, _bounds.sw.latitude) - SCTileRow(zoom, _bounds.ne.latitude) + 1;
+}
+
+- (BOOL)nextTileSource:(NSUInteger *)sourceIndex zoom:(NSUInteger *)zoom x:(NSUInteger *)x y:(NSUInteger *)y {
+    if (_cursorDone) {
+        return NO;
+    }
+
+    NSUInteger size = (NSUInteger)1 << _cursorZoom;
+    *sourceIndex = _cursorSource;
+    *zoom = _cursorZoom;
+    *x = ([self firstColumnAtZoom:_cursorZoom] + _cursorColumn) % size;
+    *y = [self firstRowAtZoom:_cursorZoom] + _cursorRow;
+
+    if (++_cursorRow < [self rowCountAtZoom:_cursorZoom]) {
+        return YES;
+    }
+    _cursorRow = 0;
+    if (++_cursorColumn < [self columnCountAtZoom:_cursorZoom]) {
+        return YES;
+    }
+    _cursorColumn = 0;
+    if (++_cursorSource < _sources.count) {
+        return YES;
+    }
+    _cursorSource = 0;
+    if (++_cursorZoom > _maximumZoom) {
+        _cursorDone = YES;
+    }
+    return YES;
+}
+
+- (BOOL)budgetExceeded {
+    return (_maxTiles > 0 && _startedTiles >= _maxTiles) || (_maxBytes > 0 && _downloadedBytes >= _maxBytes);
+}
+
+- (void)pump {
+    while (self.state == SCMapLibreOfflinePackStateDownloading && _inFlight < MAX(_maxConcurrentDownloads, (NSUInteger)1)) {
+        if ([self budgetExceeded]) {
+            break;
+        }
+
+        NSUInteger sourceIndex, zoom, x, y;
+        if (![self nextTileSource:&sourceIndex zoom:&zoom x:&x y:&y]) {
+            break;
+        }
+        _startedTiles++;
+
+        NSUInteger source = _sources[sourceIndex].unsignedIntegerValue;
+        if ([_store containsTileAtSource:source zoom:zoom x:x y:y]) {
+            _cachedTiles++;
+            continue;
+        }
+
+        NSURL *URL = [NSURL URLWithString:SCTileURL(_templates[sourceIndex], zoom, x, y)];
+        if (!URL) {
+            _failedTiles++;
+            continue;
+        }
+        __weak SCMapLibreOfflinePack *weakSelf = self;
+        NSURLSessionDataTask *task = [_session dataTaskWithURL:URL
+                                             completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+            NSInteger status = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)response).statusCode : 0;
+            [weakSelf tileDidFinishWithData:error ? nil : data status:status source:source zoom:zoom x:x y:y];
+        }];
+        _inFlight++;
+        [task resume];
+    }
+
+    if (self.state != SCMapLibreOfflinePackStateDownloading || _inFlight > 0) {
+        return;
+    }
+    if (_cursorDone) {
+        [self finishWithState:SCMapLibreOfflinePackStateComplete];
+    } else if ([self budgetExceeded]) {
+        [self finishWithState:SCMapLibreOfflinePackStateBudgetExceeded];
+    }
+}
+
+- (void)tileDidFinishWithData:(nullable NSData *)data
+                       status:(NSInteger)status
+                       source:(NSUInteger)source
+                         zoom:(NSUInteger)zoom
+                            x:(NSUInteger)x
+                            y:(NSUInteger)y {
+    if (self.state != SCMapLibreOfflinePackStateDownloading) {
+        return;
+    }
+    _inFlight--;
+
+    // A 204/404 means nothing to draw here; store it empty so the area stays offline
+    BOOL empty = status == 204 || status == 404;
+    if ((status == 200 && data) || empty) {
+        NSData *tile = empty ? [NSData data] : data;
+        _downloadedBytes += tile.length;
+        if ([_store writeTile:tile source:source zoom:zoom x:x y:y]) {
+            _downloadedTiles++;
+        } else {
+            _failedTiles++;
+        }
+    } else {
+        _failedTiles++;
+    }
+
+    [self reportProgress:NO];
+    [self pump];
+}
+
+#pragma mark - Progress
+
+// Called on `queue`
+- (NSDictionary *)currentProgress {
+    return @{
+        @"state": SCOfflinePackStateName(self.state),
+        @"totalTiles": @(_totalTiles),
+        @"completedTiles": @(_downloadedTiles + _cachedTiles),
+        @"downloadedTiles": @(_downloadedTiles),
+        @"cachedTiles": @(_cachedTiles),
+        @"failedTiles": @(_failedTiles),
+        @"downloadedBytes": @(_downloadedBytes),
+        @"storeBytes": @(_store.dataByteCount)
+    };
+}
+
+- (NSDictionary *)progress {
+    __block NSDictionary *progress;
+    dispatch_sync(_queue, ^{
+        progress = [self currentProgress];
+    });
+    return progress;
+}
+
+- (void)reportProgress:(BOOL)force {
+    CFTimeInterval now = CFAbsoluteTimeGetCurrent();
+    if (!force && now - _lastProgressTime < kProgressInterval) {
+        return;
+    }
+    _lastProgressTime = now;
+
+    NSDictionary *progress = [self currentProgress];
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if (self.progressBlock) {
+            self.progressBlock(progress);
+        }
+    });
+}
+
+@end
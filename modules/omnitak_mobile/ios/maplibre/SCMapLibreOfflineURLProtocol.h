@@ -0,0 +1,31 @@
+//
+//  SCMapLibreOfflineURLProtocol.h
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Serves MapLibre requests from offline tile packs.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ * SCMapLibreOfflineURLProtocol answers MapLibre's style, TileJSON, sprite,
+ * glyph and tile requests from SCMapLibreTileStore packs on disk, so areas
+ * covered by a pack load without any network I/O. Requests no pack can answer
+ * go to the network as usual.
+ *
+ * +install adds the protocol to MLNNetworkConfiguration's session
+ * configuration; it has to run before the first MLNMapView loads its style.
+ */
+@interface SCMapLibreOfflineURLProtocol : NSURLProtocol
+
+/// Idempotent; call before creating map views
++ (void)install;
+
+/// Data for `URL` from any pack, or nil
++ (nullable NSData *)offlineDataForURL:(NSURL *)URL;
+
+@end
+
+NS_ASSUME_NONNULL_END
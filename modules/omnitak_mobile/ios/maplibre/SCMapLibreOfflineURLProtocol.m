@@ -0,0 +1,78 @@
+//
+//  SCMapLibreOfflineURLProtocol.m
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Implementation of the offline pack URL protocol.
+//
+
+#import "SCMapLibreOfflineURLProtocol.h"
+#import "SCMapLibreTileStore.h"
+
+@import MapLibre;
+
+@implementation SCMapLibreOfflineURLProtocol
+
++ (void)install {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        MLNNetworkConfiguration *networkConfiguration = [MLNNetworkConfiguration sharedManager];
+        NSURLSessionConfiguration *sessionConfiguration = networkConfiguration.sessionConfiguration;
+        NSMutableArray *protocolClasses = [NSMutableArray arrayWithObject:self];
+        [protocolClasses addObjectsFromArray:sessionConfiguration.protocolClasses ?: @[]];
+        sessionConfiguration.protocolClasses = protocolClasses;
+        networkConfiguration.sessionConfiguration = sessionConfiguration;
+    });
+}
+
++ (nullable NSData *)offlineDataForURL:(NSURL *)URL {
+    // The first lookup opens the packs directory, on MapLibre's network thread
+    for (SCMapLibreTileStore *store in [SCMapLibreTileStore allStores]) {
+        NSData *data = [store dataForURL:URL];
+        if (data) {
+            return data;
+        }
+    }
+    return nil;
+}
+
+#pragma mark - NSURLProtocol
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    NSString *scheme = request.URL.scheme.lowercaseString;
+    if (![request.HTTPMethod isEqualToString:@"GET"] ||
+        !([scheme isEqualToString:@"https"] || [scheme isEqualToString:@"http"])) {
+        return NO;
+    }
+    return [self offlineDataForURL:request.URL] != nil;
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+    return request;
+}
+
+- (void)startLoading {
+    NSData *data = [[self class] offlineDataForURL:self.request.URL];
+    if (!data) {
+        [self.client URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                                           code:NSURLErrorResourceUnavailable
+                                                                       userInfo:nil]];
+        return;
+    }
+
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL
+                                                              statusCode:200
+                                                             HTTPVersion:@"HTTP/1.1"
+                                                            headerFields:@{
+        @"Content-Length": [NSString stringWithFormat:@"%lu", (unsigned long)data.length]
+    }];
+    // MapLibre keeps its own cache; don't copy mapped pack data into URLCache too
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    [self.client URLProtocol:self didLoadData:data];
+    [self.client URLProtocolDidFinishLoading:self];
+}
+
+- (void)stopLoading {
+    // Responses are delivered synchronously in startLoading
+}
+
+@end
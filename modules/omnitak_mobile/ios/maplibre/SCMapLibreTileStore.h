@@ -0,0 +1,81 @@
+//
+//  SCMapLibreTileStore.h
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Single-file, memory-mapped store for offline tile packs.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Highest zoom level a store can hold tiles for
+extern const NSUInteger SCMapLibreTileStoreMaxZoom;
+
+/**
+ * SCMapLibreTileStore keeps an offline pack in one append-only file, in the
+ * spirit of MBTiles: tiles addressed by source, zoom, x and y, plus style
+ * resources (style JSON, TileJSON, sprites, glyphs) addressed by URL, plus a
+ * metadata record with the pack's tile URL templates.
+ *
+ * The file is memory-mapped for reads. Opening a store scans the record
+ * headers once to build the index; looking up a tile is a dictionary probe
+ * and returns a no-copy view into the mapping, so serving tiles costs no
+ * file I/O beyond page faults. Each mapping reserves room past the end of the
+ * file, so appended records are readable without mapping again, and writes
+ * happen outside the index lock, so readers never wait on the disk. A record
+ * cut short by a crash is truncated on open.
+ *
+ * Rewriting a tile or resource leaves the old record in the file as waste;
+ * compact: rewrites the file with only the live records.
+ *
+ * Stores are shared per file: storeNamed: returns the same instance for the
+ * same name, so a download and the URL protocol serving it never write the
+ * same file twice. Thread-safe.
+ */
+@interface SCMapLibreTileStore : NSObject
+
+/// Open (or create) the store for a pack name in the packs directory
++ (nullable instancetype)storeNamed:(NSString *)name error:(NSError **)error;
+
+/// Every store in the packs directory, opened on first call
++ (NSArray<SCMapLibreTileStore *> *)allStores;
+
+/// Application Support/OmniTAKTilePacks, excluded from backups
++ (NSURL *)packsDirectoryURL;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, copy, readonly) NSString *name;
+@property (nonatomic, readonly) NSUInteger tileCount;
+/// Bytes of tile and resource data currently indexed
+@property (nonatomic, readonly) unsigned long long dataByteCount;
+/// Bytes of superseded records, reclaimed by compact:
+@property (nonatomic, readonly) unsigned long long wastedByteCount;
+
+/// Tile URL templates ({z}, {x}, {y}) in source order, persisted in the store
+@property (nonatomic, copy, readonly) NSArray<NSString *> *tileURLTemplates;
+/// Style URL the pack was built for, persisted in the store
+@property (nonatomic, copy, readonly, nullable) NSString *styleURL;
+
+/// Persist the templates used to address tiles (and fetch them)
+- (BOOL)setTileURLTemplates:(NSArray<NSString *> *)templates styleURL:(nullable NSString *)styleURL;
+
+- (BOOL)containsTileAtSource:(NSUInteger)source zoom:(NSUInteger)zoom x:(NSUInteger)x y:(NSUInteger)y;
+- (nullable NSData *)tileAtSource:(NSUInteger)source zoom:(NSUInteger)zoom x:(NSUInteger)x y:(NSUInteger)y;
+- (BOOL)writeTile:(NSData *)data source:(NSUInteger)source zoom:(NSUInteger)zoom x:(NSUInteger)x y:(NSUInteger)y;
+
+- (nullable NSData *)resourceForURL:(NSString *)URL;
+- (BOOL)writeResource:(NSData *)data forURL:(NSString *)URL;
+
+/// Tile or resource stored for a request URL: resources match exactly, tiles
+/// through the templates. Returns nil if the store can't answer the URL.
+- (nullable NSData *)dataForURL:(NSURL *)URL;
+
+/// Rewrite the file with only its live records. Writes wait until it's done but
+/// reads don't; it does blocking file I/O, so call it off the main thread.
+- (BOOL)compact:(NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
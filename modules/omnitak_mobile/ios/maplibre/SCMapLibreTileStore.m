@@ -0,0 +1,788 @@
+//
+//  SCMapLibreTileStore.m
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Implementation of the memory-mapped offline tile store.
+//
+
+#import "SCMapLibreTileStore.h"
+
+#import <fcntl.h>
+#import <os/lock.h>
+#import <pthread.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+const NSUInteger SCMapLibreTileStoreMaxZoom = 22;
+
+static NSString *const kTileStoreErrorDomain = @"SCMapLibreTileStore";
+static NSString *const kPackFileExtension = @"tiles";
+
+static const char kFileMagic[8] = {'S', 'C', 'T', 'I', 'L', 'E', 'S', '1'};
+static const uint32_t kRecordMagic = 0x52544353; // "SCTR"
+
+// Address space each mapping reserves past the file end, so appends stay readable
+// without mapping again
+static const unsigned long long kMappingReserve = 64ull << 20;
+
+typedef NS_ENUM(uint8_t, SCTileRecordKind) {
+    SCTileRecordKindTile = 1,
+    SCTileRecordKindResource = 2,
+    SCTileRecordKindMetadata = 3,
+};
+
+// Every record is this header, then nameLength bytes of UTF-8 name, then the data
+typedef struct {
+    uint32_t magic;
+    uint8_t kind;
+    uint8_t reserved[3];
+    uint32_t nameLength;
+    uint32_t dataLength;
+    uint64_t tileKey;
+} SCTileRecordHeader;
+
+// source:15 | zoom:5 | x:22 | y:22
+static uint64_t SCTileKey(NSUInteger source, NSUInteger zoom, NSUInteger x, NSUInteger y) {
+    return ((uint64_t)source << 49) | ((uint64_t)zoom << 44) | ((uint64_t)x << 22) | (uint64_t)y;
+}
+
+static BOOL SCTileKeyIsValid(NSUInteger source, NSUInteger zoom, NSUInteger x, NSUInteger y) {
+    NSUInteger size = (NSUInteger)1 << MIN(zoom, SCMapLibreTileStoreMaxZoom);
+    return source < (1u << 15) && zoom <= SCMapLibreTileStoreMaxZoom && x < size && y < size;
+}
+
+static NSError *SCTileStoreError(NSString *description) {
+    return [NSError errorWithDomain:kTileStoreErrorDomain
+                               code:1
+                           userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+static NSError *SCTileStorePOSIXError(void) {
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+}
+
+// pwrite until every byte is written
+static BOOL SCWriteFully(int fd, const void *bytes, size_t length, unsigned long long offset) {
+    const uint8_t *cursor = bytes;
+    while (length > 0) {
+        ssize_t written = pwrite(fd, cursor, length, (off_t)offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NO;
+        }
+        cursor += written;
+        length -= (size_t)written;
+        offset += (unsigned long long)written;
+    }
+    return YES;
+}
+
+static unsigned long long SCRecordLength(SCTileRecordHeader header) {
+    return sizeof(header) + (unsigned long long)header.nameLength + header.dataLength;
+}
+
+// A read-only mapping of the pack file. Every record from firstRecordOffset up to
+// the next mapping's lies wholly inside it; the space it reserves past the file
+// end is only touched once appends have filled it.
+@interface SCTileMapping : NSObject
+
+- (nullable instancetype)initWithFileDescriptor:(int)fd
+                              firstRecordOffset:(unsigned long long)firstRecordOffset
+                                  minimumLength:(unsigned long long)minimumLength;
+
+@property (nonatomic, readonly) unsigned long long firstRecordOffset;
+
+- (BOOL)coversOffset:(unsigned long long)offset length:(unsigned long long)length;
+- (const uint8_t *)bytesAtOffset:(unsigned long long)offset;
+
+@end
+
+@implementation SCTileMapping {
+    const uint8_t *_bytes;
+    unsigned long long _start;
+    size_t _length;
+}
+
+- (nullable instancetype)initWithFileDescriptor:(int)fd
+                              firstRecordOffset:(unsigned long long)firstRecordOffset
+                                  minimumLength:(unsigned long long)minimumLength {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    unsigned long long page = (unsigned long long)getpagesize();
+    _start = firstRecordOffset - firstRecordOffset % page;
+    unsigned long long length = firstRecordOffset - _start + minimumLength + kMappingReserve;
+    _length = (size_t)((length + page - 1) / page * page);
+    _firstRecordOffset = firstRecordOffset;
+
+    void *bytes = mmap(NULL, _length, PROT_READ, MAP_SHARED, fd, (off_t)_start);
+    if (bytes == MAP_FAILED) {
+        return nil;
+    }
+    _bytes = bytes;
+    return self;
+}
+
+- (void)dealloc {
+    munmap((void *)_bytes, _length);
+}
+
+- (BOOL)coversOffset:(unsigned long long)offset length:(unsigned long long)length {
+    return offset >= _firstRecordOffset && offset + length <= _start + _length;
+}
+
+- (const uint8_t *)bytesAtOffset:(unsigned long long)offset {
+    return _bytes + (offset - _start);
+}
+
+@end
+
+// The mapping that holds the record at `offset`
+static SCTileMapping *SCMappingForRecord(NSArray<SCTileMapping *> *mappings, unsigned long long offset) {
+    for (SCTileMapping *mapping in mappings.reverseObjectEnumerator) {
+        if (offset >= mapping.firstRecordOffset) {
+            return mapping;
+        }
+    }
+    return mappings.firstObject;
+}
+
+// A tile URL template compiled for matching request URLs
+@interface SCTileURLPattern : NSObject
+
+@property (nonatomic, strong) NSRegularExpression *expression;
+@property (nonatomic, assign) NSUInteger source;
+
+@end
+
+@implementation SCTileURLPattern
+@end
+
+@interface SCMapLibreTileStore () {
+    // Guards the index, the mappings and the file descriptor. Never held across file I/O.
+    os_unfair_lock _lock;
+    // Serializes appends and compaction, which do their I/O with only this held
+    pthread_mutex_t _writeMutex;
+    int _fd;
+}
+
+@property (nonatomic, copy, readwrite) NSString *name;
+@property (nonatomic, strong) NSURL *fileURL;
+// Oldest first; a record is read through the last mapping starting at or before it
+@property (nonatomic, strong) NSMutableArray<SCTileMapping *> *mappings;
+@property (nonatomic, assign) unsigned long long fileLength;
+
+// Record offsets of the newest record per tile key / resource URL
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSNumber *> *tileOffsets;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *resourceOffsets;
+@property (nonatomic, strong, nullable) NSNumber *metadataOffset;
+@property (nonatomic, assign, readwrite) unsigned long long dataByteCount;
+@property (nonatomic, assign, readwrite) unsigned long long wastedByteCount;
+
+@property (nonatomic, copy, readwrite) NSArray<NSString *> *tileURLTemplates;
+@property (nonatomic, copy, readwrite, nullable) NSString *styleURL;
+@property (nonatomic, copy) NSArray<SCTileURLPattern *> *patterns;
+
+@end
+
+@implementation SCMapLibreTileStore
+
+#pragma mark - Registry
+
+static os_unfair_lock gRegistryLock = OS_UNFAIR_LOCK_INIT;
+static NSMutableDictionary<NSString *, SCMapLibreTileStore *> *gStoresByName;
+static BOOL gScannedPacksDirectory;
+
++ (NSURL *)packsDirectoryURL {
+    NSURL *support = [[NSFileManager defaultManager] URLsForDirectory:NSApplicationSupportDirectory
+                                                             inDomains:NSUserDomainMask].firstObject;
+    return [support URLByAppendingPathComponent:@"OmniTAKTilePacks" isDirectory:YES];
+}
+
++ (BOOL)isValidName:(NSString *)name {
+    static NSCharacterSet *invalid;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSMutableCharacterSet *allowed = [NSMutableCharacterSet alphanumericCharacterSet];
+        [allowed addCharactersInString:@"._-"];
+        invalid = [allowed invertedSet];
+    });
+    return name.length > 0 && ![name hasPrefix:@"."] && [name rangeOfCharacterFromSet:invalid].location == NSNotFound;
+}
+
++ (nullable instancetype)storeNamed:(NSString *)name error:(NSError **)error {
+    if (![self isValidName:name]) {
+        if (error) {
+            *error = SCTileStoreError([NSString stringWithFormat:@"Invalid pack name '%@'", name]);
+        }
+        return nil;
+    }
+
+    os_unfair_lock_lock(&gRegistryLock);
+    if (!gStoresByName) {
+        gStoresByName = [NSMutableDictionary dictionary];
+    }
+    SCMapLibreTileStore *store = gStoresByName[name];
+    if (!store) {
+        store = [[self alloc] initWithName:name error:error];
+        if (store) {
+            gStoresByName[name] = store;
+        }
+    }
+    os_unfair_lock_unlock(&gRegistryLock);
+    return store;
+}
+
++ (NSArray<SCMapLibreTileStore *> *)allStores {
+    os_unfair_lock_lock(&gRegistryLock);
+    if (!gStoresByName) {
+        gStoresByName = [NSMutableDictionary dictionary];
+    }
+    if (!gScannedPacksDirectory) {
+        gScannedPacksDirectory = YES;
+        NSArray<NSURL *> *files = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:[self packsDirectoryURL]
+                                                                includingPropertiesForKeys:nil
+                                                                                   options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                                     error:nil];
+        for (NSURL *file in files) {
+            if (![file.pathExtension isEqualToString:kPackFileExtension]) {
+                continue;
+            }
+            NSString *name = file.lastPathComponent.stringByDeletingPathExtension;
+            if (gStoresByName[name] || ![self isValidName:name]) {
+                continue;
+            }
+            NSError *error = nil;
+            SCMapLibreTileStore *store = [[self alloc] initWithName:name error:&error];
+            if (store) {
+                gStoresByName[name] = store;
+            } else {
+                NSLog(@"[SCMapLibreTileStore] Skipping pack %@: %@", name, error.localizedDescription);
+            }
+        }
+    }
+    NSArray *stores = gStoresByName.allValues;
+    os_unfair_lock_unlock(&gRegistryLock);
+    return stores;
+}
+
+#pragma mark - Opening
+
+- (nullable instancetype)initWithName:(NSString *)name error:(NSError **)error {
+    self = [super init];
+    if (!self) {
+        return nil;
+    }
+
+    _lock = OS_UNFAIR_LOCK_INIT;
+    pthread_mutex_init(&_writeMutex, NULL);
+    _fd = -1;
+    _name = [name copy];
+    _tileOffsets = [NSMutableDictionary dictionary];
+    _resourceOffsets = [NSMutableDictionary dictionary];
+    _tileURLTemplates = @[];
+    _patterns = @[];
+
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSURL *directory = [[self class] packsDirectoryURL];
+    if (![fileManager createDirectoryAtURL:directory withIntermediateDirectories:YES attributes:nil error:error]) {
+        return nil;
+    }
+    // Packs can be re-downloaded; keep them out of device backups
+    [directory setResourceValue:@YES forKey:NSURLIsExcludedFromBackupKey error:nil];
+
+    _fileURL = [directory URLByAppendingPathComponent:[name stringByAppendingPathExtension:kPackFileExtension]];
+    if (![fileManager fileExistsAtPath:_fileURL.path]) {
+        NSData *header = [NSData dataWithBytes:kFileMagic length:sizeof(kFileMagic)];
+        if (![header writeToURL:_fileURL options:NSDataWritingAtomic error:error]) {
+            return nil;
+        }
+    }
+
+    _fd = open(_fileURL.path.fileSystemRepresentation, O_RDWR | O_CLOEXEC);
+    struct stat status;
+    if (_fd < 0 || fstat(_fd, &status) != 0) {
+        if (error) {
+            *error = SCTileStorePOSIXError();
+        }
+        return nil;
+    }
+
+    _fileLength = (unsigned long long)status.st_size;
+    SCTileMapping *mapping = [[SCTileMapping alloc] initWithFileDescriptor:_fd
+                                                         firstRecordOffset:0
+                                                             minimumLength:_fileLength];
+    if (!mapping) {
+        if (error) {
+            *error = SCTileStorePOSIXError();
+        }
+        return nil;
+    }
+    _mappings = [NSMutableArray arrayWithObject:mapping];
+
+    if (![self loadIndex:error]) {
+        return nil;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_fd >= 0) {
+        close(_fd);
+    }
+    pthread_mutex_destroy(&_writeMutex);
+}
+
+// Walk the record headers once; later records for the same key win
+- (BOOL)loadIndex:(NSError **)error {
+    const uint8_t *bytes = [_mappings.firstObject bytesAtOffset:0];
+    NSUInteger length = (NSUInteger)_fileLength;
+    if (length < sizeof(kFileMagic) || memcmp(bytes, kFileMagic, sizeof(kFileMagic)) != 0) {
+        if (error) {
+            *error = SCTileStoreError([NSString stringWithFormat:@"%@ is not a tile pack", _fileURL.lastPathComponent]);
+        }
+        return NO;
+    }
+
+    NSUInteger offset = sizeof(kFileMagic);
+    while (offset + sizeof(SCTileRecordHeader) <= length) {
+        SCTileRecordHeader header;
+        memcpy(&header, bytes + offset, sizeof(header));
+        unsigned long long end = (unsigned long long)offset + sizeof(header) + header.nameLength + header.dataLength;
+        if (header.magic != kRecordMagic || end > length) {
+            break;
+        }
+        [self indexRecord:header atOffset:offset bytes:bytes];
+        offset = (NSUInteger)end;
+    }
+
+    if (offset < length) {
+        // Drop the partial record of an interrupted write so appends line up again
+        NSLog(@"[SCMapLibreTileStore] Truncating %@ at %lu of %lu bytes",
+              _name, (unsigned long)offset, (unsigned long)length);
+        if (ftruncate(_fd, (off_t)offset) != 0) {
+            if (error) {
+                *error = SCTileStorePOSIXError();
+            }
+            return NO;
+        }
+        _fileLength = offset;
+    }
+    return YES;
+}
+
+// `bytes` is the whole file as mapped for the initial scan
+- (void)indexRecord:(SCTileRecordHeader)header atOffset:(NSUInteger)offset bytes:(const uint8_t *)bytes {
+    NSNumber *recordOffset = @(offset);
+
+    switch (header.kind) {
+        case SCTileRecordKindTile: {
+            NSNumber *key = @(header.tileKey);
+            [self forgetRecordAtOffset:_tileOffsets[key]];
+            _tileOffsets[key] = recordOffset;
+            _dataByteCount += header.dataLength;
+            break;
+        }
+        case SCTileRecordKindResource: {
+            NSString *URL = [[NSString alloc] initWithBytes:bytes + offset + sizeof(header)
+                                                     length:header.nameLength
+                                                   encoding:NSUTF8StringEncoding];
+            if (!URL) {
+                return;
+            }
+            [self forgetRecordAtOffset:_resourceOffsets[URL]];
+            _resourceOffsets[URL] = recordOffset;
+            _dataByteCount += header.dataLength;
+            break;
+        }
+        case SCTileRecordKindMetadata: {
+            NSData *json = [NSData dataWithBytesNoCopy:(void *)(bytes + offset + sizeof(header) + header.nameLength)
+                                                length:header.dataLength
+                                          freeWhenDone:NO];
+            NSDictionary *metadata = [NSJSONSerialization JSONObjectWithData:json options:0 error:nil];
+            if ([metadata isKindOfClass:[NSDictionary class]]) {
+                [self forgetRecordAtOffset:_metadataOffset];
+                _metadataOffset = recordOffset;
+                [self applyMetadata:metadata];
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Account for a record superseded by a newer one. Called with the lock held.
+- (void)forgetRecordAtOffset:(nullable NSNumber *)offset {
+    if (!offset) {
+        return;
+    }
+    SCTileRecordHeader header;
+    unsigned long long recordOffset = offset.unsignedLongLongValue;
+    memcpy(&header, [SCMappingForRecord(_mappings, recordOffset) bytesAtOffset:recordOffset], sizeof(header));
+    if (header.kind != SCTileRecordKindMetadata) {
+        _dataByteCount -= header.dataLength;
+    }
+    _wastedByteCount += SCRecordLength(header);
+}
+
+#pragma mark - Metadata
+
+- (void)applyMetadata:(NSDictionary *)metadata {
+    NSMutableArray<NSString *> *templates = [NSMutableArray array];
+    NSMutableArray<SCTileURLPattern *> *patterns = [NSMutableArray array];
+
+    NSArray *tiles = metadata[@"tiles"];
+    if ([tiles isKindOfClass:[NSArray class]]) {
+        for (NSString *template in tiles) {
+            if (![template isKindOfClass:[NSString class]]) {
+                continue;
+            }
+            SCTileURLPattern *pattern = [[SCTileURLPattern alloc] init];
+            pattern.expression = [[self class] expressionForTemplate:template];
+            pattern.source = templates.count;
+            [templates addObject:template];
+            if (pattern.expression) {
+                [patterns addObject:pattern];
+            }
+        }
+    }
+
+    NSString *style = metadata[@"style"];
+    _styleURL = [style isKindOfClass:[NSString class]] ? [style copy] : nil;
+    _tileURLTemplates = templates;
+    _patterns = patterns;
+}
+
++ (nullable NSRegularExpression *)expressionForTemplate:(NSString *)template {
+    NSString *pattern = [NSRegularExpression escapedPatternForString:template];
+    for (NSString *placeholder in @[@"z", @"x", @"y"]) {
+        NSString *escaped = [NSString stringWithFormat:@"\\{%@\\}", placeholder];
+        NSString *group = [NSString stringWithFormat:@"(?<%@>[0-9]+)", placeholder];
+        NSRange range = [pattern rangeOfString:escaped];
+        if (range.location == NSNotFound) {
+            return nil;
+        }
+        pattern = [pattern stringByReplacingCharactersInRange:range withString:group];
+    }
+    return [NSRegularExpression regularExpressionWithPattern:[NSString stringWithFormat:@"^%@$", pattern]
+                                                     options:0
+                                                       error:nil];
+}
+
+- (NSArray<NSString *> *)tileURLTemplates {
+    os_unfair_lock_lock(&_lock);
+    NSArray *templates = _tileURLTemplates;
+    os_unfair_lock_unlock(&_lock);
+    return templates;
+}
+
+- (nullable NSString *)styleURL {
+    os_unfair_lock_lock(&_lock);
+    NSString *styleURL = _styleURL;
+    os_unfair_lock_unlock(&_lock);
+    return styleURL;
+}
+
+- (BOOL)setTileURLTemplates:(NSArray<NSString *> *)templates styleURL:(nullable NSString *)styleURL {
+    NSMutableDictionary *metadata = [NSMutableDictionary dictionary];
+    metadata[@"tiles"] = templates;
+    metadata[@"style"] = styleURL;
+    NSData *json = [NSJSONSerialization dataWithJSONObject:metadata options:0 error:nil];
+    if (!json) {
+        return NO;
+    }
+
+    pthread_mutex_lock(&_writeMutex);
+    NSNumber *offset = [self appendRecordOfKind:SCTileRecordKindMetadata tileKey:0 name:nil data:json];
+    if (offset) {
+        os_unfair_lock_lock(&_lock);
+        [self forgetRecordAtOffset:_metadataOffset];
+        _metadataOffset = offset;
+        [self applyMetadata:metadata];
+        os_unfair_lock_unlock(&_lock);
+    }
+    pthread_mutex_unlock(&_writeMutex);
+    return offset != nil;
+}
+
+#pragma mark - Reading
+
+- (NSUInteger)tileCount {
+    os_unfair_lock_lock(&_lock);
+    NSUInteger count = _tileOffsets.count;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (unsigned long long)dataByteCount {
+    os_unfair_lock_lock(&_lock);
+    unsigned long long count = _dataByteCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+- (unsigned long long)wastedByteCount {
+    os_unfair_lock_lock(&_lock);
+    unsigned long long count = _wastedByteCount;
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+// Called with the lock held. The returned data keeps the mapping it points into alive.
+- (nullable NSData *)dataOfRecordAtOffset:(nullable NSNumber *)offset {
+    if (!offset) {
+        return nil;
+    }
+
+    unsigned long long recordOffset = offset.unsignedLongLongValue;
+    SCTileMapping *mapping = SCMappingForRecord(_mappings, recordOffset);
+    SCTileRecordHeader header;
+    memcpy(&header, [mapping bytesAtOffset:recordOffset], sizeof(header));
+    const uint8_t *data = [mapping bytesAtOffset:recordOffset + sizeof(header) + header.nameLength];
+
+    return [[NSData alloc] initWithBytesNoCopy:(void *)data
+                                        length:header.dataLength
+                                   deallocator:^(void *bytes, NSUInteger length) {
+        (void)mapping;
+    }];
+}
+
+- (BOOL)containsTileAtSource:(NSUInteger)source zoom:(NSUInteger)zoom x:(NSUInteger)x y:(NSUInteger)y {
+    if (!SCTileKeyIsValid(source, zoom, x, y)) {
+        return NO;
+    }
+    os_unfair_lock_lock(&_lock);
+    BOOL contains = _tileOffsets[@(SCTileKey(source, zoom, x, y))] != nil;
+    os_unfair_lock_unlock(&_lock);
+    return contains;
+}
+
+- (nullable NSData *)tileAtSource:(NSUInteger)source zoom:(NSUInteger)zoom x:(NSUInteger)x y:(NSUInteger)y {
+    if (!SCTileKeyIsValid(source, zoom, x, y)) {
+        return nil;
+    }
+    os_unfair_lock_lock(&_lock);
+    NSData *data = [self dataOfRecordAtOffset:_tileOffsets[@(SCTileKey(source, zoom, x, y))]];
+    os_unfair_lock_unlock(&_lock);
+    return data;
+}
+
+- (nullable NSData *)resourceForURL:(NSString *)URL {
+    os_unfair_lock_lock(&_lock);
+    NSData *data = [self dataOfRecordAtOffset:_resourceOffsets[URL]];
+    os_unfair_lock_unlock(&_lock);
+    return data;
+}
+
+- (nullable NSData *)dataForURL:(NSURL *)URL {
+    NSString *string = URL.absoluteString;
+    if (!string) {
+        return nil;
+    }
+
+    os_unfair_lock_lock(&_lock);
+    NSData *data = [self dataOfRecordAtOffset:_resourceOffsets[string]];
+    NSArray<SCTileURLPattern *> *patterns = _patterns;
+    os_unfair_lock_unlock(&_lock);
+    if (data) {
+        return data;
+    }
+
+    NSRange whole = NSMakeRange(0, string.length);
+    for (SCTileURLPattern *pattern in patterns) {
+        NSTextCheckingResult *match = [pattern.expression firstMatchInString:string options:0 range:whole];
+        if (!match) {
+            continue;
+        }
+        NSUInteger zoom = (NSUInteger)[string substringWithRange:[match rangeWithName:@"z"]].integerValue;
+        NSUInteger x = (NSUInteger)[string substringWithRange:[match rangeWithName:@"x"]].integerValue;
+        NSUInteger y = (NSUInteger)[string substringWithRange:[match rangeWithName:@"y"]].integerValue;
+        data = [self tileAtSource:pattern.source zoom:zoom x:x y:y];
+        if (data) {
+            return data;
+        }
+    }
+    return nil;
+}
+
+#pragma mark - Writing
+
+// Called with the write mutex held, and not the lock: the write may block on the
+// disk, and readers keep going meanwhile. On return the record is mapped but not
+// indexed yet. Returns the record offset, or nil on a write error.
+- (nullable NSNumber *)appendRecordOfKind:(SCTileRecordKind)kind
+                                  tileKey:(uint64_t)tileKey
+                                     name:(nullable NSString *)name
+                                     data:(NSData *)data {
+    NSData *nameData = [name dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+    if (data.length > UINT32_MAX || nameData.length > UINT32_MAX) {
+        return nil;
+    }
+
+    SCTileRecordHeader header = {0};
+    header.magic = kRecordMagic;
+    header.kind = kind;
+    header.nameLength = (uint32_t)nameData.length;
+    header.dataLength = (uint32_t)data.length;
+    header.tileKey = tileKey;
+
+    NSMutableData *record = [NSMutableData dataWithCapacity:sizeof(header) + nameData.length + data.length];
+    [record appendBytes:&header length:sizeof(header)];
+    [record appendData:nameData];
+    [record appendData:data];
+
+    // One write per record, so a crash leaves at most one partial record at the end.
+    // Only writers change the file length, descriptor and mappings, so they can be
+    // read here without the lock.
+    unsigned long long offset = _fileLength;
+    if (!SCWriteFully(_fd, record.bytes, record.length, offset)) {
+        NSLog(@"[SCMapLibreTileStore] Write to %@ failed: %s", _name, strerror(errno));
+        return nil;
+    }
+
+    // Map more of the file once appends outgrow the space the last mapping reserved
+    SCTileMapping *mapping = nil;
+    if (![_mappings.lastObject coversOffset:offset length:record.length]) {
+        mapping = [[SCTileMapping alloc] initWithFileDescriptor:_fd
+                                              firstRecordOffset:offset
+                                                  minimumLength:record.length];
+        if (!mapping) {
+            NSLog(@"[SCMapLibreTileStore] Mapping %@ failed: %s", _name, strerror(errno));
+            return nil;
+        }
+    }
+
+    os_unfair_lock_lock(&_lock);
+    if (mapping) {
+        [_mappings addObject:mapping];
+    }
+    _fileLength = offset + record.length;
+    os_unfair_lock_unlock(&_lock);
+    return @(offset);
+}
+
+- (BOOL)writeTile:(NSData *)data source:(NSUInteger)source zoom:(NSUInteger)zoom x:(NSUInteger)x y:(NSUInteger)y {
+    if (!SCTileKeyIsValid(source, zoom, x, y)) {
+        return NO;
+    }
+
+    uint64_t key = SCTileKey(source, zoom, x, y);
+    pthread_mutex_lock(&_writeMutex);
+    NSNumber *offset = [self appendRecordOfKind:SCTileRecordKindTile tileKey:key name:nil data:data];
+    if (offset) {
+        os_unfair_lock_lock(&_lock);
+        [self forgetRecordAtOffset:_tileOffsets[@(key)]];
+        _tileOffsets[@(key)] = offset;
+        _dataByteCount += data.length;
+        os_unfair_lock_unlock(&_lock);
+    }
+    pthread_mutex_unlock(&_writeMutex);
+    return offset != nil;
+}
+
+- (BOOL)writeResource:(NSData *)data forURL:(NSString *)URL {
+    pthread_mutex_lock(&_writeMutex);
+    NSNumber *offset = [self appendRecordOfKind:SCTileRecordKindResource tileKey:0 name:URL data:data];
+    if (offset) {
+        os_unfair_lock_lock(&_lock);
+        [self forgetRecordAtOffset:_resourceOffsets[URL]];
+        _resourceOffsets[URL] = offset;
+        _dataByteCount += data.length;
+        os_unfair_lock_unlock(&_lock);
+    }
+    pthread_mutex_unlock(&_writeMutex);
+    return offset != nil;
+}
+
+#pragma mark - Compaction
+
+- (BOOL)compact:(NSError **)error {
+    pthread_mutex_lock(&_writeMutex);
+    BOOL compacted = [self compactWithWriteMutexHeld:error];
+    pthread_mutex_unlock(&_writeMutex);
+    return compacted;
+}
+
+// Copy the live records, oldest first, into a new file and swap it in. Writers wait
+// on the mutex throughout; readers keep using the old mappings (which outlive the
+// rename) until the swap, which only takes the lock to exchange offsets.
+- (BOOL)compactWithWriteMutexHeld:(NSError **)error {
+    os_unfair_lock_lock(&_lock);
+    NSMutableArray<NSNumber *> *offsets = [NSMutableArray arrayWithArray:_tileOffsets.allValues];
+    [offsets addObjectsFromArray:_resourceOffsets.allValues];
+    if (_metadataOffset) {
+        [offsets addObject:_metadataOffset];
+    }
+    NSArray<SCTileMapping *> *mappings = [_mappings copy];
+    os_unfair_lock_unlock(&_lock);
+    [offsets sortUsingSelector:@selector(compare:)];
+
+    NSURL *compactedURL = [_fileURL URLByAppendingPathExtension:@"compacting"];
+    const char *compactedPath = compactedURL.path.fileSystemRepresentation;
+    int fd = open(compactedPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        if (error) {
+            *error = SCTileStorePOSIXError();
+        }
+        return NO;
+    }
+
+    NSMutableDictionary<NSNumber *, NSNumber *> *moved = [NSMutableDictionary dictionaryWithCapacity:offsets.count];
+    unsigned long long length = sizeof(kFileMagic);
+    BOOL written = SCWriteFully(fd, kFileMagic, sizeof(kFileMagic), 0);
+    for (NSNumber *offset in offsets) {
+        if (!written) {
+            break;
+        }
+        unsigned long long recordOffset = offset.unsignedLongLongValue;
+        const uint8_t *record = [SCMappingForRecord(mappings, recordOffset) bytesAtOffset:recordOffset];
+        SCTileRecordHeader header;
+        memcpy(&header, record, sizeof(header));
+        unsigned long long recordLength = SCRecordLength(header);
+        written = SCWriteFully(fd, record, (size_t)recordLength, length);
+        moved[offset] = @(length);
+        length += recordLength;
+    }
+
+    // The old file is replaced in one rename, so it must be complete on disk first
+    SCTileMapping *mapping = nil;
+    if (written && fsync(fd) == 0 && rename(compactedPath, _fileURL.path.fileSystemRepresentation) == 0) {
+        mapping = [[SCTileMapping alloc] initWithFileDescriptor:fd firstRecordOffset:0 minimumLength:length];
+    }
+    if (!mapping) {
+        if (error) {
+            *error = SCTileStorePOSIXError();
+        }
+        close(fd);
+        unlink(compactedPath);
+        return NO;
+    }
+
+    os_unfair_lock_lock(&_lock);
+    for (NSNumber *key in _tileOffsets.allKeys) {
+        _tileOffsets[key] = moved[_tileOffsets[key]];
+    }
+    for (NSString *URL in _resourceOffsets.allKeys) {
+        _resourceOffsets[URL] = moved[_resourceOffsets[URL]];
+    }
+    _metadataOffset = _metadataOffset ? moved[_metadataOffset] : nil;
+    _mappings = [NSMutableArray arrayWithObject:mapping];
+    unsigned long long previousLength = _fileLength;
+    _fileLength = length;
+    _wastedByteCount = 0;
+    int previousFd = _fd;
+    _fd = fd;
+    os_unfair_lock_unlock(&_lock);
+
+    close(previousFd);
+    NSLog(@"[SCMapLibreTileStore] Compacted %@ from %llu to %llu bytes", _name, previousLength, length);
+    return YES;
+}
+
+@end
@@ -0,0 +1,48 @@
+//
+//  SCMapLibreTrace.h
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Compile-time-gated os_signpost instrumentation for the marker path.
+//
+
+#import <Foundation/Foundation.h>
+#import <os/log.h>
+#import <os/signpost.h>
+
+// Build with SC_MAPLIBRE_SIGNPOSTS=1 to compile the signposts in; they are
+// left out of the binary otherwise.
+#ifndef SC_MAPLIBRE_SIGNPOSTS
+#define SC_MAPLIBRE_SIGNPOSTS 0
+#endif
+
+#if SC_MAPLIBRE_SIGNPOSTS
+
+/// Points of Interest log, shown as its own lane in Instruments
+static inline os_log_t SCMapLibreTraceLog(void) {
+    static os_log_t log;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        log = os_log_create("com.engindearing.omnitak.maplibre", OS_LOG_CATEGORY_POINTS_OF_INTEREST);
+    });
+    return log;
+}
+
+/// Correlation id for a marker: the 32-bit FNV-1a hash of its id (the CoT uid),
+/// the same value the Android bridge prints as "cid=xxxxxxxx" in its ATrace sections.
+static inline uint32_t SCMapLibreTraceCorrelationID(NSString *markerId) {
+    const char *bytes = markerId.UTF8String;
+    uint32_t hash = 2166136261u;
+    for (; bytes && *bytes; ++bytes) {
+        hash ^= (uint8_t)*bytes;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/// Signpost id for a marker, so its intervals and events share one track
+static inline os_signpost_id_t SCMapLibreTraceSignpostID(NSString *markerId) {
+    os_signpost_id_t signpost = SCMapLibreTraceCorrelationID(markerId);
+    return signpost != OS_SIGNPOST_ID_NULL ? signpost : 1;
+}
+
+#endif
@@ -0,0 +1,104 @@
+//
+//  SCMapLibreTrackLayer.h
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  GPU-batched track rendering for SCMapLibreMapView.
+//
+
+#import <UIKit/UIKit.h>
+
+@import MapLibre;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// One record of the packed `markerPositions` buffer: four native-endian Float64s.
+/// markerIndex indexes the `markerIds` table; a NaN heading leaves it unchanged.
+typedef struct {
+    double markerIndex;
+    double latitude;
+    double longitude;
+    double heading;
+} SCMapLibreMarkerPosition;
+
+/**
+ * SCMapLibreTrackLayer renders markers as features of a single MLNShapeSource
+ * drawn by an MLNSymbolStyleLayer, instead of one UIKit annotation view per
+ * marker. MapLibre draws the whole set in a few GPU draw calls, so frame rate
+ * holds up with thousands of tracks during pan and zoom.
+ *
+ * Marker dictionaries use the same keys as the `markers` attribute, plus:
+ * - icon: name of a sprite image in the style (takes precedence)
+ * - type: CoT type (e.g. "a-f-G-U-C"); picks a MIL-STD-2525 affiliation frame
+ * - heading: degrees clockwise from north, rotates the icon
+ * - course, speed: degrees true and metres per second, as in the CoT <track>
+ *   detail; used for dead reckoning
+ *
+ * Changes are collected and pushed to the source in one update per commit.
+ *
+ * Once a viewport is set, only markers inside it (plus a margin) are pushed to
+ * the source, and changes to markers outside it don't trigger a source update.
+ *
+ * When clustered, nearby markers are drawn as one counted circle per zoom level
+ * (see SCMapLibreClusterIndex); single markers still render as symbols.
+ *
+ * With a dead-reckoning horizon set, markers with a speed keep moving along
+ * their course between reports, driven by a CADisplayLink, for up to the
+ * horizon past their last report. A new report that lands close to the drawn
+ * position is blended in over a short interval instead of jumping. A marker is
+ * only moved once it has shifted by half a point at the current zoom, and the
+ * display link is paused while nothing moves.
+ */
+@interface SCMapLibreTrackLayer : NSObject
+
+- (instancetype)initWithIdentifier:(NSString *)identifier NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, copy, readonly) NSString *identifier;
+@property (nonatomic, readonly) NSUInteger count;
+
+/// Group nearby markers into clusters up to SCMapLibreClusterMaxZoom
+@property (nonatomic, assign, getter=isClustered) BOOL clustered;
+
+/// Seconds past its last report a marker is extrapolated along its course; 0 (the
+/// default) turns dead reckoning off and puts markers back at their reported positions
+@property (nonatomic, assign) NSTimeInterval deadReckoningHorizon;
+
+/// Replace the whole marker set (same semantics as the `markers` attribute)
+- (void)setMarkers:(NSArray *)markers;
+
+/// Apply add/update/remove/clear ops (same semantics as the `markerOps` attribute)
+- (void)applyMarkerOps:(NSArray *)ops;
+
+/// Move (or create) markers from packed records, resolving IDs through `markerIds`
+- (void)applyPositions:(const SCMapLibreMarkerPosition *)positions
+                 count:(NSUInteger)count
+             markerIds:(NSArray<NSString *> *)markerIds;
+
+/// Remove every marker whose ID is not in `markerIds`
+- (void)retainMarkerIds:(NSSet<NSString *> *)markerIds;
+
+/// Current markers as dictionaries, e.g. to hand them to another renderer
+- (NSArray<NSDictionary *> *)markerSnapshots;
+
+/// Push pending changes to the shape source, if attached
+- (void)commit;
+
+/// Cull markers to the visible bounds (plus a margin) and pick the cluster level;
+/// call when the camera settles
+- (void)setViewport:(MLNCoordinateBounds)bounds zoomLevel:(double)zoomLevel;
+
+/// Add the source, layer and default icons to a (re)loaded style
+- (void)attachToStyle:(MLNStyle *)style;
+
+/// Remove the source and layer from their style
+- (void)detach;
+
+/// Marker ID of the topmost track within a touch target around `point`, if any
+- (nullable NSString *)markerIdAtPoint:(CGPoint)point inMapView:(MLNMapView *)mapView;
+
+/// If a cluster is under `point`, zoom the map in until it splits and return YES
+- (BOOL)expandClusterAtPoint:(CGPoint)point inMapView:(MLNMapView *)mapView;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,921 @@
+//
+//  SCMapLibreTrackLayer.m
+//  OmniTAK Mobile - MapLibre GL Native Integration
+//
+//  Implementation of GPU-batched track rendering.
+//
+
+#import "SCMapLibreTrackLayer.h"
+#import "SCMapLibreClusterIndex.h"
+
+#import <QuartzCore/QuartzCore.h>
+
+@import MapLibre;
+
+// Default affiliation frames, registered with the style under these names
+static NSString *const kIconFriend = @"omnitak-2525-friend";
+static NSString *const kIconHostile = @"omnitak-2525-hostile";
+static NSString *const kIconNeutral = @"omnitak-2525-neutral";
+static NSString *const kIconUnknown = @"omnitak-2525-unknown";
+
+// Half the side of the square searched around a tap (44pt touch target)
+static const CGFloat kTapRadius = 22.0;
+
+// Culling bounds extend the viewport by this fraction of its size on each side,
+// so short pans don't expose missing tracks or force a source update
+static const double kViewportMargin = 0.5;
+
+// Dead reckoning
+static const double kEarthRadius = 6371008.8;          // Mean radius, metres
+static const double kWorldPointsAtZoom0 = 512.0;       // MapLibre draws the world 512pt wide at zoom 0
+static const double kMinStepPoints = 0.5;              // Smaller moves wait for a later frame
+static const CFTimeInterval kCorrectionDuration = 0.5; // A new report is blended in over this long
+static const double kMaxCorrectionDistance = 250.0;    // Metres; a report further off snaps instead
+
+// Course or speed from a marker dictionary, NaN if absent
+static double SCMotionValue(id value) {
+    return [value isKindOfClass:[NSNumber class]] ? [value doubleValue] : NAN;
+}
+
+static double SCNormalizedLongitude(double longitude) {
+    return longitude - 360.0 * floor((longitude + 180.0) / 360.0);
+}
+
+// Approximate distance in metres of a small latitude/longitude offset (degrees)
+static double SCOffsetDistance(double deltaLatitude, double deltaLongitude, double latitude) {
+    double x = deltaLongitude * cos(latitude * M_PI / 180.0);
+    return sqrt(x * x + deltaLatitude * deltaLatitude) * M_PI / 180.0 * kEarthRadius;
+}
+
+// Point `distance` metres from `origin` along `course` (degrees true), on a sphere
+static CLLocationCoordinate2D SCDeadReckonedCoordinate(CLLocationCoordinate2D origin, double course, double distance) {
+    if (!(distance > 0)) {
+        return origin;
+    }
+
+    double angle = distance / kEarthRadius;
+    double bearing = course * M_PI / 180.0;
+    double lat1 = origin.latitude * M_PI / 180.0;
+    double lon1 = origin.longitude * M_PI / 180.0;
+    double lat2 = asin(sin(lat1) * cos(angle) + cos(lat1) * sin(angle) * cos(bearing));
+    double lon2 = lon1 + atan2(sin(bearing) * sin(angle) * cos(lat1), cos(angle) - sin(lat1) * sin(lat2));
+    return CLLocationCoordinate2DMake(lat2 * 180.0 / M_PI, SCNormalizedLongitude(lon2 * 180.0 / M_PI));
+}
+
+// Last report of a marker with a course or speed
+@interface SCMapLibreTrackMotion : NSObject
+
+@property (nonatomic, assign) CLLocationCoordinate2D anchor; // Reported position
+@property (nonatomic, assign) CFTimeInterval anchorTime;     // CACurrentMediaTime() of the report
+@property (nonatomic, assign) double course;                 // Degrees true
+@property (nonatomic, assign) double speed;                  // Metres per second
+// Drawn minus reported position when the report came in, faded out over kCorrectionDuration
+@property (nonatomic, assign) double correctionLatitude;
+@property (nonatomic, assign) double correctionLongitude;
+@property (nonatomic, assign) BOOL settled;                  // At its final position until the next report
+
+@end
+
+@implementation SCMapLibreTrackMotion
+@end
+
+// CADisplayLink retains its target; this breaks the cycle with the layer
+@interface SCMapLibreTrackLayerLinkProxy : NSObject
+
+@property (nonatomic, weak) SCMapLibreTrackLayer *trackLayer;
+
+@end
+
+@interface SCMapLibreTrackLayer ()
+
+@property (nonatomic, strong) NSMutableDictionary<NSString *, MLNPointFeature *> *featuresById;
+@property (nonatomic, weak, nullable) MLNStyle *style;
+@property (nonatomic, strong, nullable) MLNShapeSource *source;
+@property (nonatomic, strong, nullable) MLNSymbolStyleLayer *layer;
+@property (nonatomic, assign) BOOL dirty;
+@property (nonatomic, assign) BOOL hasViewport;
+@property (nonatomic, assign) MLNCoordinateBounds cullBounds;
+@property (nonatomic, strong, nullable) SCMapLibreClusterIndex *clusterIndex;
+@property (nonatomic, assign) NSInteger clusterZoom;
+@property (nonatomic, strong, nullable) MLNCircleStyleLayer *clusterLayer;
+@property (nonatomic, strong, nullable) MLNSymbolStyleLayer *clusterCountLayer;
+@property (nonatomic, assign) double zoomLevel;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, SCMapLibreTrackMotion *> *motionById;
+@property (nonatomic, strong, nullable) CADisplayLink *motionLink;
+
+- (void)motionLinkDidFire:(CADisplayLink *)displayLink;
+
+@end
+
+@implementation SCMapLibreTrackLayerLinkProxy
+
+- (void)motionLinkDidFire:(CADisplayLink *)displayLink {
+    [_trackLayer motionLinkDidFire:displayLink];
+}
+
+@end
+
+@implementation SCMapLibreTrackLayer
+
+#pragma mark - Initialization
+
+- (instancetype)initWithIdentifier:(NSString *)identifier {
+    self = [super init];
+    if (self) {
+        _identifier = [identifier copy];
+        _featuresById = [NSMutableDictionary dictionary];
+        _motionById = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_motionLink invalidate];
+}
+
+- (NSUInteger)count {
+    return _featuresById.count;
+}
+
+#pragma mark - Markers
+
+// Map the affiliation letter of a CoT atom type ("a-f-G-...") to a 2525 frame
++ (NSString *)iconNameForCotType:(nullable NSString *)type {
+    if (![type isKindOfClass:[NSString class]] || type.length < 3 || ![type hasPrefix:@"a-"]) {
+        return kIconUnknown;
+    }
+
+    switch ([type characterAtIndex:2]) {
+        case 'f':
+        case 'a':
+            return kIconFriend;
+        case 'h':
+        case 's':
+        case 'j':
+        case 'k':
+            return kIconHostile;
+        case 'n':
+            return kIconNeutral;
+        default:
+            return kIconUnknown;
+    }
+}
+
+// Apply the fields present in a marker dictionary to a feature.
+// Returns NO if a coordinate is required but missing.
+- (BOOL)applyMarkerData:(NSDictionary *)markerData
+              toFeature:(MLNPointFeature *)feature
+      requireCoordinate:(BOOL)requireCoordinate {
+    NSNumber *lat = markerData[@"latitude"];
+    NSNumber *lon = markerData[@"longitude"];
+
+    if (lat && lon) {
+        feature.coordinate = CLLocationCoordinate2DMake([lat doubleValue], [lon doubleValue]);
+    } else if (requireCoordinate) {
+        return NO;
+    }
+
+    NSMutableDictionary *attributes = feature.attributes ? [feature.attributes mutableCopy]
+                                                         : [NSMutableDictionary dictionary];
+
+    NSString *title = markerData[@"title"];
+    if ([title isKindOfClass:[NSString class]]) {
+        attributes[@"title"] = title;
+    }
+
+    NSString *subtitle = markerData[@"subtitle"];
+    if ([subtitle isKindOfClass:[NSString class]]) {
+        attributes[@"subtitle"] = subtitle;
+    }
+
+    NSNumber *heading = markerData[@"heading"];
+    if ([heading isKindOfClass:[NSNumber class]]) {
+        attributes[@"heading"] = heading;
+    }
+
+    // An explicit sprite wins; otherwise derive the frame from the CoT type
+    NSString *icon = markerData[@"icon"];
+    if ([icon isKindOfClass:[NSString class]]) {
+        attributes[@"icon"] = icon;
+    } else if (markerData[@"type"] || !attributes[@"icon"]) {
+        attributes[@"icon"] = [SCMapLibreTrackLayer iconNameForCotType:markerData[@"type"]];
+    }
+
+    feature.attributes = attributes;
+    return YES;
+}
+
+- (void)upsertMarker:(NSDictionary *)markerData markerId:(NSString *)markerId {
+    MLNPointFeature *existingFeature = _featuresById[markerId];
+    if (existingFeature) {
+        // Off-screen changes wait until the marker is culled back in
+        CLLocationCoordinate2D oldCoordinate = existingFeature.coordinate;
+        BOOL wasVisible = [self isVisibleCoordinate:oldCoordinate];
+        [self applyMarkerData:markerData toFeature:existingFeature requireCoordinate:NO];
+        [self reportMotionForMarkerId:markerId
+                              feature:existingFeature
+                            drawnFrom:oldCoordinate
+                                moved:markerData[@"latitude"] && markerData[@"longitude"]
+                               course:SCMotionValue(markerData[@"course"])
+                                speed:SCMotionValue(markerData[@"speed"])];
+        [_clusterIndex moveMarkerId:markerId from:oldCoordinate to:existingFeature.coordinate];
+        if (wasVisible || [self isVisibleCoordinate:existingFeature.coordinate]) {
+            _dirty = YES;
+        }
+        return;
+    }
+
+    MLNPointFeature *feature = [[MLNPointFeature alloc] init];
+    feature.identifier = markerId;
+    feature.attributes = @{@"id": markerId};
+    if ([self applyMarkerData:markerData toFeature:feature requireCoordinate:YES]) {
+        _featuresById[markerId] = feature;
+        [self reportMotionForMarkerId:markerId
+                              feature:feature
+                            drawnFrom:feature.coordinate
+                                moved:YES
+                               course:SCMotionValue(markerData[@"course"])
+                                speed:SCMotionValue(markerData[@"speed"])];
+        [_clusterIndex addMarkerId:markerId coordinate:feature.coordinate];
+        if ([self isVisibleCoordinate:feature.coordinate]) {
+            _dirty = YES;
+        }
+    }
+}
+
+- (void)removeMarkerId:(NSString *)markerId {
+    MLNPointFeature *feature = _featuresById[markerId];
+    if (!feature) {
+        return;
+    }
+    if ([self isVisibleCoordinate:feature.coordinate]) {
+        _dirty = YES;
+    }
+    [_clusterIndex removeMarkerId:markerId coordinate:feature.coordinate];
+    [_featuresById removeObjectForKey:markerId];
+    [_motionById removeObjectForKey:markerId];
+}
+
+- (void)setMarkers:(NSArray *)markers {
+    NSMutableSet<NSString *> *newMarkerIds = [NSMutableSet setWithCapacity:markers.count];
+
+    for (NSDictionary *markerData in markers) {
+        if (![markerData isKindOfClass:[NSDictionary class]]) {
+            continue;
+        }
+
+        NSString *markerId = markerData[@"id"];
+        if (![markerId isKindOfClass:[NSString class]] || !markerData[@"latitude"] || !markerData[@"longitude"]) {
+            continue;
+        }
+
+        [newMarkerIds addObject:markerId];
+        [self upsertMarker:markerData markerId:markerId];
+    }
+
+    // Remove markers that are no longer in the list
+    for (NSString *existingId in [_featuresById allKeys]) {
+        if (![newMarkerIds containsObject:existingId]) {
+            [self removeMarkerId:existingId];
+        }
+    }
+
+    [self commit];
+}
+
+- (void)applyMarkerOps:(NSArray *)ops {
+    for (NSDictionary *op in ops) {
+        if (![op isKindOfClass:[NSDictionary class]]) {
+            continue;
+        }
+
+        NSString *kind = op[@"op"];
+        if (![kind isKindOfClass:[NSString class]]) {
+            continue;
+        }
+
+        if ([kind isEqualToString:@"clear"]) {
+            [_featuresById removeAllObjects];
+            [_motionById removeAllObjects];
+            [_clusterIndex removeAllMarkers];
+            _dirty = YES;
+            continue;
+        }
+
+        NSString *markerId = op[@"id"];
+        if (![markerId isKindOfClass:[NSString class]]) {
+            continue;
+        }
+
+        if ([kind isEqualToString:@"remove"]) {
+            [self removeMarkerId:markerId];
+        } else if ([kind isEqualToString:@"add"] || [kind isEqualToString:@"update"]) {
+            [self upsertMarker:op markerId:markerId];
+        }
+    }
+
+    [self commit];
+}
+
+- (void)applyPositions:(const SCMapLibreMarkerPosition *)positions
+                 count:(NSUInteger)count
+             markerIds:(NSArray<NSString *> *)markerIds {
+    NSUInteger idCount = markerIds.count;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        const SCMapLibreMarkerPosition *position = &positions[i];
+        if (!(position->markerIndex >= 0 && position->markerIndex < idCount) ||
+            isnan(position->latitude) || isnan(position->longitude)) {
+            continue;
+        }
+
+        NSString *markerId = markerIds[(NSUInteger)position->markerIndex];
+        CLLocationCoordinate2D coordinate = CLLocationCoordinate2DMake(position->latitude, position->longitude);
+        BOOL hasHeading = !isnan(position->heading);
+
+        MLNPointFeature *feature = _featuresById[markerId];
+        if (!feature) {
+            feature = [[MLNPointFeature alloc] init];
+            feature.identifier = markerId;
+            feature.coordinate = coordinate;
+            feature.attributes = hasHeading ? @{@"id": markerId, @"icon": kIconUnknown, @"heading": @(position->heading)}
+                                            : @{@"id": markerId, @"icon": kIconUnknown};
+            _featuresById[markerId] = feature;
+            [_clusterIndex addMarkerId:markerId coordinate:coordinate];
+            if ([self isVisibleCoordinate:coordinate]) {
+                _dirty = YES;
+            }
+            continue;
+        }
+
+        CLLocationCoordinate2D oldCoordinate = feature.coordinate;
+        BOOL wasVisible = [self isVisibleCoordinate:oldCoordinate];
+        feature.coordinate = coordinate;
+        if (_motionById[markerId]) {
+            // Keeps the course and speed from the last marker update
+            [self reportMotionForMarkerId:markerId feature:feature drawnFrom:oldCoordinate moved:YES course:NAN speed:NAN];
+        }
+
+        // Only box a new heading when it actually changed
+        NSNumber *heading = feature.attributes[@"heading"];
+        if (hasHeading && (!heading || [heading doubleValue] != position->heading)) {
+            NSMutableDictionary *attributes = [feature.attributes mutableCopy];
+            attributes[@"heading"] = @(position->heading);
+            feature.attributes = attributes;
+        }
+
+        [_clusterIndex moveMarkerId:markerId from:oldCoordinate to:coordinate];
+        if (wasVisible || [self isVisibleCoordinate:coordinate]) {
+            _dirty = YES;
+        }
+    }
+
+    [self commit];
+}
+
+- (void)retainMarkerIds:(NSSet<NSString *> *)markerIds {
+    for (NSString *existingId in [_featuresById allKeys]) {
+        if (![markerIds containsObject:existingId]) {
+            [self removeMarkerId:existingId];
+        }
+    }
+
+    [self commit];
+}
+
+- (NSArray<NSDictionary *> *)markerSnapshots {
+    NSMutableArray<NSDictionary *> *snapshots = [NSMutableArray arrayWithCapacity:_featuresById.count];
+    [_featuresById enumerateKeysAndObjectsUsingBlock:^(NSString *markerId, MLNPointFeature *feature, BOOL *stop) {
+        NSMutableDictionary *marker = [feature.attributes mutableCopy];
+        marker[@"id"] = markerId;
+        marker[@"latitude"] = @(feature.coordinate.latitude);
+        marker[@"longitude"] = @(feature.coordinate.longitude);
+
+        SCMapLibreTrackMotion *motion = self.motionById[markerId];
+        if (motion) {
+            // The last report, not wherever dead reckoning has it drawn
+            marker[@"latitude"] = @(motion.anchor.latitude);
+            marker[@"longitude"] = @(motion.anchor.longitude);
+            marker[@"course"] = @(motion.course);
+            marker[@"speed"] = @(motion.speed);
+        }
+        [snapshots addObject:marker];
+    }];
+    return snapshots;
+}
+
+- (void)commit {
+    if (!_dirty || !_source) {
+        return;
+    }
+
+    // MLNShapeSource has no per-feature updates; swapping the shape once per
+    // batch keeps it to a single GeoJSON conversion however many markers changed
+    _source.shape = [MLNShapeCollectionFeature shapeCollectionWithShapes:[self renderedFeatures]];
+    _dirty = NO;
+}
+
+#pragma mark - Clustering
+
+- (void)setClustered:(BOOL)clustered {
+    if (clustered == (_clusterIndex != nil)) {
+        return;
+    }
+
+    if (clustered) {
+        _clusterIndex = [[SCMapLibreClusterIndex alloc] init];
+        [_featuresById enumerateKeysAndObjectsUsingBlock:^(NSString *markerId, MLNPointFeature *feature, BOOL *stop) {
+            [self.clusterIndex addMarkerId:markerId coordinate:feature.coordinate];
+        }];
+    } else {
+        _clusterIndex = nil;
+    }
+    _dirty = YES;
+    [self commit];
+}
+
+- (BOOL)isClustered {
+    return _clusterIndex != nil;
+}
+
+// Features for the source: culled markers, or clusters of them at the current zoom
+- (NSArray<MLNPointFeature *> *)renderedFeatures {
+    if (!_clusterIndex || _clusterZoom > SCMapLibreClusterMaxZoom) {
+        return [self visibleFeatures];
+    }
+
+    MLNCoordinateBounds bounds = _cullBounds;
+    if (!_hasViewport) {
+        bounds = MLNCoordinateBoundsMake(CLLocationCoordinate2DMake(-90, -180), CLLocationCoordinate2DMake(90, 180));
+    }
+
+    NSArray<SCMapLibreCluster *> *clusters = [_clusterIndex clustersAtZoom:_clusterZoom inBounds:bounds];
+    NSMutableArray<MLNPointFeature *> *features = [NSMutableArray arrayWithCapacity:clusters.count];
+    for (SCMapLibreCluster *cluster in clusters) {
+        MLNPointFeature *marker = cluster.markerId ? _featuresById[cluster.markerId] : nil;
+        if (marker) {
+            [features addObject:marker];
+            continue;
+        }
+
+        MLNPointFeature *feature = [[MLNPointFeature alloc] init];
+        feature.coordinate = cluster.coordinate;
+        feature.attributes = @{
+            @"cluster": @YES,
+            @"point_count": @(cluster.count),
+            @"point_count_abbreviated": cluster.count >= 1000
+                ? [NSString stringWithFormat:@"%luk", (unsigned long)(cluster.count / 1000)]
+                : [NSString stringWithFormat:@"%lu", (unsigned long)cluster.count]
+        };
+        [features addObject:feature];
+    }
+    return features;
+}
+
+#pragma mark - Viewport Culling
+
+- (void)setViewport:(MLNCoordinateBounds)bounds zoomLevel:(double)zoomLevel {
+    _zoomLevel = zoomLevel;
+
+    NSInteger clusterZoom = (NSInteger)floor(zoomLevel);
+    if (clusterZoom != _clusterZoom) {
+        _clusterZoom = clusterZoom;
+        if (_clusterIndex) {
+            _dirty = YES;
+        }
+    }
+
+    double latSpan = bounds.ne.latitude - bounds.sw.latitude;
+    double lonSpan = bounds.ne.longitude - bounds.sw.longitude;
+    if (lonSpan < 0) {
+        lonSpan += 360.0; // sw/ne given across the antimeridian
+    }
+    if (latSpan <= 0 || lonSpan <= 0) {
+        [self commit];
+        return;
+    }
+
+    // Keep the current bounds while the viewport stays inside them and hasn't
+    // zoomed in far enough to make them wasteful
+    if (_hasViewport) {
+        double cullLatSpan = _cullBounds.ne.latitude - _cullBounds.sw.latitude;
+        double cullLonSpan = _cullBounds.ne.longitude - _cullBounds.sw.longitude;
+        BOOL inside = [self isVisibleCoordinate:bounds.sw] && [self isVisibleCoordinate:bounds.ne];
+        BOOL zoomedIn = latSpan * 4 < cullLatSpan && lonSpan * 4 < cullLonSpan;
+        if (inside && !zoomedIn) {
+            [self commit];
+            return;
+        }
+    }
+
+    double latMargin = latSpan * kViewportMargin;
+    double lonMargin = lonSpan * kViewportMargin;
+    MLNCoordinateBounds cull;
+    cull.sw = CLLocationCoordinate2DMake(MAX(bounds.sw.latitude - latMargin, -90.0), bounds.sw.longitude - lonMargin);
+    cull.ne = CLLocationCoordinate2DMake(MIN(bounds.ne.latitude + latMargin, 90.0), bounds.sw.longitude + lonSpan + lonMargin);
+
+    _cullBounds = cull;
+    _hasViewport = YES;
+    _dirty = YES;
+    [self commit];
+}
+
+- (BOOL)isVisibleCoordinate:(CLLocationCoordinate2D)coordinate {
+    if (!_hasViewport) {
+        return YES;
+    }
+    if (coordinate.latitude < _cullBounds.sw.latitude || coordinate.latitude > _cullBounds.ne.latitude) {
+        return NO;
+    }
+
+    // Compare longitudes as an eastward offset from the west edge so bounds
+    // crossing the antimeridian (or extending past ±180) work unchanged
+    double lonSpan = _cullBounds.ne.longitude - _cullBounds.sw.longitude;
+    if (lonSpan >= 360.0) {
+        return YES;
+    }
+    double offset = fmod(coordinate.longitude - _cullBounds.sw.longitude, 360.0);
+    if (offset < 0) {
+        offset += 360.0;
+    }
+    return offset <= lonSpan;
+}
+
+- (NSArray<MLNPointFeature *> *)visibleFeatures {
+    if (!_hasViewport) {
+        return [_featuresById allValues];
+    }
+
+    NSMutableArray<MLNPointFeature *> *features = [NSMutableArray array];
+    for (MLNPointFeature *feature in [_featuresById objectEnumerator]) {
+        if ([self isVisibleCoordinate:feature.coordinate]) {
+            [features addObject:feature];
+        }
+    }
+    return features;
+}
+
+#pragma mark - Dead Reckoning
+
+- (void)setDeadReckoningHorizon:(NSTimeInterval)deadReckoningHorizon {
+    NSTimeInterval horizon = isfinite(deadReckoningHorizon) ? MAX(deadReckoningHorizon, 0.0) : 0.0;
+    if (horizon == _deadReckoningHorizon) {
+        return;
+    }
+    _deadReckoningHorizon = horizon;
+
+    if (horizon > 0) {
+        // Markers reported while it was off pick up from their last report
+        for (SCMapLibreTrackMotion *motion in [_motionById objectEnumerator]) {
+            motion.settled = NO;
+        }
+        [self startMotionLinkIfNeeded];
+        return;
+    }
+
+    [_motionLink invalidate];
+    _motionLink = nil;
+    [_motionById enumerateKeysAndObjectsUsingBlock:^(NSString *markerId, SCMapLibreTrackMotion *motion, BOOL *stop) {
+        motion.settled = YES;
+        motion.correctionLatitude = 0;
+        motion.correctionLongitude = 0;
+        MLNPointFeature *feature = self.featuresById[markerId];
+        if (feature) {
+            [self moveFeature:feature markerId:markerId to:motion.anchor];
+        }
+    }];
+    [self commit];
+}
+
+// Record a report for a marker. `feature` already has the reported coordinate if
+// `moved`; `drawn` is where the marker was drawn before. A NaN course or speed keeps
+// the previous value. Markers without a course or speed so far are left alone.
+- (void)reportMotionForMarkerId:(NSString *)markerId
+                        feature:(MLNPointFeature *)feature
+                      drawnFrom:(CLLocationCoordinate2D)drawn
+                          moved:(BOOL)moved
+                         course:(double)course
+                          speed:(double)speed {
+    BOOL hasCourse = isfinite(course);
+    BOOL hasSpeed = isfinite(speed) && speed >= 0;
+    if (!moved && !hasCourse && !hasSpeed) {
+        return; // E.g. only the title changed
+    }
+
+    SCMapLibreTrackMotion *motion = _motionById[markerId];
+    if (motion && !(hasCourse && course != motion.course) && !(hasSpeed && speed != motion.speed) &&
+        (!moved || (feature.coordinate.latitude == motion.anchor.latitude &&
+                    feature.coordinate.longitude == motion.anchor.longitude))) {
+        // The same report again, e.g. from a full markers list; keep extrapolating
+        feature.coordinate = drawn;
+        return;
+    }
+    if (!motion) {
+        if (!hasCourse && !hasSpeed) {
+            return;
+        }
+        motion = [[SCMapLibreTrackMotion alloc] init];
+        _motionById[markerId] = motion;
+    }
+    if (hasCourse) {
+        motion.course = course;
+    }
+    if (hasSpeed) {
+        motion.speed = speed;
+    }
+
+    motion.anchor = feature.coordinate;
+    motion.anchorTime = CACurrentMediaTime();
+    motion.correctionLatitude = 0;
+    motion.correctionLongitude = 0;
+    if (_deadReckoningHorizon <= 0) {
+        motion.settled = YES;
+        return;
+    }
+
+    // Glide from the drawn position to the new track instead of jumping back
+    if (moved) {
+        double deltaLatitude = drawn.latitude - motion.anchor.latitude;
+        double deltaLongitude = SCNormalizedLongitude(drawn.longitude - motion.anchor.longitude);
+        if (SCOffsetDistance(deltaLatitude, deltaLongitude, drawn.latitude) <= kMaxCorrectionDistance) {
+            motion.correctionLatitude = deltaLatitude;
+            motion.correctionLongitude = deltaLongitude;
+            feature.coordinate = drawn;
+        }
+    }
+    motion.settled = NO;
+    [self startMotionLinkIfNeeded];
+}
+
+- (void)moveFeature:(MLNPointFeature *)feature markerId:(NSString *)markerId to:(CLLocationCoordinate2D)coordinate {
+    CLLocationCoordinate2D oldCoordinate = feature.coordinate;
+    BOOL wasVisible = [self isVisibleCoordinate:oldCoordinate];
+    feature.coordinate = coordinate;
+    [_clusterIndex moveMarkerId:markerId from:oldCoordinate to:coordinate];
+    if (wasVisible || [self isVisibleCoordinate:coordinate]) {
+        _dirty = YES;
+    }
+}
+
+- (void)startMotionLinkIfNeeded {
+    if (_deadReckoningHorizon <= 0 || !_source) {
+        return;
+    }
+
+    if (!_motionLink) {
+        SCMapLibreTrackLayerLinkProxy *proxy = [[SCMapLibreTrackLayerLinkProxy alloc] init];
+        proxy.trackLayer = self;
+        _motionLink = [CADisplayLink displayLinkWithTarget:proxy selector:@selector(motionLinkDidFire:)];
+        [_motionLink addToRunLoop:[NSRunLoop mainRunLoop] forMode:NSRunLoopCommonModes];
+    }
+    _motionLink.paused = NO;
+}
+
+- (void)motionLinkDidFire:(CADisplayLink *)displayLink {
+    if (!_source || _deadReckoningHorizon <= 0) {
+        displayLink.paused = YES;
+        return;
+    }
+
+    CFTimeInterval now = CACurrentMediaTime();
+    NSTimeInterval horizon = _deadReckoningHorizon;
+    // Half a point in metres at the equator; before a viewport is known every step is drawn
+    double minStep = _hasViewport ? kMinStepPoints * 2.0 * M_PI * kEarthRadius / (kWorldPointsAtZoom0 * exp2(_zoomLevel)) : 0;
+
+    __block BOOL moving = NO;
+    [_motionById enumerateKeysAndObjectsUsingBlock:^(NSString *markerId, SCMapLibreTrackMotion *motion, BOOL *stop) {
+        MLNPointFeature *feature = self.featuresById[markerId];
+        if (motion.settled || !feature) {
+            return;
+        }
+
+        CFTimeInterval elapsed = now - motion.anchorTime;
+        CLLocationCoordinate2D coordinate = SCDeadReckonedCoordinate(motion.anchor, motion.course,
+                                                                     motion.speed * MIN(elapsed, horizon));
+        double fade = 1.0 - elapsed / kCorrectionDuration;
+        if (fade > 0) {
+            coordinate.latitude += motion.correctionLatitude * fade;
+            coordinate.longitude = SCNormalizedLongitude(coordinate.longitude + motion.correctionLongitude * fade);
+        }
+
+        // Past the horizon a marker holds its last extrapolated position
+        BOOL done = (motion.speed == 0 || elapsed >= horizon) && fade <= 0;
+        if (done) {
+            motion.settled = YES;
+        } else {
+            moving = YES;
+            CLLocationCoordinate2D drawn = feature.coordinate;
+            double step = SCOffsetDistance(coordinate.latitude - drawn.latitude,
+                                           SCNormalizedLongitude(coordinate.longitude - drawn.longitude), drawn.latitude);
+            if (step < minStep * cos(drawn.latitude * M_PI / 180.0)) {
+                return;
+            }
+        }
+        [self moveFeature:feature markerId:markerId to:coordinate];
+    }];
+
+    [self commit];
+    if (!moving) {
+        displayLink.paused = YES;
+    }
+}
+
+#pragma mark - Style
+
+- (void)attachToStyle:(MLNStyle *)style {
+    // A style reload drops our source and layer, so always start over
+    [self detach];
+
+    [SCMapLibreTrackLayer registerDefaultIconsInStyle:style];
+
+    MLNShapeSource *source = [[MLNShapeSource alloc] initWithIdentifier:_identifier
+                                                                 shape:[MLNShapeCollectionFeature shapeCollectionWithShapes:[self renderedFeatures]]
+                                                               options:nil];
+    MLNSymbolStyleLayer *layer = [[MLNSymbolStyleLayer alloc] initWithIdentifier:_identifier source:source];
+
+    // Clusters are drawn by their own layers below
+    layer.predicate = [NSPredicate predicateWithFormat:@"cluster != YES"];
+    layer.iconImageName = [NSExpression expressionForKeyPath:@"icon"];
+    layer.iconRotation = [NSExpression expressionWithFormat:@"mgl_coalesce({heading, 0})"];
+    layer.iconRotationAlignment = [NSExpression expressionForConstantValue:@"map"];
+    // Tracks must never be hidden by symbol collision; it also skips placement work
+    layer.iconAllowsOverlap = [NSExpression expressionForConstantValue:@YES];
+    layer.iconIgnoresPlacement = [NSExpression expressionForConstantValue:@YES];
+
+    layer.text = [NSExpression expressionForKeyPath:@"title"];
+    layer.textFontSize = [NSExpression expressionForConstantValue:@11];
+    layer.textAnchor = [NSExpression expressionForConstantValue:@"top"];
+    layer.textOffset = [NSExpression expressionForConstantValue:[NSValue valueWithCGVector:CGVectorMake(0, 1.2)]];
+    layer.textOptional = [NSExpression expressionForConstantValue:@YES];
+    layer.textColor = [NSExpression expressionForConstantValue:[UIColor blackColor]];
+    layer.textHaloColor = [NSExpression expressionForConstantValue:[UIColor whiteColor]];
+    layer.textHaloWidth = [NSExpression expressionForConstantValue:@1];
+
+    NSPredicate *clusterPredicate = [NSPredicate predicateWithFormat:@"cluster == YES"];
+
+    MLNCircleStyleLayer *clusterLayer = [[MLNCircleStyleLayer alloc] initWithIdentifier:[self clusterLayerIdentifier]
+                                                                                 source:source];
+    clusterLayer.predicate = clusterPredicate;
+    clusterLayer.circleColor = [NSExpression expressionForConstantValue:[UIColor colorWithRed:0.20 green:0.45 blue:0.85 alpha:0.85]];
+    clusterLayer.circleRadius = [NSExpression expressionWithFormat:
+        @"mgl_step:from:stops:(point_count, 14, %@)", @{@10: @17, @100: @21, @1000: @26}];
+    clusterLayer.circleStrokeColor = [NSExpression expressionForConstantValue:[UIColor whiteColor]];
+    clusterLayer.circleStrokeWidth = [NSExpression expressionForConstantValue:@2];
+
+    MLNSymbolStyleLayer *clusterCountLayer = [[MLNSymbolStyleLayer alloc] initWithIdentifier:[self clusterCountLayerIdentifier]
+                                                                                      source:source];
+    clusterCountLayer.predicate = clusterPredicate;
+    clusterCountLayer.text = [NSExpression expressionForKeyPath:@"point_count_abbreviated"];
+    clusterCountLayer.textFontSize = [NSExpression expressionForConstantValue:@12];
+    clusterCountLayer.textColor = [NSExpression expressionForConstantValue:[UIColor whiteColor]];
+    clusterCountLayer.textAllowsOverlap = [NSExpression expressionForConstantValue:@YES];
+    clusterCountLayer.textIgnoresPlacement = [NSExpression expressionForConstantValue:@YES];
+
+    [style addSource:source];
+    [style addLayer:clusterLayer];
+    [style addLayer:clusterCountLayer];
+    [style addLayer:layer];
+
+    _style = style;
+    _source = source;
+    _layer = layer;
+    _clusterLayer = clusterLayer;
+    _clusterCountLayer = clusterCountLayer;
+    _dirty = NO;
+
+    [self startMotionLinkIfNeeded];
+}
+
+- (NSString *)clusterLayerIdentifier {
+    return [_identifier stringByAppendingString:@".clusters"];
+}
+
+- (NSString *)clusterCountLayerIdentifier {
+    return [_identifier stringByAppendingString:@".cluster-count"];
+}
+
+- (void)detach {
+    MLNStyle *style = _style;
+    if (style) {
+        if (_layer && [style layerWithIdentifier:_identifier]) {
+            [style removeLayer:_layer];
+        }
+        if (_clusterCountLayer && [style layerWithIdentifier:[self clusterCountLayerIdentifier]]) {
+            [style removeLayer:_clusterCountLayer];
+        }
+        if (_clusterLayer && [style layerWithIdentifier:[self clusterLayerIdentifier]]) {
+            [style removeLayer:_clusterLayer];
+        }
+        if (_source && [style sourceWithIdentifier:_identifier]) {
+            [style removeSource:_source];
+        }
+    }
+
+    _style = nil;
+    _source = nil;
+    _layer = nil;
+    _clusterLayer = nil;
+    _clusterCountLayer = nil;
+    _dirty = YES;
+
+    // Nothing to draw into; markers catch up when attached again
+    _motionLink.paused = YES;
+}
+
+// Simplified MIL-STD-2525 affiliation frames. Apps with a full symbol sprite
+// sheet in their style pass sprite names through the marker's `icon` field.
++ (void)registerDefaultIconsInStyle:(MLNStyle *)style {
+    if ([style imageForName:kIconFriend]) {
+        return;
+    }
+
+    UIColor *frameColor = [UIColor blackColor];
+    UIColor *friendFill = [UIColor colorWithRed:0.50 green:0.88 blue:1.00 alpha:1.0];
+    UIColor *hostileFill = [UIColor colorWithRed:1.00 green:0.50 blue:0.50 alpha:1.0];
+    UIColor *neutralFill = [UIColor colorWithRed:0.67 green:1.00 blue:0.67 alpha:1.0];
+    UIColor *unknownFill = [UIColor colorWithRed:1.00 green:1.00 blue:0.50 alpha:1.0];
+
+    // Friend: rectangle
+    [style setImage:[self frameImageWithSize:CGSizeMake(30, 20) fill:friendFill stroke:frameColor path:^UIBezierPath *(CGRect rect) {
+        return [UIBezierPath bezierPathWithRect:rect];
+    }] forName:kIconFriend];
+
+    // Hostile: diamond
+    [style setImage:[self frameImageWithSize:CGSizeMake(26, 26) fill:hostileFill stroke:frameColor path:^UIBezierPath *(CGRect rect) {
+        UIBezierPath *path = [UIBezierPath bezierPath];
+        [path moveToPoint:CGPointMake(CGRectGetMidX(rect), CGRectGetMinY(rect))];
+        [path addLineToPoint:CGPointMake(CGRectGetMaxX(rect), CGRectGetMidY(rect))];
+        [path addLineToPoint:CGPointMake(CGRectGetMidX(rect), CGRectGetMaxY(rect))];
+        [path addLineToPoint:CGPointMake(CGRectGetMinX(rect), CGRectGetMidY(rect))];
+        [path closePath];
+        return path;
+    }] forName:kIconHostile];
+
+    // Neutral: square
+    [style setImage:[self frameImageWithSize:CGSizeMake(22, 22) fill:neutralFill stroke:frameColor path:^UIBezierPath *(CGRect rect) {
+        return [UIBezierPath bezierPathWithRect:rect];
+    }] forName:kIconNeutral];
+
+    // Unknown: quatrefoil, approximated by a circle
+    [style setImage:[self frameImageWithSize:CGSizeMake(24, 24) fill:unknownFill stroke:frameColor path:^UIBezierPath *(CGRect rect) {
+        return [UIBezierPath bezierPathWithOvalInRect:rect];
+    }] forName:kIconUnknown];
+}
+
++ (UIImage *)frameImageWithSize:(CGSize)size
+                           fill:(UIColor *)fill
+                         stroke:(UIColor *)stroke
+                           path:(UIBezierPath *(^)(CGRect rect))makePath {
+    UIGraphicsImageRenderer *renderer = [[UIGraphicsImageRenderer alloc] initWithSize:size];
+    return [renderer imageWithActions:^(UIGraphicsImageRendererContext *context) {
+        UIBezierPath *path = makePath(CGRectInset(CGRectMake(0, 0, size.width, size.height), 1.5, 1.5));
+        path.lineWidth = 1.5;
+        [fill setFill];
+        [stroke setStroke];
+        [path fill];
+        [path stroke];
+    }];
+}
+
+#pragma mark - Hit Testing
+
+- (nullable NSString *)markerIdAtPoint:(CGPoint)point inMapView:(MLNMapView *)mapView {
+    if (!_layer) {
+        return nil;
+    }
+
+    CGRect touchRect = CGRectMake(point.x - kTapRadius, point.y - kTapRadius, kTapRadius * 2, kTapRadius * 2);
+    NSArray<id<MLNFeature>> *features = [mapView visibleFeaturesInRect:touchRect
+                                          inStyleLayersWithIdentifiers:[NSSet setWithObject:_identifier]];
+
+    // Features come back topmost first
+    for (id<MLNFeature> feature in features) {
+        id markerId = [feature attributeForKey:@"id"];
+        if ([markerId isKindOfClass:[NSString class]]) {
+            return markerId;
+        }
+    }
+    return nil;
+}
+
+- (BOOL)expandClusterAtPoint:(CGPoint)point inMapView:(MLNMapView *)mapView {
+    if (!_clusterLayer || !_clusterIndex) {
+        return NO;
+    }
+
+    CGRect touchRect = CGRectMake(point.x - kTapRadius, point.y - kTapRadius, kTapRadius * 2, kTapRadius * 2);
+    NSArray<id<MLNFeature>> *features = [mapView visibleFeaturesInRect:touchRect
+                                          inStyleLayersWithIdentifiers:[NSSet setWithObject:[self clusterLayerIdentifier]]];
+    id<MLNFeature> cluster = features.firstObject;
+    if (!cluster) {
+        return NO;
+    }
+
+    NSInteger zoom = [_clusterIndex expansionZoomForClusterAtZoom:_clusterZoom coordinate:cluster.coordinate];
+    [mapView setCenterCoordinate:cluster.coordinate
+                       zoomLevel:MAX((double)zoom, mapView.zoomLevel + 1)
+                        animated:YES];
+    return YES;
+}
+
+@end